@@ -22,6 +22,7 @@
 
 #define OPENGL_INTEROP
 #include "example_cuda_shared.h"
+#include "example_material_pipeline.h"
 
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
@@ -503,6 +504,8 @@ struct Options {
     std::string outputfile;
     std::vector<std::string> material_names;
     std::vector<std::string> mdl_paths;
+    std::string target_code_cache_dir;
+    unsigned int compile_threads;
 
     // Default constructor, sets default values.
     Options()
@@ -531,6 +534,8 @@ struct Options {
     , outputfile("output.exr")
     , material_names()
     , mdl_paths()
+    , target_code_cache_dir()
+    , compile_threads(0)
     {}
 };
 
@@ -715,9 +720,9 @@ public:
 
     // Constructor.
     Resource_table(
-        mi::base::Handle<mi::neuraylib::ITarget_code const> target_code,
-        mi::base::Handle<mi::neuraylib::ITransaction>       transaction,
-        Kind                                                kind)
+        Target_code_snapshot const                    &target_code,
+        mi::base::Handle<mi::neuraylib::ITransaction>  transaction,
+        Kind                                           kind)
     : m_max_len(0u)
     {
         read_resources(target_code, transaction, kind);
@@ -731,15 +736,15 @@ public:
 
 private:
     void read_resources(
-        mi::base::Handle<mi::neuraylib::ITarget_code const> target_code,
-        mi::base::Handle<mi::neuraylib::ITransaction>       transaction,
-        Kind                                                kind)
+        Target_code_snapshot const                    &target_code,
+        mi::base::Handle<mi::neuraylib::ITransaction>  transaction,
+        Kind                                           kind)
     {
         m_urls.push_back("<unset>");
         switch (kind) {
         case RESOURCE_TEXTURE:
-            for (mi::Size i = 1, n = target_code->get_texture_count(); i < n; ++i) {
-                const char *s = target_code->get_texture(i);
+            for (mi::Size i = 1, n = target_code.textures.size(); i < n; ++i) {
+                const char *s = target_code.textures[i].db_name.c_str();
                 mi::base::Handle<mi::neuraylib::ITexture const> tex(
                     transaction->access<mi::neuraylib::ITexture>(s));
                 char const *url = nullptr;
@@ -758,8 +763,8 @@ private:
             }
             break;
         case RESOURCE_LIGHT_PROFILE:
-            for (mi::Size i = 1, n = target_code->get_light_profile_count(); i < n; ++i) {
-                const char *s = target_code->get_light_profile(i);
+            for (mi::Size i = 1, n = target_code.light_profiles.size(); i < n; ++i) {
+                const char *s = target_code.light_profiles[i].c_str();
                 mi::base::Handle<mi::neuraylib::ILightprofile const> lp(
                     transaction->access<mi::neuraylib::ILightprofile>(s));
                 char const *url = lp->get_filename();
@@ -773,8 +778,8 @@ private:
             }
             break;
         case RESOURCE_BSDF_MEASUREMENT:
-            for (mi::Size i = 1, n = target_code->get_bsdf_measurement_count(); i < n; ++i) {
-                const char *s = target_code->get_bsdf_measurement(i);
+            for (mi::Size i = 1, n = target_code.bsdf_measurements.size(); i < n; ++i) {
+                const char *s = target_code.bsdf_measurements[i].c_str();
                 mi::base::Handle<mi::neuraylib::IBsdf_measurement const> bm(
                     transaction->access<mi::neuraylib::IBsdf_measurement>(s));
                 char const *url = bm->get_filename();
@@ -802,7 +807,7 @@ class String_constant_table
     typedef std::map<std::string, unsigned> String_map;
 public:
     // Constructor.
-    String_constant_table(mi::base::Handle<mi::neuraylib::ITarget_code const> target_code)
+    String_constant_table(Target_code_snapshot const &target_code)
     {
         get_all_strings(target_code);
     }
@@ -840,13 +845,13 @@ public:
 private:
     // Get all string constants used inside a target code and their maximum length.
     void get_all_strings(
-        mi::base::Handle<mi::neuraylib::ITarget_code const> target_code)
+        Target_code_snapshot const &target_code)
     {
         m_max_len = 0;
         // ignore the 0, it is the "Not-a-known-string" entry
-        m_strings.reserve(target_code->get_string_constant_count());
-        for (mi::Size i = 1, n = target_code->get_string_constant_count(); i < n; ++i) {
-            const char *s = target_code->get_string_constant(i);
+        m_strings.reserve(target_code.string_constants.size());
+        for (mi::Size i = 1, n = target_code.string_constants.size(); i < n; ++i) {
+            const char *s = target_code.string_constants[i].c_str();
             size_t l = strlen(s);
             if (l > m_max_len)
                 m_max_len = l;
@@ -919,7 +924,7 @@ static void render_scene(
     mi::base::Handle<mi::neuraylib::ITransaction>         transaction,
     mi::base::Handle<mi::neuraylib::IImage_api>           image_api,
     mi::base::Handle<mi::neuraylib::IMdl_compiler>        mdl_compiler,
-    mi::base::Handle<mi::neuraylib::ITarget_code const>   target_code,
+    Target_code_snapshot const                           &target_code,
     Material_compiler::Material_definition_list const    &material_defs,
     Material_compiler::Compiled_material_list const      &compiled_materials,
     std::vector<size_t> const                            &arg_block_indices,
@@ -1003,7 +1008,7 @@ static void render_scene(
     update_camera(kernel_params, phi, theta, base_dist, window_context.zoom);
 
     // Build the full CUDA kernel with all the generated code
-    std::vector<mi::base::Handle<const mi::neuraylib::ITarget_code> > target_codes;
+    std::vector<Target_code_snapshot> target_codes;
     target_codes.push_back(target_code);
     CUfunction  cuda_function;
     char const *ptx_name = options.enable_derivatives ?
@@ -1051,7 +1056,7 @@ static void render_scene(
         // Prepare the needed data of all target codes for the GPU
         Material_gpu_context material_gpu_context(options.enable_derivatives);
         if (!material_gpu_context.prepare_target_code_data(
-                transaction.get(), image_api.get(), target_code.get(), arg_block_indices))
+                transaction.get(), image_api.get(), target_code, arg_block_indices))
             terminate();
         kernel_params.tc_data = reinterpret_cast<Target_code_data *>(
             material_gpu_context.get_device_target_code_data_list());
@@ -1077,12 +1082,14 @@ static void render_scene(
             size_t arg_block_index = material_gpu_context.get_bsdf_argument_block_index(i);
             mi::base::Handle<mi::neuraylib::ITarget_value_layout const> layout(
                 material_gpu_context.get_argument_block_layout(arg_block_index));
-            mi::base::Handle<mi::neuraylib::ITarget_argument_block> arg_block(
-                material_gpu_context.get_argument_block(arg_block_index));
-            char *arg_block_data = arg_block != nullptr ? arg_block->get_data() : nullptr;
+            char *arg_block_data = material_gpu_context.get_argument_block_data(arg_block_index);
+
+            // Without the layout, which is not available for code restored from the target
+            // code cache, the arguments cannot be edited
+            mi::Size num_params = layout ? cur_mat->get_parameter_count() : 0;
 
             Material_info mat_info(cur_def->get_mdl_name());
-            for (mi::Size j = 0, num_params = cur_mat->get_parameter_count(); j < num_params; ++j) {
+            for (mi::Size j = 0; j < num_params; ++j) {
                 const char *name = cur_mat->get_parameter_name(j);
                 if (name == nullptr) continue;
 
@@ -1790,6 +1797,9 @@ static void usage(const char *name)
         << "--noaa                      disable pixel oversampling\n"
         << "-d                          enable use of derivatives\n"
         << " --fold_ternary_on_df       fold all ternary operators on *df types (default: false)\n"
+        << "--tc_cache <dir>            cache the generated code in the existing directory <dir>\n"
+        << "--threads <num>             number of threads compiling the materials\n"
+        << "                            (default: number of hardware threads)\n"
         << "\n"
         << "Note: material names can end with an '*' as a wildcard\n"
         << "      and alternatively, full MDLE file paths can be passed as material name\n";
@@ -1860,6 +1870,10 @@ int main(int argc, char* argv[])
                 options.enable_derivatives = true;
             } else if (strcmp(opt, "--fold_ternary_on_df") == 0) {
                 options.fold_ternary_on_df = true;
+            } else if (strcmp(opt, "--tc_cache") == 0 && i < argc - 1) {
+                options.target_code_cache_dir = argv[++i];
+            } else if (strcmp(opt, "--threads") == 0 && i < argc - 1) {
+                options.compile_threads = unsigned(std::max(atoi(argv[++i]), 0));
             } else {
                 std::cout << "Unknown option: \"" << opt << "\"" << std::endl;
                 usage(argv[0]);
@@ -1904,13 +1918,62 @@ int main(int argc, char* argv[])
     check_start_success(result);
 
     {
-        // Create a transaction
         mi::base::Handle<mi::neuraylib::IDatabase> database(
             neuray->get_api_component<mi::neuraylib::IDatabase>());
         mi::base::Handle<mi::neuraylib::IScope> scope(database->get_global_scope());
-        mi::base::Handle<mi::neuraylib::ITransaction> transaction(scope->create_transaction());
         mi::base::Handle<mi::neuraylib::IMdl_factory> mdl_factory(
             neuray->get_api_component<mi::neuraylib::IMdl_factory>());
+
+        // Expand the material name patterns
+        std::vector<std::string> used_material_names;
+        std::vector<Material_compile_pipeline::Result> compile_results;
+        {
+            Material_compile_pipeline pipeline(
+                mdl_compiler.get(),
+                mdl_factory.get(),
+                scope.get(),
+                options.compile_threads,
+                options.fold_ternary_on_df);
+
+            for (size_t i = 0; i < options.material_names.size(); ++i) {
+                std::string material_name(options.material_names[i]);
+                if (!Material_compile_pipeline::is_mdle_name(material_name)
+                        && !starts_with(material_name, "::"))
+                    material_name = "::" + material_name;
+
+                // Is this a material name pattern?
+                if (material_name.size() > 1 && material_name.back() == '*') {
+                    std::string pattern = material_name.substr(0, material_name.size() - 1);
+
+                    std::vector<std::string> module_materials(pipeline.get_material_names(
+                        Material_compiler::get_module_name(material_name)));
+
+                    for (size_t j = 0, n = module_materials.size(); j < n; ++j) {
+                        material_name = module_materials[j];
+
+                        // remove database name prefix
+                        if (starts_with(material_name, "mdl::"))
+                            material_name = material_name.substr(3);
+
+                        // make sure the material name starts with the pattern
+                        if (!starts_with(material_name, pattern))
+                            continue;
+
+                        used_material_names.push_back(material_name);
+                    }
+                } else
+                    used_material_names.push_back(material_name);
+            }
+
+            // Instantiate and compile all materials in parallel within one transaction
+            std::cout << "Compiling " << used_material_names.size() << " material(s) using "
+                << pipeline.get_thread_count() << " thread(s)..." << std::endl;
+            check_success(pipeline.compile(
+                used_material_names, options.use_class_compilation, compile_results));
+        }
+
+        // Create a transaction, which sees the compiled materials
+        mi::base::Handle<mi::neuraylib::ITransaction> transaction(scope->create_transaction());
         {
             // Initialize the material compiler with 16 result buffer slots ("texture results")
             Material_compiler mc(
@@ -1924,6 +1987,10 @@ int main(int argc, char* argv[])
                 options.enable_derivatives,
                 options.fold_ternary_on_df);
 
+            Target_code_cache target_code_cache(options.target_code_cache_dir);
+            if (target_code_cache.is_enabled())
+                mc.set_target_code_cache(&target_code_cache);
+
             // List of materials in the scene
             std::vector<Df_cuda_material> material_bundle;
 
@@ -1940,66 +2007,39 @@ int main(int argc, char* argv[])
             descs.push_back(
                 mi::neuraylib::Target_function_description("thin_walled"));
 
-            // Generate code for all materials
-            std::vector<std::string> used_material_names;
-            for (size_t i = 0; i < options.material_names.size(); ++i) {
-                std::string material_name(options.material_names[i]);
-                if (!mc.is_mdle_name(material_name) && !starts_with(material_name, "::"))
-                    material_name = "::" + material_name;
-
-                // Is this a material name pattern?
-                if (material_name.size() > 1 && material_name.back() == '*') {
-                    std::string pattern = material_name.substr(0, material_name.size() - 1);
-
-                    std::vector<std::string> module_materials(mc.get_material_names(
-                        mc.get_module_name(material_name)));
-
-                    for (size_t j = 0, n = module_materials.size(); j < n; ++j) {
-                        material_name = module_materials[j];
-
-                        // remove database name prefix
-                        if (starts_with(material_name, "mdl::"))
-                            material_name = material_name.substr(3);
-
-                        // make sure the material name starts with the pattern
-                        if (!starts_with(material_name, pattern))
-                            continue;
-
-                        std::cout << "Adding material \"" << material_name << "\"..." << std::endl;
-
-                        // Add functions of the material to the link unit
-                        check_success(mc.add_material(
-                            material_name,
-                            descs.data(), descs.size(),
-                            options.use_class_compilation));
-
-                        // Create application material representation
-                        material_bundle.push_back(create_cuda_material(
-                            0, material_bundle.size(), descs));
-                        used_material_names.push_back(material_name);
-                    }
-                } else {
-                    std::cout << "Adding material \"" << material_name << "\"..." << std::endl;
-
-                    // Add functions of the material to the link unit
-                    check_success(mc.add_material(
-                        material_name,
-                        descs.data(), descs.size(),
-                        options.use_class_compilation));
-
-                    // Create application material representation
-                    material_bundle.push_back(create_cuda_material(
-                        0, material_bundle.size(), descs));
-                    used_material_names.push_back(material_name);
-                }
+            // Add the compiled materials to the link unit in the order of the command line
+            for (size_t i = 0, n = compile_results.size(); i < n; ++i) {
+                const Material_compile_pipeline::Result &compiled = compile_results[i];
+                std::cout << "Adding material \"" << compiled.material_name << "\"..."
+                    << std::endl;
+
+                mi::base::Handle<const mi::neuraylib::IMaterial_definition> material_definition(
+                    transaction->access<mi::neuraylib::IMaterial_definition>(
+                        compiled.definition_db_name.c_str()));
+                mi::base::Handle<const mi::neuraylib::ICompiled_material> compiled_material(
+                    transaction->access<mi::neuraylib::ICompiled_material>(
+                        compiled.compiled_material_db_name.c_str()));
+
+                // Add functions of the material to the link unit
+                check_success(mc.add_compiled_material(
+                    material_definition.get(),
+                    compiled_material.get(),
+                    descs.data(), descs.size(),
+                    options.use_class_compilation));
+
+                // Create application material representation
+                material_bundle.push_back(create_cuda_material(
+                    0, material_bundle.size(), descs));
             }
 
             // Update the material names with the actually used names
             options.material_names = used_material_names;
 
             // Generate the CUDA PTX code for the link unit
-            mi::base::Handle<const mi::neuraylib::ITarget_code> target_code(
-                mc.generate_cuda_ptx());
+            Target_code_snapshot target_code(mc.generate_cuda_ptx());
+            if (target_code_cache.is_enabled())
+                std::cout << "Target code cache: " << target_code_cache.get_hit_count()
+                    << " hits, " << target_code_cache.get_miss_count() << " misses." << std::endl;
 
             // Acquire image API needed to prepare the textures
             mi::base::Handle<mi::neuraylib::IImage_api> image_api(
@@ -2018,6 +2058,9 @@ int main(int argc, char* argv[])
                 material_bundle);
         }
 
+        // The compiled materials are not needed anymore after rendering
+        Material_compile_pipeline::remove_compiled_materials(transaction.get(), compile_results);
+
         transaction->commit();
     }
 
@@ -7,7 +7,14 @@
 // Introduces the distillation of mdl materials to a fixed target model
 // and showcases how to bake material paths to a texture
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -15,7 +22,10 @@
 
 #include <mi/mdl_sdk.h>
 #include "example_shared.h"
+#include "example_bake_cache.h"
 #include "example_distilling_shared.h"
+#include "example_material_pipeline.h"
+#include "example_thread_pool.h"
 
 // Small struct used to store the result of a texture baking process
 // of a material sub expression
@@ -31,7 +41,22 @@ struct Material_parameter
 
     Remap_func*                                 remap_func;
 
-    Material_parameter() : remap_func(nullptr)
+    mi::Uint32                                  resolution;     // width and height of textures
+    mi::Uint32                                  samples;        // baking samples per texel
+    mi::Float32                                 bake_error;     // error of an adaptive bake,
+                                                                // negative if not estimated
+
+    mi::Sint32                                  bake_result;    // result of the baker
+    mi::Sint32                                  export_result;  // result of the texture export
+    std::string                                 file_name;      // name of the exported texture
+
+    Material_parameter()
+        : remap_func(nullptr)
+        , resolution(1024)
+        , samples(4)
+        , bake_error(-1.0f)
+        , bake_result(0)
+        , export_result(0)
     {
 
     }
@@ -41,6 +66,11 @@ struct Material_parameter
         Remap_func* func = nullptr)
         : value_type(value_type)
         , remap_func(func)
+        , resolution(1024)
+        , samples(4)
+        , bake_error(-1.0f)
+        , bake_result(0)
+        , export_result(0)
     {
 
     }
@@ -48,6 +78,48 @@ struct Material_parameter
 
 typedef std::map<std::string, Material_parameter> Material;
 
+// Texture resolution and number of samples used for baking, with optional
+// overrides for individual material parameters
+struct Bake_settings
+{
+    mi::Uint32                          resolution;
+    mi::Uint32                          samples;
+
+    std::map<std::string, mi::Uint32>   parameter_resolution;
+    std::map<std::string, mi::Uint32>   parameter_samples;
+
+    // Adaptive baking first bakes a probe texture and uses the smallest resolution,
+    // or a constant, that reproduces the probe within the error threshold
+    bool                                adaptive;
+    mi::Uint32                          probe_resolution;   // power of two
+    mi::Float32                         error_threshold;    // RMS error per component
+
+    Bake_settings()
+        : resolution(1024)
+        , samples(4)
+        , adaptive(false)
+        , probe_resolution(64)
+        , error_threshold(0.01f)
+    {
+
+    }
+
+    // Sets resolution and samples of all parameters of the given material
+    void apply(Material& material) const
+    {
+        for(Material::iterator it = material.begin(); it != material.end(); ++it)
+        {
+            std::map<std::string, mi::Uint32>::const_iterator r =
+                parameter_resolution.find(it->first);
+            std::map<std::string, mi::Uint32>::const_iterator s =
+                parameter_samples.find(it->first);
+
+            it->second.resolution = r != parameter_resolution.end() ? r->second : resolution;
+            it->second.samples = s != parameter_samples.end() ? s->second : samples;
+        }
+    }
+};
+
 // Configure the mdl compiler.
 void configure(
     mi::neuraylib::IMdl_compiler* compiler,
@@ -61,52 +133,6 @@ void configure(
     check_success(compiler->load_plugin_library("nv_freeimage" MI_BASE_DLL_FILE_EXT) == 0);
 }
 
-// Creates an instance of the given material.
-mi::neuraylib::IMaterial_instance* create_material_instance(
-    mi::neuraylib::ITransaction* transaction,
-    mi::neuraylib::IMdl_compiler* mdl_compiler,
-    mi::neuraylib::IMdl_execution_context* context,
-    const std::string& material_name)
-{
-    // Load mdl module.
-    std::string module_name = get_module_name(material_name);
-    check_success(mdl_compiler->load_module(transaction, module_name.c_str(), context) >= 0);
-    print_messages(context);
-
-    // Create a material instance from the material definition 
-    // with the default arguments.
-    const char *prefix = (material_name.find("::") == 0) ? "mdl" : "mdl::";
-    std::string material_db_name = prefix + material_name;
-
-    mi::base::Handle<const mi::neuraylib::IMaterial_definition> material_definition(
-        transaction->access<mi::neuraylib::IMaterial_definition>(
-            material_db_name.c_str()));
-
-    mi::Sint32 result;
-    mi::neuraylib::IMaterial_instance* material_instance =
-        material_definition->create_material_instance(0, &result);
-    check_success(result == 0);
-
-    return material_instance;
-}
-
-// Compiles the given material instance in the given compilation modes and stores
-// it in the DB.
-mi::neuraylib::ICompiled_material* compile_material_instance(
-    const mi::neuraylib::IMaterial_instance* material_instance,
-    mi::neuraylib::IMdl_execution_context* context,
-    bool class_compilation)
-{
-    mi::Uint32 flags = class_compilation
-        ? mi::neuraylib::IMaterial_instance::CLASS_COMPILATION
-        : mi::neuraylib::IMaterial_instance::DEFAULT_OPTIONS;
-   mi::neuraylib::ICompiled_material* compiled_material =
-        material_instance->create_compiled_material(flags, context);
-    check_success(print_messages(context));
-
-    return compiled_material;
-}
-
 // Distills the given compiled material to the requested target model, 
 // and returns it
 const mi::neuraylib::ICompiled_material* create_distilled_material(
@@ -435,93 +461,22 @@ void setup_target_material(
     }
 }
 
-// Constructs a material for the target model, extracts the bake paths relevant for this
-// model from the compiled material and bakes those paths into textures or constant values
-void bake_target_material_inputs(
-    mi::neuraylib::Baker_resource baker_resource,
-    mi::Uint32 baking_samples,
-    mi::neuraylib::ITransaction* transaction,
-    const mi::neuraylib::ICompiled_material* cm,
-    mi::neuraylib::IMdl_distiller_api* distiller_api,
-    mi::neuraylib::IImage_api* image_api,
-    Material& out_material)
-{
-    for(Material::iterator it = out_material.begin();
-        it != out_material.end(); ++it)
-    {
-        Material_parameter& param =  it->second;
-
-        // Do not attempt to bake empty paths
-        if(param.bake_path.empty())
-            continue;
-
-        // Create baker for current path
-        mi::base::Handle<const mi::neuraylib::IBaker> baker(distiller_api->create_baker(
-            cm, param.bake_path.c_str(), baker_resource));
-        check_success(baker.is_valid_interface());
-
-        if(baker->is_uniform())
-        {
-            mi::base::Handle<mi::IData> value;
-            if(param.value_type == "Rgb_fp")
-            {
-                mi::base::Handle<mi::IColor> v(
-                    transaction->create<mi::IColor>());
-                value = v->get_interface<mi::IData>();
-            }
-            else if(param.value_type == "Float32<3>")
-            {
-                mi::base::Handle<mi::IFloat32_3> v(
-                    transaction->create<mi::IFloat32_3>());
-                value = v->get_interface<mi::IData>();
-            }
-            else if(param.value_type == "Float32")
-            {
-                mi::base::Handle<mi::IFloat32> v(
-                    transaction->create<mi::IFloat32>());
-                value = v->get_interface<mi::IData>();
-            }
-            else
-            {
-                std::cout << "Ignoring unsupported value type '" << param.value_type
-                    << "'" << std::endl;
-                continue;
-            }
-
-            // Bake constant value
-            mi::Sint32 result = baker->bake_constant(value.get());
-            check_success(result == 0);
-
-            if(param.remap_func)
-                param.remap_func(value.get());
-
-            param.value = value;
-        }
-        else
-        {
-            // Create a canvas
-            mi::base::Handle<mi::neuraylib::ICanvas> canvas(
-                image_api->create_canvas(param.value_type.c_str(), 1024, 1024));
-
-            // Bake texture
-            mi::Sint32 result = baker->bake_texture(canvas.get(), baking_samples);
-            check_success(result == 0);
-
-            if(param.remap_func)
-                param.remap_func(canvas.get());
-
-            param.texture = canvas;
-        }
-    }
-}
 
 template <typename T, typename U>
-void init_value(mi::neuraylib::ICanvas* canvas, mi::IData* value, T*& out_array, U& out_value)
+void init_value(
+    mi::neuraylib::ICanvas* canvas,
+    mi::IData* value,
+    T*& out_array,
+    U& out_value,
+    mi::Uint32& out_rx,
+    mi::Uint32& out_ry)
 {
     if(canvas)
     {
         mi::base::Handle<mi::neuraylib::ITile> tile(canvas->get_tile(0, 0));
         out_array =static_cast<T*>(tile->get_data());
+        out_rx = canvas->get_resolution_x();
+        out_ry = canvas->get_resolution_y();
     }
     else if(value)
     {
@@ -529,7 +484,18 @@ void init_value(mi::neuraylib::ICanvas* canvas, mi::IData* value, T*& out_array,
     }
 }
 
-void calculate_f0(mi::neuraylib::ITransaction* trans, Material& material)
+// Returns the index of the texel of a (sx, sy) texture that covers texel (x, y)
+// of a (rx, ry) texture. Parameters can be baked at different resolutions.
+inline mi::Uint32 texel_index(
+    mi::Uint32 x, mi::Uint32 y,
+    mi::Uint32 rx, mi::Uint32 ry,
+    mi::Uint32 sx, mi::Uint32 sy)
+{
+    return static_cast<mi::Uint32>(mi::Uint64(y) * sy / ry) * sx
+        + static_cast<mi::Uint32>(mi::Uint64(x) * sx / rx);
+}
+
+void calculate_f0(mi::neuraylib::IFactory* factory, Material& material)
 {
     // if refl_weight value exists and is zero, set f0 to zero, too
     if(material["f0_weight"].value)
@@ -539,7 +505,7 @@ void calculate_f0(mi::neuraylib::ITransaction* trans, Material& material)
 
         if(v==0.0f)
         {
-            material["f0"].value = create_value(trans, "Color", mi::Color(0.0f));
+            material["f0"].value = create_value(factory, "Color", mi::Color(0.0f));
             material["f0"].texture = 0;
             return;
         }
@@ -557,36 +523,518 @@ void calculate_f0(mi::neuraylib::ITransaction* trans, Material& material)
     mi::Float32* f0_weight = nullptr;
     mi::Float32* f0_refl = nullptr;
 
+    mi::Uint32 color_rx = rx, color_ry = ry;
+    mi::Uint32 weight_rx = rx, weight_ry = ry;
+    mi::Uint32 refl_rx = rx, refl_ry = ry;
+
     init_value(material["f0"].texture.get(), nullptr, 
-        f0, /* dummy */ f0_color_value);
+        f0, /* dummy */ f0_color_value, rx, ry);
 
     init_value(material["f0_color"].texture.get(), material["f0_color"].value.get(), 
-        f0_color, f0_color_value);
+        f0_color, f0_color_value, color_rx, color_ry);
     init_value(material["f0_weight"].texture.get(), material["f0_weight"].value.get(), 
-        f0_weight, f0_weight_value);
+        f0_weight, f0_weight_value, weight_rx, weight_ry);
     init_value(material["f0_refl"].texture.get(), material["f0_refl"].value.get(), 
-        f0_refl, f0_refl_value);
+        f0_refl, f0_refl_value, refl_rx, refl_ry);
 
-    const mi::Uint32 n =rx * ry;
-    for(mi::Uint32 i=0; i<n; ++i)
+    for(mi::Uint32 y=0; y<ry; ++y)
     {
-        const mi::Float32 t = (f0_weight ? f0_weight[i] : f0_weight_value) *
-            (f0_refl ? f0_refl[i] : f0_refl_value);
+        for(mi::Uint32 x=0; x<rx; ++x)
+        {
+            const mi::Uint32 i = y * rx + x;
+
+            const mi::Float32 t =
+                (f0_weight ? f0_weight[texel_index(x, y, rx, ry, weight_rx, weight_ry)]
+                           : f0_weight_value) *
+                (f0_refl ? f0_refl[texel_index(x, y, rx, ry, refl_rx, refl_ry)]
+                         : f0_refl_value);
 
-        f0[i][0] = (f0_color ? f0_color[i][0] : f0_color_value[0]) * t;
-        f0[i][1] = (f0_color ? f0_color[i][1] : f0_color_value[1]) * t;
-        f0[i][2] = (f0_color ? f0_color[i][2] : f0_color_value[2]) * t;
+            if(f0_color)
+            {
+                const mi::Float32_3& c = f0_color[texel_index(x, y, rx, ry, color_rx, color_ry)];
+                f0[i][0] = c[0] * t;
+                f0[i][1] = c[1] * t;
+                f0[i][2] = c[2] * t;
+            }
+            else
+            {
+                f0[i][0] = f0_color_value[0] * t;
+                f0[i][1] = f0_color_value[1] * t;
+                f0[i][2] = f0_color_value[2] * t;
+            }
+        }
+    }
+}
+
+// Returns the name of the IData type that stores a constant of the given value type,
+// or nullptr if the value type is not supported
+const char* get_data_type_name(const std::string& value_type)
+{
+    if(value_type == "Rgb_fp")
+        return "Color";
+    if(value_type == "Float32<3>")
+        return "Float32<3>";
+    if(value_type == "Float32")
+        return "Float32";
+    return nullptr;
+}
+
+// Returns the number of float components of a texel of the given value type
+mi::Uint32 get_component_count(const std::string& value_type)
+{
+    return value_type == "Float32" ? 1 : 3;
+}
+
+// Box-filters a square image of res x res texels down to (res / factor)^2 texels
+void downsample(
+    const std::vector<mi::Float32>& texels,
+    mi::Uint32 res,
+    mi::Uint32 components,
+    mi::Uint32 factor,
+    std::vector<mi::Float32>& out_texels)
+{
+    const mi::Uint32 low_res = res / factor;
+    const mi::Float32 weight = 1.0f / static_cast<mi::Float32>(factor * factor);
+
+    out_texels.assign(size_t(low_res) * low_res * components, 0.0f);
+    for(mi::Uint32 y=0; y<res; ++y)
+    {
+        for(mi::Uint32 x=0; x<res; ++x)
+        {
+            const mi::Float32* src = &texels[(size_t(y) * res + x) * components];
+            mi::Float32* dst =
+                &out_texels[(size_t(y / factor) * low_res + x / factor) * components];
+            for(mi::Uint32 c=0; c<components; ++c)
+                dst[c] += src[c] * weight;
+        }
+    }
+}
+
+// Returns the RMS difference per component between a square image of res x res texels and
+// the bilinear magnification of its low_res x low_res version
+mi::Float32 get_reconstruction_error(
+    const std::vector<mi::Float32>& texels,
+    mi::Uint32 res,
+    mi::Uint32 components,
+    const std::vector<mi::Float32>& low_texels,
+    mi::Uint32 low_res)
+{
+    const mi::Float32 scale = static_cast<mi::Float32>(low_res) / static_cast<mi::Float32>(res);
+
+    double sum = 0.0;
+    for(mi::Uint32 y=0; y<res; ++y)
+    {
+        const mi::Float32 fy = std::max((y + 0.5f) * scale - 0.5f, 0.0f);
+        const mi::Uint32 y0 = std::min(static_cast<mi::Uint32>(fy), low_res - 1);
+        const mi::Uint32 y1 = std::min(y0 + 1, low_res - 1);
+        const mi::Float32 ty = fy - static_cast<mi::Float32>(y0);
+
+        for(mi::Uint32 x=0; x<res; ++x)
+        {
+            const mi::Float32 fx = std::max((x + 0.5f) * scale - 0.5f, 0.0f);
+            const mi::Uint32 x0 = std::min(static_cast<mi::Uint32>(fx), low_res - 1);
+            const mi::Uint32 x1 = std::min(x0 + 1, low_res - 1);
+            const mi::Float32 tx = fx - static_cast<mi::Float32>(x0);
+
+            const mi::Float32* t00 = &low_texels[(size_t(y0) * low_res + x0) * components];
+            const mi::Float32* t01 = &low_texels[(size_t(y0) * low_res + x1) * components];
+            const mi::Float32* t10 = &low_texels[(size_t(y1) * low_res + x0) * components];
+            const mi::Float32* t11 = &low_texels[(size_t(y1) * low_res + x1) * components];
+            const mi::Float32* src = &texels[(size_t(y) * res + x) * components];
+
+            for(mi::Uint32 c=0; c<components; ++c)
+            {
+                const mi::Float32 top = t00[c] + (t01[c] - t00[c]) * tx;
+                const mi::Float32 bottom = t10[c] + (t11[c] - t10[c]) * tx;
+                const mi::Float32 d = top + (bottom - top) * ty - src[c];
+                sum += d * d;
+            }
+        }
+    }
+    return static_cast<mi::Float32>(
+        std::sqrt(sum / (double(res) * double(res) * double(components))));
+}
+
+// Finds the smallest power-of-two resolution below the probe resolution whose box-filtered
+// version of the probe reproduces the probe within the error threshold. A resolution of 1
+// means the probe is uniform. Returns false, if no such resolution exists.
+bool find_adaptive_resolution(
+    const std::vector<mi::Float32>& probe,
+    mi::Uint32 probe_res,
+    mi::Uint32 components,
+    mi::Float32 error_threshold,
+    mi::Uint32& out_res,
+    std::vector<mi::Float32>& out_texels,
+    mi::Float32& out_error)
+{
+    for(mi::Uint32 res = 1; res < probe_res; res *= 2)
+    {
+        downsample(probe, probe_res, components, probe_res / res, out_texels);
+        out_error = get_reconstruction_error(probe, probe_res, components, out_texels, res);
+        if(out_error <= error_threshold)
+        {
+            out_res = res;
+            return true;
+        }
     }
+    return false;
 }
 
+// Distills materials and bakes their parameters in parallel.
+//
+// Every material is distilled by a task of the bake pool. That task submits one task per bake
+// path, so the parameters of all materials are spread over all workers. Since the SDK supports
+// only one transaction at a time, all tasks share the transaction created by run(); they only
+// read from it. Baked textures are handed over to a separate export pool, which
+// encodes and writes them to disk while the remaining parameters are still being baked.
+// With a bake cache, textures of sub-expressions that were baked before are loaded instead.
+class Bake_pipeline
+{
+public:
+    // A material to distill and bake
+    struct Job
+    {
+        std::string         material_name;      // fully-qualified material name
+        std::string         compiled_material;  // DB name of the compiled material
+        Material            material;           // the parameters of the target model
+        bool                success;            // false, if the material was not distilled
+        std::atomic<size_t> pending;            // bake tasks that have not finished yet
+
+        Job() : success(false), pending(0)
+        {
+
+        }
+    };
+
+    // Creates the pipeline.
+    //
+    // \param num_threads           the number of bake threads, 0 selects the number of
+    //                              hardware threads
+    // \param num_export_threads    the number of threads that write textures
+    // \param bake_cache            the cache for baked textures, or nullptr
+    Bake_pipeline(
+        mi::neuraylib::INeuray* neuray,
+        mi::neuraylib::IScope* scope,
+        const std::string& target_model,
+        mi::neuraylib::Baker_resource baker_resource,
+        const Bake_settings& settings,
+        size_t num_threads,
+        size_t num_export_threads,
+        Bake_cache* bake_cache)
+        : m_distiller_api(neuray->get_api_component<mi::neuraylib::IMdl_distiller_api>())
+        , m_image_api(neuray->get_api_component<mi::neuraylib::IImage_api>())
+        , m_factory(neuray->get_api_component<mi::neuraylib::IFactory>())
+        , m_mdl_compiler(neuray->get_api_component<mi::neuraylib::IMdl_compiler>())
+        , m_scope(mi::base::make_handle_dup(scope))
+        , m_target_model(target_model)
+        , m_baker_resource(baker_resource)
+        , m_settings(settings)
+        , m_bake_cache(bake_cache)
+        , m_export_pool(num_export_threads)
+        , m_bake_pool(num_threads)
+    {
+
+    }
+
+    // Distills and bakes all jobs with a compiled material. Returns after all textures
+    // have been written.
+    void run(std::vector<std::unique_ptr<Job> >& jobs)
+    {
+        m_transaction = m_scope->create_transaction();
+
+        for(size_t i = 0; i < jobs.size(); ++i)
+        {
+            if(jobs[i]->compiled_material.empty())
+                continue;
+
+            Job* job = jobs[i].get();
+            m_bake_pool.submit([this, job](size_t) { distill(*job); });
+        }
+        m_bake_pool.wait();
+
+        m_transaction->commit();
+        m_transaction.reset();
+
+        m_export_pool.wait();
+    }
+
+private:
+    // Distills the material of a job and submits the bake tasks of its parameters.
+    void distill(Job& job)
+    {
+        mi::neuraylib::ITransaction* transaction = m_transaction.get();
+
+        mi::base::Handle<const mi::neuraylib::ICompiled_material> compiled_material(
+            transaction->access<mi::neuraylib::ICompiled_material>(
+                job.compiled_material.c_str()));
+        if(!compiled_material)
+            return;
 
-// Print some information about baked material parameters to the console and
-// save the baked textures to disk
+        mi::base::Handle<const mi::neuraylib::ICompiled_material> distilled_material(
+            create_distilled_material(
+                m_distiller_api.get(),
+                compiled_material.get(),
+                m_target_model.c_str()));
+
+        // Setup result material parameters relevant for the target model
+        // and collect bake paths
+        setup_target_material(
+            m_target_model, transaction, distilled_material.get(), job.material);
+        m_settings.apply(job.material);
+        job.success = true;
+
+        // Count the bake tasks before submitting them, so the first one to
+        // finish cannot complete the job
+        size_t num_bake_paths = 0;
+        for(Material::const_iterator it = job.material.begin();
+            it != job.material.end(); ++it)
+        {
+            if(!it->second.bake_path.empty())
+                ++num_bake_paths;
+        }
+        job.pending = num_bake_paths;
+        if(num_bake_paths == 0)
+        {
+            finish(job);
+            return;
+        }
+
+        for(Material::iterator it = job.material.begin();
+            it != job.material.end(); ++it)
+        {
+            // Do not attempt to bake empty paths
+            if(it->second.bake_path.empty())
+                continue;
+
+            const std::string* param_name = &it->first;
+            Material_parameter* param = &it->second;
+            m_bake_pool.submit(
+                [this, &job, param_name, param, distilled_material](size_t) {
+                    bake(distilled_material.get(), job, *param_name, *param);
+                });
+        }
+    }
+
+    // Bakes one parameter of a job. The task that bakes the last parameter completes the job.
+    void bake(
+        const mi::neuraylib::ICompiled_material* cm,
+        Job& job,
+        const std::string& param_name,
+        Material_parameter& param)
+    {
+        // Create baker for current path
+        mi::base::Handle<const mi::neuraylib::IBaker> baker(m_distiller_api->create_baker(
+            cm, param.bake_path.c_str(), m_baker_resource));
+
+        if(!baker.is_valid_interface())
+        {
+            param.bake_result = -1;
+        }
+        else if(baker->is_uniform())
+        {
+            mi::base::Handle<mi::IData> value;
+            const char* type_name = get_data_type_name(param.value_type);
+            if(type_name)
+                value = m_factory->create<mi::IData>(type_name);
+            else
+            {
+                std::stringstream message;
+                message << "Ignoring unsupported value type '" << param.value_type
+                    << "'" << std::endl;
+                std::cout << message.str();
+            }
+
+            if(value)
+            {
+                // Bake constant value
+                param.bake_result = baker->bake_constant(value.get());
+                if(param.bake_result == 0)
+                {
+                    if(param.remap_func)
+                        param.remap_func(value.get());
+
+                    param.value = value;
+                }
+            }
+        }
+        else
+        {
+            mi::base::Handle<mi::neuraylib::ICanvas> canvas;
+            mi::base::Handle<mi::IData> value;
+
+            // Identify the baked sub-expression for the bake cache
+            const mi::Uint64 expression_hash = m_bake_cache
+                ? Bake_cache::get_expression_hash(
+                    m_transaction.get(), cm, param.bake_path.c_str())
+                : 0;
+
+            if(!m_settings.adaptive
+                || param.resolution <= m_settings.probe_resolution
+                || !bake_adaptive(baker.get(), expression_hash, param, canvas, value))
+            {
+                // Bake texture
+                canvas = bake_texture(
+                    baker.get(), expression_hash, param, param.resolution, &param.bake_result);
+            }
+
+            if(param.bake_result == 0 && value)
+            {
+                if(param.remap_func)
+                    param.remap_func(value.get());
+
+                param.value = value;
+            }
+            else if(param.bake_result == 0)
+            {
+                if(param.remap_func)
+                    param.remap_func(canvas.get());
+
+                param.texture = canvas;
+                export_texture(job, param_name, param);
+            }
+        }
+
+        if(--job.pending == 0)
+            finish(job);
+    }
+
+    // Bakes a probe of a non-uniform parameter at the probe resolution and returns the
+    // smallest texture or the constant that reproduces the probe within the error threshold.
+    // Returns false, if the probe has details that require baking at the full resolution.
+    bool bake_adaptive(
+        const mi::neuraylib::IBaker* baker,
+        mi::Uint64 expression_hash,
+        Material_parameter& param,
+        mi::base::Handle<mi::neuraylib::ICanvas>& out_canvas,
+        mi::base::Handle<mi::IData>& out_value)
+    {
+        const mi::Uint32 probe_res = m_settings.probe_resolution;
+        mi::base::Handle<mi::neuraylib::ICanvas> probe(bake_texture(
+            baker, expression_hash, param, probe_res, &param.bake_result));
+        if(param.bake_result != 0)
+            return true;
+
+        const mi::Uint32 components = get_component_count(param.value_type);
+        const size_t n = size_t(probe_res) * probe_res * components;
+        std::vector<mi::Float32> texels;
+        {
+            mi::base::Handle<const mi::neuraylib::ITile> tile(probe->get_tile(0, 0));
+            const mi::Float32* data = static_cast<const mi::Float32*>(tile->get_data());
+            texels.assign(data, data + n);
+        }
+
+        mi::Uint32 res = 0;
+        std::vector<mi::Float32> low_texels;
+        if(!find_adaptive_resolution(texels, probe_res, components,
+            m_settings.error_threshold, res, low_texels, param.bake_error))
+        {
+            param.bake_error = -1.0f;
+            return false;
+        }
+
+        const char* type_name = get_data_type_name(param.value_type);
+        if(res == 1 && type_name)
+        {
+            // The parameter is uniform in practice, store its average
+            out_value = m_factory->create<mi::IData>(type_name);
+            if(components == 1)
+                mi::set_value(out_value.get(), low_texels[0]);
+            else if(param.value_type == "Rgb_fp")
+                mi::set_value(out_value.get(),
+                    mi::Color(low_texels[0], low_texels[1], low_texels[2]));
+            else
+                mi::set_value(out_value.get(),
+                    mi::Float32_3(low_texels[0], low_texels[1], low_texels[2]));
+            return true;
+        }
+
+        out_canvas = m_image_api->create_canvas(param.value_type.c_str(), res, res);
+        mi::base::Handle<mi::neuraylib::ITile> tile(out_canvas->get_tile(0, 0));
+        memcpy(tile->get_data(), low_texels.data(), low_texels.size() * sizeof(mi::Float32));
+        return true;
+    }
+
+    // Bakes a square texture of the given resolution, or loads it from the bake cache.
+    mi::neuraylib::ICanvas* bake_texture(
+        const mi::neuraylib::IBaker* baker,
+        mi::Uint64 expression_hash,
+        const Material_parameter& param,
+        mi::Uint32 resolution,
+        mi::Sint32* result)
+    {
+        if(m_bake_cache)
+            return m_bake_cache->bake_texture(baker, expression_hash,
+                param.value_type.c_str(), resolution, resolution, param.samples, result);
+
+        // Create a canvas
+        mi::base::Handle<mi::neuraylib::ICanvas> canvas(m_image_api->create_canvas(
+            param.value_type.c_str(), resolution, resolution));
+
+        *result = baker->bake_texture(canvas.get(), param.samples);
+        if(*result != 0)
+            return nullptr;
+
+        canvas->retain();
+        return canvas.get();
+    }
+
+    // Computes the parameters that are derived from baked parameters, once all parameters
+    // of the job are baked.
+    void finish(Job& job)
+    {
+        if(m_target_model != "specular_glossy")
+            return;
+
+        // the specular glossy models f0 parameter cannot
+        // be directly taken from the distilling result but
+        // needs to be calculated 
+        Material_parameter& f0 = job.material["f0"];
+        f0.texture = m_image_api->create_canvas("Rgb_fp", f0.resolution, f0.resolution);
+
+        calculate_f0(m_factory.get(), job.material);
+
+        if(f0.texture)
+            export_texture(job, "f0", f0);
+    }
+
+    // Hands a baked texture over to the export pool. The parameter must not be modified
+    // afterwards.
+    void export_texture(const Job& job, const std::string& param_name, Material_parameter& param)
+    {
+        std::stringstream file_name;
+        file_name << get_material_name(job.material_name) << "-" << param_name << ".png";
+        param.file_name = file_name.str();
+
+        Material_parameter* p = &param;
+        m_export_pool.submit([this, p](size_t) {
+            p->export_result = m_mdl_compiler->export_canvas(
+                p->file_name.c_str(), p->texture.get());
+        });
+    }
+
+    mi::base::Handle<mi::neuraylib::IMdl_distiller_api>         m_distiller_api;
+    mi::base::Handle<mi::neuraylib::IImage_api>                 m_image_api;
+    mi::base::Handle<mi::neuraylib::IFactory>                   m_factory;
+    mi::base::Handle<mi::neuraylib::IMdl_compiler>              m_mdl_compiler;
+    mi::base::Handle<mi::neuraylib::IScope>                     m_scope;
+
+    std::string                                                 m_target_model;
+    mi::neuraylib::Baker_resource                               m_baker_resource;
+    Bake_settings                                               m_settings;
+    Bake_cache*                                                 m_bake_cache;
+
+    mi::base::Handle<mi::neuraylib::ITransaction>               m_transaction;
+
+    // The export pool is destroyed last, bake tasks submit to it.
+    Thread_pool                                                 m_export_pool;
+    Thread_pool                                                 m_bake_pool;
+};
+
+// Print some information about baked material parameters to the console.
+// The baked textures have already been saved to disk by the bake pipeline.
 void process_target_material(
     const std::string& target_model,
-    const std::string& material_name,
-    const Material& material,
-    mi::neuraylib::IMdl_compiler* compiler)
+    const Material& material)
 {
     std::cout << "--------------------------------------------------------------------------------"
         << std::endl;
@@ -600,6 +1048,8 @@ void process_target_material(
         const std::string& param_name = it->first;
         const Material_parameter& param = it->second;
 
+        check_success(param.bake_result == 0);
+
         std::cout << "Parameter: '" << param_name << "': ";
         if(param.bake_path.empty())
         {
@@ -616,14 +1066,11 @@ void process_target_material(
 
         if(param.texture)
         {
-            std::cout << "texture." << std::endl << std::endl;
+            std::cout << "texture '" << param.file_name << "' ("
+                << param.texture->get_resolution_x() << "x"
+                << param.texture->get_resolution_y() << ")." << std::endl << std::endl;
 
-            // write texture to disc
-            std::stringstream file_name;
-            file_name << material_name << "-" << param_name << ".png";
-            
-            check_success(
-                compiler->export_canvas(file_name.str().c_str(), param.texture.get()) == 0);
+            check_success(param.export_result == 0);
         }
         else if(param.value)
         {
@@ -655,12 +1102,38 @@ void process_target_material(
                     << v.x << ", " << v.y << ", " << v.z << ")."<< std::endl << std::endl;
             }
         }
+        if(param.bake_error >= 0.0f)
+            std::cout << "Adaptive bake, estimated error " << param.bake_error << "."
+                << std::endl;
         std::cout 
             << "--------------------------------------------------------------------------------"
             << std::endl;
     }
 }
 
+// Writes the kind and resolution of all baked parameters to <material_name>-bake_info.txt,
+// so tools consuming the textures do not need to decode them to learn their size.
+// The error is the one estimated by adaptive baking, or -1.
+void write_bake_info(const std::string& material_name, const Material& material)
+{
+    std::ofstream file((material_name + "-bake_info.txt").c_str());
+    check_success(file.good());
+
+    file << "# parameter kind width height error file" << std::endl;
+    for(Material::const_iterator it = material.begin();
+        it != material.end(); ++it)
+    {
+        const Material_parameter& param = it->second;
+        if(param.texture)
+            file << it->first << " texture "
+                << param.texture->get_resolution_x() << " "
+                << param.texture->get_resolution_y() << " "
+                << param.bake_error << " " << param.file_name << std::endl;
+        else if(param.value)
+            file << it->first << " constant 1 1 " << param.bake_error << " -" << std::endl;
+    }
+}
+
 // Prints program usage
 static void usage(const char *name)
 {
@@ -671,16 +1144,55 @@ static void usage(const char *name)
         << "                      specular_glossy (default: ue4)\n"
         << "--baker_resource      baking device: gpu|cpu|gpu_with_cpu_fallback (default: cpu)\n"
         << "--samples             baking samples (default: 4)\n"
+        << "--resolution          baking resolution (default: 1024)\n"
+        << "--param_samples <parameter>=<samples>\n"
+        << "                      baking samples of one parameter, can occur multiple times.\n"
+        << "--param_resolution <parameter>=<resolution>\n"
+        << "                      baking resolution of one parameter, can occur multiple times.\n"
+        << "--threads             number of baking threads (default: number of cores)\n"
+        << "--export_threads      number of threads writing textures (default: 2)\n"
+        << "--adaptive            bake a probe first and reduce the resolution of\n"
+        << "                      parameters with little detail\n"
+        << "--probe_resolution    resolution of the adaptive probe, a power of two\n"
+        << "                      (default: 64)\n"
+        << "--error_threshold     maximum RMS error of adaptive bakes (default: 0.01)\n"
+        << "--bake_cache <dir>    reuse textures baked for the same sub-expressions by\n"
+        << "                      earlier materials or runs, stored in an existing directory\n"
         << "--mdl_path <path>     mdl search path, can occur multiple times.\n";
 
     exit(EXIT_FAILURE);
 }
 
+// Parses a positive number, returns 0 on failure
+static mi::Uint32 parse_count(const char* arg)
+{
+    const int value = atoi(arg);
+    return value > 0 ? static_cast<mi::Uint32>(value) : 0;
+}
+
+// Parses a "<parameter>=<value>" argument into the given map
+static bool parse_parameter_count(const char* arg, std::map<std::string, mi::Uint32>& out)
+{
+    const char* separator = strchr(arg, '=');
+    if (!separator || separator == arg)
+        return false;
+
+    const mi::Uint32 value = parse_count(separator + 1);
+    if (value == 0)
+        return false;
+
+    out[std::string(arg, separator)] = value;
+    return true;
+}
+
 int main(int argc, char* argv[])
 {
     std::string                     target_model = "ue4";
     mi::neuraylib::Baker_resource   baker_resource = mi::neuraylib::BAKE_ON_CPU;
-    mi::Uint32                      baking_samples = 4;
+    Bake_settings                   bake_settings;
+    size_t                          num_threads = 0;
+    size_t                          num_export_threads = 2;
+    std::string                     bake_cache_directory;
     std::vector<std::string>        material_names;
     std::vector<std::string>        mdl_paths = { get_samples_mdl_root() };
 
@@ -715,10 +1227,55 @@ int main(int argc, char* argv[])
             }
             else if (strcmp(opt, "--samples") == 0) {
                 if (i < argc - 1)
-                    baking_samples = static_cast<mi::Uint32>(atoi(argv[++i]));
+                    bake_settings.samples = static_cast<mi::Uint32>(atoi(argv[++i]));
+                else
+                    usage(argv[0]);
+            }
+            else if (strcmp(opt, "--resolution") == 0) {
+                if (i >= argc - 1 || (bake_settings.resolution = parse_count(argv[++i])) == 0)
+                    usage(argv[0]);
+            }
+            else if (strcmp(opt, "--param_samples") == 0) {
+                if (i >= argc - 1
+                    || !parse_parameter_count(argv[++i], bake_settings.parameter_samples))
+                    usage(argv[0]);
+            }
+            else if (strcmp(opt, "--param_resolution") == 0) {
+                if (i >= argc - 1
+                    || !parse_parameter_count(argv[++i], bake_settings.parameter_resolution))
+                    usage(argv[0]);
+            }
+            else if (strcmp(opt, "--adaptive") == 0) {
+                bake_settings.adaptive = true;
+            }
+            else if (strcmp(opt, "--probe_resolution") == 0) {
+                if (i >= argc - 1
+                    || (bake_settings.probe_resolution = parse_count(argv[++i])) == 0
+                    || (bake_settings.probe_resolution & (bake_settings.probe_resolution - 1)))
+                    usage(argv[0]);
+            }
+            else if (strcmp(opt, "--error_threshold") == 0) {
+                if (i < argc - 1)
+                    bake_settings.error_threshold = static_cast<mi::Float32>(atof(argv[++i]));
                 else
                     usage(argv[0]);
             }
+            else if (strcmp(opt, "--bake_cache") == 0) {
+                if (i < argc - 1)
+                    bake_cache_directory = argv[++i];
+                else
+                    usage(argv[0]);
+            }
+            else if (strcmp(opt, "--threads") == 0) {
+                if (i < argc - 1)
+                    num_threads = parse_count(argv[++i]);
+                else
+                    usage(argv[0]);
+            }
+            else if (strcmp(opt, "--export_threads") == 0) {
+                if (i >= argc - 1 || (num_export_threads = parse_count(argv[++i])) == 0)
+                    usage(argv[0]);
+            }
             else
                 usage(argv[0]);
         }
@@ -748,88 +1305,71 @@ int main(int argc, char* argv[])
         mi::base::Handle<mi::neuraylib::IMdl_factory> factory(
             neuray->get_api_component<mi::neuraylib::IMdl_factory>());
 
-        // Create a transaction
         mi::base::Handle<mi::neuraylib::IDatabase> database(
             neuray->get_api_component<mi::neuraylib::IDatabase>());
         mi::base::Handle<mi::neuraylib::IScope> scope(database->get_global_scope());
-        mi::base::Handle<mi::neuraylib::ITransaction> transaction(scope->create_transaction());
-
-        for(const auto& material_name : material_names)
-        {
-            // Create an execution context
-            mi::base::Handle<mi::neuraylib::IMdl_execution_context> context(
-                factory->create_execution_context());
-
-            // Load mdl module and create a material instance
-            mi::base::Handle<mi::neuraylib::IMaterial_instance> instance(
-                create_material_instance(
-                    transaction.get(),
-                    mdl_compiler.get(),
-                    context.get(),
-                    material_name));
-
-            // Compile the material instance
-            mi::base::Handle<const mi::neuraylib::ICompiled_material> compiled_material(
-                compile_material_instance(instance.get(), context.get(), false));
-
-            // Acquire distilling api used for material distilling and baking
-            mi::base::Handle<mi::neuraylib::IMdl_distiller_api> distilling_api(
-                neuray->get_api_component<mi::neuraylib::IMdl_distiller_api>());
-            
-            // Distill compiled material to diffuse/glossy material model
-            mi::base::Handle<const mi::neuraylib::ICompiled_material> distilled_material(
-                create_distilled_material(
-                    distilling_api.get(), 
-                    compiled_material.get(),
-                    target_model.c_str()));
-
-            // Acquire image api needed to create a canvas for baking
-            mi::base::Handle<mi::neuraylib::IImage_api> image_api(
-                neuray->get_api_component<mi::neuraylib::IImage_api>());
 
-            Material out_material;
-            // Setup result material parameters relevant for target_model
-            // and collect bake paths
-            setup_target_material(
-                target_model,
-                transaction.get(),
-                distilled_material.get(), 
-                out_material);
+        // Load mdl modules, create material instances and compile them in parallel
+        std::vector<Material_compile_pipeline::Result> compile_results;
+        {
+            Material_compile_pipeline compile_pipeline(
+                mdl_compiler.get(), factory.get(), scope.get(), num_threads);
+            check_success(compile_pipeline.compile(material_names, false, compile_results));
+        }
 
-            // Bake material inputs
-            bake_target_material_inputs(
-                baker_resource,
-                baking_samples,
-                transaction.get(),
-                distilled_material.get(), 
-                distilling_api.get(),
-                image_api.get(),
-                out_material);
-
-            if(target_model == "specular_glossy")
-            {
-                // the specular glossy models f0 parameter cannot
-                // be directly taken from the distilling result but
-                // needs to be calculated 
+        std::vector<std::unique_ptr<Bake_pipeline::Job> > jobs;
+        for (size_t i = 0; i < material_names.size(); ++i)
+        {
+            jobs.emplace_back(new Bake_pipeline::Job());
+            jobs.back()->material_name = material_names[i];
+            jobs.back()->compiled_material = compile_results[i].compiled_material_db_name;
+        }
 
-                // Create f0 canvas
-                out_material["f0"].texture = 
-                    image_api->create_canvas("Rgb_fp", 1024, 1024);
+        // Create the bake cache, if requested
+        std::unique_ptr<Bake_cache> bake_cache;
+        if (!bake_cache_directory.empty())
+        {
+            mi::base::Handle<mi::neuraylib::IImage_api> image_api(
+                neuray->get_api_component<mi::neuraylib::IImage_api>());
+            bake_cache.reset(new Bake_cache(image_api.get(), bake_cache_directory));
+        }
 
-                // fill it
-                calculate_f0(transaction.get(), out_material);
-            }
-            // Process resulting material, in this case we simply
-            // print some information about the baked parameters
-            // and save the textures to disk, if any
-            process_target_material(
+        // Distill the compiled materials to the target model, bake their
+        // parameters and save the textures to disk
+        {
+            Bake_pipeline bake_pipeline(
+                neuray.get(),
+                scope.get(),
                 target_model,
-                get_material_name(material_name),
-                out_material,
-                mdl_compiler.get());
+                baker_resource,
+                bake_settings,
+                num_threads,
+                num_export_threads,
+                bake_cache.get());
+            bake_pipeline.run(jobs);
         }
 
-        transaction->commit();
+        // The compiled materials are not needed anymore after distilling
+        {
+            mi::base::Handle<mi::neuraylib::ITransaction> transaction(
+                scope->create_transaction());
+            Material_compile_pipeline::remove_compiled_materials(
+                transaction.get(), compile_results);
+            transaction->commit();
+        }
+        if (bake_cache)
+            std::cout << "Bake cache: " << bake_cache->get_hit_count() << " hits, "
+                << bake_cache->get_miss_count() << " misses." << std::endl;
+
+        // Process resulting materials, in this case we simply
+        // print some information about the baked parameters
+        // and store their resolutions next to the textures
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            check_success(jobs[i]->success);
+            process_target_material(target_model, jobs[i]->material);
+            write_bake_info(get_material_name(jobs[i]->material_name), jobs[i]->material);
+        }
     }
 
     mdl_compiler = 0;
@@ -15,6 +15,7 @@
 #include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -22,6 +23,7 @@
 #include "example_shared.h"
 #include "example_glsl_shared.h"
 #include "example_distilling_shared.h"
+#include "example_bake_cache.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -64,6 +66,7 @@ struct Options {
     std::vector<std::string> material_names;
     std::string hdrfile;
     std::string outputfile;
+    std::string bake_cache;
 
     Options() 
         : show_window(true)
@@ -726,11 +729,13 @@ public:
     Mdl_ue4_baker(
         const Mdl_sdk_state& state,
         const mi::neuraylib::ICompiled_material* cm,
-        int baking_resolution_x, int baking_resolution_y)
+        int baking_resolution_x, int baking_resolution_y,
+        Bake_cache* bake_cache = nullptr)
         : m_sdk_state(state)
         , m_cm(mi::base::make_handle_dup(cm))
         , m_baking_resolution_x(baking_resolution_x)
         , m_baking_resolution_y(baking_resolution_y)
+        , m_bake_cache(bake_cache)
     {
         // initialize material parameters
         m_material_parameters["base_color"]          = Material_parameter("Rgb_fp");
@@ -831,6 +836,8 @@ private:
     int m_baking_resolution_x;
     int m_baking_resolution_y;
 
+    Bake_cache* m_bake_cache;
+
     // bake expressions to texture
     void bake_expressions()
     {
@@ -876,6 +883,21 @@ private:
                 mi::Sint32 result = baker->bake_constant(param.value.get());
                 check_success(result == 0);
             }
+            else if (m_bake_cache)
+            {
+                // Bake texture, unless the same sub-expression was baked before
+                mi::Sint32 result = 0;
+                mi::base::Handle<mi::neuraylib::ICanvas> canvas(m_bake_cache->bake_texture(
+                    baker.get(),
+                    Bake_cache::get_expression_hash(
+                        m_sdk_state.transaction.get(), m_cm.get(), param.bake_path.c_str()),
+                    param.pixel_type.c_str(),
+                    m_baking_resolution_x, m_baking_resolution_y, 1, &result));
+                check_success(result == 0);
+
+                m_textures.push_back(canvas);
+                param.canvas_index = m_textures.size() - 1;
+            }
             else
             {
                 // Create a canvas
@@ -2150,6 +2172,14 @@ static void render_scene(
     GLuint env_tex_id = 0, iblmap_id = 0, refmap_id = 0, brdflutid = 0;
     filterEnvTexture(state, options, env_tex_id, iblmap_id, refmap_id, brdflutid);
 
+    // Create the bake cache, if requested
+    std::unique_ptr<Bake_cache> bake_cache;
+    if (!options.bake_cache.empty()) {
+        mi::base::Handle<mi::neuraylib::IImage_api> image_api(
+            state.mdl_sdk->get_api_component<mi::neuraylib::IImage_api>());
+        bake_cache.reset(new Bake_cache(image_api.get(), options.bake_cache));
+    }
+
     // Create scene data
     std::vector<Mdl_pbr_shader*> pbr_shaders(distilled_materials.size() * 2, nullptr);
     const std::string exefolder = get_executable_folder();
@@ -2173,7 +2203,8 @@ static void render_scene(
             std::cout << "Generating shader " << window_context.material << " in " << mode << " mode...\n";
             auto &a = distilled_materials[window_context.material];
             auto mdl_ue4 = window_context.bake ?
-                (Mdl_ue4*)(new Mdl_ue4_baker(state, a.get(), options.baking_resolution_x, options.baking_resolution_y)) :
+                (Mdl_ue4*)(new Mdl_ue4_baker(state, a.get(), options.baking_resolution_x,
+                    options.baking_resolution_y, bake_cache.get())) :
                 (Mdl_ue4*)(new Mdl_ue4_glsl(state, a.get()));
             sphere_shader = new Mdl_pbr_shader(state, mdl_ue4, iblmap_id, refmap_id, brdflutid);
             sphere.bind_shader(sphere_shader);
@@ -2339,6 +2370,8 @@ static void usage(const char *name)
         << "--no_baking              do not bake UE4 material parameters to textures but generate"
                                      " GLSL code\n"
         << "-r <w> <h>               baking resolution (default: 2048x2048)\n"
+        << "--bake_cache <dir>       reuse textures baked for the same sub-expressions by\n"
+        << "                         earlier materials or runs, stored in an existing directory\n"
         << "--mdl_path <path>        mdl search path, can occur multiple times.\n";
 
     exit(EXIT_FAILURE);
@@ -2367,6 +2400,9 @@ static void parse(int argc, char **argv, Options &options)
             else if (strcmp(opt, "-o") == 0 && i < argc - 1) {
                 options.outputfile = argv[++i];
             }
+            else if (strcmp(opt, "--bake_cache") == 0 && i < argc - 1) {
+                options.bake_cache = argv[++i];
+            }
             else if (strcmp(opt, "-r") == 0 && i < argc - 2) {
                 options.baking_resolution_x = atoi(argv[++i]);
                 options.baking_resolution_y = atoi(argv[++i]);
@@ -73,4 +73,46 @@ namespace mdl_d3d12
             D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
         return true;
     }
+
+
+    bool Buffer::set_data(const void* data, size_t offset, size_t size)
+    {
+        if (offset > m_size_in_byte || size > m_size_in_byte - offset)
+            return false;
+
+        // copy the range to the upload buffer, nothing is read from it
+        void *mapped_data;
+        D3D12_RANGE read_range = {0, 0};
+        if (log_on_failure(m_upload_resource->Map(0, &read_range, &mapped_data),
+            "Failed to map upload buffer: " + m_debug_name, SRC))
+            return false;
+
+        memcpy(static_cast<char*>(mapped_data) + offset, data, size);
+        D3D12_RANGE written_range = {offset, offset + size};
+        m_upload_resource->Unmap(0, &written_range);
+        return true;
+    }
+
+
+    bool Buffer::upload(
+        D3DCommandList* command_list,
+        const std::vector<std::pair<size_t, size_t>>& ranges)
+    {
+        if (ranges.empty())
+            return true;
+
+        command_list->ResourceBarrier(
+            1, &CD3DX12_RESOURCE_BARRIER::Transition(m_resource.Get(), 
+            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+
+        // copy only the given ranges to actual resource
+        for (const auto& range : ranges)
+            command_list->CopyBufferRegion(
+                m_resource.Get(), range.first, m_upload_resource.Get(), range.first, range.second);
+
+        command_list->ResourceBarrier(
+            1, &CD3DX12_RESOURCE_BARRIER::Transition(m_resource.Get(), 
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+        return true;
+    }
 }
@@ -31,6 +31,14 @@ namespace mdl_d3d12
 
         bool upload(D3DCommandList* command_list);
 
+        /// copies a part of the data, beginning at the given offset, to the upload buffer
+        bool set_data(const void* data, size_t offset, size_t size);
+
+        /// copies the given (offset, size) ranges of the upload buffer to the actual resource
+        bool upload(
+            D3DCommandList* command_list,
+            const std::vector<std::pair<size_t, size_t>>& ranges);
+
         ID3D12Resource* get_resource() const { return m_resource.Get(); }
 
         bool get_shader_resource_view_description_raw(D3D12_SHADER_RESOURCE_VIEW_DESC& desc) const
@@ -12,6 +12,7 @@
 #include <iostream>
 #include <fstream>
 
+#include "example_argument_block.h"
 #include "example_shared.h"
 
 
@@ -1182,13 +1183,28 @@ namespace mdl_d3d12
 
     void Mdl_material::update_material_parameters()
     {
-        m_argument_block_data->set_data<char>(m_info->get_argument_block_data());
-
-        // assuming material parameters do not change on a per frame basis ...
-        Command_queue* command_queue = m_app->get_command_queue(D3D12_COMMAND_LIST_TYPE_DIRECT);
-        D3DCommandList* command_list = command_queue->get_command_list();
-        m_argument_block_data->upload(command_list);
-        command_queue->execute_command_list(command_list);
+        // find the byte ranges which changed since the last update
+        m_argument_block_manager->update_from(m_info->get_argument_block_data());
+        if (m_argument_block_manager->publish())
+        {
+            std::vector<Argument_block_span> spans;
+            const char* data = m_argument_block_manager->acquire(spans);
+            std::vector<std::pair<size_t, size_t>> ranges;
+            for (const auto& span : spans)
+            {
+                m_argument_block_data->set_data(data + span.offset, span.offset, span.size);
+                ranges.push_back(std::make_pair(span.offset, span.size));
+            }
+            m_argument_block_manager->release();
+
+            // assuming material parameters do not change on a per frame basis ...
+            // ... only the changed ranges are copied
+            Command_queue* command_queue =
+                m_app->get_command_queue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+            D3DCommandList* command_list = command_queue->get_command_list();
+            m_argument_block_data->upload(command_list, ranges);
+            command_queue->execute_command_list(command_list);
+        }
 
         m_constants.data.material_flags = static_cast<uint32_t>(m_flags);
     }
@@ -1255,6 +1271,8 @@ namespace mdl_d3d12
                 material_definition,
                 arg_layout.get(),
                 arg_block.get());
+            m_argument_block_manager.reset(new Argument_block_manager(
+                arg_layout.get(), arg_block.get()));
 
             m_argument_block_data = new Buffer(m_app, 
                 round_to_power_of_two(arg_block->get_size(), 4), m_name + "_ArgumentBlock");
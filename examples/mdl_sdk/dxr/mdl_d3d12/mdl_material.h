@@ -13,6 +13,9 @@
 #include "scene.h"
 #include "shader.h"
 #include <mi/mdl_sdk.h>
+#include <memory>
+
+class Argument_block_manager;
 
 namespace mdl_d3d12
 {
@@ -276,6 +279,10 @@ namespace mdl_d3d12
 
         Mdl_material_info* m_info;
 
+        // tracks the changes of the argument block since the last upload
+        // (incomplete type, so the destructor of Mdl_material is defined in the source file)
+        std::unique_ptr<Argument_block_manager> m_argument_block_manager;
+
         D3D12_GPU_DESCRIPTOR_HANDLE m_material_descriptor_heap_region;
     };
 }
@@ -48,6 +48,9 @@ struct Options {
     // List of MDL module paths.
     std::vector<std::string> mdl_paths;
 
+    // Directory of the persistent target code cache, empty if disabled.
+    std::string target_code_cache_dir;
+
     // The constructor.
     Options()
         : cuda_device(0)
@@ -68,7 +71,7 @@ struct Options {
 mi::neuraylib::ICanvas *bake_expression_cuda_ptx(
     mi::neuraylib::ITransaction       *transaction,
     mi::neuraylib::IImage_api         *image_api,
-    std::vector<mi::base::Handle<const mi::neuraylib::ITarget_code> > const &target_codes,
+    std::vector<Target_code_snapshot> const &target_codes,
     std::vector<size_t> const         &arg_block_indices,
     Options                           &options,
     mi::Uint32                         num_samples)
@@ -87,7 +90,7 @@ mi::neuraylib::ICanvas *bake_expression_cuda_ptx(
     Material_gpu_context material_gpu_context(options.enable_derivatives);
     for (size_t i = 0, num_target_codes = target_codes.size(); i < num_target_codes; ++i) {
         if (!material_gpu_context.prepare_target_code_data(
-                transaction, image_api, target_codes[i].get(), arg_block_indices))
+                transaction, image_api, target_codes[i], arg_block_indices))
             return nullptr;
     }
     CUdeviceptr device_tc_data_list = material_gpu_context.get_device_target_code_data_list();
@@ -146,6 +149,7 @@ void usage(char const *prog_name)
         << "                       (default: example_cuda_<material_pattern>.png)\n"
         << "  --mdl_path <path>    mdl search path, can occur multiple times.\n"
         << " --fold_ternary_on_df  fold all ternary operators on *df types\n"
+        << "  --tc_cache <dir>     cache the generated code in the existing directory <dir>\n"
         << "  <material_pattern>   a number from 1 to 2 ^ num_materials - 1 choosing which\n"
         << "                       material combination to use (default: 2 ^ num_materials - 1)\n"
         << "  <material_name*>     qualified name of materials to use. The example will try to\n"
@@ -188,6 +192,8 @@ int main(int argc, char* argv[])
                 options.mdl_paths.push_back(argv[++i]);
             } else if (strcmp(opt, "--fold_ternary_on_df") == 0) {
                 options.fold_ternary_on_df = true;
+            } else if (strcmp(opt, "--tc_cache") == 0 && i < argc - 1) {
+                options.target_code_cache_dir = argv[++i];
             } else {
                 std::cout << "Unknown option: \"" << opt << "\"" << std::endl;
                 usage(argv[0]);
@@ -248,7 +254,7 @@ int main(int argc, char* argv[])
         {
             // Generate code for material sub-expressions of different materials
             // according to the requested material pattern
-            std::vector<mi::base::Handle<const mi::neuraylib::ITarget_code> > target_codes;
+            std::vector<Target_code_snapshot> target_codes;
 
             Material_compiler mc(
                 mdl_compiler.get(),
@@ -261,6 +267,10 @@ int main(int argc, char* argv[])
                 options.enable_derivatives,
                 options.fold_ternary_on_df);
 
+            Target_code_cache target_code_cache(options.target_code_cache_dir);
+            if (target_code_cache.is_enabled())
+                mc.set_target_code_cache(&target_code_cache);
+
             for (unsigned i = 0, n = unsigned(options.material_names.size()); i < n; ++i) {
                 if ((options.material_pattern & (1 << i)) != 0) {
                     mc.add_material_subexpr(
@@ -272,6 +282,9 @@ int main(int argc, char* argv[])
 
             // Generate target code for link unit
             target_codes.push_back(mc.generate_cuda_ptx());
+            if (target_code_cache.is_enabled())
+                std::cout << "Target code cache: " << target_code_cache.get_hit_count()
+                    << " hits, " << target_code_cache.get_miss_count() << " misses." << std::endl;
 
             // Acquire image API needed to prepare the textures and to create a canvas for baking
             mi::base::Handle<mi::neuraylib::IImage_api> image_api(
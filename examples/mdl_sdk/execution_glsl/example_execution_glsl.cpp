@@ -17,6 +17,7 @@
 #include <mi/mdl_sdk.h>
 #include "example_shared.h"
 #include "example_glsl_shared.h"
+#include "example_target_code_cache.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -76,6 +77,9 @@ struct Options {
     // An result output file name for non-interactive mode.
     std::string outputfile;
 
+    // The directory of the persistent target code cache, empty if caching is disabled.
+    std::string target_code_cache_dir;
+
     // The constructor.
     Options()
         : no_window(false)
@@ -208,8 +212,7 @@ static GLFWwindow *init_opengl(Options const &options)
 
 // Generate GLSL source code for a function executing an MDL subexpression function
 // selected by a given id.
-static std::string generate_glsl_switch_func(
-    const mi::base::Handle<const mi::neuraylib::ITarget_code>& target_code)
+static std::string generate_glsl_switch_func(const Target_code_snapshot& target_code)
 {
     // Note: The "State" struct must be in sync with the struct in example_execution_glsl.frag and
     //       the code generated by the MDL SDK (see dumped code when enabling DUMP_GLSL).
@@ -225,7 +228,7 @@ static std::string generate_glsl_switch_func(
         "};\n"
         "\n"
         "uint get_mdl_num_mat_subexprs() { return " +
-        to_string(target_code->get_callable_function_count()) +
+        to_string(target_code.functions.size()) +
         "u; }\n"
         "\n";
 
@@ -234,15 +237,14 @@ static std::string generate_glsl_switch_func(
         "    switch(id) {\n";
 
     // Create one switch case for each callable function in the target code
-    for (size_t i = 0, num_target_codes = target_code->get_callable_function_count();
+    for (size_t i = 0, num_target_codes = target_code.functions.size();
           i < num_target_codes;
           ++i)
     {
-        std::string func_name(target_code->get_callable_function(i));
+        const std::string& func_name = target_code.functions[i].name;
 
         // Add prototype declaration
-        src += target_code->get_callable_function_prototype(
-            i, mi::neuraylib::ITarget_code::SL_GLSL);
+        src += target_code.functions[i].prototype;
         src += '\n';
 
         switch_func += "        case " + to_string(i) + "u: return " + func_name + "(state);\n";
@@ -257,8 +259,7 @@ static std::string generate_glsl_switch_func(
 }
 
 // Create the shader program with a fragment shader.
-static GLuint create_shader_program(
-    const mi::base::Handle<const mi::neuraylib::ITarget_code>& target_code)
+static GLuint create_shader_program(const Target_code_snapshot& target_code)
 {
     const GLuint program = glCreateProgram();
 
@@ -283,7 +284,7 @@ static GLuint create_shader_program(
 
     //fragment program 2, MDL implementation
     if (program) {
-        std::string code(target_code->get_code());
+        std::string code(target_code.code);
 #ifdef REMAP_NOISE_FUNCTIONS
         code.append(read_text_file(get_executable_folder() + "/" + "noise_no_lut.glsl"));
 #endif
@@ -379,21 +380,21 @@ public:
     bool prepare_material_data(
         mi::base::Handle<mi::neuraylib::ITransaction>       transaction,
         mi::base::Handle<mi::neuraylib::IImage_api>         image_api,
-        mi::base::Handle<const mi::neuraylib::ITarget_code> target_code);
+        const Target_code_snapshot&                         target_code);
 
     // Sets all collected material data in the OpenGL program.
     bool set_material_data();
 
 private:
     // Sets the read-only data segments in the current OpenGL program object.
-    void set_mdl_readonly_data(mi::base::Handle<const mi::neuraylib::ITarget_code> target_code);
+    void set_mdl_readonly_data(const Target_code_snapshot& target_code);
 
     // Prepare the texture identified by the texture_index for use by the texture access functions
     // in the OpenGL program.
     bool prepare_texture(
         mi::base::Handle<mi::neuraylib::ITransaction>       transaction,
         mi::base::Handle<mi::neuraylib::IImage_api>         image_api,
-        mi::base::Handle<const mi::neuraylib::ITarget_code> code_ptx,
+        const Target_code_snapshot&                         code,
         mi::Size                                            texture_index,
         GLuint                                              texture_array);
 
@@ -425,10 +426,9 @@ Material_opengl_context::~Material_opengl_context()
 }
 
 // Sets the read-only data segments in the current OpenGL program object.
-void Material_opengl_context::set_mdl_readonly_data(
-    mi::base::Handle<const mi::neuraylib::ITarget_code> target_code)
+void Material_opengl_context::set_mdl_readonly_data(const Target_code_snapshot& target_code)
 {
-    mi::Size num_uniforms = target_code->get_ro_data_segment_count();
+    mi::Size num_uniforms = target_code.ro_data_segments.size();
     if (num_uniforms == 0) return;
 
     if (use_ssbo()) {
@@ -438,12 +438,12 @@ void Material_opengl_context::set_mdl_readonly_data(
         glGenBuffers(GLsizei(num_uniforms), &m_buffer_objects[cur_buffer_offs]);
 
         for (mi::Size i = 0; i < num_uniforms; ++i) {
-            mi::Size segment_size = target_code->get_ro_data_segment_size(i);
-            char const* segment_data = target_code->get_ro_data_segment_data(i);
+            mi::Size segment_size = target_code.ro_data_segments[i].data.size();
+            char const* segment_data = target_code.ro_data_segments[i].data.data();
 
 #ifdef DUMP_GLSL
             std::cout << "Dump ro segment data " << i << " \""
-                << target_code->get_ro_data_segment_name(i) << "\" (size = "
+                << target_code.ro_data_segments[i].name.c_str() << "\" (size = "
                 << segment_size << "):\n" << std::hex;
 
             for (int j = 0; j < 16 && j < segment_size; ++j) {
@@ -456,7 +456,7 @@ void Material_opengl_context::set_mdl_readonly_data(
             glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(segment_size), segment_data, GL_STATIC_DRAW);
 
             GLuint block_index = glGetProgramResourceIndex(
-                m_program, GL_SHADER_STORAGE_BLOCK, target_code->get_ro_data_segment_name(i));
+                m_program, GL_SHADER_STORAGE_BLOCK, target_code.ro_data_segments[i].name.c_str());
             glShaderStorageBlockBinding(m_program, block_index, m_next_storage_block_binding);
             glBindBufferBase(
                 GL_SHADER_STORAGE_BUFFER,
@@ -472,11 +472,11 @@ void Material_opengl_context::set_mdl_readonly_data(
         std::vector<char const*> uniform_names;
         for (mi::Size i = 0; i < num_uniforms; ++i) {
 #ifdef DUMP_GLSL
-            mi::Size segment_size = target_code->get_ro_data_segment_size(i);
-            const char* segment_data = target_code->get_ro_data_segment_data(i);
+            mi::Size segment_size = target_code.ro_data_segments[i].data.size();
+            const char* segment_data = target_code.ro_data_segments[i].data.data();
 
             std::cout << "Dump ro segment data " << i << " \""
-                << target_code->get_ro_data_segment_name(i) << "\" (size = "
+                << target_code.ro_data_segments[i].name.c_str() << "\" (size = "
                 << segment_size << "):\n" << std::hex;
 
             for (int i = 0; i < 16 && i < segment_size; ++i) {
@@ -485,7 +485,7 @@ void Material_opengl_context::set_mdl_readonly_data(
             std::cout << std::dec << std::endl;
 #endif
 
-            uniform_names.push_back(target_code->get_ro_data_segment_name(i));
+            uniform_names.push_back(target_code.ro_data_segments[i].name.c_str());
         }
 
         std::vector<GLuint> uniform_indices(num_uniforms, 0);
@@ -505,8 +505,8 @@ void Material_opengl_context::set_mdl_readonly_data(
                 << ": 0x" << std::hex << uniform_type << std::dec << std::endl;
 #endif
 
-            mi::Size segment_size = target_code->get_ro_data_segment_size(i);
-            const char* segment_data = target_code->get_ro_data_segment_data(i);
+            mi::Size segment_size = target_code.ro_data_segments[i].data.size();
+            const char* segment_data = target_code.ro_data_segments[i].data.data();
 
             GLint uniform_location = glGetUniformLocation(m_program, uniform_names[i]);
 
@@ -589,13 +589,13 @@ void Material_opengl_context::set_mdl_readonly_data(
 bool Material_opengl_context::prepare_texture(
     mi::base::Handle<mi::neuraylib::ITransaction>       transaction,
     mi::base::Handle<mi::neuraylib::IImage_api>         image_api,
-    mi::base::Handle<const mi::neuraylib::ITarget_code> code,
+    const Target_code_snapshot&                         code,
     mi::Size                                            texture_index,
     GLuint                                              texture_obj)
 {
     // Get access to the texture data by the texture database name from the target code.
     mi::base::Handle<const mi::neuraylib::ITexture> texture(
-        transaction->access<mi::neuraylib::ITexture>(code->get_texture(texture_index)));
+        transaction->access<mi::neuraylib::ITexture>(code.textures[texture_index].db_name.c_str()));
     mi::base::Handle<const mi::neuraylib::IImage> image(
         transaction->access<mi::neuraylib::IImage>(texture->get_image()));
     mi::base::Handle<const mi::neuraylib::ICanvas> canvas(image->get_canvas());
@@ -631,8 +631,7 @@ bool Material_opengl_context::prepare_texture(
     }
 
     // This example supports only 2D textures
-    mi::neuraylib::ITarget_code::Texture_shape texture_shape =
-        code->get_texture_shape(texture_index);
+    mi::neuraylib::ITarget_code::Texture_shape texture_shape = code.textures[texture_index].shape;
     if (texture_shape == mi::neuraylib::ITarget_code::Texture_shape_2d) {
         mi::base::Handle<const mi::neuraylib::ITile> tile(canvas->get_tile(0, 0));
         mi::Float32 const *data = static_cast<mi::Float32 const *>(tile->get_data());
@@ -654,7 +653,7 @@ bool Material_opengl_context::prepare_texture(
 bool Material_opengl_context::prepare_material_data(
     mi::base::Handle<mi::neuraylib::ITransaction>       transaction,
     mi::base::Handle<mi::neuraylib::IImage_api>         image_api,
-    mi::base::Handle<const mi::neuraylib::ITarget_code> target_code)
+    const Target_code_snapshot&                         target_code)
 {
     // Handle the read-only data segments if necessary
     set_mdl_readonly_data(target_code);
@@ -663,7 +662,7 @@ bool Material_opengl_context::prepare_material_data(
     const size_t cur_tex_offs = m_texture_objects.size();
     m_material_texture_starts.push_back(GLuint(cur_tex_offs));
 
-    const mi::Size num_textures = target_code->get_texture_count();
+    const mi::Size num_textures = target_code.textures.size();
     if (num_textures > 1) {
         m_texture_objects.insert(m_texture_objects.end(), num_textures - 1, 0);
 
@@ -767,6 +766,7 @@ public:
         , m_transaction(nullptr)
         , m_context(nullptr)
         , m_link_unit()
+        , m_target_code_cache(nullptr)
     {}
 
     void init(
@@ -785,7 +785,15 @@ public:
     bool add_material(const std::string& material_name);
 
     // Generates GLSL target code for a subexpression of a given compiled material.
-    mi::base::Handle<const mi::neuraylib::ITarget_code> generate_glsl();
+    // If a target code cache is set, the code is taken from the cache if possible.
+    Target_code_snapshot generate_glsl();
+
+    // Sets a target code cache used by generate_glsl(), or nullptr to disable caching.
+    // The cache must outlive this object.
+    void set_target_code_cache(Target_code_cache *cache)
+    {
+        m_target_code_cache = cache;
+    }
 
 private:
     // Helper function to extract the module name from a fully-qualified material name.
@@ -803,6 +811,9 @@ private:
         mi::neuraylib::IMaterial_instance* material_instance,
         bool class_compilation);
 
+    // Sets a backend option and records it in the target code cache key.
+    void set_backend_option(const char* name, const char* value);
+
 private:
     mi::base::Handle<mi::neuraylib::IMdl_compiler> m_mdl_compiler;
     mi::base::Handle<mi::neuraylib::IMdl_backend>  m_be_glsl;
@@ -810,6 +821,9 @@ private:
     mi::base::Handle<mi::neuraylib::IMdl_execution_context>
                                                    m_context;
     mi::base::Handle<mi::neuraylib::ILink_unit> m_link_unit;
+
+    Target_code_cache          *m_target_code_cache;
+    Target_code_cache_key       m_target_code_key;
 };
 
 // Helper function to extract the module name from a fully-qualified material name.
@@ -873,19 +887,29 @@ mi::neuraylib::ICompiled_material *Material_compiler::compile_material_instance(
 }
 
 // Generates GLSL target code for a subexpression of a given compiled material.
-mi::base::Handle<const mi::neuraylib::ITarget_code> Material_compiler::generate_glsl()
+Target_code_snapshot Material_compiler::generate_glsl()
 {
-    mi::Sint32 result = -1;
+    // Try the cache first. All materials are compiled in instance compilation mode,
+    // so there are no argument blocks.
+    Target_code_snapshot snapshot;
+    if (m_target_code_cache &&
+            m_target_code_cache->load(m_target_code_key, m_transaction.get(), snapshot))
+        return snapshot;
+
     mi::base::Handle<const mi::neuraylib::ITarget_code> code_glsl(
         m_be_glsl->translate_link_unit(m_link_unit.get(), m_context.get()));
     check_success(print_messages(m_context.get()));
     check_success(code_glsl);
 
+    snapshot = Target_code_snapshot(code_glsl.get(), mi::neuraylib::ITarget_code::SL_GLSL);
+    if (m_target_code_cache)
+        m_target_code_cache->store(m_target_code_key, snapshot);
+
 #ifdef DUMP_GLSL
     std::cout << "Dumping GLSL code:\n\n" << code_glsl->get_code() << std::endl;
 #endif
 
-    return code_glsl;
+    return snapshot;
 }
 
 // Generates GLSL target code for a subexpression of a given material.
@@ -906,6 +930,11 @@ bool Material_compiler::add_material_subexpr(
 
     m_link_unit->add_material_expression(compiled_material.get(), path, fname, m_context.get());
 
+    // Everything influencing the generated code is part of the target code cache key
+    m_target_code_key.add(compiled_material->get_hash());
+    m_target_code_key.add(path);
+    m_target_code_key.add(fname);
+
     auto context = m_context.get();
     return print_messages(context);
 }
@@ -923,6 +952,9 @@ bool Material_compiler::add_material(const std::string& material_name)
 
     m_link_unit->add_material(compiled_material.get(), nullptr, 0, m_context.get());
 
+    // Everything influencing the generated code is part of the target code cache key
+    m_target_code_key.add(compiled_material->get_hash());
+
     auto context = m_context.get();
     return print_messages(context);
 }
@@ -939,47 +971,56 @@ void Material_compiler::init(
     m_transaction = (mi::base::make_handle_dup(transaction));
     m_context = (mdl_factory->create_execution_context());
 
-    check_success(m_be_glsl->set_option("num_texture_spaces", "1") == 0);
+    m_target_code_key.add(mi::Uint64(mi::neuraylib::IMdl_compiler::MB_GLSL));
+
+    set_backend_option("num_texture_spaces", "1");
 
     if (use_ssbo()) {
         // SSBO requires GLSL 4.30
-        check_success(m_be_glsl->set_option("glsl_version", "430") == 0);
+        set_backend_option("glsl_version", "430");
     }
     else {
-        check_success(m_be_glsl->set_option("glsl_version", "330") == 0);
+        set_backend_option("glsl_version", "330");
     }
 
     // Specify the implementation modes for some state functions.
     // Note that "geometry_normal", "normal" and "position" default to "field" mode.
-    check_success(m_be_glsl->set_option("glsl_state_animation_time_mode", "field") == 0);
-    check_success(m_be_glsl->set_option("glsl_state_position_mode", "func") == 0);
-    check_success(m_be_glsl->set_option("glsl_state_texture_coordinate_mode", "arg") == 0);
-    check_success(m_be_glsl->set_option("glsl_state_texture_tangent_u_mode", "field") == 0);
-    check_success(m_be_glsl->set_option("glsl_state_texture_tangent_v_mode", "field") == 0);
+    set_backend_option("glsl_state_animation_time_mode", "field");
+    set_backend_option("glsl_state_position_mode", "func");
+    set_backend_option("glsl_state_texture_coordinate_mode", "arg");
+    set_backend_option("glsl_state_texture_tangent_u_mode", "field");
+    set_backend_option("glsl_state_texture_tangent_v_mode", "field");
 
     if (use_ssbo()) {
-        check_success(m_be_glsl->set_option("glsl_max_const_data", "0") == 0);
-        check_success(m_be_glsl->set_option("glsl_place_uniforms_into_ssbo", "on") == 0);
+        set_backend_option("glsl_max_const_data", "0");
+        set_backend_option("glsl_place_uniforms_into_ssbo", "on");
     }
     else {
-        check_success(m_be_glsl->set_option("glsl_max_const_data", "1024") == 0);
-        check_success(m_be_glsl->set_option("glsl_place_uniforms_into_ssbo", "off") == 0);
+        set_backend_option("glsl_max_const_data", "1024");
+        set_backend_option("glsl_place_uniforms_into_ssbo", "off");
     }
 
 #ifdef REMAP_NOISE_FUNCTIONS
     // remap noise functions that access the constant tables
-    check_success(m_be_glsl->set_option(
+    set_backend_option(
         "glsl_remap_functions",
         "_ZN4base12perlin_noiseEu6float4=noise_float4"
         ",_ZN4base12worley_noiseEu6float3fi=noise_worley"
         ",_ZN4base8mi_noiseEu6float3=noise_mi_float3"
-        ",_ZN4base8mi_noiseEu4int3=noise_mi_int3") == 0);
+        ",_ZN4base8mi_noiseEu4int3=noise_mi_int3");
 #endif
 
     // After we set the options, we can create the link unit
     m_link_unit = mi::base::make_handle(m_be_glsl->create_link_unit(transaction, m_context.get()));
 }
 
+// Sets a backend option and records it in the target code cache key.
+void Material_compiler::set_backend_option(const char* name, const char* value)
+{
+    check_success(m_be_glsl->set_option(name, value) == 0);
+    m_target_code_key.add_option(name, value);
+}
+
 
 //------------------------------------------------------------------------------
 //
@@ -1027,6 +1068,7 @@ void usage(char const *prog_name)
         << "  --nowin             don't show interactive display\n"
         << "  --res <x> <y>       resolution (default: 1024x768)\n"
         << "  -o <outputfile>     image file to write result in nowin mode (default: output.png)\n"
+        << "  --tc_cache <dir>    cache the generated code in the existing directory <dir>\n"
         << "  <material_pattern>  a number from 1 to 7 choosing which material combination to use"
         << std::endl;
     keep_console_open();
@@ -1047,6 +1089,12 @@ static void parse(int argc, char **argv, Options &options)
                 else
                     usage(argv[0]);
             }
+            else if (strcmp(opt, "--tc_cache") == 0) {
+                if (i < argc - 1)
+                    options.target_code_cache_dir = argv[++i];
+                else
+                    usage(argv[0]);
+            }
             else if (strcmp(opt, "--res") == 0) {
                 if (i < argc - 2) {
                     options.res_x = std::max(atoi(argv[++i]), 1);
@@ -1068,7 +1116,9 @@ static void parse(int argc, char **argv, Options &options)
     }
 }
 
-static GLuint setup_material(mi::base::Handle<mi::neuraylib::INeuray> neuray)
+static GLuint setup_material(
+    mi::base::Handle<mi::neuraylib::INeuray> neuray,
+    const std::string& target_code_cache_dir)
 {
     // Create a transaction
     mi::base::Handle<mi::neuraylib::ITransaction> transaction; {
@@ -1078,9 +1128,12 @@ static GLuint setup_material(mi::base::Handle<mi::neuraylib::INeuray> neuray)
     }
 
     // Generate the GLSL code for the link unit.
-    mi::base::Handle<const mi::neuraylib::ITarget_code> target_code; {
+    Target_code_snapshot target_code; {
         // Access the MDL SDK compiler component
         Material_compiler mc;
+        Target_code_cache target_code_cache(target_code_cache_dir);
+        if (target_code_cache.is_enabled())
+            mc.set_target_code_cache(&target_code_cache);
         {
             // Access MDL factory
             mi::base::Handle<mi::neuraylib::IMdl_factory> mdl_factory(
@@ -1116,6 +1169,9 @@ static GLuint setup_material(mi::base::Handle<mi::neuraylib::INeuray> neuray)
         }
 
         target_code = mc.generate_glsl();
+        if (target_code_cache.is_enabled())
+            std::cout << "Target code cache: " << target_code_cache.get_hit_count() << " hits, "
+                << target_code_cache.get_miss_count() << " misses." << std::endl;
     }
 
     // Create shader program
@@ -1183,7 +1239,7 @@ int main(int argc, char* argv[])
         Options options;
         parse(argc, argv, options);
         window = init_opengl(options);
-        const GLuint program = setup_material(neuray);
+        const GLuint program = setup_material(neuray, options.target_code_cache_dir);
         show_and_animate_scene(window, program, window_context);
         glDeleteProgram(program);
     }
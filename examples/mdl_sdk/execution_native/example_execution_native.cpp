@@ -15,7 +15,9 @@
 
 #include <mi/mdl_sdk.h>
 
+#include "example_argument_block.h"
 #include "example_shared.h"
+#include "native_baker.h"
 #include "texture_support.h"
 #include <vector>
 
@@ -35,12 +37,25 @@ struct Options {
     bool use_custom_tex_runtime;
 
     // Whether derivative support should be enabled.
-    // This example does not support derivatives in combination with the custom texture runtime.
+    // In combination with the custom texture runtime, this enables mipmapped, anisotropic
+    // texture filtering.
     bool enable_derivatives;
 
+    // Number of baking threads, 0 uses all hardware threads.
+    unsigned num_threads;
+
+    // Edge length of the tiles the canvas is split into for baking.
+    unsigned tile_size;
+
+    // Whether the timing of the individual tiles should be printed.
+    bool print_tile_stats;
+
     // Material to use.
     std::string material_name;
 
+    // New values of float or color arguments of a class-compiled material.
+    std::vector<std::pair<std::string, float> > params;
+
     // List of MDL module paths.
     std::vector<std::string> mdl_paths;
 
@@ -51,18 +66,13 @@ struct Options {
         , use_class_compilation(false)
         , use_custom_tex_runtime(false)
         , enable_derivatives(false)
+        , num_threads(0)
+        , tile_size(64)
+        , print_tile_stats(false)
     {}
 };
 
 
-// The last row is always implied to be (0, 0, 0, 1).
-const mi::Float32_3_4 identity(
-    1.0f, 0.0f, 0.0f, 0.0f,
-    0.0f, 1.0f, 0.0f, 0.0f,
-    0.0f, 0.0f, 1.0f, 0.0f
-);
-
-
 // Helper function to extract the module name from a fully-qualified material name.
 std::string get_module_name(const std::string& material_name)
 {
@@ -157,184 +167,78 @@ mi::neuraylib::ITarget_code const *generate_native(
     return code_native.get();
 }
 
-// Bake the material expression created with the native backend into a canvas with the given
-// resolution.
-mi::neuraylib::ICanvas *bake_expression_native(
-    mi::neuraylib::IImage_api            *image_api,
-    mi::neuraylib::ITarget_code const    *code_native,
-    mi::neuraylib::Texture_handler_base  *tex_handler,
-    mi::Uint32                            width,
-    mi::Uint32                            height)
+// Changes float and color arguments of a class-compiled material in a copy of the argument block
+// of the target code, without generating new code, and returns the copy.
+mi::neuraylib::ITarget_argument_block *update_arguments(
+    mi::neuraylib::ITransaction* transaction,
+    const char* compiled_material_name,
+    const mi::neuraylib::ITarget_code* target_code,
+    const std::vector<std::pair<std::string, float> >& params)
 {
-    // Create a canvas (with only one tile)
-    mi::base::Handle<mi::neuraylib::ICanvas> canvas(
-        image_api->create_canvas("Rgb_fp", width, height));
-
-    // Setup MDL material state (with only one texture space)
-    mi::Float32_3_struct   texture_coords[1]    = { { 0.0f, 0.0f, 0.0f } };
-    mi::Float32_3_struct   texture_tangent_u[1] = { { 1.0f, 0.0f, 0.0f } };
-    mi::Float32_3_struct   texture_tangent_v[1] = { { 0.0f, 1.0f, 0.0f } };
-
-    mi::neuraylib::Shading_state_material mdl_state = {
-        /*normal=*/           { 0.0f, 0.0f, 1.0f },
-        /*geom_normal=*/      { 0.0f, 0.0f, 1.0f },
-        /*position=*/         { 0.0f, 0.0f, 0.0f },
-        /*animation_time=*/   0.0f,
-        /*texture_coords=*/   texture_coords,
-        /*tangent_u=*/        texture_tangent_u,
-        /*tangent_v=*/        texture_tangent_v,
-        /*text_results=*/     nullptr,
-        /*ro_data_segment=*/  nullptr,
-        /*world_to_object=*/  &identity[0],
-        /*object_to_world=*/  &identity[0],
-        /*object_id=*/        0
-    };
-
-    // Provide a large enough buffer for any result type.
-    // In this case, we know, we will get a color which is a float3, so this is overkill.
-    union
-    {
-        int                     int_val;
-        float                   float_val;
-        double                  double_val;
-        mi::Float32_3_struct    float3_val;
-        mi::Float32_4_struct    float4_val;
-        mi::Float32_4_4_struct  float4x4_val;
-        mi::Float64_3_struct    double3_val;
-        mi::Float64_4_struct    double4_val;
-        mi::Float64_4_4_struct  double4x4_val;
-    } execute_result = { 0 };
-
-    // Calculate all expression values for a 2x2 quad around the center of the world
-    // and write them to the canvas.
-    mi::base::Handle<mi::neuraylib::ITile> tile(canvas->get_tile(0, 0));
-    mi::Float32_3_struct *data = static_cast<mi::Float32_3_struct *>(tile->get_data());
-    for (mi::Uint32 y = 0; y < height; ++y) {
-        for (mi::Uint32 x = 0; x < width; ++x) {
-            // Update state for the current pixel
-            float rel_x = float(x) / float(width);
-            float rel_y = float(y) / float(height);
-            mdl_state.position.x = 2.0f * rel_x - 1;  // [-1, 1)
-            mdl_state.position.y = 2.0f * rel_y - 1;  // [-1, 1)
-            texture_coords[0].x  = rel_x;             // [0, 1)
-            texture_coords[0].y  = rel_y;             // [0, 1)
-
-            // Evaluate sub-expression
-            check_success(
-                code_native->execute(0, mdl_state, tex_handler, nullptr, &execute_result) == 0);
-
-            // Apply gamma correction
-            execute_result.float3_val.x = powf(execute_result.float3_val.x, 1.f / 2.2f);
-            execute_result.float3_val.y = powf(execute_result.float3_val.y, 1.f / 2.2f);
-            execute_result.float3_val.z = powf(execute_result.float3_val.z, 1.f / 2.2f);
-
-            // Store result in texture
-            data[y * width + x] = execute_result.float3_val;
-        }
+    if (target_code->get_argument_block_count() == 0) {
+        std::cout << "The material has no argument block, use class compilation to change "
+            "arguments." << std::endl;
+        return nullptr;
     }
 
-    canvas->retain();
-    return canvas.get();
-}
-
-// Bake the material expression created with the native backend into a canvas with the given
-// resolution with derivative support.
-mi::neuraylib::ICanvas *bake_expression_native_with_derivs(
-    mi::neuraylib::IImage_api            *image_api,
-    mi::neuraylib::ITarget_code const    *code_native,
-    mi::neuraylib::Texture_handler_base  *tex_handler,
-    mi::Uint32                            width,
-    mi::Uint32                            height)
-{
-    // Create a canvas (with only one tile)
-    mi::base::Handle<mi::neuraylib::ICanvas> canvas(
-        image_api->create_canvas("Rgb_fp", width, height));
-
-    // Setup MDL material state (with only one texture space)
-    float step_x = 1.f / width;
-    float step_y = 1.f / height;
+    mi::base::Handle<const mi::neuraylib::ICompiled_material> compiled_material(
+        transaction->access<mi::neuraylib::ICompiled_material>(compiled_material_name));
+    const mi::Size block_index = target_code->get_callable_function_argument_block_index(0);
+    mi::base::Handle<const mi::neuraylib::ITarget_value_layout> layout(
+        target_code->get_argument_block_layout(block_index));
+    mi::base::Handle<const mi::neuraylib::ITarget_argument_block> block(
+        target_code->get_argument_block(block_index));
+
+    // Write the new values directly at their offsets in the block.
+    Argument_block_manager manager(layout.get(), block.get());
+    for (const auto& param : params) {
+        mi::Size index = 0, n = compiled_material->get_parameter_count();
+        while (index < n && param.first != compiled_material->get_parameter_name(index))
+            ++index;
+        if (index == n) {
+            std::cout << "Unknown argument \"" << param.first << "\"." << std::endl;
+            continue;
+        }
 
-    mi::neuraylib::tct_deriv_float3 texture_coords[1] = {
-        {
-            { 0.0f, 0.0f, 0.0f },     // value component
-            { step_x, 0.0f, 0.0f },   // dx component
-            { 0.0f, step_y, 0.0f }    // dy component
-        } };
-    mi::neuraylib::tct_float3 texture_tangent_u[1] = { { 1.0f, 0.0f, 0.0f } };
-    mi::neuraylib::tct_float3 texture_tangent_v[1] = { { 0.0f, 1.0f, 0.0f } };
-
-    mi::neuraylib::Shading_state_material_with_derivs mdl_state = {
-        /*normal=*/           { 0.0f, 0.0f, 1.0f },
-        /*geom_normal=*/      { 0.0f, 0.0f, 1.0f },
-        /*position=*/         { 0.0f, 0.0f, 0.0f },
-        /*animation_time=*/   0.0f,
-        /*texture_coords=*/   texture_coords,
-        /*tangent_u=*/        texture_tangent_u,
-        /*tangent_v=*/        texture_tangent_v,
-        /*text_results=*/     nullptr,
-        /*ro_data_segment=*/  nullptr,
-        /*world_to_object=*/  &identity[0],
-        /*object_to_world=*/  &identity[0],
-        /*object_id=*/        0
-    };
-
-    // Provide a large enough buffer for any result type.
-    // In this case, we know, we will get a color which is a float3, so this is overkill.
-    union
-    {
-        int                     int_val;
-        float                   float_val;
-        double                  double_val;
-        mi::Float32_3_struct    float3_val;
-        mi::Float32_4_struct    float4_val;
-        mi::Float32_4_4_struct  float4x4_val;
-        mi::Float64_3_struct    double3_val;
-        mi::Float64_4_struct    double4_val;
-        mi::Float64_4_4_struct  double4x4_val;
-    } execute_result = { 0 };
-
-    // Calculate all expression values for a 2x2 quad around the center of the world
-    // and write them to the canvas.
-    mi::base::Handle<mi::neuraylib::ITile> tile(canvas->get_tile(0, 0));
-    mi::Float32_3_struct *data = static_cast<mi::Float32_3_struct *>(tile->get_data());
-    for (mi::Uint32 y = 0; y < height; ++y) {
-        for (mi::Uint32 x = 0; x < width; ++x) {
-            // Update state for the current pixel
-            float rel_x = x * step_x;
-            float rel_y = y * step_y;
-            mdl_state.position.x    = 2.0f * rel_x - 1;  // [-1, 1)
-            mdl_state.position.y    = 2.0f * rel_y - 1;  // [-1, 1)
-            texture_coords[0].val.x = rel_x;             // [0, 1)
-            texture_coords[0].val.y = rel_y;             // [0, 1)
-
-            // Evaluate sub-expression
-            check_success(code_native->execute(
-                0,
-                reinterpret_cast<mi::neuraylib::Shading_state_material &>(mdl_state),
-                tex_handler,
-                nullptr,
-                &execute_result) == 0);
-
-            // Apply gamma correction
-            execute_result.float3_val.x = powf(execute_result.float3_val.x, 1.f / 2.2f);
-            execute_result.float3_val.y = powf(execute_result.float3_val.y, 1.f / 2.2f);
-            execute_result.float3_val.z = powf(execute_result.float3_val.z, 1.f / 2.2f);
-
-            // Store result in texture
-            data[y * width + x] = execute_result.float3_val;
+        mi::neuraylib::Target_value_layout_state state = manager.get_argument_state(index);
+        mi::neuraylib::IValue::Kind kind;
+        mi::Size size;
+        layout->get_layout(kind, size, state);
+        bool success = false;
+        if (kind == mi::neuraylib::IValue::VK_FLOAT)
+            success = manager.set(state, param.second);
+        else if (kind == mi::neuraylib::IValue::VK_COLOR) {
+            success = true;
+            for (mi::Size i = 0, num = layout->get_num_elements(state); i < num; ++i)
+                success &= manager.set(manager.get_element_state(state, i), param.second);
         }
+        if (!success)
+            std::cout << "Argument \"" << param.first << "\" is neither a float nor a color."
+                << std::endl;
     }
 
-    canvas->retain();
-    return canvas.get();
+    // Hand the changes over to the reader side, which only has to copy the changed spans.
+    manager.publish();
+    std::vector<Argument_block_span> spans;
+    const char* data = manager.acquire(spans);
+    mi::neuraylib::ITarget_argument_block* result = block->clone();
+    for (const Argument_block_span& span : spans) {
+        std::cout << "Updated argument block bytes [" << span.offset << ", "
+            << span.offset + span.size << ")" << std::endl;
+        memcpy(result->get_data() + span.offset, data + span.offset, span.size);
+    }
+    manager.release();
+    return result;
 }
 
 // Prepare the textures for our own texture runtime.
+// If requested, the mipmap chains needed for filtered lookups with derivatives are created, too.
 bool prepare_textures(
     std::vector<Texture>& textures,
     mi::neuraylib::ITransaction* transaction,
     mi::neuraylib::IImage_api* image_api,
-    const mi::neuraylib::ITarget_code* target_code)
+    const mi::neuraylib::ITarget_code* target_code,
+    bool create_mipmaps)
 {
     for (mi::Size i = 1 /*skip invalid texture*/; i < target_code->get_texture_count(); ++i)
     {
@@ -372,11 +276,39 @@ bool prepare_textures(
             // Convert to expected format
             canvas = image_api->convert(canvas.get(), "Color");
         }
-        textures.push_back(Texture(canvas));
+        textures.push_back(Texture(
+            canvas, create_mipmaps ? image_api : nullptr, target_code->get_texture_shape(i)));
     }
     return true;
 }
 
+// Prepare the light profiles and BSDF measurements for our own texture runtime, including the
+// data needed for importance sampling.
+void prepare_light_profiles_and_mbsdfs(
+    std::vector<Lightprofile>& lightprofiles,
+    std::vector<Mbsdf>& mbsdfs,
+    mi::neuraylib::ITransaction* transaction,
+    const mi::neuraylib::ITarget_code* target_code)
+{
+    for (mi::Size i = 1 /*skip invalid light profile*/;
+            i < target_code->get_light_profile_count(); ++i)
+    {
+        mi::base::Handle<const mi::neuraylib::ILightprofile> lprof(
+            transaction->access<const mi::neuraylib::ILightprofile>(
+                target_code->get_light_profile(i)));
+        lightprofiles.push_back(Lightprofile(lprof.get()));
+    }
+
+    for (mi::Size i = 1 /*skip invalid mbsdf*/;
+            i < target_code->get_bsdf_measurement_count(); ++i)
+    {
+        mi::base::Handle<const mi::neuraylib::IBsdf_measurement> mbsdf(
+            transaction->access<const mi::neuraylib::IBsdf_measurement>(
+                target_code->get_bsdf_measurement(i)));
+        mbsdfs.push_back(Mbsdf(mbsdf.get()));
+    }
+}
+
 // Print command line usage to console and terminate the application.
 void usage(char const *prog_name)
 {
@@ -387,7 +319,12 @@ void usage(char const *prog_name)
         << "  --cc                use class compilation\n"
         << "  --cr                use custom texture runtime\n"
         << "  -d                  enable use of derivatives\n"
-        << "                      (not supported in combination with --cr by this example)\n"
+        << "                      (enables mipmapped texture filtering with --cr)\n"
+        << "  --threads <n>       number of baking threads (default: all hardware threads)\n"
+        << "  --tile <n>          edge length of the baking tiles (default: 64)\n"
+        << "  --tile_stats        print the timing of every baked tile\n"
+        << "  --param <name> <v>  set a float or color argument to v (requires --cc),\n"
+        << "                      can occur multiple times\n"
         << "  -o <outputfile>     image file to write result to\n"
         << "                      (default: example_native.png)\n"
         << "  --mdl_path <path>   mdl search path, can occur multiple times."
@@ -421,6 +358,15 @@ int main(int argc, char *argv[])
                 options.use_custom_tex_runtime = true;
             } else if (strcmp(opt, "-d") == 0) {
                 options.enable_derivatives = true;
+            } else if (strcmp(opt, "--threads") == 0 && i < argc - 1) {
+                options.num_threads = std::max(atoi(argv[++i]), 0);
+            } else if (strcmp(opt, "--tile") == 0 && i < argc - 1) {
+                options.tile_size = std::max(atoi(argv[++i]), 1);
+            } else if (strcmp(opt, "--tile_stats") == 0) {
+                options.print_tile_stats = true;
+            } else if (strcmp(opt, "--param") == 0 && i < argc - 2) {
+                const char* name = argv[++i];
+                options.params.push_back(std::make_pair(name, float(atof(argv[++i]))));
             } else if (strcmp(opt, "--mdl_path") == 0 && i < argc - 1) {
                 options.mdl_paths.push_back(argv[++i]);
             } else {
@@ -431,12 +377,6 @@ int main(int argc, char *argv[])
             options.material_name = opt;
     }
 
-    if (options.use_custom_tex_runtime && options.enable_derivatives) {
-        std::cout << "This example does not support using derivatives with the custom texture "
-            "runtime.\n";
-        usage(argv[0]);
-    }
-
     // Use default material, if none was provided via command line
     if (options.material_name.empty()) {
         options.mdl_paths.push_back(get_samples_mdl_root());
@@ -509,37 +449,82 @@ int main(int argc, char *argv[])
                     options.use_custom_tex_runtime,
                     options.enable_derivatives));
 
+            // Change arguments of the class-compiled material without generating new code
+            mi::base::Handle<mi::neuraylib::ITarget_argument_block> arg_block;
+            if (!options.params.empty())
+                arg_block = update_arguments(
+                    transaction.get(), compilation_name.c_str(), target_code.get(),
+                    options.params);
+
             // Acquire image API needed to create a canvas for baking
             mi::base::Handle<mi::neuraylib::IImage_api> image_api(
                 neuray->get_api_component<mi::neuraylib::IImage_api>());
 
             mi::base::Handle<mi::neuraylib::ICanvas> canvas;
 
-            std::vector<Texture>  textures;
-            Texture_handler       tex_handler;
-            Texture_handler      *tex_handler_ptr = nullptr;
+            std::vector<Texture>            textures;
+            std::vector<Lightprofile>       lightprofiles;
+            std::vector<Mbsdf>              mbsdfs;
+            Texture_handler                 tex_handler;
+            Texture_handler_deriv           tex_handler_deriv;
+            Texture_handler_base           *tex_handler_ptr = nullptr;
             if (options.use_custom_tex_runtime) {
                 // Setup custom texture handler
                 check_success(prepare_textures(
-                    textures, transaction.get(), image_api.get(), target_code.get()));
-
-                tex_handler.vtable = &tex_vtable;
-                tex_handler.num_textures = target_code->get_texture_count() - 1;
-                tex_handler.textures = textures.data();
-
-                tex_handler_ptr = &tex_handler;
+                    textures, transaction.get(), image_api.get(), target_code.get(),
+                    options.enable_derivatives));
+                prepare_light_profiles_and_mbsdfs(
+                    lightprofiles, mbsdfs, transaction.get(), target_code.get());
+
+                if (options.enable_derivatives) {
+                    tex_handler_deriv.vtable = &tex_deriv_vtable;
+                    tex_handler_deriv.num_textures = target_code->get_texture_count() - 1;
+                    tex_handler_deriv.textures = textures.data();
+                    tex_handler_deriv.num_lightprofiles = lightprofiles.size();
+                    tex_handler_deriv.lightprofiles = lightprofiles.data();
+                    tex_handler_deriv.num_mbsdfs = mbsdfs.size();
+                    tex_handler_deriv.mbsdfs = mbsdfs.data();
+
+                    // the generated code expects a Texture_handler_base pointer in any case
+                    tex_handler_ptr =
+                        reinterpret_cast<Texture_handler_base *>(&tex_handler_deriv);
+                } else {
+                    tex_handler.vtable = &tex_vtable;
+                    tex_handler.num_textures = target_code->get_texture_count() - 1;
+                    tex_handler.textures = textures.data();
+                    tex_handler.num_lightprofiles = lightprofiles.size();
+                    tex_handler.lightprofiles = lightprofiles.data();
+                    tex_handler.num_mbsdfs = mbsdfs.size();
+                    tex_handler.mbsdfs = mbsdfs.data();
+
+                    tex_handler_ptr = &tex_handler;
+                }
             }
 
             // Bake the expression into a canvas
-            if (options.enable_derivatives) {
-                canvas = bake_expression_native_with_derivs(
-                    image_api.get(), target_code.get(), tex_handler_ptr,
-                    options.res_x, options.res_y);
-            } else {
-                canvas = bake_expression_native(
-                    image_api.get(), target_code.get(), tex_handler_ptr,
-                    options.res_x, options.res_y);
+            Native_baker baker(image_api.get(), options.num_threads, options.tile_size);
+            std::vector<Bake_tile_stats> tile_stats;
+            canvas = baker.bake(
+                target_code.get(), tex_handler_ptr, arg_block.get(),
+                options.res_x, options.res_y,
+                options.enable_derivatives,
+                &tile_stats);
+            check_success(canvas);
+
+            double total_seconds = 0.0, max_seconds = 0.0;
+            for (Bake_tile_stats const &stats : tile_stats) {
+                total_seconds += stats.seconds;
+                max_seconds = std::max(max_seconds, stats.seconds);
+                if (options.print_tile_stats)
+                    std::cout << "Tile (" << stats.x << ", " << stats.y << ") "
+                        << stats.width << "x" << stats.height
+                        << " on worker " << stats.worker << ": "
+                        << stats.seconds * 1000.0 << " ms" << std::endl;
             }
+            std::cout << "Baked " << tile_stats.size() << " tiles on "
+                << baker.get_thread_count() << " threads, "
+                << "total tile time: " << total_seconds * 1000.0 << " ms, "
+                << "slowest tile: " << max_seconds * 1000.0 << " ms" << std::endl;
 
             // Export the canvas to an image on disk
             mdl_compiler->export_canvas(options.outputfile.c_str(), canvas.get());
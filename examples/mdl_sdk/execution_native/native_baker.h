@@ -0,0 +1,327 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/native_baker.h
+//
+// A multithreaded, tiled baking engine for material sub-expressions compiled with the
+// native backend.
+
+#ifndef NATIVE_BAKER_H
+#define NATIVE_BAKER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include <mi/mdl_sdk.h>
+
+#include "example_thread_pool.h"
+
+// Timing information about a single baked tile.
+struct Bake_tile_stats
+{
+    mi::Uint32 x, y;            // lower-left pixel of the tile in the canvas
+    mi::Uint32 width, height;   // number of pixels baked in this tile
+    size_t     worker;          // index of the worker thread which baked the tile
+    double     seconds;         // time spent in the tile
+};
+
+// Bakes a material sub-expression generated by the native backend into a canvas.
+//
+// The canvas is split into tiles which are distributed over a work-stealing thread pool. Every
+// worker owns its own MDL material state and result buffer, so tiles can be evaluated without
+// any synchronization. The expression is evaluated on the quad [-1, 1)^2 around the world origin
+// with texture coordinates in [0, 1)^2 and the result is expected to be a color.
+class Native_baker
+{
+public:
+    // Creates the baker.
+    //
+    // \param image_api     the image API used to create the result canvases
+    // \param num_threads   the number of worker threads, 0 selects the number of hardware threads
+    // \param tile_size     the edge length of the square tiles in pixels
+    Native_baker(
+        mi::neuraylib::IImage_api *image_api,
+        size_t                     num_threads = 0,
+        mi::Uint32                 tile_size = 64)
+        : m_image_api(image_api, mi::base::DUP_INTERFACE)
+        , m_pool(num_threads)
+        , m_tile_size(tile_size > 0 ? tile_size : 64)
+        , m_cancelled(false)
+        , m_failed(false)
+    {
+    }
+
+    // Returns the number of worker threads.
+    size_t get_thread_count() const { return m_pool.get_thread_count(); }
+
+    // Bakes the first function of the given target code into a new "Rgb_fp" canvas.
+    //
+    // \param code_native   the target code generated by the native backend
+    // \param tex_handler   the custom texture handler or \c nullptr for the builtin one
+    // \param arg_block     the arguments of a class-compiled material or \c nullptr for the
+    //                      argument block of the target code
+    // \param width         the width of the canvas
+    // \param height        the height of the canvas
+    // \param with_derivs   true, if the code was generated with "texture_runtime_with_derivs"
+    // \param tile_stats    if not \c nullptr, receives the timing of every baked tile
+    // \return              the canvas or \c nullptr, if baking was cancelled or failed
+    mi::neuraylib::ICanvas *bake(
+        mi::neuraylib::ITarget_code const    *code_native,
+        mi::neuraylib::Texture_handler_base  *tex_handler,
+        mi::neuraylib::ITarget_argument_block const *arg_block,
+        mi::Uint32                            width,
+        mi::Uint32                            height,
+        bool                                  with_derivs,
+        std::vector<Bake_tile_stats>         *tile_stats = nullptr)
+    {
+        m_cancelled = false;
+        m_failed = false;
+
+        mi::base::Handle<mi::neuraylib::ICanvas> canvas(
+            m_image_api->create_canvas("Rgb_fp", width, height, m_tile_size, m_tile_size));
+        if (!canvas)
+            return nullptr;
+
+        // Collect the tiles up front, so the workers never touch the canvas itself.
+        std::vector<Tile_job> jobs;
+        for (mi::Uint32 y = 0; y < height; y += m_tile_size) {
+            for (mi::Uint32 x = 0; x < width; x += m_tile_size) {
+                Tile_job job;
+                job.tile = canvas->get_tile(x, y);
+                job.x = x;
+                job.y = y;
+                job.width = std::min(m_tile_size, width - x);
+                job.height = std::min(m_tile_size, height - y);
+                jobs.push_back(job);
+            }
+        }
+
+        if (tile_stats) {
+            tile_stats->clear();
+            tile_stats->resize(jobs.size());
+        }
+
+        if (with_derivs)
+            run_jobs<true>(
+                jobs, code_native, tex_handler, arg_block, width, height, tile_stats);
+        else
+            run_jobs<false>(
+                jobs, code_native, tex_handler, arg_block, width, height, tile_stats);
+
+        if (m_cancelled || m_failed)
+            return nullptr;
+
+        canvas->retain();
+        return canvas.get();
+    }
+
+    // Requests cancellation of a running bake() call. May be called from any thread.
+    // Tiles which have already been started are aborted at the next scanline.
+    void cancel() { m_cancelled = true; }
+
+    // Returns true, if the last bake() call was cancelled.
+    bool was_cancelled() const { return m_cancelled; }
+
+    // Returns true, if the last bake() call failed because the generated code reported an error.
+    bool has_failed() const { return m_failed; }
+
+private:
+    // A tile of the result canvas, which is baked by one task.
+    struct Tile_job
+    {
+        mi::base::Handle<mi::neuraylib::ITile> tile;
+        mi::Uint32 x, y;
+        mi::Uint32 width, height;
+    };
+
+    // Provides a large enough buffer for any result type.
+    union Result_buffer
+    {
+        int                     int_val;
+        float                   float_val;
+        double                  double_val;
+        mi::Float32_3_struct    float3_val;
+        mi::Float32_4_struct    float4_val;
+        mi::Float32_4_4_struct  float4x4_val;
+        mi::Float64_3_struct    double3_val;
+        mi::Float64_4_struct    double4_val;
+        mi::Float64_4_4_struct  double4x4_val;
+    };
+
+    // The MDL material state of one worker (with only one texture space).
+    template <bool with_derivs>
+    struct Worker_state
+    {
+        typedef mi::neuraylib::Shading_state_material_impl<with_derivs> State;
+        typedef typename State::traits::tct_derivable_float3 Coord;
+
+        Coord                       texture_coords[1];
+        mi::neuraylib::tct_float3   texture_tangent_u[1];
+        mi::neuraylib::tct_float3   texture_tangent_v[1];
+        State                       mdl_state;
+        Result_buffer               result;
+    };
+
+    // The last row is always implied to be (0, 0, 0, 1).
+    static mi::neuraylib::tct_float4 const *identity_matrix()
+    {
+        static const mi::neuraylib::tct_float4 identity[3] = {
+            { 1.0f, 0.0f, 0.0f, 0.0f },
+            { 0.0f, 1.0f, 0.0f, 0.0f },
+            { 0.0f, 0.0f, 1.0f, 0.0f }
+        };
+        return identity;
+    }
+
+    static void init_coord(mi::neuraylib::tct_float3 &coord, float, float)
+    {
+        coord.x = coord.y = coord.z = 0.0f;
+    }
+
+    static void init_coord(mi::neuraylib::tct_deriv_float3 &coord, float step_x, float step_y)
+    {
+        coord.val.x = coord.val.y = coord.val.z = 0.0f;
+        coord.dx.x = step_x; coord.dx.y = 0.0f;   coord.dx.z = 0.0f;
+        coord.dy.x = 0.0f;   coord.dy.y = step_y; coord.dy.z = 0.0f;
+    }
+
+    static void set_coord(mi::neuraylib::tct_float3 &coord, float u, float v)
+    {
+        coord.x = u;
+        coord.y = v;
+    }
+
+    static void set_coord(mi::neuraylib::tct_deriv_float3 &coord, float u, float v)
+    {
+        coord.val.x = u;
+        coord.val.y = v;
+    }
+
+    template <bool with_derivs>
+    static void init_worker_state(Worker_state<with_derivs> &ws, float step_x, float step_y)
+    {
+        init_coord(ws.texture_coords[0], step_x, step_y);
+        ws.texture_tangent_u[0].x = 1.0f;
+        ws.texture_tangent_u[0].y = 0.0f;
+        ws.texture_tangent_u[0].z = 0.0f;
+        ws.texture_tangent_v[0].x = 0.0f;
+        ws.texture_tangent_v[0].y = 1.0f;
+        ws.texture_tangent_v[0].z = 0.0f;
+
+        typename Worker_state<with_derivs>::State &s = ws.mdl_state;
+        s.normal.x = 0.0f;      s.normal.y = 0.0f;      s.normal.z = 1.0f;
+        s.geom_normal.x = 0.0f; s.geom_normal.y = 0.0f; s.geom_normal.z = 1.0f;
+        s.position.x = 0.0f;    s.position.y = 0.0f;    s.position.z = 0.0f;
+        s.animation_time = 0.0f;
+        s.text_coords = ws.texture_coords;
+        s.tangent_u = ws.texture_tangent_u;
+        s.tangent_v = ws.texture_tangent_v;
+        s.text_results = nullptr;
+        s.ro_data_segment = nullptr;
+        s.world_to_object = identity_matrix();
+        s.object_to_world = identity_matrix();
+        s.object_id = 0;
+
+        memset(&ws.result, 0, sizeof(ws.result));
+    }
+
+    // Submits all tile jobs to the pool and waits for their completion.
+    template <bool with_derivs>
+    void run_jobs(
+        std::vector<Tile_job>                &jobs,
+        mi::neuraylib::ITarget_code const    *code_native,
+        mi::neuraylib::Texture_handler_base  *tex_handler,
+        mi::neuraylib::ITarget_argument_block const *arg_block,
+        mi::Uint32                            width,
+        mi::Uint32                            height,
+        std::vector<Bake_tile_stats>         *tile_stats)
+    {
+        const float step_x = 1.f / width;
+        const float step_y = 1.f / height;
+
+        std::vector<Worker_state<with_derivs>> states(m_pool.get_thread_count());
+        for (Worker_state<with_derivs> &ws : states)
+            init_worker_state(ws, step_x, step_y);
+
+        for (size_t i = 0, n = jobs.size(); i < n; ++i) {
+            m_pool.submit([&, i](size_t worker) {
+                if (m_cancelled || m_failed)
+                    return;
+
+                auto start = std::chrono::steady_clock::now();
+                bake_tile(
+                    states[worker], jobs[i], code_native, tex_handler, arg_block, step_x, step_y);
+                auto end = std::chrono::steady_clock::now();
+
+                if (tile_stats) {
+                    Bake_tile_stats &stats = (*tile_stats)[i];
+                    stats.x = jobs[i].x;
+                    stats.y = jobs[i].y;
+                    stats.width = jobs[i].width;
+                    stats.height = jobs[i].height;
+                    stats.worker = worker;
+                    stats.seconds = std::chrono::duration<double>(end - start).count();
+                }
+            });
+        }
+        m_pool.wait();
+    }
+
+    // Evaluates the expression for all pixels of one tile.
+    template <bool with_derivs>
+    void bake_tile(
+        Worker_state<with_derivs>            &ws,
+        Tile_job                             &job,
+        mi::neuraylib::ITarget_code const    *code_native,
+        mi::neuraylib::Texture_handler_base  *tex_handler,
+        mi::neuraylib::ITarget_argument_block const *arg_block,
+        float                                 step_x,
+        float                                 step_y)
+    {
+        const mi::Uint32 pitch = job.tile->get_resolution_x();
+        mi::Float32_3_struct *data = static_cast<mi::Float32_3_struct *>(job.tile->get_data());
+
+        for (mi::Uint32 ty = 0; ty < job.height; ++ty) {
+            if (m_cancelled)
+                return;
+
+            float rel_y = (job.y + ty) * step_y;
+            ws.mdl_state.position.y = 2.0f * rel_y - 1;   // [-1, 1)
+
+            for (mi::Uint32 tx = 0; tx < job.width; ++tx) {
+                // Update state for the current pixel
+                float rel_x = (job.x + tx) * step_x;
+                ws.mdl_state.position.x = 2.0f * rel_x - 1;   // [-1, 1)
+                set_coord(ws.texture_coords[0], rel_x, rel_y);  // [0, 1)
+
+                // Evaluate sub-expression
+                if (code_native->execute(
+                        0,
+                        reinterpret_cast<mi::neuraylib::Shading_state_material &>(ws.mdl_state),
+                        tex_handler,
+                        arg_block,
+                        &ws.result) != 0) {
+                    m_failed = true;
+                    return;
+                }
+
+                // Store result in the tile
+                data[ty * pitch + tx] = ws.result.float3_val;
+            }
+
+            // Apply gamma correction to the whole row
+            mi::math::gamma_encode(&data[ty * pitch].x, job.width * 3, 2.2f);
+        }
+    }
+
+    mi::base::Handle<mi::neuraylib::IImage_api> m_image_api;
+    Thread_pool                                 m_pool;
+    mi::Uint32                                  m_tile_size;
+    std::atomic<bool>                           m_cancelled;
+    std::atomic<bool>                           m_failed;
+};
+
+#endif // NATIVE_BAKER_H
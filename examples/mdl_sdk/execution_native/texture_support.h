@@ -9,29 +9,197 @@
 
 #include <mi/mdl_sdk.h>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The lookup functions use SSE2 whenever it is available, which is the case for all x86-64
+// targets.
+#if defined(__SSE2__) || defined(_M_X64) || defined(HAS_SSE)
+#define TEXTURE_SUPPORT_USE_SSE
+#include <emmintrin.h>
+#endif
+
 #define USE_SMOOTHERSTEP_FILTER
+#ifndef M_PI
+    #define M_PI            3.14159265358979323846
+#endif
+#define M_ONE_OVER_PI       0.318309886183790671538
 
 
 typedef mi::neuraylib::Texture_handler_base Texture_handler_base;
 typedef mi::neuraylib::Tex_wrap_mode Tex_wrap_mode;
 
-// Custom structure representing an MDL texture
-struct Texture
+// Cropping and scaling constants of one texture axis.
+//
+// They only depend on the texture size and the crop range, so they are computed once per texture
+// for the default crop range [0, 1] and once per lookup otherwise.
+struct Texture_axis
 {
-    Texture(mi::base::Handle<const mi::neuraylib::ICanvas> c)
+    mi::Sint32  crop_offset;    // first texel of the crop range
+    mi::Sint32  crop_res;       // number of texels in the crop range (at least 1)
+    mi::Float32 crop_res_f;     // crop_res as float
+    mi::Float32 inv_crop_res;   // 1 / crop_res
+};
+
+// Computes the constants of one texture axis with the given size and crop range.
+static inline Texture_axis make_texture_axis(mi::Uint32 tex_size, const mi::Float32 crop[2])
+{
+    Texture_axis axis;
+    axis.crop_offset = mi::Sint32(mi::Float32(tex_size - 1) * crop[0]);
+    axis.crop_res = std::max(mi::Sint32(mi::Float32(tex_size) * (crop[1] - crop[0])), 1);
+    axis.crop_res_f = mi::Float32(axis.crop_res);
+    axis.inv_crop_res = 1.0f / axis.crop_res_f;
+    return axis;
+}
+
+// One level of the mipmap chain of a texture.
+struct Texture_level
+{
+    Texture_level(mi::base::Handle<const mi::neuraylib::ICanvas> c)
         : canvas(c)
-        , ncomp(4)
     {
         // for now, we only support floating point rgba
         check_success(strcmp(canvas->get_type(), "Color") == 0);
 
         mi::base::Handle < const mi::neuraylib::ITile> tile(canvas->get_tile(0, 0));
 
+        width = canvas->get_resolution_x();
+        height = canvas->get_resolution_y();
+        row_stride = size_t(width) * 4;
+
+        data = static_cast<const mi::Float32*> (tile->get_data());
+
+        const mi::Float32 full_crop[2] = { 0.0f, 1.0f };
+        full_u = make_texture_axis(width, full_crop);
+        full_v = make_texture_axis(height, full_crop);
+    }
+
+    // Returns the axis constants for the given crop range in u direction.
+    Texture_axis axis_u(const mi::Float32 crop[2]) const
+    {
+        return (crop[0] == 0.0f && crop[1] == 1.0f) ? full_u : make_texture_axis(width, crop);
+    }
+
+    // Returns the axis constants for the given crop range in v direction.
+    Texture_axis axis_v(const mi::Float32 crop[2]) const
+    {
+        return (crop[0] == 0.0f && crop[1] == 1.0f) ? full_v : make_texture_axis(height, crop);
+    }
+
+    mi::base::Handle<const mi::neuraylib::ICanvas> canvas;
+
+    mi::Float32 const       *data;          // texel data for fast access
+    mi::Uint32              width;
+    mi::Uint32              height;
+    size_t                  row_stride;     // floats per row
+
+    Texture_axis            full_u;         // axis constants for the crop range [0, 1]
+    Texture_axis            full_v;
+};
+
+// Projects a direction onto the faces of a cube map, which are ordered +x, -x, +y, -y, +z, -z.
+// Returns the face index and the coordinates on the face in [0, 1]. The orientation of the faces
+// follows the convention of CUDA and OpenGL cube maps.
+static inline mi::Uint32 cube_face_coords(
+    mi::Float32 uv[2], mi::Float32 x, mi::Float32 y, mi::Float32 z)
+{
+    const mi::Float32 ax = std::abs(x), ay = std::abs(y), az = std::abs(z);
+    mi::Uint32 face;
+    mi::Float32 sc, tc, ma;
+    if (ax >= ay && ax >= az) {
+        face = x >= 0.0f ? 0 : 1;
+        sc = x >= 0.0f ? -z : z;
+        tc = -y;
+        ma = ax;
+    } else if (ay >= az) {
+        face = y >= 0.0f ? 2 : 3;
+        sc = x;
+        tc = y >= 0.0f ? z : -z;
+        ma = ay;
+    } else {
+        face = z >= 0.0f ? 4 : 5;
+        sc = z >= 0.0f ? x : -x;
+        tc = -y;
+        ma = az;
+    }
+    if (ma == 0.0f) {
+        uv[0] = uv[1] = 0.5f;
+        return face;
+    }
+    const mi::Float32 inv_ma = 0.5f / ma;
+    uv[0] = sc * inv_ma + 0.5f;
+    uv[1] = tc * inv_ma + 0.5f;
+    return face;
+}
+
+// Inverse of cube_face_coords(): returns the (unnormalized) direction pointing to the face
+// coordinates (sc, tc) in [-1, 1] of the given face.
+static inline void cube_face_direction(
+    mi::Float32 dir[3], mi::Uint32 face, mi::Float32 sc, mi::Float32 tc)
+{
+    switch (face) {
+    case 0:  dir[0] =  1.0f; dir[1] =   -tc; dir[2] =   -sc; break;
+    case 1:  dir[0] = -1.0f; dir[1] =   -tc; dir[2] =    sc; break;
+    case 2:  dir[0] =    sc; dir[1] =  1.0f; dir[2] =    tc; break;
+    case 3:  dir[0] =    sc; dir[1] = -1.0f; dir[2] =   -tc; break;
+    case 4:  dir[0] =    sc; dir[1] =   -tc; dir[2] =  1.0f; break;
+    default: dir[0] =   -sc; dir[1] =   -tc; dir[2] = -1.0f; break;
+    }
+}
+
+// Custom structure representing an MDL texture
+struct Texture
+{
+    // Creates the texture from the given canvas.
+    //
+    // If an image API is provided, the full mipmap chain of 2D textures is created once here,
+    // which enables filtered lookups with derivatives. Otherwise, the texture only consists of
+    // level 0. Cube maps are copied into a face-major layout with borders for seamless filtering.
+    Texture(
+        mi::base::Handle<const mi::neuraylib::ICanvas> c,
+        mi::neuraylib::IImage_api *image_api = nullptr,
+        mi::neuraylib::ITarget_code::Texture_shape s =
+            mi::neuraylib::ITarget_code::Texture_shape_2d)
+        : canvas(c)
+        , ncomp(4)
+        , shape(s)
+        , cube_row_stride(0)
+        , cube_face_stride(0)
+    {
+        levels.push_back(Texture_level(canvas));
+
+        if (image_api && shape == mi::neuraylib::ITarget_code::Texture_shape_2d &&
+                (canvas->get_resolution_x() > 1 || canvas->get_resolution_y() > 1)) {
+            mi::base::Handle<mi::IArray> mipmaps(image_api->create_mipmaps(canvas.get(), 1.0f));
+            for (mi::Size i = 0, n = mipmaps ? mipmaps->get_length() : 0; i < n; ++i) {
+                mi::base::Handle<mi::IPointer> mipmap_ptr(mipmaps->get_element<mi::IPointer>(i));
+                mi::base::Handle<const mi::neuraylib::ICanvas> level_canvas(
+                    mipmap_ptr->get_pointer<mi::neuraylib::ICanvas>());
+                levels.push_back(Texture_level(level_canvas));
+            }
+        }
+
         size.x = canvas->get_resolution_x();
         size.y = canvas->get_resolution_y();
         size.z = canvas->get_layers_size();
 
-        data = static_cast<const mi::Float32*> (tile->get_data());
+        data = levels[0].data;
+
+        for (mi::Uint32 layer = 0; layer < size.z; ++layer) {
+            mi::base::Handle<const mi::neuraylib::ITile> tile(canvas->get_tile(0, 0, layer));
+            layers.push_back(static_cast<const mi::Float32*>(tile->get_data()));
+        }
+
+        if (shape == mi::neuraylib::ITarget_code::Texture_shape_cube)
+            init_cube_faces();
+    }
+
+    // Returns a pointer to texel (0, 0) of the given cube face, where the border texels have
+    // the coordinates -1 and size.x.
+    mi::Float32 const *cube_face(mi::Uint32 face) const
+    {
+        return cube_faces.data() + face * cube_face_stride + cube_row_stride + 4;
     }
 
     mi::base::Handle<const mi::neuraylib::ICanvas> canvas;
@@ -42,6 +210,433 @@ struct Texture
 
     mi::Uint32              ncomp;  // components per pixel
 
+    mi::neuraylib::ITarget_code::Texture_shape shape;
+
+    std::vector<Texture_level> levels;  // the mipmap chain, starting with level 0
+
+    std::vector<mi::Float32 const *> layers;    // texel data of all layers of level 0
+
+    // The six faces of a cube map, each surrounded by a border of one texel taken from the
+    // adjacent faces, so bilinear filtering never has to cross a face.
+    std::vector<mi::Float32> cube_faces;
+    size_t                  cube_row_stride;    // floats per row of a face including the border
+    size_t                  cube_face_stride;   // floats per face including the border
+
+private:
+    void init_cube_faces()
+    {
+        check_success(size.z == 6 && size.x == size.y);
+
+        const mi::Uint32 n = size.x;
+        cube_row_stride = size_t(n + 2) * 4;
+        cube_face_stride = cube_row_stride * (n + 2);
+        cube_faces.resize(cube_face_stride * 6);
+
+        for (mi::Uint32 face = 0; face < 6; ++face) {
+            mi::Float32 *dst = cube_faces.data() + face * cube_face_stride + cube_row_stride + 4;
+            for (mi::Uint32 y = 0; y < n; ++y)
+                memcpy(dst + y * cube_row_stride, layers[face] + size_t(y) * n * 4,
+                    n * 4 * sizeof(mi::Float32));
+        }
+
+        // Fill the borders with the closest texels of the adjacent faces.
+        const mi::Float32 scale = 2.0f / mi::Float32(n);
+        for (mi::Uint32 face = 0; face < 6; ++face) {
+            mi::Float32 *dst = cube_faces.data() + face * cube_face_stride;
+            for (mi::Uint32 y = 0; y < n + 2; ++y) {
+                for (mi::Uint32 x = 0; x < n + 2; ++x) {
+                    if (x > 0 && x <= n && y > 0 && y <= n) {
+                        x = n;  // skip the interior of this row
+                        continue;
+                    }
+
+                    mi::Float32 dir[3];
+                    cube_face_direction(dir, face,
+                        (mi::Float32(x) - 0.5f) * scale - 1.0f,
+                        (mi::Float32(y) - 0.5f) * scale - 1.0f);
+
+                    mi::Float32 uv[2];
+                    const mi::Uint32 src_face = cube_face_coords(uv, dir[0], dir[1], dir[2]);
+                    const mi::Uint32 sx = std::min(mi::Uint32(uv[0] * n), n - 1);
+                    const mi::Uint32 sy = std::min(mi::Uint32(uv[1] * n), n - 1);
+
+                    memcpy(dst + y * cube_row_stride + x * 4,
+                        cube_face(src_face) + sy * cube_row_stride + sx * 4,
+                        4 * sizeof(mi::Float32));
+                }
+            }
+        }
+    }
+};
+
+// Builds the guide table for a normalized CDF of the given size, which allows to sample the CDF
+// in expected constant time (cutpoint method). Entry k is the first index, whose CDF value
+// exceeds k / size, so a search starting there ends at the same index as a binary search.
+static inline void build_cdf_guide(const mi::Float32 *cdf, mi::Uint32 size, mi::Uint32 *guide)
+{
+    mi::Uint32 i = 0;
+    for (mi::Uint32 k = 0; k < size; ++k) {
+        const mi::Float32 xi = mi::Float32(k) / mi::Float32(size);
+        while (i < size - 1 && xi >= cdf[i])
+            ++i;
+        guide[k] = i;
+    }
+}
+
+// Returns the first index of the CDF whose value exceeds xi, or the last index, using the
+// guide table built by build_cdf_guide(). The result matches the binary search of the CUDA
+// texture runtime for every xi.
+static inline mi::Uint32 sample_cdf(
+    const mi::Float32 *cdf,
+    const mi::Uint32  *guide,
+    mi::Uint32         size,
+    mi::Float32        xi)
+{
+    mi::Uint32 k = mi::Uint32(std::max(xi, 0.0f) * mi::Float32(size));
+    mi::Uint32 i = guide[std::min(k, size - 1)];
+    while (i < size - 1 && xi >= cdf[i])
+        ++i;
+    return i;
+}
+
+// Computes the texel indices and the interpolation weight of a linearly filtered lookup at the
+// normalized coordinate u with clamped addressing. This mirrors the texture units of the GPU,
+// so the CPU evaluation of light profiles and measured BSDFs matches the CUDA renderer.
+static inline void linear_clamp_coord(
+    mi::Float32 u, mi::Uint32 res, mi::Uint32 &i0, mi::Uint32 &i1, mi::Float32 &frac)
+{
+    const mi::Float32 x = u * mi::Float32(res) - 0.5f;
+    const mi::Float32 x_floor = floorf(x);
+    const mi::Sint32 i = mi::Sint32(x_floor);
+    const mi::Sint32 last = mi::Sint32(res) - 1;
+    frac = x - x_floor;
+    i0 = mi::Uint32(std::min(std::max(i, 0), last));
+    i1 = mi::Uint32(std::min(std::max(i + 1, 0), last));
+}
+
+// Custom structure representing an MDL light profile.
+//
+// Next to the measured intensities used for evaluation, the structure holds the CDFs for
+// sampling a grid cell of the profile, first over theta and then over phi, together with their
+// guide tables. All tables are stored in contiguous arrays with the layout used by the CUDA
+// texture runtime.
+struct Lightprofile
+{
+    explicit Lightprofile(mi::neuraylib::ILightprofile const *lprof)
+        : candela_multiplier(float(lprof->get_candela_multiplier()))
+        , total_power(0.0f)
+    {
+        angular_resolution.x = lprof->get_resolution_theta();
+        angular_resolution.y = lprof->get_resolution_phi();
+        theta_phi_start.x = lprof->get_theta(0);
+        theta_phi_start.y = lprof->get_phi(0);
+        theta_phi_delta.x = lprof->get_theta(1) - theta_phi_start.x;
+        theta_phi_delta.y = lprof->get_phi(1) - theta_phi_start.y;
+        theta_phi_inv_delta.x = theta_phi_delta.x ? 1.0f / theta_phi_delta.x : 0.0f;
+        theta_phi_inv_delta.y = theta_phi_delta.y ? 1.0f / theta_phi_delta.y : 0.0f;
+
+        // phi-major: [res.x x res.y]
+        const mi::Uint32 res_x = angular_resolution.x;
+        const mi::Uint32 res_y = angular_resolution.y;
+        const float *data = lprof->get_data();
+        eval_data.assign(data, data + size_t(res_x) * res_y);
+
+        // The first (res.x - 1) values are the CDF for sampling theta, followed by
+        // (res.x - 1) CDFs of size (res.y - 1) for sampling phi after theta.
+        cdf_data.resize((res_x - 1) + size_t(res_x - 1) * (res_y - 1));
+        cdf_guide.resize(cdf_data.size());
+
+        float sum_theta = 0.0f;
+        float cos_theta0 = cosf(theta_phi_start.x);
+        for (mi::Uint32 t = 0; t < res_x - 1; ++t) {
+            const float cos_theta1 = cosf(theta_phi_start.x + float(t + 1) * theta_phi_delta.x);
+
+            // area of the patch (grid cell)
+            const float mu = cos_theta0 - cos_theta1;
+            cos_theta0 = cos_theta1;
+
+            // build CDF for phi, the value of a cell is the average of its corners
+            // (the factor 1/4 is omitted, as the CDF is normalized in the end)
+            float *cdf_data_phi = phi_cdf(t);
+            float sum_phi = 0.0f;
+            for (mi::Uint32 p = 0; p < res_y - 1; ++p) {
+                const float value = data[p * res_x + t]
+                    + data[p * res_x + t + 1]
+                    + data[(p + 1) * res_x + t]
+                    + data[(p + 1) * res_x + t + 1];
+
+                sum_phi += value * mu;
+                cdf_data_phi[p] = sum_phi;
+            }
+
+            // normalize CDF for phi
+            for (mi::Uint32 p = 0; p < res_y - 2; ++p)
+                cdf_data_phi[p] = sum_phi ? (cdf_data_phi[p] / sum_phi) : 0.0f;
+            cdf_data_phi[res_y - 2] = 1.0f;
+
+            build_cdf_guide(cdf_data_phi, res_y - 1, &cdf_guide[cdf_data_phi - cdf_data.data()]);
+
+            // build CDF for theta
+            sum_theta += sum_phi;
+            cdf_data[t] = sum_theta;
+        }
+        total_power = sum_theta * 0.25f * theta_phi_delta.y * candela_multiplier;
+
+        // normalize CDF for theta
+        for (mi::Uint32 t = 0; t < res_x - 2; ++t)
+            cdf_data[t] = sum_theta ? (cdf_data[t] / sum_theta) : cdf_data[t];
+        cdf_data[res_x - 2] = 1.0f;
+
+        build_cdf_guide(cdf_data.data(), res_x - 1, cdf_guide.data());
+    }
+
+    // Returns the CDF for sampling phi in the given theta cell.
+    float *phi_cdf(mi::Uint32 idx_theta)
+    {
+        return cdf_data.data() + (angular_resolution.x - 1) +
+            size_t(idx_theta) * (angular_resolution.y - 1);
+    }
+
+    float const *phi_cdf(mi::Uint32 idx_theta) const
+    {
+        return const_cast<Lightprofile *>(this)->phi_cdf(idx_theta);
+    }
+
+    // Returns the bilinearly interpolated intensity at the normalized coordinates (u, v).
+    float lookup(float u, float v) const
+    {
+        mi::Uint32 u0, u1, v0, v1;
+        float ufrac, vfrac;
+        linear_clamp_coord(u, angular_resolution.x, u0, u1, ufrac);
+        linear_clamp_coord(v, angular_resolution.y, v0, v1, vfrac);
+
+        const float *row0 = eval_data.data() + size_t(v0) * angular_resolution.x;
+        const float *row1 = eval_data.data() + size_t(v1) * angular_resolution.x;
+        const float val0 = row0[u0] + (row0[u1] - row0[u0]) * ufrac;
+        const float val1 = row1[u0] + (row1[u1] - row1[u0]) * ufrac;
+        return val0 + (val1 - val0) * vfrac;
+    }
+
+    mi::Uint32_2_struct     angular_resolution;     // angular resolution of the grid
+    mi::Float32_2_struct    theta_phi_start;        // start of the grid
+    mi::Float32_2_struct    theta_phi_delta;        // angular step size
+    mi::Float32_2_struct    theta_phi_inv_delta;    // inverse step size
+    float                   candela_multiplier;     // factor to rescale the normalized data
+    float                   total_power;
+
+    std::vector<float>      eval_data;  // normalized intensities, phi-major
+    std::vector<float>      cdf_data;   // CDFs for sampling a light profile cell
+    std::vector<mi::Uint32> cdf_guide;  // guide tables for cdf_data with the same layout
+};
+
+// Custom structure representing an MDL BSDF measurement.
+//
+// For both the reflection and the transmission part, the structure holds the symmetrized
+// measurement used for evaluation, the per theta_in CDFs for sampling theta_out and phi_out
+// with their guide tables, and the albedos. All tables are stored in contiguous arrays with
+// the layout used by the CUDA texture runtime.
+struct Mbsdf
+{
+    explicit Mbsdf(mi::neuraylib::IBsdf_measurement const *bsdf_measurement)
+    {
+        for (unsigned i = 0; i < 2; ++i) {
+            has_data[i] = false;
+            angular_resolution[i].x = angular_resolution[i].y = 0;
+            inv_angular_resolution[i].x = inv_angular_resolution[i].y = 0.0f;
+            num_channels[i] = 0;
+            max_albedo[i] = 0.0f;
+        }
+
+        mi::base::Handle<const mi::neuraylib::Bsdf_isotropic_data> reflection(
+            bsdf_measurement->get_reflection<mi::neuraylib::Bsdf_isotropic_data>());
+        mi::base::Handle<const mi::neuraylib::Bsdf_isotropic_data> transmission(
+            bsdf_measurement->get_transmission<mi::neuraylib::Bsdf_isotropic_data>());
+        prepare_part(mi::neuraylib::MBSDF_DATA_REFLECTION, reflection.get());
+        prepare_part(mi::neuraylib::MBSDF_DATA_TRANSMISSION, transmission.get());
+    }
+
+    // Returns the CDF for sampling theta_out for the given theta_in.
+    float const *theta_cdf(unsigned part, mi::Uint32 idx_theta_in) const
+    {
+        return sample_data[part].data() + size_t(idx_theta_in) * angular_resolution[part].x;
+    }
+
+    // Returns the CDF for sampling phi_out for the given theta_in and theta_out.
+    float const *phi_cdf(unsigned part, mi::Uint32 idx_theta_in, mi::Uint32 idx_theta_out) const
+    {
+        const mi::Uint32 res_x = angular_resolution[part].x;
+        return sample_data[part].data() + size_t(res_x) * res_x +
+            (size_t(idx_theta_in) * res_x + idx_theta_out) * angular_resolution[part].y;
+    }
+
+    // Returns the guide table of a CDF returned by theta_cdf() or phi_cdf().
+    mi::Uint32 const *cdf_guide(unsigned part, float const *cdf) const
+    {
+        return sample_guide[part].data() + (cdf - sample_data[part].data());
+    }
+
+    // Returns the trilinearly interpolated measurement at the normalized coordinates
+    // (phi_delta, theta_out, theta_in).
+    void lookup(float result[3], unsigned part, float u, float v, float w) const
+    {
+        const mi::Uint32 res_x = angular_resolution[part].x;
+        const mi::Uint32 res_y = angular_resolution[part].y;
+        const mi::Uint32 nc = num_channels[part];
+
+        mi::Uint32 u0, u1, v0, v1, w0, w1;
+        float ufrac, vfrac, wfrac;
+        linear_clamp_coord(u, res_y, u0, u1, ufrac);
+        linear_clamp_coord(v, res_x, v0, v1, vfrac);
+        linear_clamp_coord(w, res_x, w0, w1, wfrac);
+
+        const float *data = eval_data[part].data();
+        const mi::Uint32 ws[2] = { w0, w1 };
+        const mi::Uint32 vs[2] = { v0, v1 };
+        float slice[2][3];
+        for (unsigned j = 0; j < 2; ++j) {
+            float row[2][3];
+            for (unsigned k = 0; k < 2; ++k) {
+                const float *texels = data + (size_t(ws[j]) * res_x + vs[k]) * res_y * nc;
+                for (mi::Uint32 c = 0; c < nc; ++c)
+                    row[k][c] = texels[u0 * nc + c] +
+                        (texels[u1 * nc + c] - texels[u0 * nc + c]) * ufrac;
+            }
+            for (mi::Uint32 c = 0; c < nc; ++c)
+                slice[j][c] = row[0][c] + (row[1][c] - row[0][c]) * vfrac;
+        }
+        for (mi::Uint32 c = 0; c < nc; ++c)
+            result[c] = slice[0][c] + (slice[1][c] - slice[0][c]) * wfrac;
+        for (mi::Uint32 c = nc; c < 3; ++c)
+            result[c] = result[0];
+    }
+
+    bool                    has_data[2];
+    mi::Uint32_2_struct     angular_resolution[2];      // theta, phi
+    mi::Float32_2_struct    inv_angular_resolution[2];
+    mi::Uint32              num_channels[2];            // 1 or 3
+    float                   max_albedo[2];              // maximum albedo over all theta_in
+
+    std::vector<float>      eval_data[2];       // symmetrized measurement
+    std::vector<float>      sample_data[2];     // CDFs for sampling theta_out and phi_out
+    std::vector<mi::Uint32> sample_guide[2];    // guide tables for sample_data
+    std::vector<float>      albedo_data[2];     // albedo per theta_in
+
+private:
+    void prepare_part(
+        mi::neuraylib::Mbsdf_part part,
+        mi::neuraylib::Bsdf_isotropic_data const *dataset)
+    {
+        // no data, fine
+        if (!dataset)
+            return;
+
+        const unsigned p = static_cast<unsigned>(part);
+        const mi::Uint32 res_x = dataset->get_resolution_theta();
+        const mi::Uint32 res_y = dataset->get_resolution_phi();
+        const mi::Uint32 nc = dataset->get_type() == mi::neuraylib::BSDF_SCALAR ? 1 : 3;
+
+        has_data[p] = true;
+        angular_resolution[p].x = res_x;
+        angular_resolution[p].y = res_y;
+        inv_angular_resolution[p].x = 1.0f / float(res_x);
+        inv_angular_resolution[p].y = 1.0f / float(res_y);
+        num_channels[p] = nc;
+
+        // {1,3} * (index_theta_in * (res_phi * res_theta) + index_theta_out * res_phi + index_phi)
+        mi::base::Handle<const mi::neuraylib::IBsdf_buffer> buffer(dataset->get_bsdf_buffer());
+        const mi::Float32 *src_data = buffer->get_data();
+
+        // Importance sampling data: for each theta_in, a CDF to select theta_out, followed by
+        // a CDF to select phi_out for each theta_in x theta_out combination. The maximum
+        // component is used as probability for colored measurements.
+        const size_t cdf_theta_size = size_t(res_x) * res_x;
+        sample_data[p].resize(cdf_theta_size + cdf_theta_size * res_y);
+        sample_guide[p].resize(sample_data[p].size());
+        albedo_data[p].resize(res_x);
+
+        float *sample_data_theta = sample_data[p].data();
+        float *sample_data_phi = sample_data_theta + cdf_theta_size;
+        mi::Uint32 *guide_theta = sample_guide[p].data();
+        mi::Uint32 *guide_phi = guide_theta + cdf_theta_size;
+
+        const float s_theta = float(M_PI * 0.5) / float(res_x);    // step size
+        const float s_phi = float(M_PI) / float(res_y);             // step size
+
+        for (mi::Uint32 t_in = 0; t_in < res_x; ++t_in) {
+            float sum_theta = 0.0f;
+            float sintheta0_sqd = 0.0f;
+            for (mi::Uint32 t_out = 0; t_out < res_x; ++t_out) {
+                const float sintheta1 = sinf(float(t_out + 1) * s_theta);
+                const float sintheta1_sqd = sintheta1 * sintheta1;
+
+                // BSDFs are symmetric: f(w_in, w_out) = f(w_out, w_in), so the average of
+                // both measurements is used, weighted by the area of the surface element
+                const float mu = (sintheta1_sqd - sintheta0_sqd) * s_phi * 0.5f;
+                sintheta0_sqd = sintheta1_sqd;
+
+                const size_t offset_phi  = (size_t(t_in) * res_x + t_out) * res_y;
+                const size_t offset_phi2 = (size_t(t_out) * res_x + t_in) * res_y;
+
+                // build CDF for phi
+                float sum_phi = 0.0f;
+                for (mi::Uint32 p_out = 0; p_out < res_y; ++p_out) {
+                    const size_t idx  = offset_phi  + p_out;
+                    const size_t idx2 = offset_phi2 + p_out;
+
+                    float value;
+                    if (nc == 3) {
+                        value = std::max(std::max(src_data[3 * idx  + 0], src_data[3 * idx  + 1]),
+                                         std::max(src_data[3 * idx  + 2], 0.0f))
+                              + std::max(std::max(src_data[3 * idx2 + 0], src_data[3 * idx2 + 1]),
+                                         std::max(src_data[3 * idx2 + 2], 0.0f));
+                    } else {
+                        value = std::max(src_data[idx], 0.0f) + std::max(src_data[idx2], 0.0f);
+                    }
+
+                    sum_phi += value * mu;
+                    sample_data_phi[idx] = sum_phi;
+                }
+
+                // normalize CDF for phi
+                for (mi::Uint32 p_out = 0; p_out < res_y; ++p_out) {
+                    float &cdf = sample_data_phi[offset_phi + p_out];
+                    cdf = sum_phi ? (cdf / sum_phi) : 1.0f;
+                }
+                build_cdf_guide(
+                    sample_data_phi + offset_phi, res_y, guide_phi + offset_phi);
+
+                // build CDF for theta
+                sum_theta += sum_phi;
+                sample_data_theta[t_in * res_x + t_out] = sum_theta;
+            }
+
+            max_albedo[p] = std::max(max_albedo[p], sum_theta);
+            albedo_data[p][t_in] = sum_theta;
+
+            // normalize CDF for theta
+            float *cdf_theta = sample_data_theta + size_t(t_in) * res_x;
+            for (mi::Uint32 t_out = 0; t_out < res_x; ++t_out)
+                cdf_theta[t_out] = sum_theta ? (cdf_theta[t_out] / sum_theta) : 1.0f;
+            build_cdf_guide(cdf_theta, res_x, guide_theta + size_t(t_in) * res_x);
+        }
+
+        // Evaluation data: the measurement made symmetric, without padding of colors
+        eval_data[p].resize(cdf_theta_size * res_y * nc);
+        float *lookup_data = eval_data[p].data();
+        for (mi::Uint32 t_in = 0; t_in < res_x; ++t_in) {
+            for (mi::Uint32 t_out = 0; t_out < res_x; ++t_out) {
+                const size_t offset_phi  = (size_t(t_in) * res_x + t_out) * res_y;
+                const size_t offset_phi2 = (size_t(t_out) * res_x + t_in) * res_y;
+                for (mi::Uint32 p_out = 0; p_out < res_y; ++p_out) {
+                    const size_t idx  = offset_phi  + p_out;
+                    const size_t idx2 = offset_phi2 + p_out;
+                    for (mi::Uint32 c = 0; c < nc; ++c)
+                        lookup_data[nc * idx + c] =
+                            (src_data[nc * idx + c] + src_data[nc * idx2 + c]) * 0.5f;
+                }
+            }
+        }
+    }
 };
 
 // The texture handler structure required by the MDL SDK with custom additional fields.
@@ -51,6 +646,26 @@ struct Texture_handler : Texture_handler_base {
                                        // (without the invalid texture)
     Texture const *textures;           // the textures used by the material
                                        // (without the invalid texture)
+    size_t         num_lightprofiles;  // the number of light profiles used by the material
+                                       // (without the invalid light profile)
+    Lightprofile const *lightprofiles; // the light profiles used by the material
+                                       // (without the invalid light profile)
+    size_t         num_mbsdfs;         // the number of mbsdfs used by the material
+                                       // (without the invalid mbsdf)
+    Mbsdf const   *mbsdfs;             // the mbsdfs used by the material
+                                       // (without the invalid mbsdf)
+};
+
+// The texture handler structure required by the MDL SDK for code generated with
+// "texture_runtime_with_derivs". It must have the same layout as Texture_handler, as the
+// texture access functions are shared.
+struct Texture_handler_deriv : mi::neuraylib::Texture_handler_deriv_base {
+    size_t         num_textures;
+    Texture const *textures;
+    size_t         num_lightprofiles;
+    Lightprofile const *lightprofiles;
+    size_t         num_mbsdfs;
+    Mbsdf const   *mbsdfs;
 };
 
 // Stores a float4 in a float[4] array.
@@ -100,56 +715,127 @@ static inline void store_result3(float res[3], const float v0, const float v1, c
     res[2] = v2;
 }
 
-static inline mi::Float32 u2f_rn(const mi::Uint32 u) {
-    return (mi::Float32) u;
+// Maps an integer texel coordinate into the crop range of an axis in clamp or clip mode.
+static inline mi::Sint32 texremap_clamp(const Texture_axis &axis, mi::Sint32 texi)
+{
+    texi = texi < 0 ? 0 : (texi >= axis.crop_res ? axis.crop_res - 1 : texi);
+    return texi + axis.crop_offset;
 }
 
-static inline mi::Uint32 f2u_rz(const mi::Float32 f) {
-    return (mi::Uint32) f;
+// Maps an integer texel coordinate into the crop range of an axis in repeat mode.
+static inline mi::Sint32 texremap_repeat(const Texture_axis &axis, mi::Sint32 texi)
+{
+    if (mi::Uint32(texi) >= mi::Uint32(axis.crop_res)) {
+        texi %= axis.crop_res;
+        if (texi < 0)
+            texi += axis.crop_res;
+    }
+    return texi + axis.crop_offset;
 }
 
-static inline mi::Sint64 f2ll_rz(const mi::Float32 f) {
-    return (mi::Sint64) f;
+// Maps an integer texel coordinate into the crop range of an axis in mirrored repeat mode.
+static inline mi::Sint32 texremap_mirrored_repeat(const Texture_axis &axis, mi::Sint32 texi)
+{
+    if (mi::Uint32(texi) >= mi::Uint32(axis.crop_res)) {
+        const mi::Sint32 period = 2 * axis.crop_res;
+        texi %= period;
+        if (texi < 0)
+            texi += period;
+        if (texi >= axis.crop_res)
+            texi = period - 1 - texi;
+    }
+    return texi + axis.crop_offset;
 }
 
-static inline mi::Sint64 f2ll_rd(const mi::Float32 f) {
-    return (mi::Sint64) mi::math::floor(f);
+// Maps an integer texel coordinate into the crop range of an axis.
+static inline mi::Sint32 texremap(
+    const Texture_axis &axis, Tex_wrap_mode wrap_mode, mi::Sint32 texi)
+{
+    switch (wrap_mode) {
+    case Tex_wrap_mode::TEX_WRAP_REPEAT:
+        return texremap_repeat(axis, texi);
+    case Tex_wrap_mode::TEX_WRAP_MIRRORED_REPEAT:
+        return texremap_mirrored_repeat(axis, texi);
+    default:
+        return texremap_clamp(axis, texi);
+    }
 }
 
-mi::Uint32 texremap(
-    mi::Uint32 tex_size, Tex_wrap_mode wrap_mode, const mi::Sint32 crop_offset, float texf)
+// Converts a continuous texel coordinate to float with a range safe for the conversion to int.
+static inline mi::Float32 clamp_texel_coord(mi::Float32 texf)
 {
-    mi::Sint32 texi = 0;
-    const mi::Sint64 texil = f2ll_rz(texf);
-    const mi::Sint64 texsizel = mi::Sint64(tex_size);
-
-    if (mi::Uint64(f2ll_rd(texf)) >= mi::Uint64(tex_size)) {
-
-        // Wrap or clamp
-        if (wrap_mode == Tex_wrap_mode::TEX_WRAP_CLAMP || wrap_mode == Tex_wrap_mode::TEX_WRAP_CLIP)
-            texi = (int) std::min(std::max(texil, 0ll), (texsizel - 1ll));
-        // Repeat
-        else {
+    return std::min(std::max(texf, -1e9f), 1e9f);
+}
 
-            texi = mi::Sint32(texil % texsizel);
+// Applies the reconstruction filter to the fractional part of a texel coordinate.
+static inline mi::Float32 filter_weight(mi::Float32 frac)
+{
+#ifdef USE_SMOOTHERSTEP_FILTER
+    frac *= frac*frac*(frac*(frac*6.0f - 15.0f) + 10.0f); // smoother step
+#endif
+    return frac;
+}
 
-            const mi::Sint32 s = mi::math::sign_bit(texf);
-            const mi::Sint64 d = texil / (mi::Sint64) tex_size;
-            const mi::Sint32 a =
-                (mi::Sint32) (wrap_mode == Tex_wrap_mode::TEX_WRAP_MIRRORED_REPEAT) &
-                ((mi::Sint32) d^s) & 1;
-            const bool alternate = (a != 0);
-            if (alternate)   // Flip negative tex
-                texi = -texi;
-            if (s != a) // "Otherwise" pad negative tex back to positive
-                texi += (mi::Sint32) tex_size - 1;
-        }
+// Bilinearly interpolates the four texels (u0, v0), (u1, v0), (u0, v1) and (u1, v1) of an
+// rgba float image with the given number of floats per row.
+static inline void tex_fetch_bilinear(
+    mi::Float32         res[4],
+    const mi::Float32   *data,
+    size_t              row_stride,
+    mi::Sint32          u0,
+    mi::Sint32          u1,
+    mi::Sint32          v0,
+    mi::Sint32          v1,
+    mi::Float32         ufrac,
+    mi::Float32         vfrac)
+{
+    const mi::Float32 *row0 = data + size_t(v0) * row_stride;
+    const mi::Float32 *row1 = data + size_t(v1) * row_stride;
+    const mi::Float32 *t00 = row0 + size_t(u0) * 4;
+    const mi::Float32 *t01 = row0 + size_t(u1) * 4;
+    const mi::Float32 *t10 = row1 + size_t(u0) * 4;
+    const mi::Float32 *t11 = row1 + size_t(u1) * 4;
+
+#ifdef TEXTURE_SUPPORT_USE_SSE
+    const __m128 c00 = _mm_loadu_ps(t00);
+    const __m128 c01 = _mm_loadu_ps(t01);
+    const __m128 c10 = _mm_loadu_ps(t10);
+    const __m128 c11 = _mm_loadu_ps(t11);
+    const __m128 fu = _mm_set1_ps(ufrac);
+    const __m128 fv = _mm_set1_ps(vfrac);
+    const __m128 c1 = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c01, c00), fu));
+    const __m128 c2 = _mm_add_ps(c10, _mm_mul_ps(_mm_sub_ps(c11, c10), fu));
+    _mm_storeu_ps(res, _mm_add_ps(c1, _mm_mul_ps(_mm_sub_ps(c2, c1), fv)));
+#else
+    for (int i = 0; i < 4; ++i) {
+        const mi::Float32 c1 = t00[i] + (t01[i] - t00[i]) * ufrac;
+        const mi::Float32 c2 = t10[i] + (t11[i] - t10[i]) * ufrac;
+        res[i] = c1 + (c2 - c1) * vfrac;
     }
-    else texi = (int) texil;
+#endif
+}
 
-    // Crop
-    texi += crop_offset;
-    return mi::Uint32(texi);
+// Bilinear lookup of a single texture coordinate in the given mipmap level.
+static inline void tex_lookup2D(
+    mi::Float32                   res[4],
+    Texture_level const           &level,
+    const mi::Float32             uv[2],
+    mi::neuraylib::Tex_wrap_mode  wrap_u,
+    mi::neuraylib::Tex_wrap_mode  wrap_v,
+    const Texture_axis            &axis_u,
+    const Texture_axis            &axis_v)
+{
+    const mi::Float32 U = clamp_texel_coord(uv[0] * axis_u.crop_res_f - 0.5f);
+    const mi::Float32 V = clamp_texel_coord(uv[1] * axis_v.crop_res_f - 0.5f);
+    const mi::Float32 U_floor = mi::math::floor(U);
+    const mi::Float32 V_floor = mi::math::floor(V);
+    const mi::Sint32 Ui = mi::Sint32(U_floor);
+    const mi::Sint32 Vi = mi::Sint32(V_floor);
+
+    tex_fetch_bilinear(res, level.data, level.row_stride,
+        texremap(axis_u, wrap_u, Ui), texremap(axis_u, wrap_u, Ui + 1),
+        texremap(axis_v, wrap_v, Vi), texremap(axis_v, wrap_v, Vi + 1),
+        filter_weight(U - U_floor), filter_weight(V - V_floor));
 }
 
 void tex_lookup2D(
@@ -161,49 +847,180 @@ void tex_lookup2D(
     const mi::Float32             crop_u[2],
     const mi::Float32             crop_v[2])
 {
-    const mi::Float32 crop_w = crop_u[1] - crop_u[0];
-    const mi::Float32 crop_h = crop_v[1] - crop_v[0];
-
-    const mi::Sint32_2 crop_offset(
-        f2u_rz(u2f_rn(tex.size.x-1) * crop_u[0]),
-        f2u_rz(u2f_rn(tex.size.y-1) * crop_v[0]));
-
-    const mi::Uint32_2 crop_texres(
-        std::max(f2u_rz(u2f_rn(tex.size.x) * crop_w), 1u),
-        std::max(f2u_rz(u2f_rn(tex.size.y) * crop_h), 1u));
+    Texture_level const &level = tex.levels[0];
+    tex_lookup2D(res, level, uv, wrap_u, wrap_v, level.axis_u(crop_u), level.axis_v(crop_v));
+}
 
-    const float U = uv[0] * crop_texres.x - 0.5f;
-    const float V = uv[1] * crop_texres.y - 0.5f;
+// Linearly interpolates two rgba values.
+static inline void lerp4(
+    mi::Float32 res[4], const mi::Float32 a[4], const mi::Float32 b[4], mi::Float32 t)
+{
+#ifdef TEXTURE_SUPPORT_USE_SSE
+    const __m128 va = _mm_loadu_ps(a);
+    _mm_storeu_ps(res, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b), va), _mm_set1_ps(t))));
+#else
+    for (int i = 0; i < 4; ++i)
+        res[i] = a[i] + (b[i] - a[i]) * t;
+#endif
+}
 
-    const mi::Uint32 U0 = texremap(crop_texres.x, wrap_u, crop_offset[0], U);
-    const mi::Uint32 U1 = texremap(crop_texres.x, wrap_u, crop_offset[0], U+1.0f);
-    const mi::Uint32 V0 = texremap(crop_texres.y, wrap_v, crop_offset[1], V);
-    const mi::Uint32 V1 = texremap(crop_texres.y, wrap_v, crop_offset[1], V+1.0f);
+// Trilinear lookup of a single coordinate in a 3D texture, whose layers are the slices in
+// w direction.
+static inline void tex_lookup3D(
+    mi::Float32                   res[4],
+    Texture const                 &tex,
+    const mi::Float32             uvw[3],
+    mi::neuraylib::Tex_wrap_mode  wrap_u,
+    mi::neuraylib::Tex_wrap_mode  wrap_v,
+    mi::neuraylib::Tex_wrap_mode  wrap_w,
+    const Texture_axis            &axis_u,
+    const Texture_axis            &axis_v,
+    const Texture_axis            &axis_w)
+{
+    const mi::Float32 U = clamp_texel_coord(uvw[0] * axis_u.crop_res_f - 0.5f);
+    const mi::Float32 V = clamp_texel_coord(uvw[1] * axis_v.crop_res_f - 0.5f);
+    const mi::Float32 W = clamp_texel_coord(uvw[2] * axis_w.crop_res_f - 0.5f);
+    const mi::Float32 U_floor = mi::math::floor(U);
+    const mi::Float32 V_floor = mi::math::floor(V);
+    const mi::Float32 W_floor = mi::math::floor(W);
+    const mi::Sint32 Ui = mi::Sint32(U_floor);
+    const mi::Sint32 Vi = mi::Sint32(V_floor);
+    const mi::Sint32 Wi = mi::Sint32(W_floor);
+
+    const mi::Sint32 u0 = texremap(axis_u, wrap_u, Ui), u1 = texremap(axis_u, wrap_u, Ui + 1);
+    const mi::Sint32 v0 = texremap(axis_v, wrap_v, Vi), v1 = texremap(axis_v, wrap_v, Vi + 1);
+    const mi::Float32 ufrac = filter_weight(U - U_floor);
+    const mi::Float32 vfrac = filter_weight(V - V_floor);
+    const size_t row_stride = tex.levels[0].row_stride;
+
+    mi::Float32 c0[4], c1[4];
+    tex_fetch_bilinear(c0, tex.layers[texremap(axis_w, wrap_w, Wi)], row_stride,
+        u0, u1, v0, v1, ufrac, vfrac);
+    tex_fetch_bilinear(c1, tex.layers[texremap(axis_w, wrap_w, Wi + 1)], row_stride,
+        u0, u1, v0, v1, ufrac, vfrac);
+    lerp4(res, c0, c1, filter_weight(W - W_floor));
+}
 
-    const mi::Uint32 i00 = (tex.size.x * V0 + U0) * tex.ncomp;
-    const mi::Uint32 i01 = (tex.size.x * V0 + U1) * tex.ncomp;
-    const mi::Uint32 i10 = (tex.size.x * V1 + U0) * tex.ncomp;
-    const mi::Uint32 i11 = (tex.size.x * V1 + U1) * tex.ncomp;
+// Bilinear lookup of a single direction in a cube map.
+//
+// Thanks to the face borders, the four texels are always taken from the same face, which makes
+// the filtering seamless across the cube edges.
+static inline void tex_lookup_cube(
+    mi::Float32                   res[4],
+    Texture const                 &tex,
+    const mi::Float32             dir[3])
+{
+    mi::Float32 uv[2];
+    const mi::Uint32 face = cube_face_coords(uv, dir[0], dir[1], dir[2]);
+
+    const mi::Float32 n = mi::Float32(tex.size.x);
+    const mi::Float32 U = std::min(std::max(uv[0] * n - 0.5f, -0.5f), n - 0.5f);
+    const mi::Float32 V = std::min(std::max(uv[1] * n - 0.5f, -0.5f), n - 0.5f);
+    const mi::Float32 U_floor = mi::math::floor(U);
+    const mi::Float32 V_floor = mi::math::floor(V);
+    const mi::Sint32 Ui = mi::Sint32(U_floor);
+    const mi::Sint32 Vi = mi::Sint32(V_floor);
+
+    // cube_face() points to texel (0, 0), so the border at -1 is addressed from the row before
+    tex_fetch_bilinear(res, tex.cube_face(face) - tex.cube_row_stride - 4, tex.cube_row_stride,
+        Ui + 1, Ui + 2, Vi + 1, Vi + 2,
+        filter_weight(U - U_floor), filter_weight(V - V_floor));
+}
 
-    mi::Float32 ufrac = U - mi::math::floor(U);
-    mi::Float32 vfrac = V - mi::math::floor(V);
+// Maximum number of samples taken along the major axis of the pixel footprint by
+// tex_lookup2D_grad().
+#define TEX_MAX_ANISOTROPY 8
 
-#ifdef USE_SMOOTHERSTEP_FILTER
-    ufrac *= ufrac*ufrac*(ufrac*(ufrac*6.0f - 15.0f) + 10.0f); // smoother step
-    vfrac *= vfrac*vfrac*(vfrac*(vfrac*6.0f - 15.0f) + 10.0f);
-#endif
+// Trilinear lookup of a single texture coordinate at the given level of detail.
+static inline void tex_lookup2D_lod(
+    mi::Float32                   res[4],
+    Texture const                 &tex,
+    const mi::Float32             uv[2],
+    mi::Float32                   lod,
+    mi::neuraylib::Tex_wrap_mode  wrap_u,
+    mi::neuraylib::Tex_wrap_mode  wrap_v,
+    const mi::Float32             crop_u[2],
+    const mi::Float32             crop_v[2])
+{
+    const mi::Float32 max_lod = mi::Float32(tex.levels.size() - 1);
+    lod = std::min(std::max(lod, 0.0f), max_lod);
+
+    const mi::Uint32 l0 = mi::Uint32(lod);
+    Texture_level const &level0 = tex.levels[l0];
+    tex_lookup2D(res, level0, uv, wrap_u, wrap_v, level0.axis_u(crop_u), level0.axis_v(crop_v));
+
+    const mi::Float32 lfrac = lod - mi::Float32(l0);
+    if (lfrac > 0.0f) {
+        Texture_level const &level1 = tex.levels[l0 + 1];
+        mi::Float32 c1[4];
+        tex_lookup2D(c1, level1, uv, wrap_u, wrap_v, level1.axis_u(crop_u), level1.axis_v(crop_v));
+        for (int i = 0; i < 4; ++i)
+            res[i] += (c1[i] - res[i]) * lfrac;
+    }
+}
 
-    const mi::Float32_4 c1 = mi::math::lerp(
-        mi::Float32_4(tex.data[i00 + 0], tex.data[i00 + 1], tex.data[i00 + 2], tex.data[i00 + 3]),
-        mi::Float32_4(tex.data[i01 + 0], tex.data[i01 + 1], tex.data[i01 + 2], tex.data[i01 + 3]),
-        ufrac);
+// Filtered lookup of a single texture coordinate with the given screen-space derivatives.
+//
+// The derivatives span the (elliptical) footprint of the pixel in texture space. The level of
+// detail is chosen from the minor axis of the footprint, and up to TEX_MAX_ANISOTROPY trilinear
+// samples are distributed along the major axis. For isotropic footprints, this degenerates to
+// a single trilinear lookup.
+static inline void tex_lookup2D_grad(
+    mi::Float32                   res[4],
+    Texture const                 &tex,
+    const mi::Float32             uv[2],
+    const mi::Float32             duv_dx[2],
+    const mi::Float32             duv_dy[2],
+    mi::neuraylib::Tex_wrap_mode  wrap_u,
+    mi::neuraylib::Tex_wrap_mode  wrap_v,
+    const mi::Float32             crop_u[2],
+    const mi::Float32             crop_v[2])
+{
+    if (tex.levels.size() == 1) {
+        tex_lookup2D(res, tex, uv, wrap_u, wrap_v, crop_u, crop_v);
+        return;
+    }
 
-    const mi::Float32_4 c2 = mi::math::lerp(
-        mi::Float32_4(tex.data[i10 + 0], tex.data[i10 + 1], tex.data[i10 + 2], tex.data[i10 + 3]),
-        mi::Float32_4(tex.data[i11 + 0], tex.data[i11 + 1], tex.data[i11 + 2], tex.data[i11 + 3]),
-        ufrac);
+    // footprint in texels of level 0
+    Texture_level const &level0 = tex.levels[0];
+    const mi::Float32 res_u = level0.axis_u(crop_u).crop_res_f;
+    const mi::Float32 res_v = level0.axis_v(crop_v).crop_res_f;
+    const mi::Float32 dx_u = duv_dx[0] * res_u, dx_v = duv_dx[1] * res_v;
+    const mi::Float32 dy_u = duv_dy[0] * res_u, dy_v = duv_dy[1] * res_v;
+    const mi::Float32 len_x = std::sqrt(dx_u * dx_u + dx_v * dx_v);
+    const mi::Float32 len_y = std::sqrt(dy_u * dy_u + dy_v * dy_v);
+
+    const bool x_major = len_x >= len_y;
+    const mi::Float32 major = x_major ? len_x : len_y;
+    const mi::Float32 minor = x_major ? len_y : len_x;
+
+    mi::Uint32 num_samples = 1;
+    if (minor > 0.0f)
+        num_samples = mi::Uint32(std::min(
+            std::ceil(major / minor), mi::Float32(TEX_MAX_ANISOTROPY)));
+    else if (major > 0.0f)
+        num_samples = TEX_MAX_ANISOTROPY;
+
+    // the filter width of a sample is the major axis divided among the samples
+    const mi::Float32 width = major / mi::Float32(num_samples);
+    const mi::Float32 lod = width > 1.0f ? std::log2(width) : 0.0f;
+
+    if (num_samples == 1) {
+        tex_lookup2D_lod(res, tex, uv, lod, wrap_u, wrap_v, crop_u, crop_v);
+        return;
+    }
 
-    store_result4(res, mi::math::lerp(c1, c2, vfrac));
+    const mi::Float32 *axis = x_major ? duv_dx : duv_dy;
+    const mi::Float32 inv_num_samples = 1.0f / mi::Float32(num_samples);
+    res[0] = res[1] = res[2] = res[3] = 0.0f;
+    for (mi::Uint32 i = 0; i < num_samples; ++i) {
+        const mi::Float32 t = (mi::Float32(i) + 0.5f) * inv_num_samples - 0.5f;
+        const mi::Float32 sample_uv[2] = { uv[0] + axis[0] * t, uv[1] + axis[1] * t };
+        mi::Float32 c[4];
+        tex_lookup2D_lod(c, tex, sample_uv, lod, wrap_u, wrap_v, crop_u, crop_v);
+        for (int k = 0; k < 4; ++k)
+            res[k] += c[k] * inv_num_samples;
+    }
 }
 
 /// Implementation of \c tex::lookup_float4() for a texture_2d texture.
@@ -249,7 +1066,61 @@ void tex_lookup_float3_2d(
     }
 
     mi::Float32 c[4];
-    tex_lookup_float4_2d(c, self, texture_idx, coord, wrap_u, wrap_v, crop_u, crop_v);
+    tex_lookup2D(c, self->textures[texture_idx - 1], coord, wrap_u, wrap_v, crop_u, crop_v);
+
+    result[0] = c[0];
+    result[1] = c[1];
+    result[2] = c[2];
+}
+
+/// Implementation of \c tex::lookup_float4() for a texture_2d texture with derivatives.
+void tex_lookup_deriv_float4_2d(
+    mi::Float32 result[4],
+    const mi::neuraylib::Texture_handler_base *self_base,
+    mi::Uint32 texture_idx,
+    const mi::neuraylib::tct_deriv_float2 *coord,
+    mi::neuraylib::Tex_wrap_mode wrap_u,
+    mi::neuraylib::Tex_wrap_mode wrap_v,
+    const mi::Float32 crop_u[2],
+    const mi::Float32 crop_v[2])
+{
+    Texture_handler const *self = static_cast<Texture_handler const *>(self_base);
+
+    if (texture_idx == 0 || texture_idx - 1 >= self->num_textures) {
+        // invalid texture returns zero
+        store_result4(result, 0.0f);
+        return;
+    }
+
+    const mi::Float32 uv[2] = { coord->val.x, coord->val.y };
+    const mi::Float32 duv_dx[2] = { coord->dx.x, coord->dx.y };
+    const mi::Float32 duv_dy[2] = { coord->dy.x, coord->dy.y };
+
+    Texture const &tex = self->textures[texture_idx - 1];
+    tex_lookup2D_grad(result, tex, uv, duv_dx, duv_dy, wrap_u, wrap_v, crop_u, crop_v);
+}
+
+/// Implementation of \c tex::lookup_float3() for a texture_2d texture with derivatives.
+void tex_lookup_deriv_float3_2d(
+    mi::Float32 result[3],
+    const mi::neuraylib::Texture_handler_base *self_base,
+    mi::Uint32 texture_idx,
+    const mi::neuraylib::tct_deriv_float2 *coord,
+    mi::neuraylib::Tex_wrap_mode wrap_u,
+    mi::neuraylib::Tex_wrap_mode wrap_v,
+    const mi::Float32 crop_u[2],
+    const mi::Float32 crop_v[2])
+{
+    Texture_handler const *self = static_cast<Texture_handler const *>(self_base);
+
+    if (texture_idx == 0 || texture_idx - 1 >= self->num_textures) {
+        // invalid texture returns zero
+        store_result3(result, 0.0f);
+        return;
+    }
+
+    mi::Float32 c[4];
+    tex_lookup_deriv_float4_2d(c, self, texture_idx, coord, wrap_u, wrap_v, crop_u, crop_v);
 
     result[0] = c[0];
     result[1] = c[1];
@@ -268,22 +1139,29 @@ void tex_texel_float4_2d(
 
     if (texture_idx == 0 || texture_idx - 1 >= self->num_textures) {
         // invalid texture returns zero
-        store_result3(result, 0.0f);
+        store_result4(result, 0.0f);
         return;
     }
 
     Texture const &tex = self->textures[texture_idx - 1];
 
-    const mi::Uint32 idx = (tex.size.x * coord[1] + coord[0]) * tex.ncomp;
+    if (coord[0] < 0 || mi::Uint32(coord[0]) >= tex.size.x ||
+        coord[1] < 0 || mi::Uint32(coord[1]) >= tex.size.y) {
+        // out of range texel coordinates return zero
+        store_result4(result, 0.0f);
+        return;
+    }
 
-    store_result4(result,
-        mi::Float32_4(tex.data[idx + 0], tex.data[idx + 1], tex.data[idx + 2], tex.data[idx + 3]));
+    const mi::Float32 *texel =
+        tex.data + size_t(coord[1]) * tex.levels[0].row_stride + size_t(coord[0]) * 4;
+
+    store_result4(result, texel[0], texel[1], texel[2], texel[3]);
 }
 
 /// Implementation of \c tex::lookup_float4() for a texture_3d texture.
 void tex_lookup_float4_3d(
     mi::Float32 result[4],
-    const mi::neuraylib::Texture_handler_base *self,
+    const mi::neuraylib::Texture_handler_base *self_base,
     mi::Uint32 texture_idx,
     const mi::Float32 coord[3],
     mi::neuraylib::Tex_wrap_mode wrap_u,
@@ -293,16 +1171,24 @@ void tex_lookup_float4_3d(
     const mi::Float32 crop_v[2],
     const mi::Float32 crop_w[2])
 {
-    result[0] = 0.0f;
-    result[1] = 0.0f;
-    result[2] = 0.0f;
-    result[3] = 1.0f;
+    Texture_handler const *self = static_cast<Texture_handler const *>(self_base);
+
+    if (texture_idx == 0 || texture_idx - 1 >= self->num_textures) {
+        // invalid texture returns zero
+        store_result4(result, 0.0f);
+        return;
+    }
+
+    Texture const &tex = self->textures[texture_idx - 1];
+    tex_lookup3D(result, tex, coord, wrap_u, wrap_v, wrap_w,
+        tex.levels[0].axis_u(crop_u), tex.levels[0].axis_v(crop_v),
+        make_texture_axis(tex.size.z, crop_w));
 }
 
 /// Implementation of \c tex::lookup_float3() for a texture_3d texture.
 void tex_lookup_float3_3d(
     mi::Float32 result[3],
-    const mi::neuraylib::Texture_handler_base *self,
+    const mi::neuraylib::Texture_handler_base *self_base,
     mi::Uint32 texture_idx,
     const mi::Float32 coord[3],
     mi::neuraylib::Tex_wrap_mode wrap_u,
@@ -312,47 +1198,78 @@ void tex_lookup_float3_3d(
     const mi::Float32 crop_v[2],
     const mi::Float32 crop_w[2])
 {
-    result[0] = 0.0f;
-    result[1] = 0.0f;
-    result[2] = 0.0f;
+    mi::Float32 c[4];
+    tex_lookup_float4_3d(c, self_base, texture_idx, coord, wrap_u, wrap_v, wrap_w,
+        crop_u, crop_v, crop_w);
+
+    result[0] = c[0];
+    result[1] = c[1];
+    result[2] = c[2];
 }
 
 /// Implementation of \c tex::texel_float4() for a texture_3d texture.
 void tex_texel_float4_3d(
     mi::Float32 result[4],
-    const mi::neuraylib::Texture_handler_base *self,
+    const mi::neuraylib::Texture_handler_base *self_base,
     mi::Uint32 texture_idx,
     const mi::Sint32 coord[3])
 {
-    result[0] = 0.0f;
-    result[1] = 0.0f;
-    result[2] = 0.0f;
-    result[3] = 1.0f;
+    Texture_handler const *self = static_cast<Texture_handler const *>(self_base);
+
+    if (texture_idx == 0 || texture_idx - 1 >= self->num_textures) {
+        // invalid texture returns zero
+        store_result4(result, 0.0f);
+        return;
+    }
+
+    Texture const &tex = self->textures[texture_idx - 1];
+
+    if (coord[0] < 0 || mi::Uint32(coord[0]) >= tex.size.x ||
+        coord[1] < 0 || mi::Uint32(coord[1]) >= tex.size.y ||
+        coord[2] < 0 || size_t(coord[2]) >= tex.layers.size()) {
+        // out of range texel coordinates return zero
+        store_result4(result, 0.0f);
+        return;
+    }
+
+    const mi::Float32 *texel = tex.layers[coord[2]] +
+        size_t(coord[1]) * tex.levels[0].row_stride + size_t(coord[0]) * 4;
+
+    store_result4(result, texel[0], texel[1], texel[2], texel[3]);
 }
 
 /// Implementation of \c tex::lookup_float4() for a texture_cube texture.
 void tex_lookup_float4_cube(
     mi::Float32 result[4],
-    const mi::neuraylib::Texture_handler_base *self,
+    const mi::neuraylib::Texture_handler_base *self_base,
     mi::Uint32 texture_idx,
     const mi::Float32 coord[3])
 {
-    result[0] = 0.0f;
-    result[1] = 0.0f;
-    result[2] = 0.0f;
-    result[3] = 1.0f;
+    Texture_handler const *self = static_cast<Texture_handler const *>(self_base);
+
+    if (texture_idx == 0 || texture_idx - 1 >= self->num_textures ||
+            self->textures[texture_idx - 1].cube_faces.empty()) {
+        // invalid texture returns zero
+        store_result4(result, 0.0f);
+        return;
+    }
+
+    tex_lookup_cube(result, self->textures[texture_idx - 1], coord);
 }
 
 /// Implementation of \c tex::lookup_float3() for a texture_cube texture.
 void tex_lookup_float3_cube(
     mi::Float32 result[3],
-    const mi::neuraylib::Texture_handler_base *self,
+    const mi::neuraylib::Texture_handler_base *self_base,
     mi::Uint32 texture_idx,
     const mi::Float32 coord[3])
 {
-    result[0] = 0.0f;
-    result[1] = 0.0f;
-    result[2] = 0.0f;
+    mi::Float32 c[4];
+    tex_lookup_float4_cube(c, self_base, texture_idx, coord);
+
+    result[0] = c[0];
+    result[1] = c[1];
+    result[2] = c[2];
 }
 
 /// Implementation of \c resolution_2d function needed by generated code,
@@ -385,9 +1302,21 @@ void tex_resolution_3d(
     const mi::neuraylib::Texture_handler_base *self_base,
     mi::Uint32 texture_idx)
 {
-    result[0] = 0;
-    result[1] = 0;
-    result[2] = 0;
+    Texture_handler const *self = static_cast<Texture_handler const *>(self_base);
+
+    if (texture_idx == 0 || texture_idx - 1 >= self->num_textures) {
+        // invalid texture returns zero
+        result[0] = 0;
+        result[1] = 0;
+        result[2] = 0;
+        return;
+    }
+
+    Texture const &tex = self->textures[texture_idx - 1];
+
+    result[0] = tex.size.x;
+    result[1] = tex.size.y;
+    result[2] = tex.size.z;
 }
 
 /// Implementation of \c tex::texture_isvalid() function.
@@ -399,13 +1328,24 @@ bool tex_isvalid(
     return texture_idx != 0 && texture_idx - 1 < self->num_textures;
 }
 
+/// Returns the light profile with the given index or \c nullptr, if the index is invalid.
+static inline Lightprofile const *get_lightprofile(
+    const Texture_handler_base *self_base,
+    mi::Uint32                  light_profile_idx)
+{
+    Texture_handler const *self = static_cast<Texture_handler const *>(self_base);
+    if (light_profile_idx == 0 || light_profile_idx - 1 >= self->num_lightprofiles)
+        return nullptr;
+    return &self->lightprofiles[light_profile_idx - 1];
+}
+
 /// Implementation of \c df::light_profile_power() for a light profile.
-/// Note: The example does not support light profiles.
 mi::Float32 light_profile_power(
     const Texture_handler_base *self,
     mi::Uint32                  light_profile_idx)
 {
-    return 0.0f;
+    Lightprofile const *lp = get_lightprofile(self, light_profile_idx);
+    return lp ? lp->total_power : 0.0f;    // invalid light profile returns zero
 }
 
 /// Implementation of \c df::light_profile_maximum() for a light profile.
@@ -413,7 +1353,8 @@ mi::Float32 light_profile_maximum(
     const Texture_handler_base *self,
     mi::Uint32                  light_profile_idx)
 {
-    return 0.0f;
+    Lightprofile const *lp = get_lightprofile(self, light_profile_idx);
+    return lp ? lp->candela_multiplier : 0.0f;
 }
 
 /// Implementation of \c df::light_profile_isvalid() for a light profile.
@@ -421,7 +1362,18 @@ bool light_profile_isvalid(
     const Texture_handler_base *self,
     mi::Uint32                  light_profile_idx)
 {
-    return false;
+    return get_lightprofile(self, light_profile_idx) != nullptr;
+}
+
+/// Maps phi from [-pi, pi] to the phi range of the given light profile.
+static inline mi::Float32 light_profile_phi(Lightprofile const &lp, mi::Float32 phi_in)
+{
+    // converting input phi from -pi..pi to 0..2pi
+    mi::Float32 phi = (phi_in > 0.0f) ? phi_in : (float(2.0 * M_PI) + phi_in);
+
+    // floorf wraps phi range into 0..2pi
+    return phi - lp.theta_phi_start.y -
+        floorf((phi - lp.theta_phi_start.y) * float(0.5 / M_PI)) * float(2.0 * M_PI);
 }
 
 /// Implementation of \c df::light_profile_evaluate() for a light profile.
@@ -430,7 +1382,47 @@ mi::Float32 light_profile_evaluate(
     mi::Uint32 light_profile_idx,
     const float theta_phi[2])
 {
-    return 0.0f;
+    Lightprofile const *lp = get_lightprofile(self, light_profile_idx);
+    if (!lp)
+        return 0.0f;
+
+    // map theta to 0..1 range
+    const float u = (theta_phi[0] - lp->theta_phi_start.x) *
+        lp->theta_phi_inv_delta.x / float(lp->angular_resolution.x - 1);
+
+    // (phi < 0.0f) is handled by the border, as there is no data below the start of phi
+    const float v = light_profile_phi(*lp, theta_phi[1]) *
+        lp->theta_phi_inv_delta.y / float(lp->angular_resolution.y - 1);
+
+    if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+        return 0.0f;
+
+    return lp->lookup(u, v) * lp->candela_multiplier;
+}
+
+/// Samples one of the given CDFs and rescales the random number for re-usage.
+/// Returns the sampled index and the probability of the selected interval.
+static inline mi::Uint32 sample_cdf_rescale(
+    const mi::Float32 *cdf,
+    const mi::Uint32  *guide,
+    mi::Uint32         size,
+    mi::Float32       &xi,
+    mi::Float32       &prob)
+{
+    const mi::Uint32 idx = sample_cdf(cdf, guide, size, xi);
+    prob = cdf[idx];
+    if (idx > 0) {
+        prob -= cdf[idx - 1];
+        xi -= cdf[idx - 1];
+    }
+    xi /= prob;
+    return idx;
+}
+
+/// Returns the probability of the given interval of a CDF.
+static inline mi::Float32 cdf_probability(const mi::Float32 *cdf, mi::Uint32 idx)
+{
+    return idx > 0 ? cdf[idx] - cdf[idx - 1] : cdf[idx];
 }
 
 /// Implementation of \c df::light_profile_sample() for a light profile.
@@ -440,9 +1432,45 @@ void light_profile_sample(
     mi::Uint32 light_profile_idx,
     const float xi[3])
 {
-    result[0] = 0.0f;
-    result[1] = 0.0f;
+    result[0] = -1.0f;  // negative theta means no emission
+    result[1] = -1.0f;
     result[2] = 0.0f;
+
+    Lightprofile const *lp = get_lightprofile(self, light_profile_idx);
+    if (!lp)
+        return;
+
+    const mi::Uint32_2_struct res = lp->angular_resolution;
+
+    // sample theta_out
+    float xi0 = xi[0], prob_theta;
+    const mi::Uint32 idx_theta = sample_cdf_rescale(
+        lp->cdf_data.data(), lp->cdf_guide.data(), res.x - 1, xi0, prob_theta);
+
+    // sample phi_out
+    float xi1 = xi[1], prob_phi;
+    const float *cdf_data_phi = lp->phi_cdf(idx_theta);
+    const mi::Uint32 idx_phi = sample_cdf_rescale(
+        cdf_data_phi, &lp->cdf_guide[cdf_data_phi - lp->cdf_data.data()], res.y - 1,
+        xi1, prob_phi);
+
+    // sample uniformly within the patch (grid cell)
+    const mi::Float32_2_struct start = lp->theta_phi_start;
+    const mi::Float32_2_struct delta = lp->theta_phi_delta;
+
+    const float cos_theta_0 = cosf(start.x + float(idx_theta)      * delta.x);
+    const float cos_theta_1 = cosf(start.x + float(idx_theta + 1u) * delta.x);
+
+    // => \cos{\theta} = (1 - \xi) \cos{\theta_0} + \xi \cos{\theta_1}
+    const float cos_theta = (1.0f - xi1) * cos_theta_0 + xi1 * cos_theta_1;
+    result[0] = acosf(cos_theta);
+    result[1] = start.y + (float(idx_phi) + xi0) * delta.y;
+
+    // align phi
+    if (result[1] > float(2.0 * M_PI)) result[1] -= float(2.0 * M_PI);              // wrap
+    if (result[1] > float(1.0 * M_PI)) result[1] = float(-2.0 * M_PI) + result[1];  // to [-pi, pi]
+
+    result[2] = prob_theta * prob_phi / (delta.y * (cos_theta_0 - cos_theta_1));
 }
 
 /// Implementation of \c df::light_profile_pdf() for a light profile.
@@ -451,28 +1479,94 @@ mi::Float32 light_profile_pdf(
     mi::Uint32 light_profile_idx,
     const float theta_phi[2])
 {
-    return 0.0f;
+    Lightprofile const *lp = get_lightprofile(self, light_profile_idx);
+    if (!lp)
+        return 0.0f;
+
+    const mi::Uint32_2_struct res = lp->angular_resolution;
+
+    const float theta = theta_phi[0] - lp->theta_phi_start.x;
+    const int idx_theta = int(theta * lp->theta_phi_inv_delta.x);
+    const int idx_phi = int(light_profile_phi(*lp, theta_phi[1]) * lp->theta_phi_inv_delta.y);
+
+    // like the CUDA runtime, the phi index is checked against the theta resolution
+    if (idx_theta < 0 || idx_theta > int(res.x) - 2 || idx_phi < 0 || idx_phi > int(res.x) - 2)
+        return 0.0f;
+
+    const float prob_theta = cdf_probability(lp->cdf_data.data(), idx_theta);
+    const float prob_phi = cdf_probability(lp->phi_cdf(idx_theta), idx_phi);
+
+    // compute probability to select a position in the sphere patch
+    const mi::Float32_2_struct start = lp->theta_phi_start;
+    const mi::Float32_2_struct delta = lp->theta_phi_delta;
+
+    const float cos_theta_0 = cosf(start.x + float(idx_theta)      * delta.x);
+    const float cos_theta_1 = cosf(start.x + float(idx_theta + 1u) * delta.x);
+
+    return prob_theta * prob_phi / (delta.y * (cos_theta_0 - cos_theta_1));
 }
 
-/// Implementation of \c df::bsdf_measurement_isvalid() for a light profile.
-/// Note: The example does not support BSDF measurements.
+/// Returns the MBSDF with the given index or \c nullptr, if the index is invalid or the MBSDF
+/// has no data for the given part.
+static inline Mbsdf const *get_mbsdf(
+    const Texture_handler_base *self_base,
+    mi::Uint32                  bsdf_measurement_index,
+    unsigned                    part_index)
+{
+    Texture_handler const *self = static_cast<Texture_handler const *>(self_base);
+    if (bsdf_measurement_index == 0 || bsdf_measurement_index - 1 >= self->num_mbsdfs)
+        return nullptr;
+    Mbsdf const *bm = &self->mbsdfs[bsdf_measurement_index - 1];
+    return bm->has_data[part_index] ? bm : nullptr;
+}
+
+/// Implementation of \c df::bsdf_measurement_isvalid() for an MBSDF.
 bool bsdf_measurement_isvalid(
-    const Texture_handler_base *self,
+    const Texture_handler_base *self_base,
     mi::Uint32                  bsdf_measurement_index)
 {
-    return false;
+    Texture_handler const *self = static_cast<Texture_handler const *>(self_base);
+    return bsdf_measurement_index != 0 && bsdf_measurement_index - 1 < self->num_mbsdfs;
 }
 
-/// Implementation of \c df::bsdf_measurement_resolution().
+/// Implementation of \c df::bsdf_measurement_resolution(), which retrieves the number of
+/// equi-spaced steps of theta_i and theta_o, the number of equi-spaced steps of phi, and the
+/// number of color channels (1 or 3) of the given MBSDF part.
 void bsdf_measurement_resolution(
     mi::Uint32 result[3],
     const Texture_handler_base *self,
     mi::Uint32 bsdf_measurement_index,
     mi::neuraylib::Mbsdf_part part)
 {
-    result[0] = 0;
-    result[1] = 0;
-    result[2] = 0;
+    const unsigned part_index = static_cast<unsigned>(part);
+    Mbsdf const *bm = get_mbsdf(self, bsdf_measurement_index, part_index);
+    if (!bm) {
+        // invalid MBSDF returns zero
+        result[0] = 0;
+        result[1] = 0;
+        result[2] = 0;
+        return;
+    }
+
+    result[0] = bm->angular_resolution[part_index].x;
+    result[1] = bm->angular_resolution[part_index].y;
+    result[2] = bm->num_channels[part_index];
+}
+
+/// Computes the normalized lookup coordinates (phi_delta, theta_out, theta_in) of an MBSDF.
+static inline void bsdf_compute_uvw(
+    mi::Float32 uvw[3],
+    const mi::Float32 theta_phi_in[2],
+    const mi::Float32 theta_phi_out[2])
+{
+    // assuming each phi is between -pi and pi
+    float u = theta_phi_out[1] - theta_phi_in[1];
+    if (u < 0.0f) u += float(2.0 * M_PI);
+    if (u > float(1.0 * M_PI)) u = float(2.0 * M_PI) - u;
+
+    uvw[0] = u * float(M_ONE_OVER_PI);
+    uvw[1] = theta_phi_out[0] * float(2.0 / M_PI);
+    uvw[2] = theta_phi_in[0] * float(2.0 / M_PI);
 }
 
 /// Implementation of \c df::bsdf_measurement_evaluate() for an MBSDF.
@@ -484,9 +1578,16 @@ void bsdf_measurement_evaluate(
     const mi::Float32 theta_phi_out[2],
     mi::neuraylib::Mbsdf_part part)
 {
-    result[0] = 0.0f;
-    result[1] = 0.0f;
-    result[2] = 0.0f;
+    const unsigned part_index = static_cast<unsigned>(part);
+    Mbsdf const *bm = get_mbsdf(self, bsdf_measurement_index, part_index);
+    if (!bm) {
+        store_result3(result, 0.0f);
+        return;
+    }
+
+    mi::Float32 uvw[3];
+    bsdf_compute_uvw(uvw, theta_phi_in, theta_phi_out);
+    bm->lookup(result, part_index, uvw[0], uvw[1], uvw[2]);
 }
 
 /// Implementation of \c df::bsdf_measurement_sample() for an MBSDF.
@@ -498,9 +1599,62 @@ void bsdf_measurement_sample(
     const mi::Float32 xi[3],
     mi::neuraylib::Mbsdf_part part)
 {
-    result[0] = 0.0f;
-    result[1] = 0.0f;
+    result[0] = -1.0f;  // negative theta means absorption
+    result[1] = -1.0f;
     result[2] = 0.0f;
+
+    const unsigned part_index = static_cast<unsigned>(part);
+    Mbsdf const *bm = get_mbsdf(self, bsdf_measurement_index, part_index);
+    if (!bm)
+        return;
+
+    const mi::Uint32_2_struct res = bm->angular_resolution[part_index];
+
+    // compute the theta_in index (flipping input and output, BSDFs are symmetric)
+    mi::Uint32 idx_theta_in =
+        mi::Uint32(theta_phi_out[0] * float(M_ONE_OVER_PI) * 2.0f * float(res.x));
+    idx_theta_in = std::min(idx_theta_in, res.x - 1);
+
+    // sample theta_out
+    float xi0 = xi[0], prob_theta;
+    const float *cdf_theta = bm->theta_cdf(part_index, idx_theta_in);
+    const mi::Uint32 idx_theta_out = sample_cdf_rescale(
+        cdf_theta, bm->cdf_guide(part_index, cdf_theta), res.x, xi0, prob_theta);
+
+    // select which half-circle to choose with probability 0.5
+    float xi1 = xi[1], prob_phi;
+    const bool flip = (xi1 > 0.5f);
+    if (flip)
+        xi1 = 1.0f - xi1;
+    xi1 *= 2.0f;
+
+    // sample phi_out
+    const float *cdf_phi = bm->phi_cdf(part_index, idx_theta_in, idx_theta_out);
+    const mi::Uint32 idx_phi_out = sample_cdf_rescale(
+        cdf_phi, bm->cdf_guide(part_index, cdf_phi), res.y, xi1, prob_phi);
+
+    // compute theta and phi out
+    const mi::Float32_2_struct inv_res = bm->inv_angular_resolution[part_index];
+
+    const float s_theta = float(0.5 * M_PI) * inv_res.x;
+    const float s_phi   = float(1.0 * M_PI) * inv_res.y;
+
+    const float cos_theta_0 = cosf(float(idx_theta_out)      * s_theta);
+    const float cos_theta_1 = cosf(float(idx_theta_out + 1u) * s_theta);
+
+    const float cos_theta = cos_theta_0 * (1.0f - xi1) + cos_theta_1 * xi1;
+    result[0] = acosf(cos_theta);
+    result[1] = (float(idx_phi_out) + xi0) * s_phi;
+
+    if (flip)
+        result[1] = float(2.0 * M_PI) - result[1];  // phi \in [0, 2pi]
+
+    // align phi
+    result[1] += (theta_phi_out[1] > 0) ? theta_phi_out[1] : (float(2.0 * M_PI) + theta_phi_out[1]);
+    if (result[1] > float(2.0 * M_PI)) result[1] -= float(2.0 * M_PI);
+    if (result[1] > float(1.0 * M_PI)) result[1] = float(-2.0 * M_PI) + result[1];  // to [-pi, pi]
+
+    result[2] = prob_theta * prob_phi * 0.5f / (s_phi * (cos_theta_0 - cos_theta_1));
 }
 
 /// Implementation of \c df::bsdf_measurement_pdf() for an MBSDF.
@@ -511,12 +1665,66 @@ mi::Float32 bsdf_measurement_pdf(
     const mi::Float32 theta_phi_out[2],
     mi::neuraylib::Mbsdf_part part)
 {
-    return 0.0f;
+    const unsigned part_index = static_cast<unsigned>(part);
+    Mbsdf const *bm = get_mbsdf(self, bsdf_measurement_index, part_index);
+    if (!bm)
+        return 0.0f;
+
+    const mi::Uint32_2_struct res = bm->angular_resolution[part_index];
+
+    // compute indices in the CDF data
+    mi::Float32 uvw[3];
+    bsdf_compute_uvw(uvw, theta_phi_in, theta_phi_out);
+    mi::Uint32 idx_theta_in =
+        mi::Uint32(theta_phi_in[0] * float(M_ONE_OVER_PI) * 2.0f * float(res.x));
+    mi::Uint32 idx_theta_out =
+        mi::Uint32(theta_phi_out[0] * float(M_ONE_OVER_PI) * 2.0f * float(res.x));
+    mi::Uint32 idx_phi_out = mi::Uint32(uvw[0] * float(res.y));
+    idx_theta_in  = std::min(idx_theta_in, res.x - 1);
+    idx_theta_out = std::min(idx_theta_out, res.x - 1);
+    idx_phi_out   = std::min(idx_phi_out, res.y - 1);
+
+    const float prob_theta = cdf_probability(
+        bm->theta_cdf(part_index, idx_theta_in), idx_theta_out);
+    const float prob_phi = cdf_probability(
+        bm->phi_cdf(part_index, idx_theta_in, idx_theta_out), idx_phi_out);
+
+    // compute probability to select a position in the sphere patch
+    const mi::Float32_2_struct inv_res = bm->inv_angular_resolution[part_index];
+
+    const float s_theta = float(0.5 * M_PI) * inv_res.x;
+    const float s_phi   = float(1.0 * M_PI) * inv_res.y;
+
+    const float cos_theta_0 = cosf(float(idx_theta_out)      * s_theta);
+    const float cos_theta_1 = cosf(float(idx_theta_out + 1u) * s_theta);
+
+    return prob_theta * prob_phi * 0.5f / (s_phi * (cos_theta_0 - cos_theta_1));
+}
+
+/// Computes the albedo for the given direction and the maximum albedo of one MBSDF part.
+static inline void bsdf_measurement_albedo(
+    mi::Float32 result[2],
+    const Texture_handler_base *self,
+    mi::Uint32 bsdf_measurement_index,
+    const mi::Float32 theta_phi[2],
+    mi::neuraylib::Mbsdf_part part)
+{
+    const unsigned part_index = static_cast<unsigned>(part);
+    Mbsdf const *bm = get_mbsdf(self, bsdf_measurement_index, part_index);
+    if (!bm)
+        return;
+
+    const mi::Uint32 res_x = bm->angular_resolution[part_index].x;
+    mi::Uint32 idx_theta = mi::Uint32(theta_phi[0] * float(2.0 / M_PI) * float(res_x));
+    idx_theta = std::min(idx_theta, res_x - 1);
+    result[0] = bm->albedo_data[part_index][idx_theta];
+    result[1] = bm->max_albedo[part_index];
 }
 
 /// Implementation of \c df::bsdf_measurement_albedos() for an MBSDF.
 void bsdf_measurement_albedos(
-    mi::Float32 result[4],
+    mi::Float32 result[4],  // [0] albedo refl. for theta_phi, [1] max albedo refl. global,
+                            // [2] albedo trans. for theta_phi, [3] max albedo trans. global
     const Texture_handler_base *self,
     mi::Uint32 bsdf_measurement_index,
     const mi::Float32 theta_phi[2])
@@ -526,6 +1734,12 @@ void bsdf_measurement_albedos(
     result[2] = 0.0f;
     result[3] = 0.0f;
 
+    bsdf_measurement_albedo(
+        &result[0], self, bsdf_measurement_index, theta_phi,
+        mi::neuraylib::MBSDF_DATA_REFLECTION);
+    bsdf_measurement_albedo(
+        &result[2], self, bsdf_measurement_index, theta_phi,
+        mi::neuraylib::MBSDF_DATA_TRANSMISSION);
 }
 
 mi::neuraylib::Texture_handler_vtable tex_vtable = {
@@ -554,4 +1768,30 @@ mi::neuraylib::Texture_handler_vtable tex_vtable = {
     bsdf_measurement_albedos
 };
 
+mi::neuraylib::Texture_handler_deriv_vtable tex_deriv_vtable = {
+    tex_lookup_deriv_float4_2d,
+    tex_lookup_deriv_float3_2d,
+    tex_texel_float4_2d,
+    tex_lookup_float4_3d,
+    tex_lookup_float3_3d,
+    tex_texel_float4_3d,
+    tex_lookup_float4_cube,
+    tex_lookup_float3_cube,
+    tex_resolution_2d,
+    tex_resolution_3d,
+    tex_isvalid,
+    light_profile_power,
+    light_profile_maximum,
+    light_profile_isvalid,
+    light_profile_evaluate,
+    light_profile_sample,
+    light_profile_pdf,
+    bsdf_measurement_isvalid,
+    bsdf_measurement_resolution,
+    bsdf_measurement_evaluate,
+    bsdf_measurement_sample,
+    bsdf_measurement_pdf,
+    bsdf_measurement_albedos
+};
+
 #endif
@@ -181,6 +181,30 @@ void change_arguments( mi::neuraylib::INeuray* neuray, mi::neuraylib::ITransacti
             << std::endl;
         dump_instance( expression_factory.get(), function_call.get(), std::cout);
     }
+
+    // Changing arguments: using the argument batch editor
+    {
+        {
+            // Stage several changes of the function call and apply them in a single edit. The
+            // component change modifies the staged value of "tint" in place.
+            mi::neuraylib::Argument_batch_editor batch_editor(
+                transaction, function_call_name, mdl_factory.get());
+            mi::math::Color red( 1.0f, 0.0f, 0.0f);
+            check_success( batch_editor.set_value( "tint", red) == 0);
+            check_success( batch_editor.set_value( "tint", mi::Size( 2), 0.5f) == 0);
+            check_success( batch_editor.set_value( "distance", 4.0f) == 0);
+            check_success( batch_editor.get_staged_count() == 2);
+            check_success( batch_editor.commit() == 0);
+        }
+
+        mi::base::Handle<const mi::neuraylib::IFunction_call> function_call(
+            transaction->access<mi::neuraylib::IFunction_call>( function_call_name));
+        check_success( function_call.is_valid_interface());
+
+        std::cout << "Dumping batch-modified function call \"" << function_call_name << "\":"
+            << std::endl;
+        dump_instance( expression_factory.get(), function_call.get(), std::cout);
+    }
 }
 
 // Iterates over an annotation block and prints annotations and their parameters.
@@ -0,0 +1,329 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/math_benchmark.cpp
+//
+// Compares the Float32 specializations of the Math API with its general templates.
+//
+// The general templates are instantiated for a wrapper of Float32 that has no specializations,
+// so both variants perform the same arithmetic on the same data. For each operation, the time per
+// operation, the speedup and the largest relative difference of the results are printed.
+//
+// The batch transformations of mi/math/batch.h are compared with per-element calls of the Float32
+// specializations, and the color kernels of mi/math/color_batch.h with the standard library.
+//
+// The SIMD specializations are opt-in, the CMake target defines MI_MATH_ENABLE_SIMD for this
+// example, see mi/math/simd.h.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <mi/math.h>
+
+
+// A Float32 that makes the Math API use its general templates.
+struct Generic
+{
+    mi::Float32 v;
+
+    Generic() : v(0.0f) {}
+    Generic(mi::Float32 value) : v(value) {}
+};
+
+inline Generic operator+(Generic a, Generic b) { return Generic(a.v + b.v); }
+inline Generic operator-(Generic a, Generic b) { return Generic(a.v - b.v); }
+inline Generic operator*(Generic a, Generic b) { return Generic(a.v * b.v); }
+inline Generic operator/(Generic a, Generic b) { return Generic(a.v / b.v); }
+inline Generic operator-(Generic a) { return Generic(-a.v); }
+inline Generic& operator+=(Generic& a, Generic b) { a.v += b.v; return a; }
+inline Generic& operator-=(Generic& a, Generic b) { a.v -= b.v; return a; }
+inline Generic& operator*=(Generic& a, Generic b) { a.v *= b.v; return a; }
+inline Generic& operator/=(Generic& a, Generic b) { a.v /= b.v; return a; }
+inline bool operator==(Generic a, Generic b) { return a.v == b.v; }
+inline bool operator!=(Generic a, Generic b) { return a.v != b.v; }
+inline bool operator<(Generic a, Generic b) { return a.v < b.v; }
+inline bool operator>(Generic a, Generic b) { return a.v > b.v; }
+inline bool operator<=(Generic a, Generic b) { return a.v <= b.v; }
+inline bool operator>=(Generic a, Generic b) { return a.v >= b.v; }
+inline Generic abs(Generic a) { return Generic(std::fabs(a.v)); }
+
+typedef mi::math::Matrix<mi::Float32, 4, 4> Matrix4x4;
+typedef mi::math::Matrix<mi::Float32, 3, 4> Matrix3x4;
+typedef mi::math::Vector<mi::Float32, 3> Vector3;
+typedef mi::math::Vector<mi::Float32, 4> Vector4;
+
+typedef mi::math::Matrix<Generic, 4, 4> Generic_matrix4x4;
+typedef mi::math::Matrix<Generic, 3, 4> Generic_matrix3x4;
+typedef mi::math::Vector<Generic, 3> Generic_vector3;
+typedef mi::math::Vector<Generic, 4> Generic_vector4;
+
+// Input data, converted once for both variants.
+struct Data
+{
+    std::vector<Matrix4x4> matrices;
+    std::vector<Matrix3x4> matrices3x4;
+    std::vector<Vector3> vectors3;
+    std::vector<Vector4> vectors4;
+
+    std::vector<Generic_matrix4x4> generic_matrices;
+    std::vector<Generic_matrix3x4> generic_matrices3x4;
+    std::vector<Generic_vector3> generic_vectors3;
+    std::vector<Generic_vector4> generic_vectors4;
+};
+
+// Creates well conditioned transformations, i.e., rotations, scaling and translations.
+static void create_data(Data& data, size_t count)
+{
+    srand(42);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const mi::Float32 a = mi::Float32(rand()) / RAND_MAX * 6.28f;
+        const mi::Float32 b = mi::Float32(rand()) / RAND_MAX * 6.28f;
+        const mi::Float32 c = mi::Float32(rand()) / RAND_MAX * 6.28f;
+        Matrix4x4 m(1.0f);
+        m.set_rotation(a, b, c);
+        m.xx *= 1.0f + a; m.yy *= 1.0f + b; m.zz *= 1.0f + c;
+        m.set_translation(a - 3.0f, b - 3.0f, c - 3.0f);
+        if (i % 4 == 3)
+            m.xw = 0.01f * a; // projective
+        data.matrices.push_back(m);
+        data.matrices3x4.push_back(mi::math::sub_matrix<3, 4>(m));
+        data.vectors3.push_back(Vector3(a - 3.0f, b - 3.0f, c - 3.0f));
+        data.vectors4.push_back(Vector4(a - 3.0f, b - 3.0f, c - 3.0f, 1.0f));
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        data.generic_matrices.push_back(Generic_matrix4x4(data.matrices[i]));
+        data.generic_matrices3x4.push_back(Generic_matrix3x4(data.matrices3x4[i]));
+        data.generic_vectors3.push_back(Generic_vector3(data.vectors3[i]));
+        data.generic_vectors4.push_back(Generic_vector4(data.vectors4[i]));
+    }
+}
+
+inline mi::Float32 to_float(mi::Float32 a) { return a; }
+inline mi::Float32 to_float(Generic a) { return a.v; }
+
+// Returns the largest relative difference between two results.
+template <typename T, typename G>
+static mi::Float32 max_difference(const std::vector<T>& results, const std::vector<G>& reference)
+{
+    mi::Float32 max_diff = 0.0f;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const mi::Float32* r = results[i].begin();
+        const typename G::value_type* g = reference[i].begin();
+        for (mi::Size k = 0; k < T::SIZE; ++k)
+        {
+            const mi::Float32 expected = to_float(g[k]);
+            const mi::Float32 diff =
+                std::fabs(r[k] - expected) / std::max(1.0f, std::fabs(expected));
+            max_diff = std::max(max_diff, diff);
+        }
+    }
+    return max_diff;
+}
+
+// Returns the largest relative difference between two arrays of values.
+static mi::Float32 max_difference(
+    const std::vector<mi::Float32>& results, const std::vector<mi::Float32>& reference)
+{
+    mi::Float32 max_diff = 0.0f;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const mi::Float32 diff =
+            std::fabs(results[i] - reference[i]) / std::max(1.0f, std::fabs(reference[i]));
+        max_diff = std::max(max_diff, diff);
+    }
+    return max_diff;
+}
+
+// Runs an operation over all elements repeatedly and returns the time per operation in ns. The
+// fastest of several rounds is used, which is the least disturbed by other processes.
+template <typename F>
+static double measure(size_t count, size_t repetitions, F f)
+{
+    f(); // warm up
+    double best = 0.0;
+    for (size_t round = 0; round < 5; ++round)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repetitions; ++r)
+            f();
+        const std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        if (round == 0 || elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best / double(count * repetitions);
+}
+
+static void report(const char* name, double generic_ns, double specialized_ns, mi::Float32 diff)
+{
+    printf("%-28s %10.2f %12.2f %8.2fx %12.3g\n",
+        name, generic_ns, specialized_ns, generic_ns / specialized_ns, diff);
+}
+
+// Benchmarks an operation on Float32 data against the same operation on Generic data.
+#define BENCHMARK(name, result_type, generic_result_type, expression, generic_expression) \
+    {                                                                                      \
+        std::vector<result_type> results(count);                                         \
+        std::vector<generic_result_type> generic_results(count);                         \
+        const double generic_ns = measure(count, repetitions, [&]() {                    \
+            for (size_t i = 0; i < count; ++i)                                           \
+                generic_results[i] = generic_expression;                                 \
+        });                                                                              \
+        const double specialized_ns = measure(count, repetitions, [&]() {                \
+            for (size_t i = 0; i < count; ++i)                                           \
+                results[i] = expression;                                                 \
+        });                                                                              \
+        report(name, generic_ns, specialized_ns, max_difference(results, generic_results)); \
+    }
+
+int main(int argc, char* argv[])
+{
+    size_t count = 4096;
+    size_t repetitions = 1000;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--count" && i < argc - 1)
+            count = std::max(size_t(2), size_t(strtoul(argv[++i], nullptr, 10)));
+        else if (arg == "--repetitions" && i < argc - 1)
+            repetitions = std::max(size_t(1), size_t(strtoul(argv[++i], nullptr, 10)));
+        else
+        {
+            printf("Usage: math_benchmark [--count <n>] [--repetitions <n>]\n");
+            return arg == "-h" || arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    const char* simd = "none";
+#if defined(MI_MATH_SIMD_AVX)
+    simd = "AVX";
+#elif defined(MI_MATH_SIMD_SSE)
+    simd = "SSE";
+#elif defined(MI_MATH_SIMD_NEON)
+    simd = "NEON";
+#endif
+    printf("SIMD instructions: %s, %zu elements, %zu repetitions\n\n", simd, count, repetitions);
+    printf("%-28s %10s %12s %9s %12s\n",
+        "operation", "generic ns", "specialized", "speedup", "max rel diff");
+
+    Data data;
+    create_data(data, count);
+    const std::vector<Matrix4x4>& m = data.matrices;
+    const std::vector<Matrix3x4>& m3 = data.matrices3x4;
+    const std::vector<Vector3>& v3 = data.vectors3;
+    const std::vector<Vector4>& v4 = data.vectors4;
+    const std::vector<Generic_matrix4x4>& gm = data.generic_matrices;
+    const std::vector<Generic_matrix3x4>& gm3 = data.generic_matrices3x4;
+    const std::vector<Generic_vector3>& gv3 = data.generic_vectors3;
+    const std::vector<Generic_vector4>& gv4 = data.generic_vectors4;
+
+    BENCHMARK("Matrix4x4 * Matrix4x4", Matrix4x4, Generic_matrix4x4,
+        m[i] * m[(i + 1) % count],
+        gm[i] * gm[(i + 1) % count]);
+    BENCHMARK("Matrix3x4 * Matrix4x4", Matrix3x4, Generic_matrix3x4,
+        m3[i] * m[(i + 1) % count],
+        gm3[i] * gm[(i + 1) % count]);
+    BENCHMARK("Matrix4x4 * Vector4", Vector4, Generic_vector4,
+        m[i] * v4[i],
+        gm[i] * gv4[i]);
+    BENCHMARK("Vector4 * Matrix4x4", Vector4, Generic_vector4,
+        v4[i] * m[i],
+        gv4[i] * gm[i]);
+    BENCHMARK("transform_point(Vector3)", Vector3, Generic_vector3,
+        mi::math::transform_point(m[i], v3[i]),
+        mi::math::transform_point(gm[i], gv3[i]));
+    BENCHMARK("transform_vector(Vector3)", Vector3, Generic_vector3,
+        mi::math::transform_vector(m[i], v3[i]),
+        mi::math::transform_vector(gm[i], gv3[i]));
+
+    // Batch transformations of all points at once against one call per point.
+    printf("\n%-28s %10s %12s %9s %12s\n",
+        "batch operation", "element ns", "batch ns", "speedup", "max rel diff");
+
+    std::vector<mi::Float32> x(count), y(count), z(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        x[i] = v3[i].x;
+        y[i] = v3[i].y;
+        z[i] = v3[i].z;
+    }
+    std::vector<mi::Float32> out_x(count), out_y(count), out_z(count);
+    std::vector<Vector3> out(count), expected(count);
+
+    const mi::math::Batch_transform::Kind kinds[] = {
+        mi::math::Batch_transform::POINT,
+        mi::math::Batch_transform::VECTOR,
+        mi::math::Batch_transform::NORMAL };
+    const char* names[] = { "transform_points", "transform_vectors", "transform_normals" };
+    for (size_t k = 0; k < 3; ++k)
+    {
+        const mi::math::Batch_transform transform(m[3], kinds[k]);
+        const double element_ns = measure(count, repetitions, [&]() {
+            for (size_t i = 0; i < count; ++i)
+                expected[i] =
+                    k == 0 ? mi::math::transform_point(m[3], v3[i]) :
+                    k == 1 ? mi::math::transform_vector(m[3], v3[i]) :
+                             mi::math::transform_normal(m[3], v3[i]);
+        });
+
+        const double soa_ns = measure(count, repetitions, [&]() {
+            transform.apply(
+                x.data(), y.data(), z.data(), out_x.data(), out_y.data(), out_z.data(), count);
+        });
+        for (size_t i = 0; i < count; ++i)
+            out[i] = Vector3(out_x[i], out_y[i], out_z[i]);
+        report((std::string(names[k]) + " (SoA)").c_str(),
+            element_ns, soa_ns, max_difference(out, expected));
+    }
+
+    mi::math::Bbox<mi::Float32, 3> bbox, expected_bbox;
+    const double element_ns = measure(count, repetitions, [&]() {
+        expected_bbox.clear();
+        for (size_t i = 0; i < count; ++i)
+            expected_bbox.insert(v3[i]);
+    });
+    const double bbox_ns = measure(count, repetitions, [&]() {
+        bbox.clear();
+        bbox.insert(v3.data(), count);
+    });
+    report("Bbox::insert(span)", element_ns, bbox_ns, bbox == expected_bbox ? 0.0f : 1.0f);
+
+    // Color kernels of mi/math/color_batch.h against the standard library on each value.
+    std::vector<mi::Float32> values(4 * count), results(4 * count), expected_values(4 * count);
+    for (size_t i = 0; i < 4 * count; ++i)
+        values[i] = mi::Float32(rand()) / RAND_MAX * 4.0f;
+    const size_t n = values.size();
+
+    const double pow_ns = measure(n, repetitions, [&]() {
+        for (size_t i = 0; i < n; ++i)
+            expected_values[i] = std::pow(values[i], 1.0f / 2.2f);
+    });
+    const double gamma_ns = measure(n, repetitions, [&]() {
+        results = values;
+        mi::math::gamma_encode(results.data(), n, 2.2f);
+    });
+    report("gamma_encode", pow_ns, gamma_ns, max_difference(results, expected_values));
+
+    const double reinhard_element_ns = measure(n, repetitions, [&]() {
+        for (size_t i = 0; i < n; ++i)
+            expected_values[i] = values[i] / (1.0f + values[i]);
+    });
+    const double reinhard_ns = measure(n, repetitions, [&]() {
+        results = values;
+        mi::math::tone_map_reinhard(results.data(), n);
+    });
+    report("tone_map_reinhard", reinhard_element_ns, reinhard_ns,
+        max_difference(results, expected_values));
+
+    return EXIT_SUCCESS;
+}
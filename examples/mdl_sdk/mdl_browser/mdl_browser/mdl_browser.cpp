@@ -42,6 +42,7 @@ int run_demo_qt_application(Mdl_qt_plugin_interface* plugin,
     plugin_context.neuray = mi::base::make_handle_dup(neuray);
     plugin_context.transaction = mi::base::make_handle_dup(transaction);
     plugin_context.rebuild_module_cache = options.cache_rebuild;
+    plugin_context.verify_module_cache = options.cache_verify;
     plugin->set_context(&engine, &plugin_context);
 
     // setup callbacks to get the result (not required) 
@@ -79,6 +80,7 @@ int run_non_qt_application(Mdl_qt_plugin_interface* plugin,
         plugin_context.neuray = mi::base::make_handle_dup(neuray);
         plugin_context.transaction = mi::base::make_handle_dup(transaction);
         plugin_context.rebuild_module_cache = options.cache_rebuild;
+        plugin_context.verify_module_cache = options.cache_verify;
 
         Mdl_qt_plguin_browser_handle selection_handle;
         plugin->show_select_material_dialog(&plugin_context, selection_handle);
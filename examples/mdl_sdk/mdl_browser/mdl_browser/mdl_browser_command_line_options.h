@@ -17,6 +17,7 @@ struct Mdl_browser_command_line_options
     // search paths
     std::vector<std::string> search_paths;
     bool cache_rebuild;
+    bool cache_verify;
     bool keep_open;
     bool no_qt_mode;
     std::string locale;
@@ -25,6 +26,7 @@ struct Mdl_browser_command_line_options
     Mdl_browser_command_line_options(int argc, const char* const* argv)
         : search_paths()
         , cache_rebuild(false)
+        , cache_verify(false)
         , keep_open(false)
         , no_qt_mode(false)
         , locale("")
@@ -42,6 +44,9 @@ struct Mdl_browser_command_line_options
                 else if (strcmp(opt, "-c") == 0 || strcmp(opt, "--cache_rebuild") == 0)
                     cache_rebuild = true;
 
+                else if (strcmp(opt, "--verify") == 0)
+                    cache_verify = true;
+
                 else if (strcmp(opt, "-k") == 0 || strcmp(opt, "--keep_open") == 0)
                     keep_open = true;
 
@@ -83,6 +88,8 @@ struct Mdl_browser_command_line_options
             << "Options:\n"
             << "  -h|--help                     prints these usage instructions\n"
             << "  -c|--cache_rebuild            force a rebuild of the cache file\n"
+            << "  --verify                      report which modules would be reloaded, without\n"
+            << "                                updating the cache file\n"
             << "  -k|--keep_open                reopens the browser until the console is closed.\n"
             << "  -p|--mdl_path <path>          mdl search path, can occur multiple times.\n"
             << "  -l|--locale <val>             localization code (see ISO 639-1 standard).\n"
@@ -171,6 +171,10 @@ public:
 
     // true if the module is located in an MDL archive
     virtual bool get_located_in_archive() const = 0;
+
+    // hash of the module source at the time of the last successful update, zero if unknown.
+    // unlike the timestamp, it does not change when a file is touched or an archive repacked.
+    virtual mi::Uint64 get_content_hash() const = 0;
 };
 
 
@@ -258,4 +262,12 @@ public:
     virtual ~IMdl_cache_serializer_xml() = default;
 };
 
+// class to store and load a cache to and from a compact binary file,
+// which is memory mapped while loading
+class IMdl_cache_serializer_binary : public IMdl_cache_serializer
+{
+public:
+    virtual ~IMdl_cache_serializer_binary() = default;
+};
+
 #endif
@@ -12,6 +12,8 @@
 #include "mdl_cache_function.h"
 #include "../index/index_cache_elements.h"
 #include "../utilities/platform_helper.h"
+#include "example_thread_pool.h"
+#include <algorithm>
 
 using namespace tinyxml2;
 
@@ -92,7 +94,8 @@ bool Mdl_cache::erase(IMdl_cache_item* item)
 }
 
 
-bool Mdl_cache::update(mi::neuraylib::INeuray* neuray, mi::neuraylib::ITransaction* transaction)
+bool Mdl_cache::update(mi::neuraylib::INeuray* neuray, mi::neuraylib::ITransaction* transaction,
+                       const std::string& index_path, bool verify)
 {
     // run discovery api
     Platform_helper::tic_toc_log("Discover Packages and Modules: ", [&]()
@@ -106,18 +109,92 @@ bool Mdl_cache::update(mi::neuraylib::INeuray* neuray, mi::neuraylib::ITransacti
     });
 
     bool updated = false;
+    std::vector<Mdl_cache_package::Module_update> stale_modules;
 
-    // update the cache nodes
+    // update the cache nodes, changed modules are collected and loaded afterwards
     Platform_helper::tic_toc_log("Update Cache: ", [&]()
     {
         mi::base::Handle<const mi::neuraylib::IMdl_package_info> root(
             m_discovery_result->get_graph());
 
         updated = dynamic_cast<Mdl_cache_package*>(m_cache_root)->update(
-            neuray, transaction, root.get());
+            neuray, transaction, root.get(), &stale_modules);
     });
 
-    // build up inverse index for searching
+    // report the modules that would be reloaded without changing the cache
+    if (verify)
+    {
+        Platform_helper::tic_toc_log("Verify Modules: ", [&]()
+        {
+            verify_modules(neuray, stale_modules);
+        });
+        stale_modules.clear();
+    }
+
+    // load the changed modules into the given transaction, so that the caller can access them
+    // afterwards. the MDL SDK supports only one transaction at a time, so loading, which
+    // modifies the transaction, happens one module after another. hashing the sources and
+    // extracting the information only read, so these steps are done concurrently.
+    Platform_helper::tic_toc_log("Load Modules: ", [&]()
+    {
+        if (stale_modules.empty())
+            return;
+
+        const size_t num_threads = std::min<size_t>(
+            std::max(std::thread::hardware_concurrency(), 1u), stale_modules.size());
+        Thread_pool pool(num_threads);
+
+        std::vector<char> needs_loading(stale_modules.size(), 0);
+        for (size_t i = 0, n = stale_modules.size(); i < n; ++i)
+        {
+            pool.submit([&, i](size_t /*worker*/)
+            {
+                Mdl_cache_package::Module_update& stale = stale_modules[i];
+                needs_loading[i] = Mdl_cache_module::check_content(
+                    neuray, stale.module_info.get(), stale.data);
+            });
+        }
+        pool.wait();
+
+        for (size_t i = 0, n = stale_modules.size(); i < n; ++i)
+        {
+            Mdl_cache_package::Module_update& stale = stale_modules[i];
+            if (needs_loading[i] &&
+                !Mdl_cache_module::load_module(neuray, transaction, stale.module_info.get()))
+                needs_loading[i] = 0;
+        }
+
+        for (size_t i = 0, n = stale_modules.size(); i < n; ++i)
+        {
+            if (!needs_loading[i])
+                continue;
+
+            pool.submit([&, i](size_t /*worker*/)
+            {
+                Mdl_cache_package::Module_update& stale = stale_modules[i];
+                Mdl_cache_module::extract(transaction, stale.module_info.get(), stale.data);
+            });
+        }
+        pool.wait();
+    });
+
+    // merge the extracted information into the cache, from this thread only
+    Platform_helper::tic_toc_log("Merge Modules: ", [&]()
+    {
+        for (auto& stale : stale_modules)
+            stale.module->apply(stale.data);
+    });
+
+    // the stored index refers to cache elements, so it can only be loaded after the update
+    if (!index_path.empty() && m_index->get_document_count() == 0)
+    {
+        Platform_helper::tic_toc_log("Load Index: ", [&]()
+        {
+            m_index->load_from_disk(this, index_path);
+        });
+    }
+
+    // build up inverse index for searching, or update the loaded one
     Platform_helper::tic_toc_log("Update Index: ", [&]()
     {
         updated &= m_index->build(this);
@@ -126,6 +203,47 @@ bool Mdl_cache::update(mi::neuraylib::INeuray* neuray, mi::neuraylib::ITransacti
     return updated;
 }
 
+void Mdl_cache::verify_modules(
+    mi::neuraylib::INeuray* neuray,
+    std::vector<Mdl_cache_package::Module_update>& stale_modules) const
+{
+    // hashing is much cheaper than loading, but still worth to be done in parallel
+    {
+        Thread_pool pool;
+        for (auto& stale : stale_modules)
+        {
+            pool.submit([&](size_t /*worker*/)
+            {
+                stale.data.content_hash = Mdl_cache_module::compute_content_hash(
+                    neuray, stale.module_info.get());
+            });
+        }
+        pool.wait();
+    }
+
+    size_t reload_count = 0;
+    for (const auto& stale : stale_modules)
+    {
+        const char* reason = nullptr;
+        if (stale.data.cached_content_hash == 0)
+            reason = "not cached";
+        else if (stale.data.content_hash == 0)
+            reason = "source not readable";
+        else if (stale.data.content_hash != stale.data.cached_content_hash)
+            reason = "content changed";
+
+        if (reason)
+            reload_count++;
+
+        std::cerr << "[Mdl_cache] verify: " << stale.module->get_qualified_name() << ": "
+                  << (reason ? "reload, " : "keep, file time changed only")
+                  << (reason ? reason : "") << "\n";
+    }
+
+    std::cerr << "[Mdl_cache] verify: " << stale_modules.size() << " modules with changed files, "
+              << reload_count << " would be reloaded.\n";
+}
+
 const IMdl_cache_package* Mdl_cache::get_cache_root() const
 {
     return m_cache_root;
@@ -151,6 +269,11 @@ bool Mdl_cache::save_to_disk(const IMdl_cache_serializer& serializer,
     return serializer.serialize(this, path.c_str());
 }
 
+bool Mdl_cache::save_index_to_disk(const std::string& path) const
+{
+    return m_index->save_to_disk(path);
+}
+
 bool Mdl_cache::load_from_disk(const IMdl_cache_serializer& serializer, 
                                const std::string& path)
 {
@@ -10,8 +10,10 @@
 #define MDL_SDK_EXAMPLES_MDL_BROWSER_MDL_CACHE_H
 
 #include "imdl_cache.h"
+#include "mdl_cache_package.h"
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <mi/base/handle.h>
 #include <mi/neuraylib/imdl_discovery_api.h>
@@ -36,7 +38,6 @@ namespace tinyxml2
     class XMLElement;
 }
 
-class Mdl_cache_package;
 class Index_cache_elements;
 
 class Mdl_cache : public IMdl_cache
@@ -67,11 +68,23 @@ public:
     bool load_from_disk(const IMdl_cache_serializer& serializer, const std::string& path);
 
     // Updates the cache structure with the info from all search paths.
+    // If an index path is specified, the search index stored there is loaded and only the
+    // elements of changed modules are indexed again.
+    // In verify mode, modules are not reloaded, instead it is reported which modules would
+    // be reloaded and why.
     // Note, this fails when no valid search path was found.
-    bool update(mi::neuraylib::INeuray* neuray, mi::neuraylib::ITransaction* transaction);
+    bool update(mi::neuraylib::INeuray* neuray, mi::neuraylib::ITransaction* transaction,
+                const std::string& index_path = "", bool verify = false);
     const Index_cache_elements* get_search_index() const { return m_index; }
 
+    // stores the search index, if it changed since it was loaded.
+    bool save_index_to_disk(const std::string& path) const;
+
 private:
+    // reports which of the modules with changed files would be reloaded
+    void verify_modules(mi::neuraylib::INeuray* neuray,
+                        std::vector<Mdl_cache_package::Module_update>& stale_modules) const;
+
     mi::base::Handle<const mi::neuraylib::IMdl_discovery_result> m_discovery_result;
     IMdl_cache_package* m_cache_root;
     Index_cache_elements* m_index;
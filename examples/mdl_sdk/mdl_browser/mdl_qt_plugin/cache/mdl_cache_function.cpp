@@ -10,15 +10,31 @@ bool Mdl_cache_function::update(mi::neuraylib::INeuray* neuray,
                                 mi::neuraylib::ITransaction* transaction, 
                                 const mi::base::IInterface* module)
 {
+    Mdl_cache_element_data data;
+    data.kind = get_kind();
+    data.qualified_name = get_qualified_name();
+    if (!extract(transaction, data))
+        return false;
+
+    apply(data);
+    return true;
+}
+
+bool Mdl_cache_function::extract(mi::neuraylib::ITransaction* transaction,
+                                 Mdl_cache_element_data& data)
+{
+    data.hidden = false;
+    data.success = false;
+
     // Access the material definition
     const mi::base::Handle<const mi::neuraylib::IFunction_definition> function_definition(
         transaction->access<mi::neuraylib::IFunction_definition>(
-            (std::string("mdl") + get_qualified_name()).c_str()));
+            (std::string("mdl") + data.qualified_name).c_str()));
 
     if (!function_definition)
     {
         std::cerr << "[Mdl_cache_function] update: Failed to get function definition: "
-                  << get_qualified_name() << "\n";
+                  << data.qualified_name << "\n";
         return false;
     }
 
@@ -33,20 +49,21 @@ bool Mdl_cache_function::update(mi::neuraylib::INeuray* neuray,
         const char* value = nullptr;
 
         if (annotations.get_annotation_index("::anno::hidden()") != static_cast<mi::Size>(-1))
-            set_is_hidden(true);
+            data.hidden = true;
 
         if (0 == annotations.get_annotation_param_value_by_name<const char*>(
             "::anno::author(string)", 0, value))
-            set_cache_data("Author", value);
+            data.cache_data.push_back({"Author", value});
 
         if (0 == annotations.get_annotation_param_value_by_name<const char*>(
             "::anno::display_name(string)", 0, value))
-            set_cache_data("DisplayName", value);
+            data.cache_data.push_back({"DisplayName", value});
 
         if (0 == annotations.get_annotation_param_value_by_name<const char*>(
             "::anno::description(string)", 0, value))
-            set_cache_data("Description", value);
+            data.cache_data.push_back({"Description", value});
     }
 
+    data.success = true;
     return true;
 }
\ No newline at end of file
@@ -141,6 +141,18 @@ private:
 };
 
 
+// information about an element that is extracted from a loaded module.
+// extracting does not access the cache, which allows to extract modules on worker threads
+// while only one thread writes the results into the cache.
+struct Mdl_cache_element_data
+{
+    IMdl_cache_item::Kind kind;
+    std::string qualified_name;
+    std::vector<std::pair<std::string, std::string>> cache_data; // key-value pairs
+    bool hidden;
+    bool success;
+};
+
 // generic item class to realize (multiple) interface inheritance 
 template<class T_element>
 class Mdl_cache_element :
@@ -154,6 +166,9 @@ public:
 
     const char* get_module() const override;
 
+    // stores extracted information in this element
+    void apply(const Mdl_cache_element_data& data);
+
 protected:
     typedef Mdl_cache_item<T_element> Base;
 
@@ -325,6 +340,16 @@ bool Mdl_cache_node<T_node>::remove_child(IMdl_cache_item* child)
 // Implementation: ELEMENT
 // ------------------------------------------------------------------------------------------------
 
+template<class T_element>
+void Mdl_cache_element<T_element>::apply(const Mdl_cache_element_data& data)
+{
+    if (data.hidden)
+        Base::set_is_hidden(true);
+
+    for (const auto& kv : data.cache_data)
+        Base::set_cache_data(kv.first.c_str(), kv.second.c_str());
+}
+
 template<class T_element>
 const char* Mdl_cache_element<T_element>::get_module() const
 {
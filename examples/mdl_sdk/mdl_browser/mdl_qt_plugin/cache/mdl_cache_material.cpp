@@ -10,15 +10,31 @@ bool Mdl_cache_material::update(mi::neuraylib::INeuray* neuray,
                                 mi::neuraylib::ITransaction* transaction,
                                 const mi::base::IInterface* module)
 {
+    Mdl_cache_element_data data;
+    data.kind = get_kind();
+    data.qualified_name = get_qualified_name();
+    if (!extract(transaction, data))
+        return false;
+
+    apply(data);
+    return true;
+}
+
+bool Mdl_cache_material::extract(mi::neuraylib::ITransaction* transaction,
+                                 Mdl_cache_element_data& data)
+{
+    data.hidden = false;
+    data.success = false;
+
     // Access the material definition
     const mi::base::Handle<const mi::neuraylib::IMaterial_definition> material_definition(
         transaction->access<mi::neuraylib::IMaterial_definition>(
-            (std::string("mdl") + get_qualified_name()).c_str()));
+            (std::string("mdl") + data.qualified_name).c_str()));
 
     if (!material_definition)
     {
         std::cerr << "[Mdl_cache_material] update: Failed to get material defintion: "
-                  << get_qualified_name() << "\n";
+                  << data.qualified_name << "\n";
         return false;
     }
 
@@ -33,19 +49,19 @@ bool Mdl_cache_material::update(mi::neuraylib::INeuray* neuray,
         const char* value = nullptr;
 
         if (annotations.get_annotation_index("::anno::hidden()") != static_cast<mi::Size>(-1))
-            set_is_hidden(true);
+            data.hidden = true;
 
         if (0 == annotations.get_annotation_param_value_by_name<const char*>(
             "::anno::author(string)", 0, value))
-            set_cache_data("Author", value);
+            data.cache_data.push_back({"Author", value});
 
         if (0 == annotations.get_annotation_param_value_by_name<const char*>(
             "::anno::display_name(string)", 0, value))
-            set_cache_data("DisplayName", value);
+            data.cache_data.push_back({"DisplayName", value});
 
         if (0 == annotations.get_annotation_param_value_by_name<const char*>(
             "::anno::description(string)", 0, value))
-            set_cache_data("Description", value);
+            data.cache_data.push_back({"Description", value});
 
         const mi::Size ai = annotations.get_annotation_index("::anno::key_words(string[N])");
         if (ai != static_cast<mi::Size>(-1))
@@ -74,7 +90,7 @@ bool Mdl_cache_material::update(mi::neuraylib::INeuray* neuray,
             if (keyword_count > 0)
             {
                 std::string keywords = s.str();
-                set_cache_data("Keywords", keywords.c_str());
+                data.cache_data.push_back({"Keywords", keywords});
             }
         }
     }
@@ -83,7 +99,8 @@ bool Mdl_cache_material::update(mi::neuraylib::INeuray* neuray,
     // however, loading the material is no option during runtime
     const char* path = material_definition->get_thumbnail();
     if (path)
-        set_cache_data("Thumbnail", path);
+        data.cache_data.push_back({"Thumbnail", path});
     
+    data.success = true;
     return true;
 }
\ No newline at end of file
@@ -38,6 +38,10 @@ public:
                 mi::neuraylib::ITransaction* transaction, 
                 const mi::base::IInterface* module) override;
 
+    // extracts the information about the material data.qualified_name from a loaded module.
+    // does not access the cache and can be called concurrently with the same transaction.
+    static bool extract(mi::neuraylib::ITransaction* transaction, Mdl_cache_element_data& data);
+
 protected:
     typedef Mdl_cache_element<IMdl_cache_material> Base;
 };
@@ -5,6 +5,8 @@
 
 #include "mdl_cache_module.h"
 #include <mi/mdl_sdk.h>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include "mdl_cache_material.h"
 #include "mdl_cache_function.h"
@@ -21,26 +23,42 @@ bool Mdl_cache_module::update(mi::neuraylib::INeuray* neuray,
     if (!module_info)
         return false;
 
+    Module_data data;
+    if (is_up_to_date(module_info.get(), data))
+        return true;
+
+    load(neuray, transaction, module_info.get(), data);
+    return apply(data);
+}
+
+bool Mdl_cache_module::is_up_to_date(const mi::neuraylib::IMdl_module_info* module_info,
+                                     Module_data& data) const
+{
     // get the resolved path of the file this module is defined in
     // in case of modules in archives, we need the file path of the archive
     const mi::base::Handle<const mi::IString> resolved_path(module_info->get_resolved_path());
-    std::string current_path = resolved_path->get_c_str();
-    if(module_info->in_archive())
+    data.file_path = resolved_path->get_c_str();
+    data.in_archive = module_info->in_archive();
+    if (data.in_archive)
     {
-        const size_t pos = current_path.find(".mdr:");
-        current_path = current_path.substr(0, pos + 4);
+        const size_t pos = data.file_path.find(".mdr:");
+        data.file_path = data.file_path.substr(0, pos + 4);
     }
 
     // if the search path is one we stored in the cache, we check the date
-    const mi::Uint64 timestamp = static_cast<time_t>(
-        Platform_helper::get_file_change_time(current_path));
+    data.timestamp = static_cast<time_t>(
+        Platform_helper::get_file_change_time(data.file_path));
+
+    data.cached_content_hash = get_content_hash();
+    data.content_hash = 0;
+    data.content_unchanged = false;
 
     // maybe, this module is from another search path
     const char* cached_path = get_file_path();
-    if(cached_path && strcmp(current_path.c_str(), cached_path) == 0)
+    if(cached_path && strcmp(data.file_path.c_str(), cached_path) == 0)
     {
         // return true here if the file has not changed
-        if (timestamp > 0 && timestamp <= get_timestamp())
+        if (data.timestamp > 0 && data.timestamp <= get_timestamp())
         {
             /*
             std::cerr << "[Mdl_cache_module] update: skipped unchanged module: "
@@ -49,7 +67,48 @@ bool Mdl_cache_module::update(mi::neuraylib::INeuray* neuray,
             return true;
         }
     }
+    return false;
+}
+
+bool Mdl_cache_module::load(mi::neuraylib::INeuray* neuray,
+                            mi::neuraylib::ITransaction* transaction,
+                            const mi::neuraylib::IMdl_module_info* module_info,
+                            Module_data& data)
+{
+    if (!check_content(neuray, module_info, data))
+        return true;
+
+    if (!load_module(neuray, transaction, module_info))
+        return false;
+
+    return extract(transaction, module_info, data);
+}
+
+bool Mdl_cache_module::check_content(mi::neuraylib::INeuray* neuray,
+                                     const mi::neuraylib::IMdl_module_info* module_info,
+                                     Module_data& data)
+{
+    data.loaded = false;
+    data.hidden = false;
+    data.elements.clear();
+
+    // the file time changed, but maybe not the content, e.g., on network file systems or
+    // when an archive was repacked
+    data.content_hash = compute_content_hash(neuray, module_info);
+    data.content_unchanged =
+        data.content_hash != 0 && data.content_hash == data.cached_content_hash;
+    if (data.content_unchanged)
+    {
+        data.loaded = true;
+        return false;
+    }
+    return true;
+}
 
+bool Mdl_cache_module::load_module(mi::neuraylib::INeuray* neuray,
+                                   mi::neuraylib::ITransaction* transaction,
+                                   const mi::neuraylib::IMdl_module_info* module_info)
+{
     // load the selected module
     mi::base::Handle<mi::neuraylib::IMdl_compiler> compiler(
         neuray->get_api_component<mi::neuraylib::IMdl_compiler>());
@@ -57,10 +116,16 @@ bool Mdl_cache_module::update(mi::neuraylib::INeuray* neuray,
     if (!compiler || 0 > compiler->load_module(transaction, module_info->get_qualified_name()))
     {
         std::cerr << "[Mdl_cache_module] update: Failed to load module: " 
-                  << get_simple_name() << "\n";
+                  << module_info->get_simple_name() << "\n";
         return false;
     }
+    return true;
+}
 
+bool Mdl_cache_module::extract(mi::neuraylib::ITransaction* transaction,
+                               const mi::neuraylib::IMdl_module_info* module_info,
+                               Module_data& data)
+{
     mi::base::Handle<const mi::neuraylib::IModule> mdl_module(
         transaction->access<mi::neuraylib::IModule>(
         (std::string("mdl") + module_info->get_qualified_name()).c_str()));
@@ -68,9 +133,10 @@ bool Mdl_cache_module::update(mi::neuraylib::INeuray* neuray,
     if (!mdl_module)
     {
         std::cerr << "[Mdl_cache_module] update: Failed to load module: " 
-                  << get_simple_name() << "\n";
+                  << module_info->get_simple_name() << "\n";
         return false;
     }
+    data.loaded = true;
 
     // get infos from annotations
     const mi::base::Handle<const mi::neuraylib::IAnnotation_block> anno_block(
@@ -82,56 +148,63 @@ bool Mdl_cache_module::update(mi::neuraylib::INeuray* neuray,
         const mi::neuraylib::Annotation_wrapper annotations(anno_block.get());
 
         if (annotations.get_annotation_index("::anno::hidden()") != static_cast<mi::Size>(-1))
-            set_is_hidden(true);
+            data.hidden = true;
     }
 
-    // keep track of the existence of children to allow clean-up
-    std::set<Child_map_key> not_present_children;
-    for (const auto& c : get_children())
-        not_present_children.insert(c.first);
-
     bool success = true;
 
     // Iterate over all materials exported by the module.
     for (mi::Size i = 0, n = mdl_module->get_material_count(); i < n; ++i)
     {
-        std::string qualified_name = mdl_module->get_material(i) + 3; // ignore the leading "mdl"
-        const std::string simple_name = Mdl_helper::qualified_to_simple_name(qualified_name);
-        const Child_map_key key{IMdl_cache_item::CK_MATERIAL, simple_name};
+        Mdl_cache_element_data element;
+        element.kind = IMdl_cache_item::CK_MATERIAL;
+        element.qualified_name = mdl_module->get_material(i) + 3; // ignore the leading "mdl"
+        success &= Mdl_cache_material::extract(transaction, element);
+        data.elements.push_back(std::move(element));
+    }
 
-        // "mark" as present by removing from not_present_children
-        const auto& pos = not_present_children.find(key);
-        if (pos != not_present_children.end())
-            not_present_children.erase(pos);
+    // Iterate over all functions exported by the module.
+    for (mi::Size i = 0, n = mdl_module->get_function_count(); i < n; ++i)
+    {
+        Mdl_cache_element_data element;
+        element.kind = IMdl_cache_item::CK_FUNCTION;
+        element.qualified_name = mdl_module->get_function(i) + 3; // ignore the leading "mdl"
+        success &= Mdl_cache_function::extract(transaction, element);
+        data.elements.push_back(std::move(element));
+    }
 
-        // insert new child if not already available
-        IMdl_cache_item* child = get_child(key);
-        if (!child)
-        {
-            child = get_cache()->create(CK_MATERIAL, qualified_name.c_str());
-            add_child(child);
-        }
+    return success;
+}
 
-        // update recursively
-        if (!dynamic_cast<Mdl_cache_material*>(child)->update(
-            neuray, transaction, mdl_module.get()))
-        {
-            std::cerr << "[Mdl_cache_module] update: Failed to update material: " 
-                      << get_qualified_name() << "\n";
-            success = false;
-        }
+bool Mdl_cache_module::apply(const Module_data& data)
+{
+    if (!data.loaded)
+        return false;
 
-        // pass down the hidden property
-        if (get_is_hidden())
-            dynamic_cast<Mdl_cache_material*>(child)->set_is_hidden(true);
+    // only the file changed, the cached data is still valid
+    if (data.content_unchanged)
+    {
+        set_timestamp(data.timestamp);
+        set_file_path(data.file_path.c_str());
+        set_located_in_archive(data.in_archive);
+        return true;
     }
 
-    // Iterate over all materials exported by the module.
-    for (mi::Size i = 0, n = mdl_module->get_function_count(); i < n; ++i)
+    if (data.hidden)
+        set_is_hidden(true);
+
+    // keep track of the existence of children to allow clean-up
+    std::set<Child_map_key> not_present_children;
+    for (const auto& c : get_children())
+        not_present_children.insert(c.first);
+
+    bool success = true;
+
+    for (const auto& element : data.elements)
     {
-        std::string qualified_name = mdl_module->get_function(i) + 3; // ignore the leading "mdl"
-        const std::string simple_name = Mdl_helper::qualified_to_simple_name(qualified_name);
-        const Child_map_key key{IMdl_cache_item::CK_FUNCTION, simple_name};
+        const std::string simple_name = Mdl_helper::qualified_to_simple_name(
+            element.qualified_name);
+        const Child_map_key key{element.kind, simple_name};
 
         // "mark" as present by removing from not_present_children
         const auto& pos = not_present_children.find(key);
@@ -142,22 +215,34 @@ bool Mdl_cache_module::update(mi::neuraylib::INeuray* neuray,
         IMdl_cache_item* child = get_child(key);
         if (!child)
         {
-            child = get_cache()->create(CK_FUNCTION, qualified_name.c_str());
+            child = get_cache()->create(element.kind, element.qualified_name.c_str());
             add_child(child);
         }
 
-        // update recursively
-        if (!dynamic_cast<Mdl_cache_function*>(child)->update(
-            neuray, transaction, mdl_module.get()))
+        if (!element.success)
         {
-            std::cerr << "[Mdl_cache_module] update: Failed to update function: " 
+            std::cerr << "[Mdl_cache_module] update: Failed to update "
+                      << (element.kind == CK_MATERIAL ? "material" : "function") << ": "
                       << get_qualified_name() << "\n";
             success = false;
+            continue;
         }
 
-        // pass down the hidden property
-        if (get_is_hidden())
-            dynamic_cast<Mdl_cache_function*>(child)->set_is_hidden(true);
+        // update the child and pass down the hidden property
+        if (element.kind == CK_MATERIAL)
+        {
+            Mdl_cache_material* material = dynamic_cast<Mdl_cache_material*>(child);
+            material->apply(element);
+            if (get_is_hidden())
+                material->set_is_hidden(true);
+        }
+        else
+        {
+            Mdl_cache_function* function = dynamic_cast<Mdl_cache_function*>(child);
+            function->apply(element);
+            if (get_is_hidden())
+                function->set_is_hidden(true);
+        }
     }
 
     // remove all cached modules that are not present anymore
@@ -167,14 +252,76 @@ bool Mdl_cache_module::update(mi::neuraylib::INeuray* neuray,
         get_cache()->erase(item);
     }
         
-    // keep the timestamp if everything went fine
-    set_timestamp(success ? timestamp : 0);
-    set_file_path(current_path.c_str()); // store the search path, too
-    set_located_in_archive(module_info->in_archive());
+    // keep the timestamp and the hash if everything went fine
+    set_timestamp(success ? data.timestamp : 0);
+    set_content_hash(success ? data.content_hash : 0);
+    set_file_path(data.file_path.c_str()); // store the search path, too
+    set_located_in_archive(data.in_archive);
 
     return success;
 }
 
+mi::Uint64 Mdl_cache_module::compute_content_hash(
+    mi::neuraylib::INeuray* neuray, const mi::neuraylib::IMdl_module_info* module_info)
+{
+    const mi::base::Handle<const mi::IString> resolved_path(module_info->get_resolved_path());
+
+    // 64 bit FNV-1a
+    mi::Uint64 hash = 14695981039346656037ull;
+    char buffer[64 * 1024];
+    bool read = false;
+
+    if (module_info->in_archive())
+    {
+        // the resolved path is the archive path followed by a colon and the file in the archive
+        mi::base::Handle<mi::neuraylib::IMdl_archive_api> archive_api(
+            neuray->get_api_component<mi::neuraylib::IMdl_archive_api>());
+        mi::base::Handle<mi::neuraylib::IReader> reader(
+            archive_api ? archive_api->get_file(resolved_path->get_c_str()) : nullptr);
+        if (!reader)
+            return 0;
+
+        mi::Sint64 count;
+        while ((count = reader->read(buffer, sizeof(buffer))) > 0)
+        {
+            for (mi::Sint64 i = 0; i < count; ++i)
+                hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ull;
+            read = true;
+        }
+    }
+    else
+    {
+        std::ifstream file(resolved_path->get_c_str(), std::ios::binary);
+        if (!file)
+            return 0;
+
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+        {
+            for (std::streamsize i = 0, count = file.gcount(); i < count; ++i)
+                hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ull;
+            read = true;
+        }
+    }
+
+    // zero means unknown
+    if (!read)
+        return 0;
+    return hash != 0 ? hash : 1;
+}
+
+mi::Uint64 Mdl_cache_module::get_content_hash() const
+{
+    const char* value = Base::get_cache_data("ContentHash");
+    return value ? static_cast<mi::Uint64>(strtoull(value, nullptr, 16)) : 0;
+}
+
+void Mdl_cache_module::set_content_hash(mi::Uint64 value)
+{
+    std::stringstream ss;
+    ss << std::hex << value;
+    Base::set_cache_data("ContentHash", ss.str().c_str());
+}
+
 bool Mdl_cache_module::get_located_in_archive() const
 {
     const char* value = Base::get_cache_data("LocatedInArchive");
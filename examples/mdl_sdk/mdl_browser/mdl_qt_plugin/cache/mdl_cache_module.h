@@ -22,6 +22,7 @@ namespace mi
     namespace neuraylib
     {
         class INeuray;
+        class IMdl_module_info;
         class ITransaction;
     }
 }
@@ -29,17 +30,76 @@ namespace mi
 class Mdl_cache_module : public Mdl_cache_node<IMdl_cache_module>
 {
 public:
+    // information extracted from a loaded module, see load()
+    struct Module_data
+    {
+        std::string file_path;  // resolved path of the module, or of the archive it is in
+        mi::Uint64 timestamp;   // change time of that file
+        bool in_archive;
+        mi::Uint64 cached_content_hash; // hash stored in the cache, zero if unknown
+        mi::Uint64 content_hash;        // hash of the current module source, zero if unknown
+        bool content_unchanged; // the source did not change, only the file time
+        bool loaded;            // false if the module could not be loaded
+        bool hidden;
+        std::vector<Mdl_cache_element_data> elements;
+    };
+
     explicit Mdl_cache_module() = default;
     virtual ~Mdl_cache_module() = default;
 
     IMdl_cache_item::Kind get_kind() const override { return CK_MODULE; }
 
+    // updates the module and its elements, which loads the module if it changed.
+    // equivalent to calling is_up_to_date(), load() and apply().
     bool update(mi::neuraylib::INeuray* neuray, 
                 mi::neuraylib::ITransaction* transaction, 
                 const mi::base::IInterface* node) override;
 
+    // checks if the module file changed since the last update.
+    // sets the file path, timestamp and cached content hash of data.
+    bool is_up_to_date(const mi::neuraylib::IMdl_module_info* module_info,
+                       Module_data& data) const;
+
+    // computes a hash of the module source, which is read from the archive for modules in
+    // MDL archives. returns zero if the source could not be read.
+    static mi::Uint64 compute_content_hash(mi::neuraylib::INeuray* neuray,
+                                           const mi::neuraylib::IMdl_module_info* module_info);
+
+    // loads a module and extracts the information about its elements.
+    // loading is skipped if the content hash of the module did not change.
+    // equivalent to calling check_content(), load_module() and extract().
+    static bool load(mi::neuraylib::INeuray* neuray,
+                     mi::neuraylib::ITransaction* transaction,
+                     const mi::neuraylib::IMdl_module_info* module_info,
+                     Module_data& data);
+
+    // resets the extracted information and compares the content hash of the module with the
+    // cached one. returns false if the content did not change and loading can be skipped.
+    // does not access the cache or the database and can be called concurrently.
+    static bool check_content(mi::neuraylib::INeuray* neuray,
+                              const mi::neuraylib::IMdl_module_info* module_info,
+                              Module_data& data);
+
+    // loads the module into the database. modifies the transaction, so modules have to be
+    // loaded one after another.
+    static bool load_module(mi::neuraylib::INeuray* neuray,
+                            mi::neuraylib::ITransaction* transaction,
+                            const mi::neuraylib::IMdl_module_info* module_info);
+
+    // extracts the information about the elements of a loaded module.
+    // only reads from the database and does not access the cache, so it can be called
+    // concurrently for different modules with the same transaction.
+    static bool extract(mi::neuraylib::ITransaction* transaction,
+                        const mi::neuraylib::IMdl_module_info* module_info,
+                        Module_data& data);
+
+    // updates the module and its elements with information extracted by load().
+    bool apply(const Module_data& data);
+
     bool get_located_in_archive() const override;
 
+    mi::Uint64 get_content_hash() const override;
+
 protected:
     typedef Mdl_cache_node<IMdl_cache_module> Base;
 
@@ -47,6 +107,7 @@ private:
     void set_located_in_archive(bool value);
     const char* get_file_path() const;
     void set_file_path(const char* search_path);
+    void set_content_hash(mi::Uint64 value);
     mutable bool m_located_in_archive;
 };
 
@@ -11,6 +11,14 @@
 bool Mdl_cache_package::update(mi::neuraylib::INeuray* neuray, 
                                mi::neuraylib::ITransaction* transaction, 
                                const mi::base::IInterface* node)
+{
+    return update(neuray, transaction, node, nullptr);
+}
+
+bool Mdl_cache_package::update(mi::neuraylib::INeuray* neuray,
+                               mi::neuraylib::ITransaction* transaction,
+                               const mi::base::IInterface* node,
+                               std::vector<Module_update>* stale_modules)
 {
     const mi::base::Handle<const mi::neuraylib::IMdl_package_info> graph_node(
         node->get_interface<const mi::neuraylib::IMdl_package_info>());
@@ -57,7 +65,7 @@ bool Mdl_cache_package::update(mi::neuraylib::INeuray* neuray,
 
                 // update recursively
                 changed |= dynamic_cast<Mdl_cache_package*>(child)->update(
-                    neuray, transaction, c_discovery.get());
+                    neuray, transaction, c_discovery.get(), stale_modules);
 
                 break;
             }
@@ -79,9 +87,25 @@ bool Mdl_cache_package::update(mi::neuraylib::INeuray* neuray,
                     add_child(child);
                 }
 
-                // update recursively
-                changed |= dynamic_cast<Mdl_cache_module*>(child)->update(
-                    neuray, transaction, c_discovery.get());
+                Mdl_cache_module* module = dynamic_cast<Mdl_cache_module*>(child);
+                if (!stale_modules)
+                {
+                    // update recursively
+                    changed |= module->update(neuray, transaction, c_discovery.get());
+                    break;
+                }
+
+                // defer loading changed modules
+                Module_update stale;
+                stale.module = module;
+                stale.module_info =
+                    c_discovery->get_interface<const mi::neuraylib::IMdl_module_info>();
+                if (!stale.module_info)
+                    break;
+
+                if (!module->is_up_to_date(stale.module_info.get(), stale.data))
+                    stale_modules->push_back(std::move(stale));
+                changed = true;
 
                 break;
             }
@@ -11,6 +11,10 @@
 
 #include "imdl_cache.h"
 #include "mdl_cache_impl.h"
+#include "mdl_cache_module.h"
+#include <mi/base/handle.h>
+#include <mi/neuraylib/imdl_discovery_api.h>
+#include <vector>
 
 namespace mi
 {
@@ -34,10 +38,26 @@ public:
 
     IMdl_cache_item::Kind get_kind() const override { return CK_PACKAGE; }
 
+    // a module that needs to be loaded, collected by update
+    struct Module_update
+    {
+        Mdl_cache_module* module;
+        mi::base::Handle<const mi::neuraylib::IMdl_module_info> module_info;
+        Mdl_cache_module::Module_data data;
+    };
+
     bool update(mi::neuraylib::INeuray* neuray, 
                 mi::neuraylib::ITransaction* transaction, 
                 const mi::base::IInterface* node) override;
 
+    // updates the package structure recursively.
+    // changed modules are not loaded but added to stale_modules, which allows the caller to
+    // load them concurrently and to apply the results afterwards.
+    bool update(mi::neuraylib::INeuray* neuray,
+                mi::neuraylib::ITransaction* transaction,
+                const mi::base::IInterface* node,
+                std::vector<Module_update>* stale_modules);
+
 protected:
     typedef Mdl_cache_node<IMdl_cache_package> Base;
 };
@@ -0,0 +1,272 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+
+#include "mdl_cache_serializer_binary_impl.h"
+#include <mi/mdl_sdk.h>
+#include "imdl_cache.h"
+#include "../utilities/mapped_file.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    const char s_magic[8] = {'M', 'D', 'L', 'B', 'C', 'C', 'H', '\0'};
+    const uint32_t s_version = 1;
+    const uint32_t s_byte_order = 0x01020304;
+    const uint32_t s_no_string = ~0u;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t item_count;        // number of item records, the first one is the root
+        uint32_t data_count;        // number of key-value records
+        uint32_t string_table_size; // size of the string table in bytes
+        uint32_t locale;            // string offset of the locale or s_no_string
+    };
+
+    struct Item_record
+    {
+        uint32_t kind;              // IMdl_cache_item::Kind
+        uint32_t simple_name;       // string offset
+        uint32_t first_child;       // index of the first child item record
+        uint32_t child_count;
+        uint32_t first_data;        // index of the first key-value record
+        uint32_t data_count;
+    };
+
+    struct Data_record
+    {
+        uint32_t key;               // string offset
+        uint32_t value;             // string offset
+    };
+
+    // collects the strings of the file, each string is stored once
+    class String_table
+    {
+    public:
+        uint32_t add(const char* s)
+        {
+            if (!s)
+                return s_no_string;
+
+            const auto found = m_offsets.find(s);
+            if (found != m_offsets.end())
+                return found->second;
+
+            const uint32_t offset = static_cast<uint32_t>(m_data.size());
+            m_data.append(s, strlen(s) + 1);
+            m_offsets[s] = offset;
+            return offset;
+        }
+
+        const std::string& get_data() const { return m_data; }
+
+    private:
+        std::unordered_map<std::string, uint32_t> m_offsets;
+        std::string m_data;
+    };
+
+    // true if the kind of an item can be stored as child of the parent kind
+    bool is_valid_child(uint32_t parent_kind, uint32_t child_kind)
+    {
+        switch (parent_kind)
+        {
+            case IMdl_cache_item::CK_PACKAGE:
+                return child_kind == IMdl_cache_item::CK_PACKAGE
+                    || child_kind == IMdl_cache_item::CK_MODULE;
+            case IMdl_cache_item::CK_MODULE:
+                return child_kind == IMdl_cache_item::CK_MATERIAL
+                    || child_kind == IMdl_cache_item::CK_FUNCTION;
+            default:
+                return false;
+        }
+    }
+}
+
+Mdl_cache_serializer_binary_impl::Mdl_cache_serializer_binary_impl()
+{
+}
+
+bool Mdl_cache_serializer_binary_impl::serialize(const IMdl_cache* cache,
+                                                 const char* file_path) const
+{
+    String_table strings;
+    std::vector<Item_record> items;
+    std::vector<Data_record> data;
+
+    // breadth-first traversal, the records of the children of an item are added when
+    // the item is processed, so they are stored consecutively
+    std::vector<const IMdl_cache_item*> queue;
+    queue.push_back(cache->get_cache_root());
+    items.push_back({IMdl_cache_item::CK_PACKAGE, strings.add("::"), 0, 0, 0, 0});
+
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        const IMdl_cache_item* item = queue[i];
+
+        // key-value pairs
+        items[i].first_data = static_cast<uint32_t>(data.size());
+        for (mi::Size d = 0, n = item->get_cache_element_count(); d < n; ++d)
+        {
+            const char* key = item->get_cache_key(d);
+            const char* value = item->get_cache_data(key);
+            if (value)
+                data.push_back({strings.add(key), strings.add(value)});
+        }
+        items[i].data_count = static_cast<uint32_t>(data.size()) - items[i].first_data;
+
+        // children
+        if (item->get_kind() != IMdl_cache_item::CK_PACKAGE &&
+            item->get_kind() != IMdl_cache_item::CK_MODULE)
+            continue;
+
+        const IMdl_cache_node* node = static_cast<const IMdl_cache_node*>(item);
+        items[i].first_child = static_cast<uint32_t>(items.size());
+        for (mi::Size c = 0, n = node->get_child_count(); c < n; ++c)
+        {
+            const IMdl_cache_item* child = node->get_child(*node->get_child_key(c));
+            queue.push_back(child);
+            items.push_back({static_cast<uint32_t>(child->get_kind()),
+                             strings.add(child->get_simple_name()), 0, 0, 0, 0});
+        }
+        items[i].child_count = static_cast<uint32_t>(items.size()) - items[i].first_child;
+    }
+
+    Header header;
+    memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.version = s_version;
+    header.byte_order = s_byte_order;
+    header.item_count = static_cast<uint32_t>(items.size());
+    header.data_count = static_cast<uint32_t>(data.size());
+    header.locale = strings.add(cache->get_locale());
+    header.string_table_size = static_cast<uint32_t>(strings.get_data().size());
+
+    std::string buffer;
+    buffer.reserve(sizeof(Header) + items.size() * sizeof(Item_record)
+                   + data.size() * sizeof(Data_record) + strings.get_data().size());
+    buffer.append(reinterpret_cast<const char*>(&header), sizeof(Header));
+    buffer.append(reinterpret_cast<const char*>(items.data()), items.size() * sizeof(Item_record));
+    buffer.append(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(Data_record));
+    buffer.append(strings.get_data());
+
+    return Mapped_file::write_atomic(file_path, buffer.data(), buffer.size());
+}
+
+
+IMdl_cache_package* Mdl_cache_serializer_binary_impl::deserialize(
+    IMdl_cache* cache, const char* file_path) const
+{
+    Mapped_file file;
+    if (!file.open(file_path) || file.get_size() < sizeof(Header))
+        return nullptr;
+
+    Header header;
+    memcpy(&header, file.get_data(), sizeof(Header));
+    if (memcmp(header.magic, s_magic, sizeof(s_magic)) != 0 ||
+        header.version != s_version || header.byte_order != s_byte_order)
+    {
+        std::cerr << "[Mdl_cache_serializer_binary_impl] deserialize: "
+                  << "Unsupported file format: " << file_path << "\n";
+        return nullptr;
+    }
+
+    const uint64_t expected_size = sizeof(Header)
+        + static_cast<uint64_t>(header.item_count) * sizeof(Item_record)
+        + static_cast<uint64_t>(header.data_count) * sizeof(Data_record)
+        + header.string_table_size;
+    if (file.get_size() != expected_size || header.item_count == 0)
+    {
+        std::cerr << "[Mdl_cache_serializer_binary_impl] deserialize: "
+                  << "Invalid file size: " << file_path << "\n";
+        return nullptr;
+    }
+
+    // the records are 4 byte aligned in the file and the mapping is page aligned
+    const Item_record* items = reinterpret_cast<const Item_record*>(
+        file.get_data() + sizeof(Header));
+    const Data_record* data = reinterpret_cast<const Data_record*>(
+        items + header.item_count);
+    const char* strings = reinterpret_cast<const char*>(data + header.data_count);
+
+    // validate everything before creating any item, so a corrupted file can not leave
+    // a partial tree behind
+    const uint32_t string_table_size = header.string_table_size;
+    auto valid_string = [&](uint32_t offset) { return offset < string_table_size; };
+    bool valid = string_table_size > 0 && strings[string_table_size - 1] == '\0'
+        && items[0].kind == IMdl_cache_item::CK_PACKAGE
+        && (header.locale == s_no_string || valid_string(header.locale));
+
+    uint32_t next_child = 1; // children partition the records following the root
+    for (uint32_t i = 0; valid && i < header.item_count; ++i)
+    {
+        const Item_record& item = items[i];
+        valid = valid_string(item.simple_name)
+            && item.first_data <= header.data_count
+            && item.data_count <= header.data_count - item.first_data;
+        for (uint32_t d = 0; valid && d < item.data_count; ++d)
+            valid = valid_string(data[item.first_data + d].key)
+                 && valid_string(data[item.first_data + d].value);
+
+        if (!valid || item.child_count == 0)
+            continue;
+
+        valid = item.first_child == next_child && item.first_child > i
+            && item.child_count <= header.item_count - item.first_child;
+        for (uint32_t c = 0; valid && c < item.child_count; ++c)
+            valid = is_valid_child(item.kind, items[item.first_child + c].kind);
+        next_child += item.child_count;
+    }
+    if (!valid || next_child != header.item_count)
+    {
+        std::cerr << "[Mdl_cache_serializer_binary_impl] deserialize: "
+                  << "Corrupted file: " << file_path << "\n";
+        return nullptr;
+    }
+
+    if (header.locale != s_no_string)
+        cache->set_locale(strings + header.locale);
+
+    // create the items, every record is visited after its parent
+    std::vector<IMdl_cache_item*> cache_items(header.item_count, nullptr);
+    cache_items[0] = cache->create(IMdl_cache_item::CK_PACKAGE, "::");
+    std::string qualified_name;
+    for (uint32_t i = 0; i < header.item_count; ++i)
+    {
+        const Item_record& item = items[i];
+        IMdl_cache_item* cache_item = cache_items[i];
+
+        for (uint32_t d = 0; d < item.data_count; ++d)
+        {
+            const Data_record& record = data[item.first_data + d];
+            cache_item->set_cache_data(strings + record.key, strings + record.value);
+        }
+
+        if (item.child_count == 0)
+            continue;
+
+        // only packages and modules have children, see is_valid_child
+        IMdl_cache_node* cache_node = static_cast<IMdl_cache_node*>(cache_item);
+
+        const std::string parent_qualified_name = cache_item->get_qualified_name();
+        for (uint32_t c = item.first_child; c < item.first_child + item.child_count; ++c)
+        {
+            qualified_name = (parent_qualified_name == "::")
+                ? parent_qualified_name + (strings + items[c].simple_name)
+                : parent_qualified_name + "::" + (strings + items[c].simple_name);
+
+            cache_items[c] = cache->create(
+                static_cast<IMdl_cache_item::Kind>(items[c].kind), qualified_name.c_str());
+            cache_node->add_child(cache_items[c]);
+        }
+    }
+
+    return static_cast<IMdl_cache_package*>(cache_items[0]);
+}
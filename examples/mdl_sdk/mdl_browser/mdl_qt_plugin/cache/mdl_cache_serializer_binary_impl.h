@@ -0,0 +1,32 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+/// \file
+/// \brief Implementation of the IMdl_cache_serializer_binary interface.
+
+
+#ifndef MDL_SDK_EXAMPLES_MDL_BROWSER_MDL_CACHE_SERIALIZER_BINARY_IMPL_H
+#define MDL_SDK_EXAMPLES_MDL_BROWSER_MDL_CACHE_SERIALIZER_BINARY_IMPL_H
+
+#include "imdl_cache.h"
+
+// Stores the cache tree in a binary file that consists of
+//  - a header,
+//  - fixed-size records of all items in breadth-first order, so the children of an item are
+//    stored consecutively and referenced by the index of the first child and their count,
+//  - fixed-size records of the key-value pairs of all items, referenced the same way,
+//  - a string table with all names, keys and values, each stored only once and referenced by
+//    its offset.
+// Loading maps the file and creates the cache items directly from the records.
+class Mdl_cache_serializer_binary_impl : public IMdl_cache_serializer_binary
+{
+public:
+    explicit Mdl_cache_serializer_binary_impl();
+    virtual ~Mdl_cache_serializer_binary_impl() = default;
+
+    bool serialize(const IMdl_cache* cache, const char* file_path) const override;
+    IMdl_cache_package* deserialize(IMdl_cache* cache, const char* file_path) const override;
+};
+
+#endif
@@ -47,6 +47,9 @@ struct Mdl_qt_plugin_context
     // Force to cache to rebuild.
     bool rebuild_module_cache = false;
 
+    // Report which modules would be reloaded instead of updating the cache.
+    bool verify_module_cache = false;
+
     // callbacks for mdl browser events.
     Mdl_browser_callbacks mdl_browser;
 };
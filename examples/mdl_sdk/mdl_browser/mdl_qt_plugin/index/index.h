@@ -4,22 +4,26 @@
 
 /// \file
 /// \brief A simple inverse index structure to support searching.
-///        The index is currently build on startup every time.
-///        It is not possible to update documents at that point.
+///        Documents can be added and removed incrementally and the index can be stored to
+///        and memory mapped from disk, so it does not need to be build on every startup.
 
 
 #ifndef MDL_SDK_EXAMPLES_MDL_BROWSER_INDEX_H
 #define MDL_SDK_EXAMPLES_MDL_BROWSER_INDEX_H
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <map>
+#include <string>
+#include <utility>
 #include <vector>
-#include <regex>
-#include <set>
 #include "tokenizer.h"
 #include "index_document.h"
-#include <cstdlib>
+#include "../utilities/mapped_file.h"
 
-// list element stored for each document that contains the current word 
+// list element stored for each document that contains the current word
 template<class T_document>
 struct PostingListItem
 {
@@ -31,26 +35,80 @@ struct PostingListItem
 template<class T_document>
 struct ResultListItem
 {
-    ResultListItem<T_document>(const T_document* document, float ranking) 
+    ResultListItem<T_document>(const T_document* document, float ranking)
         : Document(document)
         , Ranking(ranking)
     {  }
 
     const T_document* Document; // the document that fits the query
-    float Ranking;              // the rating this document has for the query                      
+    float Ranking;              // the rating this document has for the query
 };
 
+// read-only array of the index.
+// the data is either owned or points into a memory mapped index file.
+template<typename T>
+class Index_array
+{
+public:
+    explicit Index_array() : m_data(nullptr), m_size(0) { }
+
+    // takes the content of values
+    void assign(std::vector<T>& values)
+    {
+        m_owned.swap(values);
+        m_data = m_owned.data();
+        m_size = m_owned.size();
+    }
+
+    // refers to external data, that has to stay valid as long as this array is used
+    void map(const T* data, size_t size)
+    {
+        std::vector<T>().swap(m_owned);
+        m_data = data;
+        m_size = size;
+    }
+
+    const T* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+    const T& back() const { return m_data[m_size - 1]; }
+    const T& operator[](size_t index) const { return m_data[index]; }
+
+private:
+    std::vector<T> m_owned;
+    const T* m_data;
+    size_t m_size;
+};
+
+// Inverse index with substring search.
+//
+// Documents are collected with add_document() and removed with remove_document(). Both become
+// effective after finalize(), which compacts the index into read-only structures:
+//  - a sorted term dictionary stored in one contiguous character array,
+//  - per term, a posting list of delta and variable-length encoded document indices, each
+//    followed by the ranking weight of the word for that document,
+//  - an n-gram index, which maps every 1-, 2- and 3-gram to the sorted list of terms
+//    containing it.
+// Queries of up to three characters are answered directly by the n-gram index, longer queries
+// intersect the term lists of their trigrams and verify the remaining candidates.
+//
+// The structures are stored unchanged by save(). load() maps the file and uses the data in
+// place, only the documents themselves are recreated using deserialize_document().
 template<class T_document>
 class Index
 {
 public:
     typedef PostingListItem<T_document> PostingItem;
     typedef ResultListItem<T_document> ResultItem;
-    typedef std::map<uint32_t, PostingListItem<T_document>> PostingList;
 
     explicit Index()
+        : m_removed_count(0)
+        , m_modified(false)
     {
         m_tokenizer = new Tokenizer();
+        clear();
     }
 
     virtual ~Index()
@@ -63,51 +121,216 @@ public:
     };
 
     // add new document to the index.
-    // is called during build up.
+    // is called during build up, the document is searchable after the next finalize().
     void add_document(const T_document* doc)
     {
-        uint32_t id = doc->get_document_id();
+        const uint32_t doc_index = static_cast<uint32_t>(m_documents.size());
         Index_document::word_list words = doc->get_words(m_tokenizer);
         for (const auto& p : words)
         {
-            // make sure there is a posting list for this word
-            if (m_index.find(p.first) == m_index.end())
-                m_index[p.first] = PostingList();
-
             // add new posting or increment frequency counter
-            auto& list = m_index[p.first];
-            if (list.find(id) == list.end())
-                list[id] = {doc,  p.second};
+            auto& list = m_pending[p.first];
+            if (list.empty() || list.back().first != doc_index)
+                list.push_back(std::make_pair(doc_index, p.second));
             else
-                list[id].Ranking_weight += p.second; // accumulate single contributions (simple)
+                list.back().second += p.second; // accumulate single contributions (simple)
         }
         m_documents.push_back(doc);
+        m_modified = true;
+    }
+
+    // removes and deletes a document.
+    // the document index stays valid (but empty) until the next finalize(), which compacts the
+    // document list and the posting lists.
+    void remove_document(size_t doc_index)
+    {
+        if (doc_index >= m_documents.size() || !m_documents[doc_index])
+            return;
+
+        delete m_documents[doc_index];
+        m_documents[doc_index] = nullptr;
+        m_removed_count++;
+        m_modified = true;
+    }
+
+    // number of documents, including removed ones until the next finalize().
+    size_t get_document_count() const { return m_documents.size(); }
+
+    // get a document by index, returns null for removed documents.
+    const T_document* get_document(size_t doc_index) const { return m_documents[doc_index]; }
+
+    // merges all documents added and removed since the last call into the search structures.
+    // is called once after build up or update.
+    void finalize()
+    {
+        if (m_pending.empty() && m_removed_count == 0)
+            return;
+
+        merge_pending();
+        build_gram_index();
+
+        // all data is owned now
+        m_file.close();
+    }
+
+    // removes all documents.
+    void clear()
+    {
+        for (auto it : m_documents)
+            delete it;
+        m_documents.clear();
+        m_pending.clear();
+        m_removed_count = 0;
+
+        std::vector<uint32_t> zero(1, 0);
+        std::vector<char> term_chars;
+        std::vector<uint8_t> posting_data;
+        std::vector<uint32_t> gram_keys, gram_terms;
+        m_term_chars.assign(term_chars);
+        m_term_offsets.assign(zero);
+        m_posting_data.assign(posting_data);
+        zero.assign(1, 0);
+        m_posting_offsets.assign(zero);
+        m_gram_keys.assign(gram_keys);
+        zero.assign(1, 0);
+        m_gram_offsets.assign(zero);
+        m_gram_terms.assign(gram_terms);
+
+        m_file.close();
+        m_modified = true;
+    }
+
+    // true if documents have been added or removed since the index was loaded or saved.
+    bool is_modified() const { return m_modified; }
+
+    // stores the finalized index to disk, along with arbitrary user data.
+    // the file is replaced atomically, so a concurrently running application can still use it.
+    bool save(const std::string& path, const std::string& user_data)
+    {
+        if (!m_pending.empty() || m_removed_count > 0)
+            return false; // not finalized
+
+        std::string documents;
+        const uint32_t doc_count = static_cast<uint32_t>(m_documents.size());
+        documents.append(reinterpret_cast<const char*>(&doc_count), sizeof(uint32_t));
+        std::string payload;
+        for (const T_document* doc : m_documents)
+        {
+            payload.clear();
+            if (!serialize_document(doc, payload))
+                return false;
+
+            const uint32_t size = static_cast<uint32_t>(payload.size());
+            documents.append(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+            documents.append(payload);
+        }
+
+        std::string buffer(s_magic, sizeof(s_magic));
+        const uint32_t header[2] = {s_version, s_byte_order};
+        buffer.append(reinterpret_cast<const char*>(header), sizeof(header));
+
+        write_section(buffer, m_term_chars);
+        write_section(buffer, m_term_offsets);
+        write_section(buffer, m_posting_data);
+        write_section(buffer, m_posting_offsets);
+        write_section(buffer, m_gram_keys);
+        write_section(buffer, m_gram_offsets);
+        write_section(buffer, m_gram_terms);
+        write_section(buffer, documents.data(), documents.size());
+        write_section(buffer, user_data.data(), user_data.size());
+
+        if (!Mapped_file::write_atomic(path, buffer.data(), buffer.size()))
+            return false;
+
+        m_modified = false;
+        return true;
+    }
+
+    // replaces the content of this index by an index stored with save().
+    // documents that can not be deserialized anymore are removed with the next finalize().
+    // returns false and leaves an empty index if the file is missing or invalid.
+    bool load(const std::string& path, std::string& user_data)
+    {
+        clear();
+        user_data.clear();
+        if (!m_file.open(path))
+            return false;
+
+        if (!load_mapped(user_data))
+        {
+            clear();
+            user_data.clear();
+            return false;
+        }
+
+        m_modified = m_removed_count > 0;
+        return true;
     }
 
-    // find documents for a search term (query)
+    // find documents for a search term (query), one result per document.
+    // the results are sorted by descending ranking, if max_results is not zero, only the
+    // max_results best ranked documents are returned.
     // called at run time.
-    std::vector<ResultItem> find(const std::string& query) const
+    std::vector<ResultItem> find(const std::string& query, size_t max_results = 0) const
     {
         std::vector<ResultItem> results;
-        const std::regex expression("(.*)(" + query + ")(.*)");
-        std::smatch matches;
 
-        for (const auto& entry : m_index)
+        std::vector<uint32_t> terms;
+        find_terms(query, terms);
+        if (terms.empty())
+            return results;
+
+        // merge the postings of all matching terms, keeping the best ranking per document
+        std::vector<float> best(m_documents.size(), -1.0f);
+        std::vector<uint32_t> found;
+        std::string word;
+        for (uint32_t t : terms)
         {
-            std::regex_match(entry.first, matches, expression);
-            if (!matches.empty())
+            word.assign(m_term_chars.data() + m_term_offsets[t], term_length(t));
+
+            const uint8_t* data = m_posting_data.data() + m_posting_offsets[t];
+            const uint8_t* end = m_posting_data.data() + m_posting_offsets[t + 1];
+            uint32_t doc_index = 0;
+            while (data < end)
             {
-                for (const auto& p : entry.second)
-                {
-                    ResultItem r(p.second.Document, rank(p.second, entry.first, query));
-                    results.push_back(r);
-                }
+                float weight;
+                doc_index += read_varint(data);
+                memcpy(&weight, data, sizeof(float));
+                data += sizeof(float);
+
+                // removed, but not finalized yet
+                if (!m_documents[doc_index])
+                    continue;
+
+                PostingItem item = {m_documents[doc_index], weight};
+                const float ranking = rank(item, word, query);
+                if (best[doc_index] < 0.0f)
+                    found.push_back(doc_index);
+                if (ranking > best[doc_index])
+                    best[doc_index] = ranking;
             }
         }
+
+        // order by ranking, ties by document to keep the order stable
+        auto better = [&best](uint32_t a, uint32_t b)
+        {
+            return best[a] > best[b] || (best[a] == best[b] && a < b);
+        };
+        if (max_results > 0 && max_results < found.size())
+        {
+            std::partial_sort(found.begin(), found.begin() + max_results, found.end(), better);
+            found.resize(max_results);
+        }
+        else
+            std::sort(found.begin(), found.end(), better);
+
+        results.reserve(found.size());
+        for (uint32_t doc_index : found)
+            results.push_back(ResultItem(m_documents[doc_index], best[doc_index]));
         return results;
     }
 
-    // we use one tokenizer for generating the index as well as for processing the user 
+    // we use one tokenizer for generating the index as well as for processing the user
     // input, this way we make sure the same rules are applied (casing, special chars, ...)
     const Tokenizer* get_tokenizer() const { return m_tokenizer; }
 
@@ -115,7 +338,7 @@ protected:
 
     // computes the ranking for a specific result item.
     // simple approach to rank fuzzy search results,
-    // but here we rank the regex match.. totally equal vs. only a small part of the word.
+    // but here we rank the substring match.. totally equal vs. only a small part of the word.
     virtual float rank(const PostingItem& item, // entry in the index
                        const std::string& indexed_word, // the word found in the index
                        const std::string& query) const // the queried word
@@ -125,12 +348,509 @@ protected:
         return item.Ranking_weight / (dist + 1.0f);
     }
 
+    // appends the information required to recreate a document to payload.
+    // returns false if the document can not be stored, which makes save() fail.
+    virtual bool serialize_document(const T_document* doc, std::string& payload) const
+    {
+        return false;
+    }
+
+    // recreates a document stored with serialize_document().
+    // returns null if the document can not be restored, it is removed from the index then.
+    virtual T_document* deserialize_document(const char* payload, size_t size)
+    {
+        return nullptr;
+    }
+
 private:
-    std::map<std::string, PostingList> m_index; // posting list for each word 
-    std::vector<const T_document*> m_documents; // keep track of all documents (for cleanup only)
+    typedef std::vector<std::pair<uint32_t, float>> Pending_list;
+
+    static const char s_magic[8];
+    static const uint32_t s_version = 1;
+    static const uint32_t s_byte_order = 0x01020304;
+    static const uint32_t s_removed = ~0u;
+
+    uint32_t get_term_count() const
+    {
+        return static_cast<uint32_t>(m_term_offsets.size() - 1);
+    }
+
+    uint32_t term_length(uint32_t term) const
+    {
+        return m_term_offsets[term + 1] - m_term_offsets[term];
+    }
+
+    static void write_varint(std::vector<uint8_t>& dst, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            dst.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        dst.push_back(static_cast<uint8_t>(value));
+    }
+
+    static uint32_t read_varint(const uint8_t*& src)
+    {
+        uint32_t value = 0;
+        for (uint32_t shift = 0;; shift += 7)
+        {
+            const uint8_t byte = *src++;
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+    }
+
+    // key of an n-gram with 1 to 3 characters
+    static uint32_t gram_key(const char* s, size_t n)
+    {
+        uint32_t key = static_cast<uint32_t>(n) << 24;
+        for (size_t i = 0; i < n; ++i)
+            key |= static_cast<uint32_t>(static_cast<unsigned char>(s[i])) << (16 - 8 * i);
+        return key;
+    }
+
+    // appends a posting list to the compacted postings, doc_base is the document index
+    // preceding the first entry of the list.
+    // remap maps old to new document indices, if documents have been removed.
+    static void append_postings(
+        std::vector<uint8_t>& data,
+        const Pending_list& list,
+        const std::vector<uint32_t>& remap,
+        uint32_t& doc_base)
+    {
+        for (const auto& p : list)
+        {
+            const uint32_t doc_index = remap.empty() ? p.first : remap[p.first];
+            if (doc_index == s_removed)
+                continue;
+
+            write_varint(data, doc_index - doc_base);
+            doc_base = doc_index;
+            const uint8_t* w = reinterpret_cast<const uint8_t*>(&p.second);
+            data.insert(data.end(), w, w + sizeof(float));
+        }
+    }
+
+    // appends the posting list of an existing term to the compacted postings.
+    void copy_postings(
+        std::vector<uint8_t>& data,
+        uint32_t term,
+        const std::vector<uint32_t>& remap,
+        uint32_t& doc_base) const
+    {
+        const uint8_t* src = m_posting_data.data() + m_posting_offsets[term];
+        const uint8_t* end = m_posting_data.data() + m_posting_offsets[term + 1];
+
+        // nothing removed, so the list can be copied as is
+        if (remap.empty())
+        {
+            data.insert(data.end(), src, end);
+            doc_base = last_document(term);
+            return;
+        }
+
+        uint32_t doc_index = 0;
+        while (src < end)
+        {
+            doc_index += read_varint(src);
+            const uint32_t new_index = remap[doc_index];
+            if (new_index != s_removed)
+            {
+                write_varint(data, new_index - doc_base);
+                doc_base = new_index;
+                data.insert(data.end(), src, src + sizeof(float));
+            }
+            src += sizeof(float);
+        }
+    }
+
+    // merges the pending postings into the compacted term dictionary and posting lists
+    // and drops removed documents.
+    // documents are only appended, so pending postings always follow the existing ones.
+    void merge_pending()
+    {
+        // compact the document list
+        std::vector<uint32_t> remap;
+        if (m_removed_count > 0)
+        {
+            remap.resize(m_documents.size());
+            uint32_t next = 0;
+            for (size_t i = 0, n = m_documents.size(); i < n; ++i)
+            {
+                remap[i] = s_removed;
+                if (!m_documents[i])
+                    continue;
+                remap[i] = next;
+                m_documents[next++] = m_documents[i];
+            }
+            m_documents.resize(next);
+            m_removed_count = 0;
+        }
+
+        std::vector<char> term_chars;
+        std::vector<uint32_t> term_offsets(1, 0);
+        std::vector<uint8_t> posting_data;
+        std::vector<uint32_t> posting_offsets(1, 0);
+        term_chars.reserve(m_term_chars.size());
+        posting_data.reserve(m_posting_data.size());
+
+        auto pending = m_pending.begin();
+        uint32_t term = 0;
+        const uint32_t term_count = get_term_count();
+        while (term < term_count || pending != m_pending.end())
+        {
+            // order of the pending term relative to the existing one
+            int order;
+            if (term == term_count)
+                order = -1;
+            else if (pending == m_pending.end())
+                order = 1;
+            else
+                order = pending->first.compare(0, std::string::npos,
+                    m_term_chars.data() + m_term_offsets[term], term_length(term));
+
+            uint32_t doc_base = 0;
+            if (order <= 0)
+            {
+                // pending term, maybe after the postings of the existing one
+                if (order == 0)
+                    copy_postings(posting_data, term++, remap, doc_base);
+                term_chars.insert(term_chars.end(), pending->first.begin(), pending->first.end());
+                append_postings(posting_data, pending->second, remap, doc_base);
+                ++pending;
+            }
+            else
+            {
+                // existing term only
+                term_chars.insert(term_chars.end(),
+                    m_term_chars.begin() + m_term_offsets[term],
+                    m_term_chars.begin() + m_term_offsets[term + 1]);
+                copy_postings(posting_data, term++, remap, doc_base);
+            }
+
+            // drop terms that are not used by any document anymore
+            if (posting_data.size() == posting_offsets.back())
+            {
+                term_chars.resize(term_offsets.back());
+                continue;
+            }
+            term_offsets.push_back(static_cast<uint32_t>(term_chars.size()));
+            posting_offsets.push_back(static_cast<uint32_t>(posting_data.size()));
+        }
+
+        m_term_chars.assign(term_chars);
+        m_term_offsets.assign(term_offsets);
+        m_posting_data.assign(posting_data);
+        m_posting_offsets.assign(posting_offsets);
+        m_pending.clear();
+    }
+
+    // returns the index of the last document in the posting list of a term
+    uint32_t last_document(uint32_t term) const
+    {
+        const uint8_t* data = m_posting_data.data() + m_posting_offsets[term];
+        const uint8_t* end = m_posting_data.data() + m_posting_offsets[term + 1];
+        uint32_t doc_index = 0;
+        while (data < end)
+        {
+            doc_index += read_varint(data);
+            data += sizeof(float);
+        }
+        return doc_index;
+    }
+
+    // rebuilds the n-gram index from the term dictionary
+    void build_gram_index()
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> grams; // (gram key, term)
+        std::vector<uint32_t> term_grams;
+        for (uint32_t t = 0, n = get_term_count(); t < n; ++t)
+        {
+            const char* s = m_term_chars.data() + m_term_offsets[t];
+            const size_t length = term_length(t);
+
+            term_grams.clear();
+            for (size_t g = 1; g <= 3; ++g)
+                for (size_t i = 0; i + g <= length; ++i)
+                    term_grams.push_back(gram_key(s + i, g));
+            std::sort(term_grams.begin(), term_grams.end());
+            term_grams.erase(
+                std::unique(term_grams.begin(), term_grams.end()), term_grams.end());
+
+            for (uint32_t key : term_grams)
+                grams.push_back(std::make_pair(key, t));
+        }
+        std::sort(grams.begin(), grams.end());
+
+        std::vector<uint32_t> gram_keys;
+        std::vector<uint32_t> gram_offsets(1, 0);
+        std::vector<uint32_t> gram_terms;
+        gram_terms.reserve(grams.size());
+        for (size_t i = 0, n = grams.size(); i < n; ++i)
+        {
+            if (gram_keys.empty() || gram_keys.back() != grams[i].first)
+            {
+                if (!gram_keys.empty())
+                    gram_offsets.push_back(static_cast<uint32_t>(gram_terms.size()));
+                gram_keys.push_back(grams[i].first);
+            }
+            gram_terms.push_back(grams[i].second);
+        }
+        if (!gram_keys.empty())
+            gram_offsets.push_back(static_cast<uint32_t>(gram_terms.size()));
+
+        m_gram_keys.assign(gram_keys);
+        m_gram_offsets.assign(gram_offsets);
+        m_gram_terms.assign(gram_terms);
+    }
+
+    // looks up the sorted list of terms containing an n-gram, returns false if there is none
+    bool find_gram(const char* s, size_t n, const uint32_t*& begin, const uint32_t*& end) const
+    {
+        const uint32_t key = gram_key(s, n);
+        auto it = std::lower_bound(m_gram_keys.begin(), m_gram_keys.end(), key);
+        if (it == m_gram_keys.end() || *it != key)
+            return false;
+
+        const size_t g = static_cast<size_t>(it - m_gram_keys.begin());
+        begin = m_gram_terms.data() + m_gram_offsets[g];
+        end = m_gram_terms.data() + m_gram_offsets[g + 1];
+        return true;
+    }
+
+    // collects all terms that contain the query as substring, sorted by term index
+    void find_terms(const std::string& query, std::vector<uint32_t>& terms) const
+    {
+        terms.clear();
+        const size_t length = query.length();
+
+        // every word contains the empty string
+        if (length == 0)
+        {
+            for (uint32_t t = 0, n = get_term_count(); t < n; ++t)
+                terms.push_back(t);
+            return;
+        }
+
+        // short queries are n-grams themselves
+        const uint32_t* begin;
+        const uint32_t* end;
+        if (length <= 3)
+        {
+            if (find_gram(query.data(), length, begin, end))
+                terms.assign(begin, end);
+            return;
+        }
+
+        // intersect the term lists of all trigrams, starting with the shortest one
+        std::vector<std::pair<const uint32_t*, const uint32_t*>> lists;
+        for (size_t i = 0; i + 3 <= length; ++i)
+        {
+            if (!find_gram(query.data() + i, 3, begin, end))
+                return;
+            lists.push_back(std::make_pair(begin, end));
+        }
+        std::sort(lists.begin(), lists.end(),
+            [](const std::pair<const uint32_t*, const uint32_t*>& a,
+               const std::pair<const uint32_t*, const uint32_t*>& b)
+            {
+                return (a.second - a.first) < (b.second - b.first);
+            });
+
+        terms.assign(lists[0].first, lists[0].second);
+        for (size_t l = 1, n = lists.size(); l < n && !terms.empty(); ++l)
+        {
+            auto out = terms.begin();
+            for (uint32_t t : terms)
+                if (std::binary_search(lists[l].first, lists[l].second, t))
+                    *out++ = t;
+            terms.erase(out, terms.end());
+        }
+
+        // sharing all trigrams does not imply containing the query
+        auto out = terms.begin();
+        for (uint32_t t : terms)
+        {
+            const char* s = m_term_chars.data() + m_term_offsets[t];
+            const char* e = s + term_length(t);
+            if (std::search(s, e, query.begin(), query.end()) != e)
+                *out++ = t;
+        }
+        terms.erase(out, terms.end());
+    }
+
+    // appends a section to the file buffer: its size in bytes, the data and padding to keep
+    // all sections 8 byte aligned
+    static void write_section(std::string& buffer, const void* data, size_t size)
+    {
+        const uint64_t size64 = static_cast<uint64_t>(size);
+        buffer.append(reinterpret_cast<const char*>(&size64), sizeof(uint64_t));
+        buffer.append(static_cast<const char*>(data), size);
+        buffer.append((8 - size % 8) % 8, '\0');
+    }
+
+    template<typename T>
+    static void write_section(std::string& buffer, const Index_array<T>& array)
+    {
+        write_section(buffer, array.data(), array.size() * sizeof(T));
+    }
+
+    // reads the next section of the mapped file, returns false if the file is too short
+    bool read_section(size_t& pos, const char*& data, size_t& size) const
+    {
+        const size_t file_size = m_file.get_size();
+        uint64_t size64;
+        if (file_size - pos < sizeof(uint64_t))
+            return false;
+        memcpy(&size64, m_file.get_data() + pos, sizeof(uint64_t));
+        pos += sizeof(uint64_t);
+
+        if (size64 > file_size - pos)
+            return false;
+        size = static_cast<size_t>(size64);
+        data = m_file.get_data() + pos;
+        pos += size + (8 - size % 8) % 8;
+        pos = std::min(pos, file_size);
+        return true;
+    }
+
+    template<typename T>
+    bool read_section(size_t& pos, Index_array<T>& array) const
+    {
+        const char* data;
+        size_t size;
+        if (!read_section(pos, data, size) || size % sizeof(T) != 0)
+            return false;
+        array.map(reinterpret_cast<const T*>(data), size / sizeof(T));
+        return true;
+    }
+
+    // checks that an offset table starts at zero, is monotonic and ends at the data size
+    static bool check_offsets(const Index_array<uint32_t>& offsets, size_t data_size)
+    {
+        if (offsets.empty() || offsets[0] != 0 || offsets.back() != data_size)
+            return false;
+        for (size_t i = 1, n = offsets.size(); i < n; ++i)
+            if (offsets[i] < offsets[i - 1])
+                return false;
+        return true;
+    }
+
+    // maps the structures of the opened file and recreates the documents.
+    // the file is checked thoroughly, a corrupted file must not crash the application.
+    bool load_mapped(std::string& user_data)
+    {
+        const size_t header_size = sizeof(s_magic) + 2 * sizeof(uint32_t);
+        if (m_file.get_size() < header_size)
+            return false;
+
+        uint32_t header[2];
+        memcpy(header, m_file.get_data() + sizeof(s_magic), sizeof(header));
+        if (memcmp(m_file.get_data(), s_magic, sizeof(s_magic)) != 0 ||
+            header[0] != s_version || header[1] != s_byte_order)
+            return false;
+
+        size_t pos = header_size;
+        const char* documents;
+        const char* user;
+        size_t documents_size, user_size;
+        if (!read_section(pos, m_term_chars) ||
+            !read_section(pos, m_term_offsets) ||
+            !read_section(pos, m_posting_data) ||
+            !read_section(pos, m_posting_offsets) ||
+            !read_section(pos, m_gram_keys) ||
+            !read_section(pos, m_gram_offsets) ||
+            !read_section(pos, m_gram_terms) ||
+            !read_section(pos, documents, documents_size) ||
+            !read_section(pos, user, user_size))
+            return false;
+
+        // check the structure
+        if (!check_offsets(m_term_offsets, m_term_chars.size()) ||
+            !check_offsets(m_posting_offsets, m_posting_data.size()) ||
+            !check_offsets(m_gram_offsets, m_gram_terms.size()) ||
+            m_posting_offsets.size() != m_term_offsets.size() ||
+            m_gram_offsets.size() != m_gram_keys.size() + 1)
+            return false;
+
+        const uint32_t term_count = get_term_count();
+        for (uint32_t t : m_gram_terms)
+            if (t >= term_count)
+                return false;
+
+        // recreate the documents
+        uint32_t doc_count;
+        if (documents_size < sizeof(uint32_t))
+            return false;
+        memcpy(&doc_count, documents, sizeof(uint32_t));
+        size_t offset = sizeof(uint32_t);
+        m_documents.reserve(doc_count);
+        for (uint32_t i = 0; i < doc_count; ++i)
+        {
+            uint32_t size;
+            if (documents_size - offset < sizeof(uint32_t))
+                return false;
+            memcpy(&size, documents + offset, sizeof(uint32_t));
+            offset += sizeof(uint32_t);
+            if (documents_size - offset < size)
+                return false;
+
+            const T_document* doc = deserialize_document(documents + offset, size);
+            offset += size;
+            m_documents.push_back(doc);
+            if (!doc)
+                m_removed_count++;
+        }
+
+        // check the posting lists, they must only refer to existing documents
+        for (uint32_t t = 0; t < term_count; ++t)
+        {
+            const uint8_t* data = m_posting_data.data() + m_posting_offsets[t];
+            const uint8_t* end = m_posting_data.data() + m_posting_offsets[t + 1];
+            uint64_t doc_index = 0;
+            while (data < end)
+            {
+                uint32_t value = 0;
+                for (uint32_t shift = 0; data < end; shift += 7)
+                {
+                    const uint8_t byte = *data++;
+                    value |= static_cast<uint32_t>(byte & 0x7f) << (shift & 31);
+                    if ((byte & 0x80) == 0)
+                        break;
+                }
+                doc_index += value;
+                if (doc_index >= doc_count || static_cast<size_t>(end - data) < sizeof(float))
+                    return false;
+                data += sizeof(float);
+            }
+        }
+
+        user_data.assign(user, user_size);
+        return true;
+    }
+
+    std::map<std::string, Pending_list> m_pending;  // postings added since the last finalize()
+
+    Index_array<char> m_term_chars;         // all terms in sorted order, without separators
+    Index_array<uint32_t> m_term_offsets;   // start of each term in m_term_chars (+ end)
+    Index_array<uint8_t> m_posting_data;    // delta coded document indices and weights
+    Index_array<uint32_t> m_posting_offsets; // start of each posting list in m_posting_data
+
+    Index_array<uint32_t> m_gram_keys;      // sorted keys of all n-grams
+    Index_array<uint32_t> m_gram_offsets;   // start of each n-gram's list in m_gram_terms
+    Index_array<uint32_t> m_gram_terms;     // sorted term lists of all n-grams
+
+    std::vector<const T_document*> m_documents; // all documents, posting lists index this
+    size_t m_removed_count;                 // number of removed documents not finalized yet
+    bool m_modified;                        // changed since the last load() or save()
+    Mapped_file m_file;                     // the loaded index file, if still in use
     Tokenizer* m_tokenizer;
 };
 
+template<class T_document>
+const char Index<T_document>::s_magic[8] = {'M', 'D', 'L', 'B', 'I', 'D', 'X', '\0'};
 
 
-#endif
\ No newline at end of file
+#endif
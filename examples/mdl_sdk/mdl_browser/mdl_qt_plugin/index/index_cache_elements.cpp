@@ -5,43 +5,212 @@
 
 #include "index_cache_elements.h"
 #include "../cache/imdl_cache.h"
-#include "../cache/mdl_cache.h"
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
 
 
-bool build_recursively(Index_cache_elements* index, const IMdl_cache_node* node)
+namespace
 {
-    bool success = true;
+    // collects all modules of the cache, indexed by qualified name
+    bool collect_modules(const IMdl_cache_node* node,
+                         std::map<std::string, const IMdl_cache_module*>& modules)
+    {
+        bool success = true;
+        for (mi::Size i = 0, n = node->get_child_count(); i < n; ++i)
+        {
+            const IMdl_cache_item* child_item = node->get_child(*node->get_child_key(i));
 
+            const auto child_module = dynamic_cast<const IMdl_cache_module*>(child_item);
+            if (child_module)
+            {
+                modules[child_module->get_qualified_name()] = child_module;
+                continue;
+            }
 
-    for (mi::Size i = 0, n = node->get_child_count(); i<n; ++i)
+            // nodes that can have "grand" children  (packages only)
+            const auto child_node = dynamic_cast<const IMdl_cache_node*>(child_item);
+            if (child_node)
+            {
+                success &= collect_modules(child_node, modules);
+                continue;
+            }
+
+            std::cerr << "[Index_mdl_cache] collect_modules: missing case.\n";
+            success = false;
+        }
+        return success;
+    }
+
+    // adds the elements of a module as documents
+    bool add_module(Index_cache_elements* index, const IMdl_cache_module* module)
     {
-        // nodes that can have "grand" children  (packages only)
-        const IMdl_cache_item* child_item = node->get_child(*node->get_child_key(i));
-        const auto child_node = dynamic_cast<const IMdl_cache_node*>(child_item);
-        if (child_node)
+        bool success = true;
+        for (mi::Size i = 0, n = module->get_child_count(); i < n; ++i)
         {
-            build_recursively(index, child_node);
-            continue;
+            // elements that can be selected
+            const IMdl_cache_item* child_item = module->get_child(*module->get_child_key(i));
+            const auto child_element = dynamic_cast<const IMdl_cache_element*>(child_item);
+            if (child_element)
+            {
+                index->add_document(new Index_document_cache_element(child_element));
+                continue;
+            }
+
+            std::cerr << "[Index_mdl_cache] add_module: missing case.\n";
+            success = false;
         }
+        return success;
+    }
+
+    // identifies the state of a module, modules are indexed again if it changes.
+    // the content hash does not change when only the file time changes.
+    mi::Uint64 get_version(const IMdl_cache_module* module)
+    {
+        const mi::Uint64 content_hash = module->get_content_hash();
+        return content_hash != 0 ? content_hash : module->get_timestamp();
+    }
+
+    std::string safe_str(const char* string)
+    {
+        return string ? string : "";
+    }
+}
+
+Index_cache_elements::Index_cache_elements()
+    : m_loading_cache(nullptr)
+{
+}
+
+bool Index_cache_elements::build(const IMdl_cache* cache)
+{
+    std::map<std::string, const IMdl_cache_module*> modules;
+    bool success = collect_modules(cache->get_cache_root(), modules);
 
-        // elements that can be selected
-        const auto child_element = dynamic_cast<const IMdl_cache_element*>(child_item);
-        if (child_element)
+    // translated data can not be reused
+    const std::string locale = safe_str(cache->get_locale());
+    if (locale != m_locale)
+    {
+        clear();
+        m_module_versions.clear();
+        m_locale = locale;
+    }
+
+    // modules that are new, changed, removed or failed to update (version zero)
+    std::set<std::string> outdated;
+    outdated.swap(m_outdated_modules);
+    for (const auto& m : modules)
+    {
+        const mi::Uint64 version = get_version(m.second);
+        const auto found = m_module_versions.find(m.first);
+        if (version == 0 || found == m_module_versions.end() || found->second != version)
+            outdated.insert(m.first);
+    }
+    for (const auto& m : m_module_versions)
+        if (modules.find(m.first) == modules.end())
+            outdated.insert(m.first);
+
+    // remove the documents of these modules and index the current elements
+    if (!outdated.empty())
+    {
+        for (size_t i = 0, n = get_document_count(); i < n; ++i)
         {
-            index->add_document(new Index_document_cache_element(child_element));
-            continue;
+            const Index_document_cache_element* doc = get_document(i);
+            if (doc && outdated.find(doc->get_module()) != outdated.end())
+                remove_document(i);
         }
 
-        std::cerr << "[Index_mdl_cache] build_recursively: missing case.\n";
-        success = false;
-        break;
+        for (const auto& name : outdated)
+        {
+            const auto found = modules.find(name);
+            if (found != modules.end())
+                success &= add_module(this, found->second);
+        }
     }
+
+    m_module_versions.clear();
+    for (const auto& m : modules)
+        m_module_versions[m.first] = get_version(m.second);
+
+    // make the changes searchable
+    finalize();
     return success;
 }
 
-bool Index_cache_elements::build(const Mdl_cache* cache)
+bool Index_cache_elements::load_from_disk(const IMdl_cache* cache, const std::string& path)
+{
+    std::string user_data;
+    m_loading_cache = cache;
+    const bool success = load(path, user_data);
+    m_loading_cache = nullptr;
+
+    m_module_versions.clear();
+    m_locale.clear();
+    if (!success)
+    {
+        m_outdated_modules.clear();
+        return false;
+    }
+
+    // user data: locale in the first line, followed by one line per module:
+    // qualified name and version, separated by a tab
+    std::istringstream stream(user_data);
+    std::string line;
+    std::getline(stream, m_locale);
+    while (std::getline(stream, line))
+    {
+        const size_t pos = line.find('\t');
+        if (pos == std::string::npos)
+            continue;
+        m_module_versions[line.substr(0, pos)] =
+            static_cast<mi::Uint64>(std::strtoull(line.c_str() + pos + 1, nullptr, 10));
+    }
+    return true;
+}
+
+bool Index_cache_elements::save_to_disk(const std::string& path)
+{
+    if (!is_modified())
+        return true;
+
+    std::ostringstream stream;
+    stream << m_locale << "\n";
+    for (const auto& m : m_module_versions)
+        stream << m.first << "\t" << m.second << "\n";
+
+    return save(path, stream.str());
+}
+
+bool Index_cache_elements::serialize_document(
+    const Index_document_cache_element* doc, std::string& payload) const
+{
+    // kind, qualified name and module name, separated by zeros
+    payload.push_back(static_cast<char>(doc->get_kind()));
+    payload.append(doc->get_qualified_name());
+    payload.push_back('\0');
+    payload.append(doc->get_module());
+    return true;
+}
+
+Index_document_cache_element* Index_cache_elements::deserialize_document(
+    const char* payload, size_t size)
 {
-    const IMdl_cache_package* root = cache->get_cache_root();
-    return build_recursively(this, root);
+    const std::string data(payload, size);
+    const size_t pos = data.find('\0', 1);
+    if (data.empty() || pos == std::string::npos)
+        return nullptr;
+
+    const auto kind = static_cast<IMdl_cache_item::Kind>(data[0]);
+    const std::string qualified_name = data.substr(1, pos - 1);
+
+    // the element is gone, so the module needs to be indexed again
+    const auto element = dynamic_cast<const IMdl_cache_element*>(
+        m_loading_cache->get_cache_item({kind, qualified_name}));
+    if (!element)
+    {
+        m_outdated_modules.insert(data.substr(pos + 1));
+        return nullptr;
+    }
+
+    return new Index_document_cache_element(element);
 }
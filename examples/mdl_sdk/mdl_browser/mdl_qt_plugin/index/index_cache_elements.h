@@ -13,17 +13,45 @@
 
 #include "index.h"
 #include "index_document_cache_element.h"
+#include <map>
+#include <set>
 
-class Mdl_cache;
+class IMdl_cache;
 
 // inverse index build of cache elements.
 // allows to search for materials in modules based on available info, e.g., from annotations
 class Index_cache_elements : public Index<Index_document_cache_element>
 {
 public:
-    // constructs the cache index from the cache.
-    // therefore, each element in the cache is treated as document
-    bool build(const Mdl_cache* cache);
+    explicit Index_cache_elements();
+    virtual ~Index_cache_elements() = default;
+
+    // constructs or updates the cache index from the cache.
+    // therefore, each element in the cache is treated as document.
+    // only the elements of modules with a changed content hash (or timestamp, if the hash
+    // is unknown) are (re-)indexed.
+    bool build(const IMdl_cache* cache);
+
+    // loads an index stored by save_to_disk.
+    // has to be called after the cache is updated and before build, because the documents
+    // are bound to the elements of the current cache.
+    bool load_from_disk(const IMdl_cache* cache, const std::string& path);
+
+    // stores the index, if it changed since the last load or save.
+    bool save_to_disk(const std::string& path);
+
+protected:
+    bool serialize_document(
+        const Index_document_cache_element* doc, std::string& payload) const override;
+
+    Index_document_cache_element* deserialize_document(
+        const char* payload, size_t size) override;
+
+private:
+    const IMdl_cache* m_loading_cache;                      // the cache to bind documents to
+    std::map<std::string, mi::Uint64> m_module_versions;    // indexed modules and versions
+    std::set<std::string> m_outdated_modules;               // modules with missing elements
+    std::string m_locale;                                   // locale of the indexed data
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -14,6 +14,9 @@ class Mdl_cache_function;
 
 Index_document_cache_element::Index_document_cache_element(const IMdl_cache_element* cache_item) 
     : m_cache_element(cache_item)
+    , m_kind(cache_item->get_kind())
+    , m_qualified_name(cache_item->get_qualified_name())
+    , m_module(cache_item->get_module())
 {
 }
 
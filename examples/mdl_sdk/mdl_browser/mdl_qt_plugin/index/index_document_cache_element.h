@@ -11,6 +11,7 @@
 #define MDL_SDK_EXAMPLES_MDL_BROWSER_DOCUMENT_MDL_ELEMENT_H
 
 #include "index_document.h"
+#include "../cache/imdl_cache.h"
 
 class IMdl_cache_element;
 class Tokenizer;
@@ -29,8 +30,22 @@ public:
     // the cache element this documented is created from
     const IMdl_cache_element* get_cache_element() const { return m_cache_element; }
 
+    // kind of the cache element
+    IMdl_cache_item::Kind get_kind() const { return m_kind; }
+
+    // qualified name of the cache element.
+    // the names are copied, because the cache element can be deleted during a cache update
+    // before its document is removed from the index.
+    const std::string& get_qualified_name() const { return m_qualified_name; }
+
+    // qualified name of the module the cache element is defined in
+    const std::string& get_module() const { return m_module; }
+
 private:
     const IMdl_cache_element* m_cache_element;
+    IMdl_cache_item::Kind m_kind;
+    std::string m_qualified_name;
+    std::string m_module;
 };
 
 #endif
@@ -61,6 +61,7 @@ bool Mdl_qt_plugin::set_context(QQmlApplicationEngine* engine, Mdl_qt_plugin_con
         context->transaction.get(),
         &context->mdl_browser,
         context->rebuild_module_cache,
+        context->verify_module_cache,
         Platform_helper::get_executable_directory().c_str());
 
     m_engine->rootContext()->setContextProperty("vm_mdl_browser", m_view_model);
@@ -95,6 +96,7 @@ void Mdl_qt_plugin::show_select_material_dialog(Mdl_qt_plugin_context* context,
                 context->transaction.get(),
                 &context->mdl_browser,
                 context->rebuild_module_cache,
+                context->verify_module_cache,
             Platform_helper::get_executable_directory().c_str());
 
         // create and run an internal application
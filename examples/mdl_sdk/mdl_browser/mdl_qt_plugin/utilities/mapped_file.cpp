@@ -0,0 +1,148 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+
+#include "mapped_file.h"
+
+// MDL SDK platform definitions
+#include <mi/mdl_sdk.h>
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+
+#if defined(MI_PLATFORM_WINDOWS)
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+Mapped_file::Mapped_file()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_file_handle(nullptr)
+    , m_mapping_handle(nullptr)
+{
+}
+
+Mapped_file::~Mapped_file()
+{
+    close();
+}
+
+bool Mapped_file::open(const std::string& path)
+{
+    close();
+
+#ifdef MI_PLATFORM_WINDOWS
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file_handle = file;
+    m_mapping_handle = mapping;
+    m_data = static_cast<const char*>(data);
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat result {};
+    if (fstat(fd, &result) != 0 || result.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(result.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (data == MAP_FAILED)
+        return false;
+
+    m_data = static_cast<const char*>(data);
+    m_size = static_cast<size_t>(result.st_size);
+#endif
+    return true;
+}
+
+void Mapped_file::close()
+{
+    if (!m_data)
+        return;
+
+#ifdef MI_PLATFORM_WINDOWS
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping_handle));
+    CloseHandle(static_cast<HANDLE>(m_file_handle));
+#else
+    munmap(const_cast<char*>(m_data), m_size);
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_file_handle = nullptr;
+    m_mapping_handle = nullptr;
+}
+
+bool Mapped_file::write_atomic(const std::string& path, const void* data, size_t size)
+{
+    // the temporary file is unique per process and call, so concurrent writers of the same
+    // path never share it. the last rename wins.
+    static std::atomic<unsigned> s_counter(0);
+#ifdef MI_PLATFORM_WINDOWS
+    const unsigned long pid = static_cast<unsigned long>(GetCurrentProcessId());
+#else
+    const unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+    std::stringstream temp_name;
+    temp_name << path << ".tmp" << pid << "_" << s_counter++;
+    const std::string temp_path = temp_name.str();
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    const bool written = fwrite(data, 1, size, file) == size;
+    if (fclose(file) != 0 || !written)
+    {
+        remove(temp_path.c_str());
+        return false;
+    }
+
+#ifdef MI_PLATFORM_WINDOWS
+    if (!MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+    if (rename(temp_path.c_str(), path.c_str()) != 0)
+#endif
+    {
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
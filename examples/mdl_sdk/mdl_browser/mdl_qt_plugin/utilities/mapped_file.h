@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+/// \file
+/// \brief Read-only memory mapping of files and atomic file replacement.
+
+
+#ifndef MDL_SDK_EXAMPLES_MDL_BROWSER_MAPPED_FILE_H
+#define MDL_SDK_EXAMPLES_MDL_BROWSER_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// maps a file read-only into memory.
+// the mapped data stays valid until the object is closed or destroyed.
+class Mapped_file
+{
+public:
+    explicit Mapped_file();
+    ~Mapped_file();
+
+    // maps the given file, returns false if the file does not exist or could not be mapped.
+    // a previously mapped file is closed first.
+    bool open(const std::string& path);
+
+    // unmaps the file
+    void close();
+
+    // the file content or nullptr if no file is mapped
+    const char* get_data() const { return m_data; }
+
+    // size of the file content in bytes
+    size_t get_size() const { return m_size; }
+
+    // writes data to a temporary file next to path and replaces path by it.
+    // readers of the old file, including existing mappings, are not affected.
+    static bool write_atomic(const std::string& path, const void* data, size_t size);
+
+private:
+    Mapped_file(const Mapped_file&) = delete;
+    Mapped_file& operator=(const Mapped_file&) = delete;
+
+    const char* m_data;
+    size_t m_size;
+    void* m_file_handle;
+    void* m_mapping_handle;
+};
+
+#endif
@@ -173,15 +173,9 @@ bool Selection_filter_single_token_search::evaluate_intern(const VM_sel_element*
 {
     const IMdl_cache_element* item = element->get_cache_element();
 
-    bool found = false;
-    float found_ranking = 1.0f;
-    for (const auto& it : m_query_results)
-        if (it.Document->get_cache_element() == item)
-        {
-            found = true;
-            found_ranking = it.Ranking;
-            break;
-        }
+    const auto it = m_query_results.find(item);
+    const bool found = it != m_query_results.end();
+    const float found_ranking = found ? it->second : 1.0f;
 
     if (found ^ get_negated())
         element->set_search_ranking({}, element->get_search_ranking() * found_ranking);
@@ -196,15 +190,21 @@ void Selection_filter_single_token_search::set_query(const std::string& value)
 
     // negated search?
     bool negated = false;
+    std::vector<ResultListItem<Index_document_cache_element>> results;
     if (m_query[0] == '-')
     {
-        m_query_results = m_index->find(value.substr(1));
+        results = m_index->find(value.substr(1));
         negated = true;
     }
     else
     {
-        m_query_results = m_index->find(value);
+        results = m_index->find(value);
     }
+
+    // results are unique per document, keep them for fast lookup during evaluation
+    m_query_results.clear();
+    for (const auto& it : results)
+        m_query_results[it.Document->get_cache_element()] = it.Ranking;
     
     // invalidate only once
     if(get_negated() == negated)
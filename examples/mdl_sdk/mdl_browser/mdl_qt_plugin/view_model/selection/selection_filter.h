@@ -9,6 +9,7 @@
 #ifndef MDL_SDK_EXAMPLES_MDL_BROWSER_SELECTION_FILTER_H
 #define MDL_SDK_EXAMPLES_MDL_BROWSER_SELECTION_FILTER_H
 
+#include <unordered_map>
 #include <vector>
 #include "vm_sel_element.h"
 #include "../../index/index.h"
@@ -169,7 +170,7 @@ public:
 private:
     const Index_cache_elements* m_index;
     std::string m_query;
-    std::vector<ResultListItem<Index_document_cache_element>> m_query_results;
+    std::unordered_map<const IMdl_cache_element*, float> m_query_results; // ranking per element
 };
 
 // filter based on more complex multi-token search query 
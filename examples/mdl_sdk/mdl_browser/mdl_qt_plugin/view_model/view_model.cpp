@@ -16,7 +16,7 @@
 #include "../utilities/platform_helper.h"
 
 #include "../cache/mdl_cache.h"
-#include "cache/mdl_cache_serializer_xml_impl.h"
+#include "cache/mdl_cache_serializer_binary_impl.h"
 
 namespace 
 {
@@ -30,6 +30,7 @@ View_model::View_model(mi::neuraylib::INeuray* neuray,
                        mi::neuraylib::ITransaction* transaction,
                        Mdl_browser_callbacks* callbacks,
                        bool cache_rebuild,
+                       bool cache_verify,
                        const char* application_folder)
     : m_neuray(mi::base::make_handle_dup(neuray))
     , m_transaction(mi::base::make_handle_dup(transaction))
@@ -40,8 +41,12 @@ View_model::View_model(mi::neuraylib::INeuray* neuray,
 {
     // use the discovered tree of the cache to be consistent regards to changes since then
     m_cache = new Mdl_cache();
-    const std::string cache_path = Platform_helper::get_executable_directory() + "/mdl_cache.xml";
-    const Mdl_cache_serializer_xml_impl serializer;
+    // the binary cache loads much faster than the xml one for large libraries,
+    // Mdl_cache_serializer_xml_impl can be used to inspect the cache content
+    const std::string cache_path = Platform_helper::get_executable_directory() + "/mdl_cache.bin";
+    const std::string index_path =
+        Platform_helper::get_executable_directory() + "/mdl_cache.index";
+    const Mdl_cache_serializer_binary_impl serializer;
 
     // discard cache if specified on the command line
     if (!cache_rebuild)
@@ -72,15 +77,25 @@ View_model::View_model(mi::neuraylib::INeuray* neuray,
     }
 
     // timings are measured withing (broken down)
-    if (!m_cache->update(neuray, transaction))
+    // the stored search index is discarded along with the cache
+    if (!m_cache->update(neuray, transaction, cache_rebuild ? "" : index_path, cache_verify))
         std::cerr << "[Mdl_sdk] start: failed to update the cache.\n";
 
-
-    Platform_helper::tic_toc_log("Save Cache: ", [&]()
+    // when verifying, the stored cache is kept as it is
+    if (!cache_verify)
     {
-        if (!m_cache->save_to_disk(serializer, cache_path))
-            std::cerr << "[Mdl_sdk] start: failed to store the cache.\n";
-    });
+        Platform_helper::tic_toc_log("Save Cache: ", [&]()
+        {
+            if (!m_cache->save_to_disk(serializer, cache_path))
+                std::cerr << "[Mdl_sdk] start: failed to store the cache.\n";
+        });
+
+        Platform_helper::tic_toc_log("Save Index: ", [&]()
+        {
+            if (!m_cache->save_index_to_disk(index_path))
+                std::cerr << "[Mdl_sdk] start: failed to store the search index.\n";
+        });
+    }
 
     mi::base::Handle<const mi::neuraylib::IMdl_discovery_result> discovery_result(
         m_cache->get_discovery_result());
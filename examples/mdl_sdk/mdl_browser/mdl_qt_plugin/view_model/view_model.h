@@ -33,6 +33,7 @@ public:
                         mi::neuraylib::ITransaction* transaction,
                         Mdl_browser_callbacks* callbacks,
                         bool cache_rebuild, 
+                        bool cache_verify,
                         const char* application_folder);
 
     virtual ~View_model();
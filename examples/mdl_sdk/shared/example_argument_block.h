@@ -0,0 +1,326 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/example_argument_block.h
+//
+// CPU-side management of the argument blocks of class-compiled materials with minimal updates.
+
+#ifndef EXAMPLE_ARGUMENT_BLOCK_H
+#define EXAMPLE_ARGUMENT_BLOCK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <mi/mdl_sdk.h>
+
+// A byte range of an argument block that has to be copied to the device.
+struct Argument_block_span
+{
+    size_t offset;
+    size_t size;
+};
+
+// Manages a CPU-side copy of an argument block and the byte ranges changed since the last update.
+//
+// The writer changes arguments with set() or set_value(), which write at the offsets given by the
+// ITarget_value_layout of the block, or applies changes made elsewhere with update_from(), which
+// compares a modified block with the managed copy. Only bytes that really change are recorded.
+// publish() hands the changes over to the reader, which uploads just the returned spans instead of
+// the whole block. Changing the arguments this way never requires new target code.
+//
+// The manager keeps two copies of the block. The writer owns the back block, the reader reads the
+// front block between acquire() and release(). publish() swaps the blocks with a single atomic
+// operation and fails instead of blocking while the reader holds the front block, so one writer
+// thread and one reader thread can exchange updates without locks. The spans of publications the
+// reader has missed are accumulated. Both sides may also be used from the same thread, e.g., for
+// an upload directly after an edit.
+class Argument_block_manager
+{
+public:
+    // Creates the manager for a block with the given layout and initial data.
+    //
+    // Spans that are at most merge_gap bytes apart are merged to reduce the number of copies.
+    Argument_block_manager(
+        mi::neuraylib::ITarget_value_layout const *layout,
+        mi::neuraylib::ITarget_argument_block const *block,
+        size_t merge_gap = 16)
+        : m_layout(layout, mi::base::DUP_INTERFACE)
+        , m_size(block->get_size())
+        , m_merge_gap(merge_gap)
+        , m_state(0)
+    {
+        m_blocks[0].assign(block->get_data(), block->get_data() + m_size);
+        m_blocks[1] = m_blocks[0];
+    }
+
+    // Creates the manager for a block given by its data and size.
+    //
+    // The layout may be nullptr, if the arguments are only changed by update_from().
+    Argument_block_manager(
+        mi::neuraylib::ITarget_value_layout const *layout,
+        char const *data,
+        size_t size,
+        size_t merge_gap = 16)
+        : m_layout(layout, mi::base::DUP_INTERFACE)
+        , m_size(size)
+        , m_merge_gap(merge_gap)
+        , m_state(0)
+    {
+        m_blocks[0].assign(data, data + m_size);
+        m_blocks[1] = m_blocks[0];
+    }
+
+    // Returns the size of the block in bytes.
+    size_t get_size() const { return m_size; }
+
+    // Returns the layout of the block.
+    mi::neuraylib::ITarget_value_layout const *get_layout() const { return m_layout.get(); }
+
+    //--------------------------------------------------------------------------
+    // Writer side
+    //--------------------------------------------------------------------------
+
+    // Returns the layout state of the i'th argument of the material.
+    mi::neuraylib::Target_value_layout_state get_argument_state(mi::Size i) const
+    {
+        return m_layout->get_nested_state(i);
+    }
+
+    // Returns the layout state of the i'th element of a compound argument, e.g., of a color.
+    mi::neuraylib::Target_value_layout_state get_element_state(
+        mi::neuraylib::Target_value_layout_state state, mi::Size i) const
+    {
+        return m_layout->get_nested_state(i, state);
+    }
+
+    // Writes a value of a plain type (e.g., float, int, bool, or tct_float3) at the position of
+    // the given layout state. Returns false, if the size of T does not match the layout.
+    template <typename T>
+    bool set(mi::neuraylib::Target_value_layout_state state, T const &value)
+    {
+        mi::neuraylib::IValue::Kind kind;
+        mi::Size size = 0;
+        const mi::Size offset = m_layout->get_layout(kind, size, state);
+        if (size != sizeof(T) || offset > m_size || m_size - offset < sizeof(T))
+            return false;
+        write(size_t(offset), reinterpret_cast<char const *>(&value), sizeof(T));
+        return true;
+    }
+
+    // Writes a value of a plain type as i'th argument of the material.
+    template <typename T>
+    bool set_argument(mi::Size i, T const &value)
+    {
+        return set(get_argument_state(i), value);
+    }
+
+    // Writes an MDL value as i'th argument of the material. Strings and resources are mapped to
+    // indices by the resource callback. Returns the result of ITarget_value_layout::set_value().
+    mi::Sint32 set_value(
+        mi::Size i,
+        mi::neuraylib::IValue const *value,
+        mi::neuraylib::ITarget_resource_callback *resource_callback)
+    {
+        const mi::neuraylib::Target_value_layout_state state = get_argument_state(i);
+        mi::neuraylib::IValue::Kind kind;
+        mi::Size size = 0;
+        const mi::Size offset = m_layout->get_layout(kind, size, state);
+        if (offset > m_size || m_size - offset < size)
+            return -2;
+
+        // Let the layout write into a scratch copy of the argument and record only real changes.
+        // The layout only writes the bytes of the argument, so only these are copied.
+        std::vector<char> const &back = m_blocks[back_index()];
+        m_scratch.resize(m_size);
+        memcpy(m_scratch.data() + offset, back.data() + offset, size_t(size));
+        const mi::Sint32 result =
+            m_layout->set_value(m_scratch.data(), value, resource_callback, state);
+        if (result == 0)
+            write(size_t(offset), m_scratch.data() + offset, size_t(size));
+        return result;
+    }
+
+    // Applies the changes of a modified copy of the block, e.g., of a block edited by a user
+    // interface. Returns the number of changed bytes.
+    size_t update_from(char const *data)
+    {
+        std::vector<char> &back = m_blocks[back_index()];
+        size_t changed = 0;
+        size_t i = 0;
+        while (i < m_size) {
+            if (data[i] == back[i]) {
+                ++i;
+                continue;
+            }
+            const size_t begin = i;
+            while (i < m_size && data[i] != back[i])
+                ++i;
+            memcpy(back.data() + begin, data + begin, i - begin);
+            add_span(begin, i - begin);
+            changed += i - begin;
+        }
+        return changed;
+    }
+
+    // Returns the writer's copy of the block including all changes not published yet.
+    char const *get_data() const { return m_blocks[back_index()].data(); }
+
+    // Indicates whether there are changes that have not been published yet.
+    bool has_pending_changes() const { return !m_pending.empty(); }
+
+    // Makes the pending changes available to the reader.
+    //
+    // Returns false if the reader currently holds the front block. The changes stay pending in
+    // this case and should be published again later.
+    bool publish()
+    {
+        if (m_pending.empty())
+            return true;
+        normalize(m_pending);
+
+        unsigned state = m_state.load(std::memory_order_acquire);
+        for (;;) {
+            if (state & READER_BUSY)
+                return false;
+
+            // The spans of the new front block include the spans the reader has not seen yet.
+            const unsigned front = state & FRONT_INDEX;
+            std::vector<Argument_block_span> &spans = m_spans[front ^ 1];
+            spans = m_pending;
+            if (state & FRESH) {
+                spans.insert(spans.end(), m_spans[front].begin(), m_spans[front].end());
+                normalize(spans);
+            }
+            if (m_state.compare_exchange_weak(
+                    state, (front ^ 1) | FRESH,
+                    std::memory_order_acq_rel, std::memory_order_acquire))
+                break;
+        }
+
+        // Bring the new back block up to date. It only differs in the pending spans.
+        std::vector<char> &back = m_blocks[back_index()];
+        std::vector<char> const &front = m_blocks[back_index() ^ 1];
+        for (Argument_block_span const &span : m_pending)
+            memcpy(back.data() + span.offset, front.data() + span.offset, span.size);
+        m_pending.clear();
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Reader side
+    //--------------------------------------------------------------------------
+
+    // Acquires the front block for reading until release() is called.
+    //
+    // Returns the spans that changed since the previous acquire() in spans, which is empty if
+    // nothing was published in between.
+    char const *acquire(std::vector<Argument_block_span> &spans)
+    {
+        unsigned state = m_state.load(std::memory_order_acquire);
+        while (!m_state.compare_exchange_weak(
+                state, (state | READER_BUSY) & ~unsigned(FRESH),
+                std::memory_order_acq_rel, std::memory_order_acquire)) {}
+
+        const unsigned front = state & FRONT_INDEX;
+        if (state & FRESH)
+            spans = m_spans[front];
+        else
+            spans.clear();
+        return m_blocks[front].data();
+    }
+
+    // Releases the front block acquired by acquire().
+    void release()
+    {
+        m_state.fetch_and(~unsigned(READER_BUSY), std::memory_order_release);
+    }
+
+private:
+    enum State_bits
+    {
+        FRONT_INDEX = 1,    // index of the front block
+        READER_BUSY = 2,    // the reader holds the front block
+        FRESH       = 4     // the front block has changes the reader has not acquired yet
+    };
+
+    unsigned back_index() const
+    {
+        // Only the writer changes the front index, so a relaxed load suffices on its side.
+        return (m_state.load(std::memory_order_relaxed) & FRONT_INDEX) ^ 1;
+    }
+
+    // Writes data into the back block and records the bytes that changed.
+    void write(size_t offset, char const *data, size_t size)
+    {
+        char *dst = m_blocks[back_index()].data() + offset;
+        size_t begin = 0;
+        while (begin < size && dst[begin] == data[begin])
+            ++begin;
+        size_t end = size;
+        while (end > begin && dst[end - 1] == data[end - 1])
+            --end;
+        if (begin == end)
+            return;
+        memcpy(dst + begin, data + begin, end - begin);
+        add_span(offset + begin, end - begin);
+    }
+
+    void add_span(size_t offset, size_t size)
+    {
+        if (!m_pending.empty()) {
+            // Consecutive writes often extend the previous span.
+            Argument_block_span &last = m_pending.back();
+            if (offset >= last.offset && offset <= last.offset + last.size + m_merge_gap) {
+                last.size = std::max(last.size, offset + size - last.offset);
+                return;
+            }
+        }
+        Argument_block_span span = { offset, size };
+        m_pending.push_back(span);
+
+        // Keep the list short while changes are not published for a long time.
+        if (m_pending.size() >= 64)
+            normalize(m_pending);
+    }
+
+    // Sorts the spans and merges overlapping spans and spans at most m_merge_gap bytes apart.
+    void normalize(std::vector<Argument_block_span> &spans) const
+    {
+        if (spans.size() < 2)
+            return;
+        std::sort(spans.begin(), spans.end(),
+            [](Argument_block_span const &a, Argument_block_span const &b) {
+                return a.offset < b.offset;
+            });
+        size_t n = 0;
+        for (size_t i = 1; i < spans.size(); ++i) {
+            Argument_block_span &last = spans[n];
+            if (spans[i].offset <= last.offset + last.size + m_merge_gap)
+                last.size = std::max(last.size, spans[i].offset + spans[i].size - last.offset);
+            else
+                spans[++n] = spans[i];
+        }
+        spans.resize(n + 1);
+    }
+
+    mi::base::Handle<mi::neuraylib::ITarget_value_layout const> m_layout;
+    size_t                                                      m_size;
+    size_t                                                      m_merge_gap;
+
+    // The front and back block, and the spans to upload when acquiring the respective block.
+    std::vector<char>                   m_blocks[2];
+    std::vector<Argument_block_span>    m_spans[2];
+
+    // Changes of the back block that have not been published yet (writer only).
+    std::vector<Argument_block_span>    m_pending;
+    std::vector<char>                   m_scratch;
+
+    // Combination of State_bits.
+    std::atomic<unsigned>               m_state;
+};
+
+#endif // EXAMPLE_ARGUMENT_BLOCK_H
@@ -0,0 +1,632 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/example_bake_cache.h
+//
+// Caches baked material expressions on disk, keyed by a hash of the baked sub-expression.
+
+#ifndef EXAMPLE_BAKE_CACHE_H
+#define EXAMPLE_BAKE_CACHE_H
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <mi/mdl_sdk.h>
+
+#ifdef MI_PLATFORM_WINDOWS
+#include <mi/base/miwindows.h>
+#else
+#include <unistd.h>
+#endif
+
+// A cache for baked textures shared by all materials baked by an application, and by
+// subsequent runs of the application.
+//
+// Bakes are keyed by a hash of the baked sub-expression of the compiled material, the pixel
+// type, the resolution, and the number of samples. Materials often share sub-expressions like
+// the same normal map or roughness texture chain, which are then baked only once. The hash
+// covers everything the result depends on: the called definitions and the file of their
+// module, constants, the arguments of referenced parameters, and the files of referenced
+// resources, identified by name, size and modification time. The hashes provided by
+// #mi::neuraylib::ICompiled_material::get_slot_hash() are not sufficient, because they do not
+// include arguments and identify resources by their database IDs only.
+//
+// The cached textures are stored unprocessed, i.e., before any remapping of the values.
+class Bake_cache
+{
+public:
+    // Creates the cache.
+    //
+    // \param image_api     the image API used to create the canvases
+    // \param directory     the directory for the cached bakes, which must exist
+    Bake_cache(mi::neuraylib::IImage_api* image_api, const std::string& directory)
+        : m_image_api(mi::base::make_handle_dup(image_api))
+        , m_directory(directory)
+        , m_hits(0)
+        , m_misses(0)
+    {
+    }
+
+    // Returns the number of bakes that were loaded from the cache.
+    size_t get_hit_count() const { return m_hits; }
+
+    // Returns the number of bakes that were not found in the cache.
+    size_t get_miss_count() const { return m_misses; }
+
+    // Returns the hash of the sub-expression at the given path of a compiled material, or 0 if
+    // the path does not exist.
+    static mi::Uint64 get_expression_hash(
+        mi::neuraylib::ITransaction*             transaction,
+        const mi::neuraylib::ICompiled_material* cm,
+        const char*                              path)
+    {
+        mi::base::Handle<const mi::neuraylib::IExpression> expr(cm->lookup_sub_expression(path));
+        if (!expr)
+            return 0;
+
+        Expression_hasher hasher(transaction, cm);
+        hasher.add_expression(expr.get());
+        return hasher.get_hash();
+    }
+
+    // Bakes a texture, or loads it, if it was baked before for the same expression hash, pixel
+    // type, resolution and samples. Concurrent calls for the same key bake only once.
+    //
+    // \param baker             the baker of the expression
+    // \param expression_hash   the hash of the expression, see #get_expression_hash()
+    // \param pixel_type        the pixel type of the canvas
+    // \param width             the width of the canvas
+    // \param height            the height of the canvas
+    // \param samples           the number of samples per texel
+    // \param result            receives the result of #mi::neuraylib::IBaker::bake_texture()
+    // \return                  the baked canvas, or \c NULL in case of failure
+    mi::neuraylib::ICanvas* bake_texture(
+        const mi::neuraylib::IBaker* baker,
+        mi::Uint64                   expression_hash,
+        const char*                  pixel_type,
+        mi::Uint32                   width,
+        mi::Uint32                   height,
+        mi::Uint32                   samples,
+        mi::Sint32*                  result = nullptr)
+    {
+        mi::Sint32 dummy_result;
+        if (!result)
+            result = &dummy_result;
+        *result = 0;
+
+        // Without a hash, the expression cannot be identified.
+        if (expression_hash == 0)
+            return bake(baker, pixel_type, width, height, samples, result);
+
+        Hash key;
+        key.add(&expression_hash, sizeof(expression_hash));
+        key.add(pixel_type);
+        key.add(&width, sizeof(width));
+        key.add(&height, sizeof(height));
+        key.add(&samples, sizeof(samples));
+        const std::string file_name = get_file_name(key.get());
+
+        // Most lookups find an existing entry, e.g., when many materials share a texture, so
+        // they only take the lock shared and do not serialize the baking threads.
+        std::shared_ptr<Entry> entry;
+        {
+            mi::base::Shared_lock::Shared_block block(&m_entries_lock);
+            std::map<mi::Uint64, std::shared_ptr<Entry> >::const_iterator it =
+                m_entries.find(key.get());
+            if (it != m_entries.end())
+                entry = it->second;
+        }
+        if (!entry) {
+            mi::base::Shared_lock::Block block(&m_entries_lock);
+            std::shared_ptr<Entry>& e = m_entries[key.get()];
+            if (!e)
+                e.reset(new Entry());
+            entry = e;
+        }
+
+        // The first call for a key loads or bakes the texture and stores it, other calls wait
+        // and load the stored file afterwards.
+        mi::base::Handle<mi::neuraylib::ICanvas> canvas;
+        std::call_once(entry->once, [&]() {
+            canvas = load(file_name, pixel_type, width, height);
+            if (canvas) {
+                ++m_hits;
+                return;
+            }
+            ++m_misses;
+            canvas = bake(baker, pixel_type, width, height, samples, &entry->result);
+            if (canvas)
+                store(file_name, canvas.get());
+        });
+
+        if (!canvas) {
+            if (entry->result != 0) {
+                *result = entry->result;
+                return nullptr;
+            }
+            canvas = load(file_name, pixel_type, width, height);
+            if (canvas)
+                ++m_hits;
+            else
+                // The file could not be stored, bake without the cache.
+                canvas = bake(baker, pixel_type, width, height, samples, result);
+        }
+        if (canvas)
+            canvas->retain();
+        return canvas.get();
+    }
+
+private:
+    // 64-bit FNV-1a hash.
+    class Hash
+    {
+    public:
+        Hash() : m_value(0xcbf29ce484222325ull) {}
+
+        void add(const void* data, size_t size)
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; ++i) {
+                m_value ^= bytes[i];
+                m_value *= 0x100000001b3ull;
+            }
+        }
+
+        // Adds a string including the terminating zero, which separates it from the data
+        // that follows.
+        void add(const char* s)
+        {
+            if (!s)
+                s = "";
+            add(s, strlen(s) + 1);
+        }
+
+        void add(mi::Uint64 value) { add(&value, sizeof(value)); }
+
+        mi::Uint64 get() const { return m_value; }
+
+    private:
+        mi::Uint64 m_value;
+    };
+
+    // Computes the hash of an expression of a compiled material.
+    class Expression_hasher
+    {
+    public:
+        Expression_hasher(
+            mi::neuraylib::ITransaction*             transaction,
+            const mi::neuraylib::ICompiled_material* cm)
+            : m_transaction(transaction)
+            , m_cm(cm)
+        {
+        }
+
+        mi::Uint64 get_hash() const { return m_hash.get(); }
+
+        void add_expression(const mi::neuraylib::IExpression* expr)
+        {
+            const mi::neuraylib::IExpression::Kind kind = expr->get_kind();
+            m_hash.add(static_cast<mi::Uint64>(kind));
+
+            switch (kind) {
+            case mi::neuraylib::IExpression::EK_CONSTANT:
+            {
+                mi::base::Handle<const mi::neuraylib::IExpression_constant> constant(
+                    expr->get_interface<mi::neuraylib::IExpression_constant>());
+                mi::base::Handle<const mi::neuraylib::IValue> value(constant->get_value());
+                add_value(value.get());
+                break;
+            }
+            case mi::neuraylib::IExpression::EK_PARAMETER:
+            {
+                mi::base::Handle<const mi::neuraylib::IExpression_parameter> parameter(
+                    expr->get_interface<mi::neuraylib::IExpression_parameter>());
+                mi::base::Handle<const mi::neuraylib::IValue> value(
+                    m_cm->get_argument(parameter->get_index()));
+                if (value)
+                    add_value(value.get());
+                break;
+            }
+            case mi::neuraylib::IExpression::EK_TEMPORARY:
+            {
+                // Temporaries are shared sub-expressions. They are expanded at their first
+                // occurrence and referenced by the order of their first occurrence afterwards,
+                // which does not depend on the numbering of the temporaries in the material.
+                mi::base::Handle<const mi::neuraylib::IExpression_temporary> temporary(
+                    expr->get_interface<mi::neuraylib::IExpression_temporary>());
+                const mi::Size index = temporary->get_index();
+
+                std::map<mi::Size, mi::Uint64>::const_iterator it = m_temporaries.find(index);
+                if (it != m_temporaries.end()) {
+                    m_hash.add(it->second);
+                    break;
+                }
+                const mi::Uint64 ordinal = m_temporaries.size();
+                m_temporaries[index] = ordinal;
+                m_hash.add(ordinal);
+
+                mi::base::Handle<const mi::neuraylib::IExpression> body(
+                    m_cm->get_temporary(index));
+                if (body)
+                    add_expression(body.get());
+                break;
+            }
+            case mi::neuraylib::IExpression::EK_DIRECT_CALL:
+            {
+                mi::base::Handle<const mi::neuraylib::IExpression_direct_call> call(
+                    expr->get_interface<mi::neuraylib::IExpression_direct_call>());
+                add_definition(call->get_definition());
+
+                mi::base::Handle<const mi::neuraylib::IExpression_list> arguments(
+                    call->get_arguments());
+                const mi::Size n = arguments->get_size();
+                m_hash.add(static_cast<mi::Uint64>(n));
+                for (mi::Size i = 0; i < n; ++i) {
+                    m_hash.add(arguments->get_name(i));
+                    mi::base::Handle<const mi::neuraylib::IExpression> argument(
+                        arguments->get_expression(i));
+                    add_expression(argument.get());
+                }
+                break;
+            }
+            case mi::neuraylib::IExpression::EK_CALL:
+            {
+                // Does not occur in compiled materials.
+                mi::base::Handle<const mi::neuraylib::IExpression_call> call(
+                    expr->get_interface<mi::neuraylib::IExpression_call>());
+                m_hash.add(call->get_call());
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+    private:
+        void add_value(const mi::neuraylib::IValue* value)
+        {
+            const mi::neuraylib::IValue::Kind kind = value->get_kind();
+            m_hash.add(static_cast<mi::Uint64>(kind));
+
+            switch (kind) {
+            case mi::neuraylib::IValue::VK_BOOL:
+            {
+                mi::base::Handle<const mi::neuraylib::IValue_bool> v(
+                    value->get_interface<mi::neuraylib::IValue_bool>());
+                const bool b = v->get_value();
+                m_hash.add(&b, sizeof(b));
+                break;
+            }
+            case mi::neuraylib::IValue::VK_INT:
+            {
+                mi::base::Handle<const mi::neuraylib::IValue_int> v(
+                    value->get_interface<mi::neuraylib::IValue_int>());
+                const mi::Sint32 i = v->get_value();
+                m_hash.add(&i, sizeof(i));
+                break;
+            }
+            case mi::neuraylib::IValue::VK_ENUM:
+            {
+                mi::base::Handle<const mi::neuraylib::IValue_enum> v(
+                    value->get_interface<mi::neuraylib::IValue_enum>());
+                const mi::Sint32 i = v->get_value();
+                m_hash.add(&i, sizeof(i));
+                break;
+            }
+            case mi::neuraylib::IValue::VK_FLOAT:
+            {
+                mi::base::Handle<const mi::neuraylib::IValue_float> v(
+                    value->get_interface<mi::neuraylib::IValue_float>());
+                const mi::Float32 f = v->get_value();
+                m_hash.add(&f, sizeof(f));
+                break;
+            }
+            case mi::neuraylib::IValue::VK_DOUBLE:
+            {
+                mi::base::Handle<const mi::neuraylib::IValue_double> v(
+                    value->get_interface<mi::neuraylib::IValue_double>());
+                const mi::Float64 d = v->get_value();
+                m_hash.add(&d, sizeof(d));
+                break;
+            }
+            case mi::neuraylib::IValue::VK_STRING:
+            {
+                mi::base::Handle<const mi::neuraylib::IValue_string> v(
+                    value->get_interface<mi::neuraylib::IValue_string>());
+                m_hash.add(v->get_value());
+                break;
+            }
+            case mi::neuraylib::IValue::VK_VECTOR:
+            case mi::neuraylib::IValue::VK_MATRIX:
+            case mi::neuraylib::IValue::VK_COLOR:
+            case mi::neuraylib::IValue::VK_ARRAY:
+            case mi::neuraylib::IValue::VK_STRUCT:
+            {
+                mi::base::Handle<const mi::neuraylib::IValue_compound> v(
+                    value->get_interface<mi::neuraylib::IValue_compound>());
+                const mi::Size n = v->get_size();
+                m_hash.add(static_cast<mi::Uint64>(n));
+                for (mi::Size i = 0; i < n; ++i) {
+                    mi::base::Handle<const mi::neuraylib::IValue> element(v->get_value(i));
+                    add_value(element.get());
+                }
+                break;
+            }
+            case mi::neuraylib::IValue::VK_TEXTURE:
+            case mi::neuraylib::IValue::VK_LIGHT_PROFILE:
+            case mi::neuraylib::IValue::VK_BSDF_MEASUREMENT:
+            {
+                mi::base::Handle<const mi::neuraylib::IValue_resource> v(
+                    value->get_interface<mi::neuraylib::IValue_resource>());
+                m_hash.add(v->get_file_path());
+                add_resource(kind, v->get_value());
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        // Adds the files backing a resource. Resources without files, e.g., those created in
+        // memory, are identified by their database name.
+        void add_resource(mi::neuraylib::IValue::Kind kind, const char* db_name)
+        {
+            if (!db_name)
+                return;
+
+            bool has_file = false;
+            if (kind == mi::neuraylib::IValue::VK_TEXTURE) {
+                mi::base::Handle<const mi::neuraylib::ITexture> texture(
+                    m_transaction->access<mi::neuraylib::ITexture>(db_name));
+                if (texture) {
+                    const mi::Float32 gamma = texture->get_gamma();
+                    m_hash.add(&gamma, sizeof(gamma));
+
+                    mi::base::Handle<const mi::neuraylib::IImage> image(
+                        m_transaction->access<mi::neuraylib::IImage>(texture->get_image()));
+                    if (image) {
+                        const mi::Size n = image->get_uvtile_length();
+                        for (mi::Size i = 0; i < n; ++i)
+                            has_file |= add_file(image->get_filename(static_cast<mi::Uint32>(i)));
+                    }
+                }
+            }
+            else if (kind == mi::neuraylib::IValue::VK_LIGHT_PROFILE) {
+                mi::base::Handle<const mi::neuraylib::ILightprofile> light_profile(
+                    m_transaction->access<mi::neuraylib::ILightprofile>(db_name));
+                if (light_profile)
+                    has_file = add_file(light_profile->get_filename());
+            }
+            else {
+                mi::base::Handle<const mi::neuraylib::IBsdf_measurement> bsdf_measurement(
+                    m_transaction->access<mi::neuraylib::IBsdf_measurement>(db_name));
+                if (bsdf_measurement)
+                    has_file = add_file(bsdf_measurement->get_filename());
+            }
+
+            if (!has_file)
+                m_hash.add(db_name);
+        }
+
+        // Adds a called definition and the file of its module, which covers the
+        // implementation of the definition.
+        void add_definition(const char* definition_db_name)
+        {
+            m_hash.add(definition_db_name);
+
+            mi::base::Handle<const mi::neuraylib::IFunction_definition> definition(
+                m_transaction->access<mi::neuraylib::IFunction_definition>(
+                    definition_db_name));
+            if (!definition)
+                return;
+
+            const char* module_db_name = definition->get_module();
+            if (!module_db_name || !m_modules.insert(module_db_name).second)
+                return;
+
+            mi::base::Handle<const mi::neuraylib::IModule> module(
+                m_transaction->access<mi::neuraylib::IModule>(module_db_name));
+            if (module)
+                add_file(module->get_filename());
+        }
+
+        // Adds the name, size, and modification time of a file. Files inside MDL archives,
+        // e.g., "/path/archive.mdr:pkg/image.png", are identified by the size and modification
+        // time of the archive. Returns false, if the file does not exist.
+        bool add_file(const char* filename)
+        {
+            if (!filename)
+                return false;
+
+            struct stat info;
+            if (stat(filename, &info) != 0) {
+                const char* archive_end = strstr(filename, ".mdr:");
+                if (!archive_end)
+                    return false;
+                const std::string archive(filename, archive_end + 4);
+                if (stat(archive.c_str(), &info) != 0)
+                    return false;
+            }
+
+            m_hash.add(filename);
+            m_hash.add(static_cast<mi::Uint64>(info.st_size));
+            m_hash.add(static_cast<mi::Uint64>(info.st_mtime));
+            return true;
+        }
+
+        mi::neuraylib::ITransaction*             m_transaction;
+        const mi::neuraylib::ICompiled_material* m_cm;
+        Hash                                     m_hash;
+        std::map<mi::Size, mi::Uint64>           m_temporaries;  // index to first occurrence
+        std::set<std::string>                    m_modules;      // modules already added
+    };
+
+    // The state of a key in this run of the application.
+    struct Entry
+    {
+        std::once_flag once;
+        mi::Sint32     result;  // the result of the bake, if it failed
+
+        Entry() : result(0) {}
+    };
+
+    // Header of a cached bake, followed by the pixel type and the pixel data.
+    struct File_header
+    {
+        char       magic[8];
+        mi::Uint32 version;
+        mi::Uint32 width;
+        mi::Uint32 height;
+        mi::Uint32 pixel_type_length;
+    };
+
+    static const char* get_magic() { return "MDLBAKE"; }
+
+    static const mi::Uint32 s_version = 1;
+
+    std::string get_file_name(mi::Uint64 key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bake", static_cast<unsigned long long>(key));
+        return m_directory + "/" + name;
+    }
+
+    size_t get_data_size(const char* pixel_type, mi::Uint32 width, mi::Uint32 height) const
+    {
+        return size_t(width) * height
+            * m_image_api->get_components_per_pixel(pixel_type)
+            * m_image_api->get_bytes_per_component(pixel_type);
+    }
+
+    mi::neuraylib::ICanvas* bake(
+        const mi::neuraylib::IBaker* baker,
+        const char*                  pixel_type,
+        mi::Uint32                   width,
+        mi::Uint32                   height,
+        mi::Uint32                   samples,
+        mi::Sint32*                  result) const
+    {
+        mi::base::Handle<mi::neuraylib::ICanvas> canvas(
+            m_image_api->create_canvas(pixel_type, width, height));
+        *result = baker->bake_texture(canvas.get(), samples);
+        if (*result != 0)
+            return nullptr;
+
+        canvas->retain();
+        return canvas.get();
+    }
+
+    // Loads a cached bake, returns \c NULL if the file does not exist or does not match.
+    mi::neuraylib::ICanvas* load(
+        const std::string& file_name,
+        const char*        pixel_type,
+        mi::Uint32         width,
+        mi::Uint32         height) const
+    {
+        std::ifstream file(file_name.c_str(), std::ios::binary);
+        if (!file)
+            return nullptr;
+
+        File_header header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || memcmp(header.magic, get_magic(), sizeof(header.magic)) != 0
+            || header.version != s_version
+            || header.width != width
+            || header.height != height
+            || header.pixel_type_length != strlen(pixel_type))
+            return nullptr;
+
+        std::string stored_pixel_type(header.pixel_type_length, '\0');
+        if (!file.read(&stored_pixel_type[0], header.pixel_type_length)
+            || stored_pixel_type != pixel_type)
+            return nullptr;
+
+        mi::base::Handle<mi::neuraylib::ICanvas> canvas(
+            m_image_api->create_canvas(pixel_type, width, height));
+        mi::base::Handle<mi::neuraylib::ITile> tile(canvas->get_tile(0, 0));
+        const size_t size = get_data_size(pixel_type, width, height);
+        if (!file.read(static_cast<char*>(tile->get_data()), size)
+            || file.peek() != std::char_traits<char>::eof())
+            return nullptr;
+
+        canvas->retain();
+        return canvas.get();
+    }
+
+    // Stores a bake. The file is written under a temporary name first, so readers never see
+    // a partially written file.
+    void store(const std::string& file_name, const mi::neuraylib::ICanvas* canvas) const
+    {
+        const char* pixel_type = canvas->get_type();
+
+        File_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, get_magic(), sizeof(header.magic));
+        header.version = s_version;
+        header.width = canvas->get_resolution_x();
+        header.height = canvas->get_resolution_y();
+        header.pixel_type_length = static_cast<mi::Uint32>(strlen(pixel_type));
+
+        mi::base::Handle<const mi::neuraylib::ITile> tile(canvas->get_tile(0, 0));
+        const size_t size = get_data_size(pixel_type, header.width, header.height);
+
+        // The temporary name is unique, so concurrent stores of the same bake by other
+        // threads or processes do not write into the same file.
+        static std::atomic<unsigned> s_counter(0);
+        std::stringstream temp_stream;
+        temp_stream << file_name << ".tmp" << get_process_id() << "_" << s_counter++;
+        const std::string temp_name = temp_stream.str();
+        {
+            std::ofstream file(temp_name.c_str(), std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(pixel_type, header.pixel_type_length);
+            file.write(static_cast<const char*>(tile->get_data()), size);
+            if (!file) {
+                file.close();
+                remove(temp_name.c_str());
+                return;
+            }
+        }
+
+        // Renaming fails on some platforms if the file exists, e.g., because another
+        // process stored the same bake in the meantime.
+        if (rename(temp_name.c_str(), file_name.c_str()) != 0) {
+            remove(file_name.c_str());
+            if (rename(temp_name.c_str(), file_name.c_str()) != 0)
+                remove(temp_name.c_str());
+        }
+    }
+
+    static unsigned long get_process_id()
+    {
+#ifdef MI_PLATFORM_WINDOWS
+        return static_cast<unsigned long>(GetCurrentProcessId());
+#else
+        return static_cast<unsigned long>(getpid());
+#endif
+    }
+
+    mi::base::Handle<mi::neuraylib::IImage_api>   m_image_api;
+    std::string                                   m_directory;
+
+    mi::base::Shared_lock                         m_entries_lock;
+    std::map<mi::Uint64, std::shared_ptr<Entry> > m_entries;
+
+    std::atomic<size_t>                           m_hits;
+    std::atomic<size_t>                           m_misses;
+};
+
+#endif // EXAMPLE_BAKE_CACHE_H
@@ -7,6 +7,7 @@
 #ifndef EXAMPLE_CUDA_SHARED_H
 #define EXAMPLE_CUDA_SHARED_H
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -17,7 +18,9 @@
 
 #include <mi/mdl_sdk.h>
 
+#include "example_argument_block.h"
 #include "example_shared.h"
+#include "example_target_code_cache.h"
 
 #include <cuda.h>
 #ifdef OPENGL_INTEROP
@@ -400,7 +403,7 @@ public:
     bool prepare_target_code_data(
         mi::neuraylib::ITransaction          *transaction,
         mi::neuraylib::IImage_api            *image_api,
-        mi::neuraylib::ITarget_code const    *target_code,
+        Target_code_snapshot const           &target_code,
         std::vector<size_t> const            &arg_block_indices);
 
     // Get a device pointer to the target code data list.
@@ -432,15 +435,16 @@ public:
         return m_bsdf_arg_block_indices[i];
     }
 
-    // Get a writable copy of the i'th target argument block.
-    mi::base::Handle<mi::neuraylib::ITarget_argument_block> get_argument_block(size_t i)
+    // Get the data of a writable copy of the i'th target argument block.
+    char *get_argument_block_data(size_t i)
     {
-        if (i >= m_own_arg_blocks.size())
-            return mi::base::Handle<mi::neuraylib::ITarget_argument_block>();
-        return m_own_arg_blocks[i];
+        if (i >= m_own_arg_blocks.size() || m_own_arg_blocks[i].empty())
+            return nullptr;
+        return m_own_arg_blocks[i].data();
     }
 
     // Get the layout of the i'th target argument block.
+    // The layout is invalid if the target code was restored from a target code cache.
     mi::base::Handle<mi::neuraylib::ITarget_value_layout const> get_argument_block_layout(size_t i)
     {
         if (i >= m_arg_block_layouts.size())
@@ -449,7 +453,7 @@ public:
     }
 
     // Update the i'th target argument block on the device with the data from the corresponding
-    // block returned by get_argument_block().
+    // block returned by get_argument_block_data().
     void update_device_argument_block(size_t i);
 private:
     // Copy the image data of a canvas to a CUDA array.
@@ -460,7 +464,7 @@ private:
     bool prepare_texture(
         mi::neuraylib::ITransaction       *transaction,
         mi::neuraylib::IImage_api         *image_api,
-        mi::neuraylib::ITarget_code const *code_ptx,
+        Target_code_snapshot const        &code_ptx,
         mi::Size                           texture_index,
         std::vector<Texture>              &textures);
 
@@ -468,7 +472,7 @@ private:
     // functions on the GPU.
     bool prepare_mbsdf(
         mi::neuraylib::ITransaction       *transaction,
-        mi::neuraylib::ITarget_code const *code_ptx,
+        Target_code_snapshot const        &code_ptx,
         mi::Size                           mbsdf_index,
         std::vector<Mbsdf>                &mbsdfs);
 
@@ -476,7 +480,7 @@ private:
     // functions on the GPU.
     bool prepare_lightprofile(
         mi::neuraylib::ITransaction       *transaction,
-        mi::neuraylib::ITarget_code const *code_ptx,
+        Target_code_snapshot const        &code_ptx,
         mi::Size                           lightprofile_index,
         std::vector<Lightprofile>        &lightprofiles);
 
@@ -496,7 +500,7 @@ private:
     Resource_container<CUdeviceptr> m_target_argument_block_list;
 
     // List of all local, writable copies of the target argument blocks.
-    std::vector<mi::base::Handle<mi::neuraylib::ITarget_argument_block> > m_own_arg_blocks;
+    std::vector<std::vector<char> > m_own_arg_blocks;
 
     // List of argument block indices per material BSDF.
     std::vector<size_t> m_bsdf_arg_block_indices;
@@ -504,6 +508,9 @@ private:
     // List of all target argument block layouts.
     std::vector<mi::base::Handle<mi::neuraylib::ITarget_value_layout const> > m_arg_block_layouts;
 
+    // List of managers tracking the changes of the local argument blocks since the last upload.
+    std::vector<std::unique_ptr<Argument_block_manager> > m_arg_block_managers;
+
     // List of all Texture objects owned by this context.
     Resource_container<Texture> m_all_textures;
 
@@ -557,13 +564,14 @@ void Material_gpu_context::copy_canvas_to_cuda_array(
 bool Material_gpu_context::prepare_texture(
     mi::neuraylib::ITransaction       *transaction,
     mi::neuraylib::IImage_api         *image_api,
-    mi::neuraylib::ITarget_code const *code_ptx,
+    Target_code_snapshot const        &code_ptx,
     mi::Size                           texture_index,
     std::vector<Texture>              &textures)
 {
     // Get access to the texture data by the texture database name from the target code.
     mi::base::Handle<const mi::neuraylib::ITexture> texture(
-        transaction->access<mi::neuraylib::ITexture>(code_ptx->get_texture(texture_index)));
+        transaction->access<mi::neuraylib::ITexture>(
+            code_ptx.textures[texture_index].db_name.c_str()));
     mi::base::Handle<const mi::neuraylib::IImage> image(
         transaction->access<mi::neuraylib::IImage>(texture->get_image()));
     mi::base::Handle<const mi::neuraylib::ICanvas> canvas(image->get_canvas());
@@ -604,7 +612,7 @@ bool Material_gpu_context::prepare_texture(
 
     // Copy image data to GPU array depending on texture shape
     mi::neuraylib::ITarget_code::Texture_shape texture_shape =
-        code_ptx->get_texture_shape(texture_index);
+        code_ptx.textures[texture_index].shape;
     if (texture_shape == mi::neuraylib::ITarget_code::Texture_shape_cube ||
         texture_shape == mi::neuraylib::ITarget_code::Texture_shape_3d) {
         // Cubemap and 3D texture objects require 3D CUDA arrays
@@ -963,14 +971,14 @@ namespace
 
 bool Material_gpu_context::prepare_mbsdf(
     mi::neuraylib::ITransaction       *transaction,
-    mi::neuraylib::ITarget_code const *code_ptx,
+    Target_code_snapshot const        &code_ptx,
     mi::Size                           mbsdf_index,
     std::vector<Mbsdf>                &mbsdfs)
 {
     // Get access to the texture data by the texture database name from the target code.
     mi::base::Handle<const mi::neuraylib::IBsdf_measurement> mbsdf(
         transaction->access<mi::neuraylib::IBsdf_measurement>(
-        code_ptx->get_bsdf_measurement(mbsdf_index)));
+        code_ptx.bsdf_measurements[mbsdf_index].c_str()));
 
     Mbsdf mbsdf_cuda;
 
@@ -987,7 +995,7 @@ bool Material_gpu_context::prepare_mbsdf(
 
 bool Material_gpu_context::prepare_lightprofile(
     mi::neuraylib::ITransaction       *transaction,
-    mi::neuraylib::ITarget_code const *code_ptx,
+    Target_code_snapshot const        &code_ptx,
     mi::Size                           lightprofile_index,
     std::vector<Lightprofile>         &lightprofiles)
 {
@@ -995,7 +1003,7 @@ bool Material_gpu_context::prepare_lightprofile(
     // Get access to the texture data by the texture database name from the target code.
     mi::base::Handle<const mi::neuraylib::ILightprofile> lprof_nr(
         transaction->access<mi::neuraylib::ILightprofile>(
-        code_ptx->get_light_profile(lightprofile_index)));
+        code_ptx.light_profiles[lightprofile_index].c_str()));
 
     uint2 res = make_uint2(lprof_nr->get_resolution_theta(), lprof_nr->get_resolution_phi());
     float2 start = make_float2(lprof_nr->get_theta(0), lprof_nr->get_phi(0));
@@ -1122,7 +1130,7 @@ bool Material_gpu_context::prepare_lightprofile(
 bool Material_gpu_context::prepare_target_code_data(
     mi::neuraylib::ITransaction          *transaction,
     mi::neuraylib::IImage_api            *image_api,
-    mi::neuraylib::ITarget_code const    *target_code,
+    Target_code_snapshot const           &target_code,
     std::vector<size_t> const            &arg_block_indices)
 {
     // Target code data list may not have been retrieved already
@@ -1131,15 +1139,15 @@ bool Material_gpu_context::prepare_target_code_data(
     // Handle the read-only data segments if necessary.
     // They are only created, if the "enable_ro_segment" backend option was set to "on".
     CUdeviceptr device_ro_data = 0;
-    if (target_code->get_ro_data_segment_count() > 0) {
+    if (!target_code.ro_data_segments.empty()) {
         device_ro_data = gpu_mem_dup(
-            target_code->get_ro_data_segment_data(0),
-            target_code->get_ro_data_segment_size(0));
+            target_code.ro_data_segments[0].data.data(),
+            target_code.ro_data_segments[0].data.size());
     }
 
     // Copy textures to GPU if the code has more than just the invalid texture
     CUdeviceptr device_textures = 0;
-    mi::Size num_textures = target_code->get_texture_count();
+    mi::Size num_textures = target_code.textures.size();
     if (num_textures > 1) {
         std::vector<Texture> textures;
 
@@ -1157,7 +1165,7 @@ bool Material_gpu_context::prepare_target_code_data(
 
     // Copy MBSDFs to GPU if the code has more than just the invalid mbsdf
     CUdeviceptr device_mbsdfs = 0;
-    mi::Size num_mbsdfs = target_code->get_bsdf_measurement_count();
+    mi::Size num_mbsdfs = target_code.bsdf_measurements.size();
     if (num_mbsdfs > 1) {
         std::vector<Mbsdf> mbsdfs;
 
@@ -1175,7 +1183,7 @@ bool Material_gpu_context::prepare_target_code_data(
 
     // Copy light profiles to GPU if the code has more than just the invalid light profile
     CUdeviceptr device_lightprofiles = 0;
-    mi::Size num_lightprofiles = target_code->get_light_profile_count();
+    mi::Size num_lightprofiles = target_code.light_profiles.size();
     if (num_lightprofiles > 1) {
         std::vector<Lightprofile> lightprofiles;
 
@@ -1197,14 +1205,14 @@ bool Material_gpu_context::prepare_target_code_data(
                          num_lightprofiles, device_lightprofiles,
                          device_ro_data));
 
-    for (mi::Size i = 0, num = target_code->get_argument_block_count(); i < num; ++i) {
-        mi::base::Handle<mi::neuraylib::ITarget_argument_block const> arg_block(
-            target_code->get_argument_block(i));
-        CUdeviceptr dev_block = gpu_mem_dup(arg_block->get_data(), arg_block->get_size());
+    for (size_t i = 0, num = target_code.argument_blocks.size(); i < num; ++i) {
+        std::vector<char> const &arg_block = target_code.argument_blocks[i];
+        CUdeviceptr dev_block = gpu_mem_dup(arg_block.data(), arg_block.size());
         m_target_argument_block_list->push_back(dev_block);
-        m_own_arg_blocks.push_back(mi::base::make_handle(arg_block->clone()));
-        m_arg_block_layouts.push_back(
-            mi::base::make_handle(target_code->get_argument_block_layout(i)));
+        m_own_arg_blocks.push_back(arg_block);
+        m_arg_block_layouts.push_back(target_code.argument_block_layouts[i]);
+        m_arg_block_managers.emplace_back(new Argument_block_manager(
+            m_arg_block_layouts.back().get(), arg_block.data(), arg_block.size()));
     }
 
     for (size_t arg_block_index : arg_block_indices) {
@@ -1215,15 +1223,23 @@ bool Material_gpu_context::prepare_target_code_data(
 }
 
 // Update the i'th target argument block on the device with the data from the corresponding
-// block returned by get_argument_block().
+// block returned by get_argument_block_data().
 void Material_gpu_context::update_device_argument_block(size_t i)
 {
     CUdeviceptr device_ptr = get_device_target_argument_block(i);
     if (device_ptr == 0) return;
 
-    mi::base::Handle<mi::neuraylib::ITarget_argument_block> arg_block(get_argument_block(i));
-    check_cuda_success(cuMemcpyHtoD(
-        device_ptr, arg_block->get_data(), arg_block->get_size()));
+    // Only copy the byte ranges which changed since the last update.
+    Argument_block_manager &manager = *m_arg_block_managers[i];
+    manager.update_from(get_argument_block_data(i));
+    if (!manager.publish()) return;
+
+    std::vector<Argument_block_span> spans;
+    char const *data = manager.acquire(spans);
+    for (Argument_block_span const &span : spans)
+        check_cuda_success(cuMemcpyHtoD(
+            device_ptr + span.offset, data + span.offset, span.size));
+    manager.release();
 }
 
 
@@ -1294,8 +1310,26 @@ public:
         mi::Size description_count,
         bool class_compilation = false);
 
+    // Add (multiple) MDL distribution function and expressions of an already compiled material
+    // to this link unit, for example one compiled by a Material_compile_pipeline.
+    // The function descriptions are handled like in add_material().
+    bool add_compiled_material(
+        const mi::neuraylib::IMaterial_definition* material_definition,
+        const mi::neuraylib::ICompiled_material* compiled_material,
+        mi::neuraylib::Target_function_description* function_descriptions,
+        mi::Size description_count,
+        bool class_compilation = false);
+
     // Generates CUDA PTX target code for the current link unit.
-    mi::base::Handle<const mi::neuraylib::ITarget_code> generate_cuda_ptx();
+    // If a target code cache is set, the code is taken from the cache if possible.
+    Target_code_snapshot generate_cuda_ptx();
+
+    // Sets a target code cache used by generate_cuda_ptx(), or nullptr to disable caching.
+    // The cache must outlive this object.
+    void set_target_code_cache(Target_code_cache *cache)
+    {
+        m_target_code_cache = cache;
+    }
 
     typedef std::vector<mi::base::Handle<mi::neuraylib::IMaterial_definition const> >
         Material_definition_list;
@@ -1332,10 +1366,21 @@ private:
         mi::neuraylib::IMaterial_instance* material_instance,
         bool class_compilation);
 
+    // Sets a backend option and records it in the target code cache key.
+    void set_backend_option(const char* name, const char* value);
+
+    // Adds the selected functions of a compiled material to the link unit.
+    bool link_material(
+        const mi::neuraylib::ICompiled_material* compiled_material,
+        mi::neuraylib::Target_function_description* function_descriptions,
+        mi::Size description_count,
+        bool class_compilation);
+
 private:
     mi::base::Handle<mi::neuraylib::IMdl_compiler> m_mdl_compiler;
     mi::base::Handle<mi::neuraylib::IMdl_backend>  m_be_cuda_ptx;
     mi::base::Handle<mi::neuraylib::ITransaction>  m_transaction;
+    mi::base::Handle<mi::neuraylib::IValue_factory> m_value_factory;
 
     mi::base::Handle<mi::neuraylib::IMdl_execution_context> m_context;
     mi::base::Handle<mi::neuraylib::ILink_unit>             m_link_unit;
@@ -1343,6 +1388,9 @@ private:
     Material_definition_list  m_material_defs;
     Compiled_material_list    m_compiled_materials;
     std::vector<size_t>       m_arg_block_indexes;
+
+    Target_code_cache        *m_target_code_cache;
+    Target_code_cache_key     m_target_code_key;
 };
 
 // Constructor.
@@ -1359,10 +1407,14 @@ Material_compiler::Material_compiler(
     : m_mdl_compiler(mi::base::make_handle_dup(mdl_compiler))
     , m_be_cuda_ptx(mdl_compiler->get_backend(mi::neuraylib::IMdl_compiler::MB_CUDA_PTX))
     , m_transaction(mi::base::make_handle_dup(transaction))
+    , m_value_factory(mdl_factory->create_value_factory(transaction))
     , m_context(mdl_factory->create_execution_context())
     , m_link_unit()
+    , m_target_code_cache(nullptr)
 {
-    check_success(m_be_cuda_ptx->set_option("num_texture_spaces", "1") == 0);
+    m_target_code_key.add(mi::Uint64(mi::neuraylib::IMdl_compiler::MB_CUDA_PTX));
+
+    set_backend_option("num_texture_spaces", "1");
 
     // Option "enable_ro_segment": Default is disabled.
     // If you have a lot of big arrays, enabling this might speed up compilation.
@@ -1371,26 +1423,24 @@ Material_compiler::Material_compiler(
     if (enable_derivatives) {
         // Option "texture_runtime_with_derivs": Default is disabled.
         // We enable it to get coordinates with derivatives for texture lookup functions.
-        check_success(m_be_cuda_ptx->set_option("texture_runtime_with_derivs", "on") == 0);
+        set_backend_option("texture_runtime_with_derivs", "on");
     }
 
     // Option "tex_lookup_call_mode": Default mode is vtable mode.
     // You can switch to the slower vtable mode by commenting out the next line.
-    check_success(m_be_cuda_ptx->set_option("tex_lookup_call_mode", "direct_call") == 0);
+    set_backend_option("tex_lookup_call_mode", "direct_call");
 
     // Option "num_texture_results": Default is 0.
     // Set the size of a renderer provided array for texture results in the MDL SDK state in number
     // of float4 elements processed by the init() function.
-    check_success(m_be_cuda_ptx->set_option(
-        "num_texture_results",
-        to_string(num_texture_results).c_str()) == 0);
+    set_backend_option("num_texture_results", to_string(num_texture_results).c_str());
 
 #if !defined(MDL_SOURCE_RELEASE) && defined(MDL_ENABLE_INTERPRETER)
     // Option "enable_df_interpreter": Default is disabled.
     // Using the interpreter allows to reuse the same code for multiple materials
     // reducing code divergence, if your scene shows many materials at the same time.
     if (use_df_interpreter) {
-        check_success(m_be_cuda_ptx->set_option("enable_df_interpreter", "on") == 0);
+        set_backend_option("enable_df_interpreter", "on");
     }
 #endif
 
@@ -1398,11 +1448,20 @@ Material_compiler::Material_compiler(
     m_context->set_option("experimental", true);
 
     m_context->set_option("fold_ternary_on_df", fold_ternary_on_df);
+    m_target_code_key.add_option("experimental", "true");
+    m_target_code_key.add_option("fold_ternary_on_df", fold_ternary_on_df ? "true" : "false");
 
     // After we set the options, we can create the link unit
     m_link_unit = mi::base::make_handle(m_be_cuda_ptx->create_link_unit(transaction, m_context.get()));
 }
 
+// Sets a backend option and records it in the target code cache key.
+void Material_compiler::set_backend_option(const char* name, const char* value)
+{
+    check_success(m_be_cuda_ptx->set_option(name, value) == 0);
+    m_target_code_key.add_option(name, value);
+}
+
 bool Material_compiler::is_mdle_name(const std::string& name)
 {
     size_t l = name.length();
@@ -1532,19 +1591,30 @@ mi::neuraylib::ICompiled_material *Material_compiler::compile_material_instance(
 }
 
 // Generates CUDA PTX target code for the current link unit.
-mi::base::Handle<const mi::neuraylib::ITarget_code> Material_compiler::generate_cuda_ptx()
+Target_code_snapshot Material_compiler::generate_cuda_ptx()
 {
+    // Try the cache first. The arguments of class-compiled materials are part of the key,
+    // so the cached argument blocks can be used directly.
+    Target_code_snapshot snapshot;
+    if (m_target_code_cache &&
+            m_target_code_cache->load(m_target_code_key, m_transaction.get(), snapshot))
+        return snapshot;
+
     mi::base::Handle<const mi::neuraylib::ITarget_code> code_cuda_ptx(
         m_be_cuda_ptx->translate_link_unit(m_link_unit.get(), m_context.get()));
     check_success(print_messages(m_context.get()));
     check_success(code_cuda_ptx);
 
+    snapshot = Target_code_snapshot(code_cuda_ptx.get(), mi::neuraylib::ITarget_code::SL_PTX);
+    if (m_target_code_cache)
+        m_target_code_cache->store(m_target_code_key, snapshot);
+
 #ifdef DUMP_PTX
     std::cout << "Dumping CUDA PTX code:\n\n"
         << code_cuda_ptx->get_code() << std::endl;
 #endif
 
-    return code_cuda_ptx;
+    return snapshot;
 }
 
 // Add a subexpression of a given material to the link unit.
@@ -1603,10 +1673,55 @@ bool Material_compiler::add_material(
     mi::base::Handle<mi::neuraylib::ICompiled_material> compiled_material(
         compile_material_instance(material_instance.get(), class_compilation));
 
+    return link_material(
+        compiled_material.get(), function_descriptions, description_count, class_compilation);
+}
+
+// Add (multiple) MDL distribution function and expressions of an already compiled material
+// to this link unit.
+bool Material_compiler::add_compiled_material(
+    const mi::neuraylib::IMaterial_definition* material_definition,
+    const mi::neuraylib::ICompiled_material* compiled_material,
+    mi::neuraylib::Target_function_description* function_descriptions,
+    mi::Size description_count,
+    bool class_compilation)
+{
+    if (description_count == 0 || !material_definition || !compiled_material)
+        return false;
+
+    m_material_defs.push_back(mi::base::make_handle_dup(material_definition));
+    m_compiled_materials.push_back(mi::base::make_handle_dup(compiled_material));
+
+    return link_material(
+        compiled_material, function_descriptions, description_count, class_compilation);
+}
+
+// Adds the selected functions of a compiled material to the link unit.
+bool Material_compiler::link_material(
+    const mi::neuraylib::ICompiled_material* compiled_material,
+    mi::neuraylib::Target_function_description* function_descriptions,
+    mi::Size description_count,
+    bool class_compilation)
+{
     m_link_unit->add_material(
-        compiled_material.get(), function_descriptions, description_count,
+        compiled_material, function_descriptions, description_count,
         m_context.get());
 
+    // Everything influencing the generated code and the argument blocks is part of the target
+    // code cache key
+    m_target_code_key.add(compiled_material->get_hash());
+    m_target_code_key.add(mi::Uint64(class_compilation));
+    for (mi::Size i = 0; i < description_count; ++i) {
+        m_target_code_key.add(function_descriptions[i].path);
+        m_target_code_key.add(function_descriptions[i].base_fname);
+    }
+    for (mi::Size i = 0, n = compiled_material->get_parameter_count(); i < n; ++i) {
+        mi::base::Handle<const mi::neuraylib::IValue> argument(compiled_material->get_argument(i));
+        mi::base::Handle<const mi::IString> dump(
+            m_value_factory->dump(argument.get(), compiled_material->get_parameter_name(i)));
+        m_target_code_key.add(dump->get_c_str());
+    }
+
     // Note: the same argument_block_index is filled into all function descriptions of a
     //       material, if any function uses it
     m_arg_block_indexes.push_back(function_descriptions[0].argument_block_index);
@@ -1649,7 +1764,7 @@ void print_array_func(
 
 // Generate PTX array containing the references to all generated functions.
 std::string generate_func_array_ptx(
-    const std::vector<mi::base::Handle<const mi::neuraylib::ITarget_code> > &target_codes)
+    const std::vector<Target_code_snapshot> &target_codes)
 {
     // Create PTX header and mdl_expr_functions_count constant
     std::string src =
@@ -1670,8 +1785,7 @@ std::string generate_func_array_ptx(
     // Iterate over all target codes
     for (size_t tc_index = 0, num = target_codes.size(); tc_index < num; ++tc_index)
     {
-        mi::base::Handle<const mi::neuraylib::ITarget_code> const &target_code = 
-            target_codes[tc_index];
+        Target_code_snapshot const &target_code = target_codes[tc_index];
 
         // in case of multiple target codes, we need to address the functions by a pair of 
         // target_code_index and function_index.
@@ -1681,7 +1795,7 @@ std::string generate_func_array_ptx(
         tc_offsets += to_string(f_count);
 
         // Collect all names and prototypes of callable functions within the current target code
-        for (size_t func_index = 0, func_count = target_code->get_callable_function_count();
+        for (size_t func_index = 0, func_count = target_code.functions.size();
              func_index < func_count; ++func_index)
         {
             // add to function list
@@ -1696,16 +1810,15 @@ std::string generate_func_array_ptx(
             tc_indices += to_string(tc_index);
 
             // name of the function
-            function_names += target_code->get_callable_function(func_index);
+            function_names += target_code.functions[func_index].name;
 
             // Get argument block index and translate to 1 based list index (-> 0 = not-used)
-            mi::Size ab_index = target_code->get_callable_function_argument_block_index(func_index);
+            mi::Size ab_index = target_code.functions[func_index].argument_block_index;
             ab_indices += to_string(ab_index == mi::Size(~0) ? 0 : (ab_index + 1));
             f_count++;
             
             // Add prototype declaration
-            src += target_code->get_callable_function_prototype(
-                func_index, mi::neuraylib::ITarget_code::SL_PTX);
+            src += target_code.functions[func_index].prototype;
             src += '\n';
         }
     }
@@ -1729,7 +1842,7 @@ std::string generate_func_array_ptx(
 // Build a linked CUDA kernel containing our kernel and all the generated code, making it
 // available to the kernel via an added "mdl_expr_functions" array.
 CUmodule build_linked_kernel(
-    std::vector<mi::base::Handle<const mi::neuraylib::ITarget_code> > const &target_codes,
+    std::vector<Target_code_snapshot> const &target_codes,
     const char *ptx_file,
     const char *kernel_function_name,
     CUfunction *out_kernel_function)
@@ -1776,8 +1889,8 @@ CUmodule build_linked_kernel(
         for (size_t i = 0, num_target_codes = target_codes.size(); i < num_target_codes; ++i) {
             link_result = cuLinkAddData(
                 cuda_link_state, CU_JIT_INPUT_PTX,
-                const_cast<char *>(target_codes[i]->get_code()),
-                target_codes[i]->get_code_size(),
+                const_cast<char *>(target_codes[i].code.c_str()),
+                target_codes[i].code.size(),
                 nullptr, 0, nullptr, nullptr);
             if (link_result != CUDA_SUCCESS) break;
         }
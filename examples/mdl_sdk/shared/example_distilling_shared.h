@@ -11,15 +11,15 @@
 #include "example_shared.h"
 #include <string>
 
-// Create IData value
-template <typename T>
+// Create IData value, using either a transaction or the factory as creator
+template <typename T, typename Creator>
 mi::IData* create_value(
-    mi::neuraylib::ITransaction* transaction,
+    Creator* creator,
     const char* type_name,
     const T& default_value)
 {
     mi::base::Handle<mi::base::IInterface> value(
-        transaction->create(type_name));
+        creator->create(type_name));
 
     mi::base::Handle<mi::IData> data(value->get_interface<mi::IData>());
     mi::set_value(data.get(), default_value);
@@ -0,0 +1,285 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/example_material_pipeline.h
+//
+// Compiles lists of materials in parallel within a single transaction.
+
+#ifndef EXAMPLE_MATERIAL_PIPELINE_H
+#define EXAMPLE_MATERIAL_PIPELINE_H
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <mi/mdl_sdk.h>
+
+#include "example_shared.h"
+#include "example_thread_pool.h"
+
+// Instantiates and compiles materials concurrently.
+//
+// The MDL SDK supports only one transaction at a time, so compile() uses a single transaction.
+// The modules of all requested materials are loaded up front, one after another. Afterwards,
+// the workers of a thread pool instantiate and compile the materials, which only accesses
+// database elements and is allowed concurrently within one transaction. The compiled materials
+// are stored in the database in the order of the request after all workers have finished, and
+// the transaction is committed before compile() returns, so the results are visible to any
+// transaction created afterwards. They can then be added to a link unit in the order of the
+// request, which keeps the generated code independent of the thread scheduling. The compiled
+// materials stay in the database until remove_compiled_materials() is called.
+class Material_compile_pipeline
+{
+public:
+    // The result of compiling one material.
+    struct Result
+    {
+        std::string material_name;              // the requested material name
+        std::string definition_db_name;         // the DB name of the material definition
+        std::string compiled_material_db_name;  // the DB name of the stored compiled material
+        bool        success;                    // false, if any step failed for this material
+    };
+
+    // Creates the pipeline.
+    //
+    // \param mdl_compiler        the MDL compiler
+    // \param mdl_factory         the MDL factory used to create the execution contexts
+    // \param scope               the scope in which the transaction is created
+    // \param num_threads         the number of worker threads, 0 selects the number of
+    //                            hardware threads
+    // \param fold_ternary_on_df  the value of the "fold_ternary_on_df" context option
+    Material_compile_pipeline(
+        mi::neuraylib::IMdl_compiler *mdl_compiler,
+        mi::neuraylib::IMdl_factory  *mdl_factory,
+        mi::neuraylib::IScope        *scope,
+        size_t                        num_threads = 0,
+        bool                          fold_ternary_on_df = false)
+        : m_mdl_compiler(mi::base::make_handle_dup(mdl_compiler))
+        , m_mdl_factory(mi::base::make_handle_dup(mdl_factory))
+        , m_scope(mi::base::make_handle_dup(scope))
+        , m_pool(num_threads)
+        , m_fold_ternary_on_df(fold_ternary_on_df)
+    {
+    }
+
+    // Returns the number of worker threads.
+    size_t get_thread_count() const { return m_pool.get_thread_count(); }
+
+    // Returns true, if the given material name is an MDLE file path.
+    static bool is_mdle_name(const std::string &name)
+    {
+        size_t l = name.length();
+        if (l > 5 && name.compare(l - 5, 5, ".mdle") == 0)
+            return true;
+
+        return name.find(".mdle:") != std::string::npos;
+    }
+
+    // Returns the list of all material names in the given MDL module.
+    std::vector<std::string> get_material_names(const std::string &module_name)
+    {
+        check_success(!is_mdle_name(module_name));
+
+        mi::base::Handle<mi::neuraylib::ITransaction> transaction(m_scope->create_transaction());
+        check_success(
+            m_mdl_compiler->load_module(transaction.get(), module_name.c_str()) >= 0);
+
+        const char *prefix = (module_name.find("::") == 0) ? "mdl" : "mdl::";
+
+        mi::base::Handle<const mi::neuraylib::IModule> module(
+            transaction->access<mi::neuraylib::IModule>((prefix + module_name).c_str()));
+
+        mi::Size num_materials = module->get_material_count();
+        std::vector<std::string> material_names(num_materials);
+        for (mi::Size i = 0; i < num_materials; ++i)
+            material_names[i] = module->get_material(i);
+
+        module = nullptr;
+        transaction->commit();
+        return material_names;
+    }
+
+    // Loads, instantiates and compiles the given materials.
+    //
+    // Messages are printed in the order of the material names after all materials have been
+    // processed.
+    //
+    // \param material_names     the fully-qualified material names or MDLE file paths
+    // \param class_compilation  true to use class compilation, false for instance compilation
+    // \param results            receives one entry per material name, in the same order
+    // \return                   true, if all materials were compiled successfully
+    bool compile(
+        const std::vector<std::string> &material_names,
+        bool                            class_compilation,
+        std::vector<Result>            &results)
+    {
+        const size_t n = material_names.size();
+        results.clear();
+        results.resize(n);
+
+        std::vector<std::string> function_names(n);
+        std::vector<std::string> module_names(n);
+        for (size_t i = 0; i < n; ++i) {
+            results[i].material_name = material_names[i];
+            results[i].success = false;
+            split_material_name(material_names[i], module_names[i], function_names[i]);
+        }
+
+        mi::base::Handle<mi::neuraylib::ITransaction> transaction(m_scope->create_transaction());
+
+        // Load every module only once, in the order of the first request.
+        std::map<std::string, std::string> module_db_names;
+        for (size_t i = 0; i < n; ++i) {
+            if (module_names[i].empty() || module_db_names.count(module_names[i]) != 0)
+                continue;
+
+            mi::base::Handle<mi::neuraylib::IMdl_execution_context> context(
+                m_mdl_factory->create_execution_context());
+
+            std::string &db_name = module_db_names[module_names[i]];
+            if (m_mdl_compiler->load_module(
+                    transaction.get(), module_names[i].c_str(), context.get()) >= 0) {
+                const char *module_db_name = m_mdl_compiler->get_module_db_name(
+                    transaction.get(), module_names[i].c_str(), context.get());
+                if (module_db_name)
+                    db_name = module_db_name;
+            }
+            print_messages(context.get());
+        }
+
+        const mi::Uint32 flags = class_compilation
+            ? mi::neuraylib::IMaterial_instance::CLASS_COMPILATION
+            : mi::neuraylib::IMaterial_instance::DEFAULT_OPTIONS;
+
+        // Every material gets its own context, so the messages can be reported in order.
+        std::vector<mi::base::Handle<mi::neuraylib::IMdl_execution_context> > contexts(n);
+        std::vector<mi::base::Handle<mi::neuraylib::ICompiled_material> > compiled_materials(n);
+        const unsigned run = next_run_id();
+
+        for (size_t i = 0; i < n; ++i) {
+            const std::string &module_db_name = module_db_names[module_names[i]];
+            if (module_db_name.empty())
+                continue;
+
+            results[i].definition_db_name = module_db_name + "::" + function_names[i];
+            results[i].compiled_material_db_name =
+                "compiled_material_pipeline_" + std::to_string(run) + "_" + std::to_string(i);
+
+            contexts[i] = m_mdl_factory->create_execution_context();
+            contexts[i]->set_option("experimental", true);
+            contexts[i]->set_option("fold_ternary_on_df", m_fold_ternary_on_df);
+
+            m_pool.submit([&, i, flags](size_t /*worker*/) {
+                compiled_materials[i] = compile_material(
+                    transaction.get(), contexts[i].get(), flags, results[i]);
+            });
+        }
+        m_pool.wait();
+
+        // Storing modifies the transaction, so it is done here in the order of the request.
+        for (size_t i = 0; i < n; ++i) {
+            if (!compiled_materials[i])
+                continue;
+            results[i].success = transaction->store(
+                compiled_materials[i].get(), results[i].compiled_material_db_name.c_str()) == 0;
+            compiled_materials[i] = nullptr;
+        }
+        transaction->commit();
+
+        bool success = true;
+        for (size_t i = 0; i < n; ++i) {
+            if (contexts[i])
+                print_messages(contexts[i].get());
+            if (!results[i].success) {
+                std::cerr << "Compiling material \"" << material_names[i] << "\" failed."
+                    << std::endl;
+                success = false;
+            }
+        }
+        return success;
+    }
+
+    // Removes the compiled materials stored by compile() from the database.
+    //
+    // Call this when the compiled materials are no longer accessed, e.g., after their code has
+    // been generated. The removal takes effect when the transaction is committed.
+    static void remove_compiled_materials(
+        mi::neuraylib::ITransaction *transaction,
+        const std::vector<Result>   &results)
+    {
+        for (size_t i = 0, n = results.size(); i < n; ++i) {
+            if (results[i].success)
+                transaction->remove(results[i].compiled_material_db_name.c_str());
+        }
+    }
+
+private:
+    // Splits a material name into the module name and the name of the material in the module.
+    static void split_material_name(
+        const std::string &material_name,
+        std::string       &module_name,
+        std::string       &function_name)
+    {
+        if (is_mdle_name(material_name)) {
+            module_name = material_name;
+            function_name = "main";
+            return;
+        }
+
+        size_t p = material_name.rfind("::");
+        if (p == std::string::npos || p == 0) {
+            module_name.clear();
+            function_name.clear();
+            return;
+        }
+        module_name = material_name.substr(0, p);
+        function_name = material_name.substr(p + 2);
+    }
+
+    // Returns a new identifier for a compile() call, used to make the DB names unique.
+    static unsigned next_run_id()
+    {
+        static std::atomic<unsigned> s_next_run_id(0);
+        return s_next_run_id++;
+    }
+
+    // Instantiates and compiles one material. Returns NULL if any step failed.
+    // Runs on a worker thread and only accesses the database.
+    static mi::neuraylib::ICompiled_material *compile_material(
+        mi::neuraylib::ITransaction           *transaction,
+        mi::neuraylib::IMdl_execution_context *context,
+        mi::Uint32                             flags,
+        const Result                          &result)
+    {
+        mi::base::Handle<const mi::neuraylib::IMaterial_definition> material_definition(
+            transaction->access<mi::neuraylib::IMaterial_definition>(
+                result.definition_db_name.c_str()));
+        if (!material_definition)
+            return nullptr;
+
+        mi::Sint32 ret = 0;
+        mi::base::Handle<mi::neuraylib::IMaterial_instance> material_instance(
+            material_definition->create_material_instance(0, &ret));
+        if (ret != 0 || !material_instance)
+            return nullptr;
+
+        mi::base::Handle<mi::neuraylib::ICompiled_material> compiled_material(
+            material_instance->create_compiled_material(flags, context));
+        if (!compiled_material || context->get_error_messages_count() != 0)
+            return nullptr;
+
+        compiled_material->retain();
+        return compiled_material.get();
+    }
+
+    mi::base::Handle<mi::neuraylib::IMdl_compiler> m_mdl_compiler;
+    mi::base::Handle<mi::neuraylib::IMdl_factory>  m_mdl_factory;
+    mi::base::Handle<mi::neuraylib::IScope>        m_scope;
+    Thread_pool                                    m_pool;
+    bool                                           m_fold_ternary_on_df;
+};
+
+#endif // EXAMPLE_MATERIAL_PIPELINE_H
@@ -0,0 +1,515 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/example_target_code_cache.h
+//
+// A persistent, content-addressed on-disk cache for target code generated by the MDL backends.
+
+#ifndef EXAMPLE_TARGET_CODE_CACHE_H
+#define EXAMPLE_TARGET_CODE_CACHE_H
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mi/mdl_sdk.h>
+
+#ifdef MI_PLATFORM_WINDOWS
+#include <mi/base/miwindows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Builds the key of a target code cache entry.
+//
+// The key is a 128-bit hash over everything influencing the generated code and the argument
+// blocks: the hashes and, for class compilation, the arguments of the compiled materials, the
+// backend kind and options, and the paths and names of the generated functions. The SDK version
+// is always included, so entries of other SDK versions are ignored.
+class Target_code_cache_key
+{
+public:
+    Target_code_cache_key()
+        : m_hash0(0xcbf29ce484222325ull)
+        , m_hash1(0x84222325cbf29ce4ull)
+    {
+        add(MI_NEURAYLIB_PRODUCT_VERSION_STRING);
+        add(mi::Uint64(MI_NEURAYLIB_API_VERSION));
+    }
+
+    // Adds raw data to the key.
+    void add(const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            m_hash0 = (m_hash0 ^ bytes[i]) * 0x100000001b3ull;
+            m_hash1 = (m_hash1 ^ bytes[i]) * 0x1000000001b3ull + 0x9e3779b97f4a7c15ull;
+        }
+    }
+
+    // Adds a string to the key. \c nullptr and the empty string are distinguished.
+    void add(const char *s)
+    {
+        if (!s) {
+            add(~mi::Uint64(0));
+            return;
+        }
+        const mi::Uint64 len = strlen(s);
+        add(len);
+        add(s, size_t(len));
+    }
+
+    void add(const std::string &s) { add(s.c_str()); }
+
+    void add(mi::Uint64 value) { add(&value, sizeof(value)); }
+
+    void add(const mi::base::Uuid &uuid)
+    {
+        const mi::Uint32 parts[4] = { uuid.m_id1, uuid.m_id2, uuid.m_id3, uuid.m_id4 };
+        add(parts, sizeof(parts));
+    }
+
+    // Adds a backend option given as name/value pair.
+    void add_option(const char *name, const char *value)
+    {
+        add(name);
+        add(value);
+    }
+
+    // Returns the key as a hexadecimal string, usable as file name.
+    std::string str() const
+    {
+        char buf[33];
+        snprintf(buf, sizeof(buf), "%016llx%016llx",
+            static_cast<unsigned long long>(m_hash0), static_cast<unsigned long long>(m_hash1));
+        return buf;
+    }
+
+private:
+    mi::Uint64 m_hash0;
+    mi::Uint64 m_hash1;
+};
+
+namespace target_code_cache_detail {
+
+// The file format is a sequence of little-endian integers, strings and blobs.
+static const char       s_magic[8] = { 'M', 'D', 'L', 'T', 'C', 'C', '\0', '\0' };
+static const mi::Uint32 s_version = 2;
+
+// Serializes a cache entry into a memory buffer.
+class Writer
+{
+public:
+    void put_u32(mi::Uint32 v) { m_buffer.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+    void put_u64(mi::Uint64 v) { m_buffer.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+
+    void put_blob(const char *data, size_t size)
+    {
+        put_u64(size);
+        if (size > 0)
+            m_buffer.append(data, size);
+    }
+
+    void put_string(const std::string &s) { put_blob(s.data(), s.size()); }
+
+    void put_raw(const char *data, size_t size) { m_buffer.append(data, size); }
+
+    const std::string &buffer() const { return m_buffer; }
+
+private:
+    std::string m_buffer;
+};
+
+// Deserializes a cache entry from a memory buffer.
+class Reader
+{
+public:
+    explicit Reader(const std::string &data) : m_data(data), m_pos(0), m_ok(true) {}
+
+    bool ok() const { return m_ok; }
+
+    // Indicates whether all data has been read.
+    bool at_end() const { return m_pos == m_data.size(); }
+
+    mi::Uint32 get_u32() { mi::Uint32 v = 0; get_raw(&v, sizeof(v)); return v; }
+    mi::Uint64 get_u64() { mi::Uint64 v = 0; get_raw(&v, sizeof(v)); return v; }
+
+    // Reads a count and checks that the remaining data can hold that many items of the
+    // given minimum size.
+    size_t get_count(size_t min_item_size)
+    {
+        const mi::Uint64 n = get_u64();
+        if (!m_ok || n > (m_data.size() - m_pos) / min_item_size) {
+            m_ok = false;
+            return 0;
+        }
+        return size_t(n);
+    }
+
+    void get_blob(std::vector<char> &blob)
+    {
+        const size_t size = get_count(1);
+        blob.assign(m_data.data() + m_pos, m_data.data() + m_pos + size);
+        m_pos += size;
+    }
+
+    void get_string(std::string &s)
+    {
+        const size_t size = get_count(1);
+        s.assign(m_data, m_pos, size);
+        m_pos += size;
+    }
+
+    void get_raw(void *dst, size_t size)
+    {
+        if (!m_ok || size > m_data.size() - m_pos) {
+            m_ok = false;
+            return;
+        }
+        memcpy(dst, m_data.data() + m_pos, size);
+        m_pos += size;
+    }
+
+private:
+    const std::string &m_data;
+    size_t             m_pos;
+    bool               m_ok;
+};
+
+} // namespace target_code_cache_detail
+
+// The parts of the target code of the PTX and GLSL backends used by the GPU examples.
+//
+// The data is either copied from the target code generated by the backend or restored from the
+// target code cache. Resource tables start with the invalid resource at index 0, like in the
+// target code.
+struct Target_code_snapshot
+{
+    // A texture of the resource table.
+    struct Texture
+    {
+        std::string                                 db_name;
+        mi::neuraylib::ITarget_code::Texture_shape  shape;
+    };
+
+    // A read-only data segment.
+    struct Segment
+    {
+        std::string         name;
+        std::vector<char>   data;
+    };
+
+    // A callable function with its prototype in the language of the backend.
+    struct Function
+    {
+        std::string name;
+        std::string prototype;
+        mi::Size    argument_block_index;
+    };
+
+    Target_code_snapshot() {}
+
+    // Copies the used parts of the given target code, using the prototypes of the given language.
+    Target_code_snapshot(
+        const mi::neuraylib::ITarget_code *target_code,
+        mi::neuraylib::ITarget_code::Prototype_language language)
+    {
+        code.assign(target_code->get_code(), size_t(target_code->get_code_size()));
+
+        ro_data_segments.resize(target_code->get_ro_data_segment_count());
+        for (size_t i = 0; i < ro_data_segments.size(); ++i) {
+            ro_data_segments[i].name = to_string(target_code->get_ro_data_segment_name(i));
+            const char *data = target_code->get_ro_data_segment_data(i);
+            ro_data_segments[i].data.assign(data, data + target_code->get_ro_data_segment_size(i));
+        }
+
+        textures.resize(target_code->get_texture_count());
+        for (size_t i = 0; i < textures.size(); ++i) {
+            textures[i].db_name = to_string(target_code->get_texture(i));
+            textures[i].shape = target_code->get_texture_shape(i);
+        }
+
+        for (mi::Size i = 0, n = target_code->get_light_profile_count(); i < n; ++i)
+            light_profiles.push_back(to_string(target_code->get_light_profile(i)));
+        for (mi::Size i = 0, n = target_code->get_bsdf_measurement_count(); i < n; ++i)
+            bsdf_measurements.push_back(to_string(target_code->get_bsdf_measurement(i)));
+        for (mi::Size i = 0, n = target_code->get_string_constant_count(); i < n; ++i)
+            string_constants.push_back(to_string(target_code->get_string_constant(i)));
+
+        functions.resize(target_code->get_callable_function_count());
+        for (size_t i = 0; i < functions.size(); ++i) {
+            functions[i].name = to_string(target_code->get_callable_function(i));
+            functions[i].prototype =
+                to_string(target_code->get_callable_function_prototype(i, language));
+            functions[i].argument_block_index =
+                target_code->get_callable_function_argument_block_index(i);
+        }
+
+        for (mi::Size i = 0, n = target_code->get_argument_block_count(); i < n; ++i) {
+            mi::base::Handle<const mi::neuraylib::ITarget_argument_block> block(
+                target_code->get_argument_block(i));
+            argument_blocks.push_back(
+                std::vector<char>(block->get_data(), block->get_data() + block->get_size()));
+            argument_block_layouts.push_back(
+                mi::base::make_handle(target_code->get_argument_block_layout(i)));
+        }
+    }
+
+    // The generated PTX or GLSL code.
+    std::string                 code;
+
+    std::vector<Segment>        ro_data_segments;
+    std::vector<Texture>        textures;
+    std::vector<std::string>    light_profiles;
+    std::vector<std::string>    bsdf_measurements;
+    std::vector<std::string>    string_constants;
+    std::vector<Function>       functions;
+
+    // The initial argument blocks of class-compiled materials.
+    std::vector<std::vector<char> > argument_blocks;
+
+    // The layouts of the argument blocks. They are only available for generated code, the
+    // entries are invalid for code restored from the cache.
+    std::vector<mi::base::Handle<const mi::neuraylib::ITarget_value_layout> >
+                                argument_block_layouts;
+
+private:
+    static std::string to_string(const char *s) { return s ? s : ""; }
+};
+
+// A persistent on-disk cache for target code.
+//
+// Every entry is stored in its own file named after the key in the cache directory. Entries
+// are written to a temporary file first and renamed afterwards, so concurrent processes never
+// see partially written entries. Only the data of Target_code_snapshot is stored, so the native
+// backend, which needs its JIT-compiled code for execution, is not supported.
+class Target_code_cache
+{
+public:
+    // Creates a cache in the given directory, which must exist. An empty directory name
+    // disables the cache.
+    explicit Target_code_cache(const std::string &directory)
+        : m_directory(directory)
+        , m_hits(0)
+        , m_misses(0)
+    {
+    }
+
+    // Returns true, if the cache is enabled.
+    bool is_enabled() const { return !m_directory.empty(); }
+
+    // Looks up the target code for the given key.
+    //
+    // \param key          the key of the entry
+    // \param transaction  if not \c nullptr, the entry is only used if all resources
+    //                     referenced by the code exist in the database
+    // \param snapshot     receives the restored target code
+    // \return             true on a cache hit
+    bool load(
+        const Target_code_cache_key &key,
+        mi::neuraylib::ITransaction *transaction,
+        Target_code_snapshot &snapshot)
+    {
+        if (!is_enabled())
+            return false;
+
+        if (!read(get_path(key), snapshot) ||
+                (transaction && !resources_exist(snapshot, transaction))) {
+            ++m_misses;
+            return false;
+        }
+
+        ++m_hits;
+        return true;
+    }
+
+    // Stores the target code under the given key. Failures are not fatal, the code will simply
+    // be generated again next time.
+    bool store(const Target_code_cache_key &key, const Target_code_snapshot &snapshot)
+    {
+        if (!is_enabled())
+            return false;
+
+        // The process ID and a counter keep the temporary files of concurrent writers apart.
+        static std::atomic<unsigned> s_counter(0);
+        const std::string path = get_path(key);
+        std::ostringstream tmp_path;
+        tmp_path << path << ".tmp" << get_process_id() << "_" << s_counter++;
+        {
+            std::ofstream file(tmp_path.str().c_str(), std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+            const std::string data = serialize(snapshot);
+            file.write(data.data(), std::streamsize(data.size()));
+            if (!file) {
+                file.close();
+                remove(tmp_path.str().c_str());
+                return false;
+            }
+        }
+#ifdef MI_PLATFORM_WINDOWS
+        if (!MoveFileExA(tmp_path.str().c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+        if (rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+#endif
+            remove(tmp_path.str().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Returns the number of successful lookups.
+    size_t get_hit_count() const { return m_hits; }
+
+    // Returns the number of failed lookups.
+    size_t get_miss_count() const { return m_misses; }
+
+private:
+    std::string get_path(const Target_code_cache_key &key) const
+    {
+        return m_directory + "/" + key.str() + ".mdltc";
+    }
+
+    static unsigned long get_process_id()
+    {
+#ifdef MI_PLATFORM_WINDOWS
+        return static_cast<unsigned long>(GetCurrentProcessId());
+#else
+        return static_cast<unsigned long>(getpid());
+#endif
+    }
+
+    static std::string serialize(const Target_code_snapshot &snapshot)
+    {
+        using namespace target_code_cache_detail;
+
+        Writer w;
+        w.put_raw(s_magic, sizeof(s_magic));
+        w.put_u32(s_version);
+
+        w.put_string(snapshot.code);
+
+        w.put_u64(snapshot.ro_data_segments.size());
+        for (const Target_code_snapshot::Segment &segment : snapshot.ro_data_segments) {
+            w.put_string(segment.name);
+            w.put_blob(segment.data.data(), segment.data.size());
+        }
+
+        w.put_u64(snapshot.textures.size());
+        for (const Target_code_snapshot::Texture &texture : snapshot.textures) {
+            w.put_string(texture.db_name);
+            w.put_u32(mi::Uint32(texture.shape));
+        }
+
+        const std::vector<std::string> *name_tables[] = {
+            &snapshot.light_profiles, &snapshot.bsdf_measurements, &snapshot.string_constants };
+        for (const std::vector<std::string> *names : name_tables) {
+            w.put_u64(names->size());
+            for (const std::string &name : *names)
+                w.put_string(name);
+        }
+
+        w.put_u64(snapshot.functions.size());
+        for (const Target_code_snapshot::Function &function : snapshot.functions) {
+            w.put_string(function.name);
+            w.put_string(function.prototype);
+            w.put_u64(function.argument_block_index);
+        }
+
+        w.put_u64(snapshot.argument_blocks.size());
+        for (const std::vector<char> &block : snapshot.argument_blocks)
+            w.put_blob(block.data(), block.size());
+
+        return w.buffer();
+    }
+
+    static bool read(const std::string &path, Target_code_snapshot &snapshot)
+    {
+        using namespace target_code_cache_detail;
+
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file)
+            return false;
+        const std::string data(
+            (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        Reader r(data);
+        char magic[sizeof(s_magic)];
+        r.get_raw(magic, sizeof(magic));
+        if (!r.ok() || memcmp(magic, s_magic, sizeof(s_magic)) != 0 || r.get_u32() != s_version)
+            return false;
+
+        r.get_string(snapshot.code);
+
+        snapshot.ro_data_segments.resize(r.get_count(16));
+        for (Target_code_snapshot::Segment &segment : snapshot.ro_data_segments) {
+            r.get_string(segment.name);
+            r.get_blob(segment.data);
+        }
+
+        snapshot.textures.resize(r.get_count(12));
+        for (Target_code_snapshot::Texture &texture : snapshot.textures) {
+            r.get_string(texture.db_name);
+            texture.shape = mi::neuraylib::ITarget_code::Texture_shape(r.get_u32());
+        }
+
+        std::vector<std::string> *name_tables[] = {
+            &snapshot.light_profiles, &snapshot.bsdf_measurements, &snapshot.string_constants };
+        for (std::vector<std::string> *names : name_tables) {
+            names->resize(r.get_count(8));
+            for (std::string &name : *names)
+                r.get_string(name);
+        }
+
+        snapshot.functions.resize(r.get_count(24));
+        for (Target_code_snapshot::Function &function : snapshot.functions) {
+            r.get_string(function.name);
+            r.get_string(function.prototype);
+            function.argument_block_index = mi::Size(r.get_u64());
+        }
+
+        snapshot.argument_blocks.resize(r.get_count(8));
+        for (std::vector<char> &block : snapshot.argument_blocks)
+            r.get_blob(block);
+        snapshot.argument_block_layouts.clear();
+        snapshot.argument_block_layouts.resize(snapshot.argument_blocks.size());
+
+        return r.ok() && r.at_end() && !snapshot.code.empty();
+    }
+
+    static bool resource_exists(mi::neuraylib::ITransaction *transaction, const std::string &name)
+    {
+        if (name.empty())
+            return true;
+        mi::base::Handle<const mi::base::IInterface> element(transaction->access(name.c_str()));
+        return element.is_valid_interface();
+    }
+
+    static bool resources_exist(
+        const Target_code_snapshot &snapshot, mi::neuraylib::ITransaction *transaction)
+    {
+        // index 0 is always the invalid resource
+        for (size_t i = 1; i < snapshot.textures.size(); ++i)
+            if (!resource_exists(transaction, snapshot.textures[i].db_name))
+                return false;
+        for (size_t i = 1; i < snapshot.light_profiles.size(); ++i)
+            if (!resource_exists(transaction, snapshot.light_profiles[i]))
+                return false;
+        for (size_t i = 1; i < snapshot.bsdf_measurements.size(); ++i)
+            if (!resource_exists(transaction, snapshot.bsdf_measurements[i]))
+                return false;
+        return true;
+    }
+
+    std::string m_directory;
+    size_t      m_hits;
+    size_t      m_misses;
+};
+
+#endif // EXAMPLE_TARGET_CODE_CACHE_H
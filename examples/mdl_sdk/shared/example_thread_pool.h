@@ -0,0 +1,222 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/example_thread_pool.h
+//
+// A small work-stealing thread pool shared by the examples.
+
+#ifndef EXAMPLE_THREAD_POOL_H
+#define EXAMPLE_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed-size pool of worker threads.
+//
+// Every worker owns a task queue. Workers take tasks from the back of their own queue and steal
+// from the front of the queues of the other workers when they run out of work. Tasks receive the
+// index of the executing worker in [0, get_thread_count()), which allows callers to keep
+// per-worker state (e.g., a shading state or a transaction) without any locking.
+//
+// An exception thrown by a task is caught by the worker, and the first such exception is rethrown
+// by the next call of wait().
+class Thread_pool
+{
+public:
+    // A task executed by the pool. The argument is the index of the executing worker.
+    typedef std::function<void(size_t)> Task;
+
+    // Creates the pool.
+    //
+    // \param num_threads   the number of worker threads, 0 selects the number of hardware threads
+    explicit Thread_pool(size_t num_threads = 0)
+        : m_queued(0)
+        , m_pending(0)
+        , m_next_queue(0)
+        , m_stop(false)
+    {
+        if (num_threads == 0)
+            num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        m_queues.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; ++i)
+            m_queues.emplace_back(new Queue());
+
+        m_threads.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; ++i)
+            m_threads.emplace_back(&Thread_pool::run, this, i);
+    }
+
+    // Waits for all pending tasks and joins the worker threads.
+    ~Thread_pool()
+    {
+        wait_for_tasks();
+        {
+            std::unique_lock<std::mutex> lock(m_wake_mutex);
+            m_stop = true;
+        }
+        m_wake_cv.notify_all();
+        for (std::thread& t : m_threads)
+            t.join();
+    }
+
+    // Returns the number of worker threads.
+    size_t get_thread_count() const { return m_threads.size(); }
+
+    // Enqueues a task.
+    //
+    // Tasks submitted from a worker of this pool go to the queue of that worker, other tasks are
+    // distributed round-robin over all queues.
+    void submit(Task task)
+    {
+        ++m_pending;
+
+        size_t q = current_worker();
+        if (q == size_t(~0))
+            q = m_next_queue++ % m_queues.size();
+
+        // Count the task before it becomes visible, so a worker taking it right away never
+        // decrements the counter below zero.
+        {
+            std::unique_lock<std::mutex> lock(m_wake_mutex);
+            ++m_queued;
+        }
+        {
+            std::unique_lock<std::mutex> lock(m_queues[q]->mutex);
+            m_queues[q]->tasks.push_back(std::move(task));
+        }
+        m_wake_cv.notify_one();
+    }
+
+    // Blocks until all submitted tasks have been executed.
+    //
+    // Rethrows the first exception thrown by a task since the previous call. Must not be called
+    // from inside a task of this pool.
+    void wait()
+    {
+        std::exception_ptr error = wait_for_tasks();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // Returns the index of the calling worker thread, or ~0 if the caller is not a worker of
+    // this pool.
+    size_t current_worker() const
+    {
+        const Worker_info& info = worker_info();
+        return info.pool == this ? info.index : size_t(~0);
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct Worker_info
+    {
+        Thread_pool const *pool;
+        size_t             index;
+    };
+
+    static Worker_info& worker_info()
+    {
+        static thread_local Worker_info info = { nullptr, 0 };
+        return info;
+    }
+
+    // Blocks until all submitted tasks have been executed and returns the first exception thrown
+    // by a task since the previous call.
+    std::exception_ptr wait_for_tasks()
+    {
+        std::unique_lock<std::mutex> lock(m_done_mutex);
+        m_done_cv.wait(lock, [this]() { return m_pending == 0; });
+        std::exception_ptr error = m_error;
+        m_error = nullptr;
+        return error;
+    }
+
+    // Takes a task from the own queue or steals one from another worker.
+    bool pop_task(size_t index, Task& task)
+    {
+        {
+            Queue& own = *m_queues[index];
+            std::unique_lock<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                --m_queued;
+                return true;
+            }
+        }
+        for (size_t i = 1, n = m_queues.size(); i < n; ++i) {
+            Queue& victim = *m_queues[(index + i) % n];
+            std::unique_lock<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --m_queued;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Main loop of a worker thread.
+    void run(size_t index)
+    {
+        worker_info().pool = this;
+        worker_info().index = index;
+
+        for (;;) {
+            Task task;
+            if (pop_task(index, task)) {
+                try {
+                    task(index);
+                } catch (...) {
+                    std::unique_lock<std::mutex> lock(m_done_mutex);
+                    if (!m_error)
+                        m_error = std::current_exception();
+                }
+                if (--m_pending == 0) {
+                    std::unique_lock<std::mutex> lock(m_done_mutex);
+                    m_done_cv.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_wake_mutex);
+            m_wake_cv.wait(lock, [this]() { return m_stop || m_queued > 0; });
+            if (m_stop && m_queued == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread>            m_threads;
+
+    std::atomic<size_t>                 m_queued;       // tasks waiting in any queue
+    std::atomic<size_t>                 m_pending;      // tasks submitted but not finished
+    std::atomic<size_t>                 m_next_queue;   // round-robin counter for submit()
+
+    std::mutex                          m_wake_mutex;
+    std::condition_variable             m_wake_cv;
+    bool                                m_stop;
+
+    std::mutex                          m_done_mutex;
+    std::condition_variable             m_done_cv;
+    std::exception_ptr                  m_error;        // first exception thrown by a task
+};
+
+#endif // EXAMPLE_THREAD_POOL_H
@@ -0,0 +1,697 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/compiled_material_snapshot.cpp
+
+#include "compiled_material_snapshot.h"
+#include "compiled_material_traverser_base.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+const mi::Uint32 Compiled_material_snapshot::INVALID_INDEX = 0xffffffffU;
+
+namespace
+{
+    // identifies the binary format written by Compiled_material_snapshot::write
+    const char SNAPSHOT_MAGIC[8] = { 'M', 'D', 'L', 'S', 'N', 'A', 'P', '\0' };
+    const mi::Uint32 SNAPSHOT_VERSION = 1;
+
+    template<typename T>
+    void write_array(std::ostream& stream, const std::vector<T>& data)
+    {
+        const mi::Uint32 count = static_cast<mi::Uint32>(data.size());
+        stream.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        if (count > 0)
+            stream.write(reinterpret_cast<const char*>(data.data()), count * sizeof(T));
+    }
+
+    template<typename T>
+    bool read_array(std::istream& stream, std::vector<T>& data)
+    {
+        mi::Uint32 count = 0;
+        if (!stream.read(reinterpret_cast<char*>(&count), sizeof(count)))
+            return false;
+
+        // grow in steps, so a corrupted count fails at the end of the stream instead of
+        // allocating the full size upfront
+        data.clear();
+        const mi::Uint32 step = 1u << 16;
+        for (mi::Uint32 offset = 0; offset < count; offset += step)
+        {
+            const mi::Uint32 n = std::min(step, count - offset);
+            data.resize(offset + n);
+            if (!stream.read(reinterpret_cast<char*>(data.data() + offset), n * sizeof(T)))
+                return false;
+        }
+        return true;
+    }
+
+    const char* node_kind_to_string(mi::Uint8 kind)
+    {
+        switch (kind)
+        {
+            case Compiled_material_snapshot::NK_VALUE:          return "value";
+            case Compiled_material_snapshot::NK_PARAMETER:      return "parameter";
+            case Compiled_material_snapshot::NK_TEMPORARY:      return "temporary";
+            case Compiled_material_snapshot::NK_DIRECT_CALL:    return "call";
+            default:                                            return "unknown";
+        }
+    }
+} // anonymous namespace
+
+// Fills a snapshot while traversing the compiled material.
+//
+// Every element that becomes a node pushes its id onto a list of pending ids when it is
+// finished. When the parent is finished, the ids of its children are at the end of that list
+// and are moved into the child table in one piece, which keeps the child ranges contiguous.
+class Compiled_material_snapshot::Builder : public Compiled_material_traverser_base
+{
+public:
+
+    Builder(mi::neuraylib::ITransaction* transaction, Compiled_material_snapshot* snapshot)
+        : m_transaction(transaction)
+        , m_snapshot(snapshot)
+    { }
+
+    void build(const mi::neuraylib::ICompiled_material* material)
+    {
+        traverse(material, nullptr);
+    }
+
+protected:
+
+    void stage_begin(const mi::neuraylib::ICompiled_material* /*material*/,
+                     Traveral_stage /*stage*/, void* /*context*/) const
+    {
+        m_pending.clear();
+    }
+
+    void stage_end(const mi::neuraylib::ICompiled_material* material,
+                   Traveral_stage stage, void* /*context*/) const
+    {
+        switch (stage)
+        {
+            case ES_PARAMETERS:
+                m_snapshot->m_parameters = m_pending;
+                for (mi::Size i = 0, n = m_pending.size(); i < n; ++i)
+                    m_snapshot->m_parameter_names.push_back(
+                        m_snapshot->intern(get_parameter_name(material, i).c_str()));
+                break;
+
+            case ES_TEMPORARIES:
+                m_snapshot->m_temporaries = m_pending;
+                break;
+
+            case ES_BODY:
+                if (!m_pending.empty())
+                    m_snapshot->m_body = m_pending.back();
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    void visit_begin(const mi::neuraylib::ICompiled_material* /*material*/,
+                     const Traversal_element& /*element*/, void* /*context*/) const
+    {
+        m_starts.push_back(static_cast<mi::Uint32>(m_pending.size()));
+    }
+
+    void visit_child(const mi::neuraylib::ICompiled_material* /*material*/,
+                     const Traversal_element& /*element*/,
+                     mi::Size /*children_count*/, mi::Size /*child_index*/,
+                     void* /*context*/) const
+    { }
+
+    void visit_end(const mi::neuraylib::ICompiled_material* material,
+                   const Traversal_element& element, void* /*context*/) const
+    {
+        const mi::Uint32 start = m_starts.back();
+        m_starts.pop_back();
+
+        // parameters, temporaries and constant expressions only wrap their single child,
+        // which stays on the pending list in their place
+        if (element.parameter || element.temporary ||
+            (element.expression &&
+             element.expression->get_kind() == mi::neuraylib::IExpression::EK_CONSTANT))
+            return;
+
+        Node node;
+        node.kind = NK_VALUE;
+        node.value_kind = 0;
+        node.reserved = 0;
+        node.semantic = mi::neuraylib::IFunction_definition::DS_UNKNOWN;
+        node.type = INVALID_INDEX;
+        node.name = INVALID_INDEX;
+        node.data = INVALID_INDEX;
+        node.first_child = static_cast<mi::Uint32>(m_snapshot->m_children.size());
+        node.child_count = static_cast<mi::Uint32>(m_pending.size() - start);
+
+        if (element.expression)
+            fill_expression(material, element.expression, node);
+        else if (element.value)
+            fill_value(element.value, node);
+
+        m_snapshot->m_children.insert(
+            m_snapshot->m_children.end(), m_pending.begin() + start, m_pending.end());
+        m_pending.resize(start);
+
+        m_pending.push_back(static_cast<mi::Uint32>(m_snapshot->m_nodes.size()));
+        m_snapshot->m_nodes.push_back(node);
+    }
+
+private:
+
+    void fill_expression(const mi::neuraylib::ICompiled_material* material,
+                         const mi::neuraylib::IExpression* expression, Node& node) const
+    {
+        const mi::base::Handle<const mi::neuraylib::IType> type(expression->get_type());
+        node.type = m_snapshot->intern(type.get());
+
+        switch (expression->get_kind())
+        {
+            case mi::neuraylib::IExpression::EK_PARAMETER:
+            {
+                const mi::base::Handle<const mi::neuraylib::IExpression_parameter> parameter(
+                    expression->get_interface<const mi::neuraylib::IExpression_parameter>());
+                node.kind = NK_PARAMETER;
+                node.data = static_cast<mi::Uint32>(parameter->get_index());
+                node.name = m_snapshot->intern(
+                    get_parameter_name(material, parameter->get_index()).c_str());
+                break;
+            }
+
+            case mi::neuraylib::IExpression::EK_TEMPORARY:
+            {
+                const mi::base::Handle<const mi::neuraylib::IExpression_temporary> temporary(
+                    expression->get_interface<const mi::neuraylib::IExpression_temporary>());
+                node.kind = NK_TEMPORARY;
+                node.data = static_cast<mi::Uint32>(temporary->get_index());
+                break;
+            }
+
+            case mi::neuraylib::IExpression::EK_DIRECT_CALL:
+            {
+                const mi::base::Handle<const mi::neuraylib::IExpression_direct_call> call(
+                    expression->get_interface<const mi::neuraylib::IExpression_direct_call>());
+                node.kind = NK_DIRECT_CALL;
+                node.name = m_snapshot->intern(call->get_definition());
+                node.semantic = get_semantic(node.name);
+
+                const mi::base::Handle<const mi::neuraylib::IExpression_list> arguments(
+                    call->get_arguments());
+                for (mi::Size i = 0; i < node.child_count; ++i)
+                    m_snapshot->m_child_names.push_back(
+                        m_snapshot->intern(arguments->get_name(i)));
+                return;
+            }
+
+            case mi::neuraylib::IExpression::EK_CONSTANT: // folded into the value
+            case mi::neuraylib::IExpression::EK_CALL: // will not happen for compiled materials
+            case mi::neuraylib::IExpression::EK_FORCE_32_BIT: // not a valid value
+                break;
+        }
+
+        add_unnamed_children(node);
+    }
+
+    void fill_value(const mi::neuraylib::IValue* value, Node& node) const
+    {
+        const mi::base::Handle<const mi::neuraylib::IType> type(value->get_type());
+        node.type = m_snapshot->intern(type.get());
+        node.value_kind = static_cast<mi::Uint8>(value->get_kind());
+
+        Constant constant;
+        constant.double_value = 0.0;
+
+        switch (value->get_kind())
+        {
+            case mi::neuraylib::IValue::VK_BOOL:
+            {
+                const mi::base::Handle<const mi::neuraylib::IValue_bool> v(
+                    value->get_interface<const mi::neuraylib::IValue_bool>());
+                constant.bool_value = v->get_value();
+                node.data = add_constant(constant);
+                break;
+            }
+
+            case mi::neuraylib::IValue::VK_INT:
+            {
+                const mi::base::Handle<const mi::neuraylib::IValue_int> v(
+                    value->get_interface<const mi::neuraylib::IValue_int>());
+                constant.int_value = v->get_value();
+                node.data = add_constant(constant);
+                break;
+            }
+
+            case mi::neuraylib::IValue::VK_ENUM:
+            {
+                const mi::base::Handle<const mi::neuraylib::IValue_enum> v(
+                    value->get_interface<const mi::neuraylib::IValue_enum>());
+                constant.int_value = v->get_value();
+                node.data = add_constant(constant);
+                node.name = m_snapshot->intern(v->get_name());
+                break;
+            }
+
+            case mi::neuraylib::IValue::VK_FLOAT:
+            {
+                const mi::base::Handle<const mi::neuraylib::IValue_float> v(
+                    value->get_interface<const mi::neuraylib::IValue_float>());
+                constant.float_value = v->get_value();
+                node.data = add_constant(constant);
+                break;
+            }
+
+            case mi::neuraylib::IValue::VK_DOUBLE:
+            {
+                const mi::base::Handle<const mi::neuraylib::IValue_double> v(
+                    value->get_interface<const mi::neuraylib::IValue_double>());
+                constant.double_value = v->get_value();
+                node.data = add_constant(constant);
+                break;
+            }
+
+            case mi::neuraylib::IValue::VK_STRING:
+            {
+                const mi::base::Handle<const mi::neuraylib::IValue_string> v(
+                    value->get_interface<const mi::neuraylib::IValue_string>());
+                node.name = m_snapshot->intern(v->get_value());
+                break;
+            }
+
+            case mi::neuraylib::IValue::VK_TEXTURE:
+            case mi::neuraylib::IValue::VK_LIGHT_PROFILE:
+            case mi::neuraylib::IValue::VK_BSDF_MEASUREMENT:
+            {
+                const mi::base::Handle<const mi::neuraylib::IValue_resource> v(
+                    value->get_interface<const mi::neuraylib::IValue_resource>());
+                node.name = m_snapshot->intern(v->get_value());
+                node.data = m_snapshot->intern(v->get_file_path());
+                break;
+            }
+
+            case mi::neuraylib::IValue::VK_STRUCT:
+            {
+                const mi::base::Handle<const mi::neuraylib::IType> base_type(
+                    type->skip_all_type_aliases());
+                const mi::base::Handle<const mi::neuraylib::IType_struct> struct_type(
+                    base_type->get_interface<const mi::neuraylib::IType_struct>());
+                for (mi::Size i = 0; i < node.child_count; ++i)
+                    m_snapshot->m_child_names.push_back(
+                        m_snapshot->intern(struct_type->get_field_name(i)));
+                return;
+            }
+
+            case mi::neuraylib::IValue::VK_VECTOR:
+            case mi::neuraylib::IValue::VK_MATRIX:
+            case mi::neuraylib::IValue::VK_COLOR:
+            case mi::neuraylib::IValue::VK_ARRAY:
+            case mi::neuraylib::IValue::VK_INVALID_DF:
+            case mi::neuraylib::IValue::VK_FORCE_32_BIT:
+                break;
+        }
+
+        add_unnamed_children(node);
+    }
+
+    // Adds child names for a node whose children have no names.
+    void add_unnamed_children(const Node& node) const
+    {
+        m_snapshot->m_child_names.resize(m_snapshot->m_child_names.size() + node.child_count,
+                                         INVALID_INDEX);
+    }
+
+    mi::Uint32 add_constant(const Constant& constant) const
+    {
+        m_snapshot->m_constants.push_back(constant);
+        return static_cast<mi::Uint32>(m_snapshot->m_constants.size() - 1);
+    }
+
+    // Gets the semantic of a definition, the access to the DB is done once per definition.
+    mi::Uint32 get_semantic(mi::Uint32 definition) const
+    {
+        if (!m_transaction)
+            return mi::neuraylib::IFunction_definition::DS_UNKNOWN;
+
+        std::map<mi::Uint32, mi::Uint32>::const_iterator it =
+            m_snapshot->m_semantics.find(definition);
+        if (it != m_snapshot->m_semantics.end())
+            return it->second;
+
+        mi::Uint32 semantic = mi::neuraylib::IFunction_definition::DS_UNKNOWN;
+        const mi::base::Handle<const mi::neuraylib::IFunction_definition> function_definition(
+            m_transaction->access<mi::neuraylib::IFunction_definition>(
+                m_snapshot->get_string(definition)));
+        if (function_definition)
+            semantic = function_definition->get_semantic();
+
+        m_snapshot->m_semantics[definition] = semantic;
+        return semantic;
+    }
+
+    mi::neuraylib::ITransaction* m_transaction;
+    Compiled_material_snapshot* m_snapshot;
+
+    // ids of finished nodes that are not yet assigned to a parent
+    mutable std::vector<mi::Uint32> m_pending;
+
+    // size of the pending list when each element on the current path was entered
+    mutable std::vector<mi::Uint32> m_starts;
+};
+
+bool Compiled_material_snapshot::Type::operator<(const Type& other) const
+{
+    if (kind != other.kind) return kind < other.kind;
+    if (modifiers != other.modifiers) return modifiers < other.modifiers;
+    if (name != other.name) return name < other.name;
+    if (element_type != other.element_type) return element_type < other.element_type;
+    return size < other.size;
+}
+
+Compiled_material_snapshot::Compiled_material_snapshot()
+    : m_body(INVALID_INDEX)
+{
+}
+
+void Compiled_material_snapshot::build(mi::neuraylib::ITransaction* transaction,
+                                       const mi::neuraylib::ICompiled_material* material)
+{
+    clear();
+
+    Builder builder(transaction, this);
+    builder.build(material);
+
+    // the lookup tables are not needed anymore
+    m_string_ids.clear();
+    m_type_ids.clear();
+    m_semantics.clear();
+}
+
+void Compiled_material_snapshot::clear()
+{
+    m_nodes.clear();
+    m_children.clear();
+    m_child_names.clear();
+    m_string_data.clear();
+    m_string_offsets.clear();
+    m_types.clear();
+    m_constants.clear();
+    m_parameter_names.clear();
+    m_parameters.clear();
+    m_temporaries.clear();
+    m_body = INVALID_INDEX;
+    m_string_ids.clear();
+    m_type_ids.clear();
+    m_semantics.clear();
+}
+
+const char* Compiled_material_snapshot::get_string(mi::Uint32 id) const
+{
+    if (id >= m_string_offsets.size())
+        return nullptr;
+    return m_string_data.data() + m_string_offsets[id];
+}
+
+mi::Uint32 Compiled_material_snapshot::intern(const char* string)
+{
+    if (!string)
+        return INVALID_INDEX;
+
+    std::map<std::string, mi::Uint32>::const_iterator it = m_string_ids.find(string);
+    if (it != m_string_ids.end())
+        return it->second;
+
+    const mi::Uint32 id = static_cast<mi::Uint32>(m_string_offsets.size());
+    m_string_offsets.push_back(static_cast<mi::Uint32>(m_string_data.size()));
+    m_string_data.insert(m_string_data.end(), string, string + strlen(string) + 1);
+    m_string_ids[string] = id;
+    return id;
+}
+
+mi::Uint32 Compiled_material_snapshot::intern(const mi::neuraylib::IType* type)
+{
+    if (!type)
+        return INVALID_INDEX;
+
+    Type entry;
+    entry.kind = INVALID_INDEX;
+    entry.modifiers = type->get_all_type_modifiers();
+    entry.name = INVALID_INDEX;
+    entry.element_type = INVALID_INDEX;
+    entry.size = 0;
+
+    const mi::base::Handle<const mi::neuraylib::IType> base_type(type->skip_all_type_aliases());
+    entry.kind = base_type->get_kind();
+
+    switch (base_type->get_kind())
+    {
+        case mi::neuraylib::IType::TK_ENUM:
+        {
+            const mi::base::Handle<const mi::neuraylib::IType_enum> t(
+                base_type->get_interface<const mi::neuraylib::IType_enum>());
+            entry.name = intern(t->get_symbol());
+            break;
+        }
+
+        case mi::neuraylib::IType::TK_STRUCT:
+        {
+            const mi::base::Handle<const mi::neuraylib::IType_struct> t(
+                base_type->get_interface<const mi::neuraylib::IType_struct>());
+            entry.name = intern(t->get_symbol());
+            break;
+        }
+
+        case mi::neuraylib::IType::TK_VECTOR:
+        case mi::neuraylib::IType::TK_MATRIX:
+        {
+            const mi::base::Handle<const mi::neuraylib::IType_compound> t(
+                base_type->get_interface<const mi::neuraylib::IType_compound>());
+            const mi::base::Handle<const mi::neuraylib::IType> element(
+                t->get_component_type(0));
+            entry.element_type = intern(element.get());
+            entry.size = static_cast<mi::Uint32>(t->get_size());
+            break;
+        }
+
+        case mi::neuraylib::IType::TK_ARRAY:
+        {
+            const mi::base::Handle<const mi::neuraylib::IType_array> t(
+                base_type->get_interface<const mi::neuraylib::IType_array>());
+            const mi::base::Handle<const mi::neuraylib::IType> element(t->get_element_type());
+            entry.element_type = intern(element.get());
+            if (t->is_immediate_sized())
+                entry.size = static_cast<mi::Uint32>(t->get_size());
+            else
+                entry.name = intern(t->get_deferred_size());
+            break;
+        }
+
+        case mi::neuraylib::IType::TK_TEXTURE:
+        {
+            const mi::base::Handle<const mi::neuraylib::IType_texture> t(
+                base_type->get_interface<const mi::neuraylib::IType_texture>());
+            entry.size = t->get_shape();
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    std::map<Type, mi::Uint32>::const_iterator it = m_type_ids.find(entry);
+    if (it != m_type_ids.end())
+        return it->second;
+
+    const mi::Uint32 index = static_cast<mi::Uint32>(m_types.size());
+    m_types.push_back(entry);
+    m_type_ids[entry] = index;
+    return index;
+}
+
+bool Compiled_material_snapshot::write(std::ostream& stream) const
+{
+    const mi::Uint32 node_size = sizeof(Node);
+    stream.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    stream.write(reinterpret_cast<const char*>(&SNAPSHOT_VERSION), sizeof(SNAPSHOT_VERSION));
+    stream.write(reinterpret_cast<const char*>(&node_size), sizeof(node_size));
+
+    write_array(stream, m_nodes);
+    write_array(stream, m_children);
+    write_array(stream, m_child_names);
+    write_array(stream, m_string_data);
+    write_array(stream, m_string_offsets);
+    write_array(stream, m_types);
+    write_array(stream, m_constants);
+    write_array(stream, m_parameter_names);
+    write_array(stream, m_parameters);
+    write_array(stream, m_temporaries);
+    stream.write(reinterpret_cast<const char*>(&m_body), sizeof(m_body));
+
+    return !stream.fail();
+}
+
+bool Compiled_material_snapshot::read(std::istream& stream)
+{
+    clear();
+
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    mi::Uint32 version = 0;
+    mi::Uint32 node_size = 0;
+    stream.read(magic, sizeof(magic));
+    stream.read(reinterpret_cast<char*>(&version), sizeof(version));
+    stream.read(reinterpret_cast<char*>(&node_size), sizeof(node_size));
+    if (!stream || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0 ||
+        version != SNAPSHOT_VERSION || node_size != sizeof(Node))
+        return false;
+
+    bool success =
+        read_array(stream, m_nodes) &&
+        read_array(stream, m_children) &&
+        read_array(stream, m_child_names) &&
+        read_array(stream, m_string_data) &&
+        read_array(stream, m_string_offsets) &&
+        read_array(stream, m_types) &&
+        read_array(stream, m_constants) &&
+        read_array(stream, m_parameter_names) &&
+        read_array(stream, m_parameters) &&
+        read_array(stream, m_temporaries) &&
+        stream.read(reinterpret_cast<char*>(&m_body), sizeof(m_body));
+
+    // check the ranges, so the accessors can be used without further tests
+    success = success && m_children.size() == m_child_names.size();
+    success = success && (m_string_data.empty() || m_string_data.back() == '\0');
+    for (mi::Size i = 0; success && i < m_string_offsets.size(); ++i)
+        success = m_string_offsets[i] < m_string_data.size();
+    for (mi::Size i = 0; success && i < m_nodes.size(); ++i)
+    {
+        const Node& node = m_nodes[i];
+        success = node.first_child <= m_children.size()
+               && node.child_count <= m_children.size() - node.first_child;
+        for (mi::Uint32 c = 0; success && c < node.child_count; ++c)
+            success = m_children[node.first_child + c] < i; // post order
+    }
+    success = success && m_parameter_names.size() == m_parameters.size();
+    for (mi::Size i = 0; success && i < m_parameters.size(); ++i)
+        success = m_parameters[i] < m_nodes.size();
+    for (mi::Size i = 0; success && i < m_temporaries.size(); ++i)
+        success = m_temporaries[i] < m_nodes.size();
+    success = success && (m_body == INVALID_INDEX || m_body < m_nodes.size());
+
+    if (!success)
+        clear();
+    return success;
+}
+
+void Compiled_material_snapshot::dump_node(
+    std::ostream& stream, mi::Uint32 node_index, mi::Uint32 child_name) const
+{
+    const Node& node = m_nodes[node_index];
+    const char* name = get_string(node.name);
+    const char* child = get_string(child_name);
+
+    if (child)
+        stream << child << ": ";
+    stream << node_kind_to_string(node.kind);
+
+    switch (node.kind)
+    {
+        case NK_VALUE:
+        {
+            if (node.data == INVALID_INDEX || node.data >= m_constants.size())
+                break;
+
+            const Constant& constant = m_constants[node.data];
+            switch (node.value_kind)
+            {
+                case mi::neuraylib::IValue::VK_BOOL:
+                    stream << " " << (constant.bool_value ? "true" : "false");
+                    break;
+                case mi::neuraylib::IValue::VK_INT:
+                case mi::neuraylib::IValue::VK_ENUM:
+                    stream << " " << constant.int_value;
+                    break;
+                case mi::neuraylib::IValue::VK_FLOAT:
+                    stream << " " << constant.float_value;
+                    break;
+                case mi::neuraylib::IValue::VK_DOUBLE:
+                    stream << " " << constant.double_value;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+
+        case NK_PARAMETER:
+        case NK_TEMPORARY:
+            stream << " " << node.data;
+            break;
+
+        default:
+            break;
+    }
+
+    if (name)
+        stream << " \"" << name << "\"";
+    stream << "\n";
+}
+
+void Compiled_material_snapshot::dump(std::ostream& stream) const
+{
+    // node, child name and indentation of the elements that are not printed yet
+    struct Entry
+    {
+        mi::Uint32 node;
+        mi::Uint32 child_name;
+        mi::Size indent;
+    };
+    std::vector<Entry> stack;
+
+    const mi::Size parameter_count = m_parameters.size();
+    const mi::Size temporary_count = m_temporaries.size();
+    const mi::Size root_count =
+        parameter_count + temporary_count + (m_body != INVALID_INDEX ? 1 : 0);
+    for (mi::Size r = 0; r < root_count; ++r)
+    {
+        Entry root = { m_body, INVALID_INDEX, 1 };
+        if (r < parameter_count)
+        {
+            const char* name = get_string(m_parameter_names[r]);
+            stream << "parameter " << r << " " << (name ? name : "") << "\n";
+            root.node = m_parameters[r];
+        }
+        else if (r < parameter_count + temporary_count)
+        {
+            stream << "temporary " << (r - parameter_count) << "\n";
+            root.node = m_temporaries[r - parameter_count];
+        }
+        else
+            stream << "body\n";
+
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            const Entry entry = stack.back();
+            stack.pop_back();
+
+            stream << std::string(entry.indent * 4, ' ');
+            dump_node(stream, entry.node, entry.child_name);
+
+            // push in reverse, so the first child is printed first
+            const Node& node = m_nodes[entry.node];
+            for (mi::Uint32 c = node.child_count; c > 0; --c)
+            {
+                const mi::Size child = node.first_child + c - 1;
+                const Entry child_entry = {
+                    m_children[child], m_child_names[child], entry.indent + 1 };
+                stack.push_back(child_entry);
+            }
+        }
+    }
+}
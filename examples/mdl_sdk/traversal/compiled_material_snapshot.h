@@ -0,0 +1,192 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/compiled_material_snapshot.h
+//
+// Flattened, index based copy of a compiled material.
+// The expression DAG is converted once into plain arrays that can be walked without virtual
+// calls or interface casts, and that can be written to disk for offline analysis.
+
+#ifndef COMPILED_MATERIAL_SNAPSHOT_H
+#define COMPILED_MATERIAL_SNAPSHOT_H
+
+#include <mi/mdl_sdk.h>
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// A compiled material stored as arrays of compact records.
+//
+// Constant expressions are folded into the value nodes they wrap. Parameter and temporary
+// references are leaf nodes that store the index of the referenced parameter or temporary,
+// so temporaries shared by several parts of the body are stored only once.
+//
+// Nodes are stored in post order, i.e., children precede their parents. Bottom-up analyses
+// can therefore process all nodes in a single linear pass over get_node(0..n-1).
+class Compiled_material_snapshot
+{
+public:
+
+    // Marks missing indices, e.g., the name of an unnamed child.
+    static const mi::Uint32 INVALID_INDEX;
+
+    // The kinds of nodes.
+    enum Node_kind
+    {
+        // A value, the value kind is stored in Node::value_kind.
+        NK_VALUE = 0,
+        // A reference to a material parameter. Node::data is the parameter index.
+        NK_PARAMETER,
+        // A reference to a temporary. Node::data is the temporary index.
+        NK_TEMPORARY,
+        // A direct call. Node::name is the DB name of the called definition.
+        NK_DIRECT_CALL,
+
+        // For alignment only.
+        NK_FORCE_32_BIT = 0xffffffffU
+    };
+
+    // A node of the expression DAG.
+    //
+    // The meaning of name and data depends on the kind:
+    // - bool, int, float and double values: data is the index into the constant pool
+    // - enum values: data is the index into the constant pool, name is the enum value name
+    // - string values: name is the string
+    // - resource values: name is the DB name, data is the string id of the file path
+    // - parameters: name is the parameter name, data is the parameter index
+    // - temporaries: data is the temporary index
+    // - direct calls: name is the DB name of the definition
+    struct Node
+    {
+        mi::Uint8 kind;                 // Node_kind
+        mi::Uint8 value_kind;           // IValue::Kind, valid for values only
+        mi::Uint16 reserved;            // zero, keeps serialized snapshots deterministic
+        mi::Uint32 semantic;            // IFunction_definition::Semantics of direct calls
+        mi::Uint32 type;                // index into the type table
+        mi::Uint32 name;                // string id, see above
+        mi::Uint32 data;                // see above
+        mi::Uint32 first_child;         // index into the child table
+        mi::Uint32 child_count;         // number of children
+    };
+
+    // An entry in the type table. Aliases are resolved, their modifiers are kept.
+    struct Type
+    {
+        mi::Uint32 kind;                // IType::Kind
+        mi::Uint32 modifiers;           // IType::Modifier flags
+        mi::Uint32 name;                // symbol of enums and structs, deferred array size
+        mi::Uint32 element_type;        // element type of vectors, matrices and arrays
+        mi::Uint32 size;                // size of vectors, matrices, arrays; texture shape
+
+        bool operator<(const Type& other) const;
+    };
+
+    // An entry in the constant pool. The value kind of the referencing node selects the member.
+    union Constant
+    {
+        bool bool_value;
+        mi::Sint32 int_value;           // also used for enum values
+        mi::Float32 float_value;
+        mi::Float64 double_value;
+    };
+
+    Compiled_material_snapshot();
+
+    // Converts a compiled material into a snapshot, replacing the current content.
+    //
+    // Param:  transaction     Used to look up the semantics of called definitions.
+    //                         Can be nullptr, in that case all semantics are DS_UNKNOWN.
+    // Param:  material        The material to convert.
+    void build(mi::neuraylib::ITransaction* transaction,
+               const mi::neuraylib::ICompiled_material* material);
+
+    // Removes all content.
+    void clear();
+
+    // Nodes.
+    mi::Size get_node_count() const { return m_nodes.size(); }
+    const Node& get_node(mi::Size index) const { return m_nodes[index]; }
+
+    // Children of a node, the i-th child is get_child(node.first_child + i).
+    // The child name is the argument name for calls and the field name for structs.
+    mi::Uint32 get_child(mi::Size index) const { return m_children[index]; }
+    mi::Uint32 get_child_name(mi::Size index) const { return m_child_names[index]; }
+
+    // Interned strings. The id INVALID_INDEX yields nullptr.
+    mi::Size get_string_count() const { return m_string_offsets.size(); }
+    const char* get_string(mi::Uint32 id) const;
+
+    // Types and constants.
+    mi::Size get_type_count() const { return m_types.size(); }
+    const Type& get_type(mi::Size index) const { return m_types[index]; }
+    mi::Size get_constant_count() const { return m_constants.size(); }
+    const Constant& get_constant(mi::Size index) const { return m_constants[index]; }
+
+    // Material parameters: name and root node of the argument value.
+    mi::Size get_parameter_count() const { return m_parameters.size(); }
+    mi::Uint32 get_parameter_name(mi::Size index) const { return m_parameter_names[index]; }
+    mi::Uint32 get_parameter(mi::Size index) const { return m_parameters[index]; }
+
+    // Temporaries: root node of each temporary.
+    mi::Size get_temporary_count() const { return m_temporaries.size(); }
+    mi::Uint32 get_temporary(mi::Size index) const { return m_temporaries[index]; }
+
+    // Root node of the material body.
+    mi::Uint32 get_body() const { return m_body; }
+
+    // Writes the snapshot in a binary format that can be read by read().
+    // The format is meant for offline analysis on the same platform, it is not portable
+    // across different endianness.
+    //
+    // Return: true in case of success.
+    bool write(std::ostream& stream) const;
+
+    // Reads a snapshot that was written by write(), replacing the current content.
+    //
+    // Return: true in case of success. Otherwise the snapshot is empty.
+    bool read(std::istream& stream);
+
+    // Writes a human readable, indented listing of the parameters, temporaries and body.
+    // The listing walks the arrays with an explicit stack, like the iterative traverser.
+    void dump(std::ostream& stream) const;
+
+private:
+
+    class Builder;
+
+    // Gets the id of a string, adding it if it was not seen before.
+    mi::Uint32 intern(const char* string);
+
+    // Gets the index of a type, adding it and its element types if they were not seen before.
+    mi::Uint32 intern(const mi::neuraylib::IType* type);
+
+    // Writes a single line of the dump for a node.
+    void dump_node(std::ostream& stream, mi::Uint32 node, mi::Uint32 child_name) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<mi::Uint32> m_children;
+    std::vector<mi::Uint32> m_child_names;
+
+    // Zero terminated strings, stored back to back.
+    std::vector<char> m_string_data;
+    std::vector<mi::Uint32> m_string_offsets;
+
+    std::vector<Type> m_types;
+    std::vector<Constant> m_constants;
+
+    std::vector<mi::Uint32> m_parameter_names;
+    std::vector<mi::Uint32> m_parameters;
+    std::vector<mi::Uint32> m_temporaries;
+    mi::Uint32 m_body;
+
+    // Lookup tables that are only used while building.
+    std::map<std::string, mi::Uint32> m_string_ids;
+    std::map<Type, mi::Uint32> m_type_ids;
+    std::map<mi::Uint32, mi::Uint32> m_semantics;
+};
+
+#endif // COMPILED_MATERIAL_SNAPSHOT_H
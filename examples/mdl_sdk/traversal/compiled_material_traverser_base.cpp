@@ -6,6 +6,8 @@
 
 #include "compiled_material_traverser_base.h"
 
+#include <utility>
+
 void Compiled_material_traverser_base::traverse(
     const mi::neuraylib::ICompiled_material* material, void* context) const
 {
@@ -18,7 +20,7 @@ void Compiled_material_traverser_base::traverse(
     {
         const mi::base::Handle<const mi::neuraylib::IValue> arg(material->get_argument(i));
         Parameter parameter(arg.get());
-        traverse(material, Traversal_element(&parameter, param_count, i), context);
+        traverse_element(material, Traversal_element(&parameter, param_count, i), context);
     }
     stage_end(material, ES_PARAMETERS, context);
 
@@ -30,13 +32,13 @@ void Compiled_material_traverser_base::traverse(
         const mi::base::Handle<const mi::neuraylib::IExpression> referenced_expression(
             material->get_temporary(i));
         Temporary temporary(referenced_expression.get());
-        traverse(material, Traversal_element(&temporary, temp_count, i), context);
+        traverse_element(material, Traversal_element(&temporary, temp_count, i), context);
     }
     stage_end(material, ES_TEMPORARIES, context);
 
     // body stage
     stage_begin(material, ES_BODY, context);
-    traverse(material, Traversal_element(body.get()), context);
+    traverse_element(material, Traversal_element(body.get()), context);
     stage_end(material, ES_BODY, context);
 
     // mark finished
@@ -154,6 +156,147 @@ void Compiled_material_traverser_base::traverse(const mi::neuraylib::ICompiled_m
     visit_end(material, element, context);
 }
 
+void Compiled_material_traverser_base::traverse_element(
+    const mi::neuraylib::ICompiled_material* material,
+    const Traversal_element& element,
+    void* context) const
+{
+    if (m_traversal_mode == TM_ITERATIVE)
+        traverse_iterative(material, element, context);
+    else
+        traverse(material, element, context);
+}
+
+void Compiled_material_traverser_base::traverse_iterative(
+    const mi::neuraylib::ICompiled_material* material,
+    const Traversal_element& element,
+    void* context) const
+{
+    // The stack is empty between traversals, but keeps its capacity.
+    m_stack.clear();
+    m_stack.push_back(Frame(element));
+
+    while (!m_stack.empty())
+    {
+        // Note, pushing a frame invalidates this reference.
+        Frame& frame = m_stack.back();
+
+        // First time on top of the stack: visit the element and collect its children.
+        // Parameters, temporaries and constants have a single child that is traversed
+        // without a visit_child call, like in the recursive traversal.
+        if (!frame.expanded)
+        {
+            frame.expanded = true;
+            visit_begin(material, frame.element, context);
+
+            if (frame.element.expression)
+            {
+                switch (frame.element.expression->get_kind())
+                {
+                    case mi::neuraylib::IExpression::EK_CONSTANT:
+                    {
+                        const mi::base::Handle<const mi::neuraylib::IExpression_constant>
+                            expr_const(frame.element.expression->get_interface<
+                                const mi::neuraylib::IExpression_constant>());
+                        frame.constant_value = expr_const->get_value();
+                        frame.child_count = 1;
+                        break;
+                    }
+
+                    case mi::neuraylib::IExpression::EK_DIRECT_CALL:
+                    {
+                        const mi::base::Handle<const mi::neuraylib::IExpression_direct_call>
+                            expr_dcall(frame.element.expression->get_interface<
+                                const mi::neuraylib::IExpression_direct_call>());
+                        frame.arguments = expr_dcall->get_arguments();
+                        frame.child_count = frame.arguments->get_size();
+                        break;
+                    }
+
+                    default:
+                        break; // no children
+                }
+            }
+            else if (frame.element.value)
+            {
+                switch (frame.element.value->get_kind())
+                {
+                    // the following values have children
+                    case mi::neuraylib::IValue::VK_VECTOR:
+                    case mi::neuraylib::IValue::VK_MATRIX:
+                    case mi::neuraylib::IValue::VK_COLOR:
+                    case mi::neuraylib::IValue::VK_ARRAY:
+                    case mi::neuraylib::IValue::VK_STRUCT:
+                    {
+                        frame.compound = frame.element.value->get_interface<
+                            const mi::neuraylib::IValue_compound>();
+                        frame.child_count = frame.compound->get_size();
+                        break;
+                    }
+
+                    default:
+                        break; // no children
+                }
+            }
+            else if (frame.element.parameter || frame.element.temporary)
+            {
+                frame.child_count = 1;
+            }
+        }
+
+        // All children done: finish the element.
+        if (frame.next_child == frame.child_count)
+        {
+            visit_end(material, frame.element, context);
+
+            // batched, if the caller opened a mi::base::Deferred_release_scope
+            mi::base::release_deferred(frame.node);
+            mi::base::release_deferred(frame.arguments);
+            mi::base::release_deferred(frame.compound);
+            mi::base::release_deferred(frame.constant_value);
+            m_stack.pop_back();
+            continue;
+        }
+
+        const mi::Size count = frame.child_count;
+        const mi::Size i = frame.next_child++;
+
+        if (frame.arguments)
+        {
+            mi::base::Handle<const mi::neuraylib::IExpression> expr(
+                frame.arguments->get_expression(i));
+
+            visit_child(material, frame.element, count, i, context);
+            Frame child(Traversal_element(expr.get(), count, i));
+            child.node = std::move(expr);
+            m_stack.push_back(std::move(child));
+        }
+        else if (frame.compound)
+        {
+            mi::base::Handle<const mi::neuraylib::IValue> compound_element(
+                frame.compound->get_value(i));
+
+            visit_child(material, frame.element, count, i, context);
+            Frame child(Traversal_element(compound_element.get(), count, i));
+            child.node = std::move(compound_element);
+            m_stack.push_back(std::move(child));
+        }
+        else if (frame.constant_value)
+        {
+            // the child is kept alive by the constant_value handle of the parent frame
+            m_stack.push_back(Frame(Traversal_element(frame.constant_value.get())));
+        }
+        else if (frame.element.parameter)
+        {
+            m_stack.push_back(Frame(Traversal_element(frame.element.parameter->value)));
+        }
+        else
+        {
+            m_stack.push_back(Frame(Traversal_element(frame.element.temporary->expression)));
+        }
+    }
+}
+
 std::string Compiled_material_traverser_base::get_parameter_name(
     const mi::neuraylib::ICompiled_material* material, mi::Size index,
     bool* out_generated) const
@@ -165,11 +308,16 @@ std::string Compiled_material_traverser_base::get_parameter_name(
     return name;
 }
 
-std::string Compiled_material_traverser_base::get_temporary_name(
+const std::string& Compiled_material_traverser_base::get_temporary_name(
     const mi::neuraylib::ICompiled_material* /*material*/,
     mi::Size index) const
 {
-    std::stringstream s;
-    s << "temporary_" << index;
-    return s.str();
+    // the names only depend on the index, so they are shared by all materials
+    while (m_temporary_names.size() <= index)
+    {
+        std::stringstream s;
+        s << "temporary_" << m_temporary_names.size();
+        m_temporary_names.push_back(s.str());
+    }
+    return m_temporary_names[index];
 }
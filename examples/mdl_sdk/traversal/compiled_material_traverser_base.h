@@ -132,15 +132,44 @@ protected:
 
 public:
 
+    // Possible ways of walking the expression DAG of a compiled material.
+    // Both modes produce the same sequence of visit calls.
+    enum Traversal_mode
+    {
+        // Recursion on the call stack, one level per nesting level of the material.
+        TM_RECURSIVE = 0,
+        // Explicit stack that is kept between traversals. Deeply layered materials do not
+        // exhaust the call stack, and once the stack has grown to the nesting depth of the
+        // traversed materials, no further memory is allocated by the traversal itself.
+        TM_ITERATIVE,
+
+        // For alignment only.
+        TM_FORCE_32_BIT = 0xffffffffU
+    };
+
+    Compiled_material_traverser_base()
+        : m_traversal_mode(TM_ITERATIVE)
+    { }
+
     // virtual destructor
     virtual ~Compiled_material_traverser_base() {}; /* = default;*/
 
+    // Selects the traversal mode used by subsequent traversals.
+    void set_traversal_mode(Traversal_mode mode) { m_traversal_mode = mode; }
+
+    // Gets the traversal mode.
+    Traversal_mode get_traversal_mode() const { return m_traversal_mode; }
+
 
 protected:
 
     // Traverses a compiled material and calls the corresponding virtual visit methods.
     //
     // This method is meant to be called by deriving class to start the actual traversal.
+    // The traversal uses scratch storage of this instance, so concurrent traversals need
+    // separate instances. The iterative traversal drops the interfaces of finished elements
+    // through mi::base::release_deferred(), a mi::base::Deferred_release_scope of the caller
+    // batches these releases.
     //
     // Param:          material    The material that is traversed.
     // Param: [in,out] context     User defined context that is passed through without changes.
@@ -215,16 +244,60 @@ protected:
 
     // Gets the name of a temporary of the traversed material.
     // Since the name is usually unknown, due to optimization, a proper name is generated.
+    // Generated names are kept, so repeated references do not allocate.
     //
     // Param:  material    The material that is traversed.
     // Param:  index       Index of the parameter in the materials temporary list.
     //
     // Return: The temporary name.
-    std::string get_temporary_name(const mi::neuraylib::ICompiled_material* material,
-                                         mi::Size index) const;
+    const std::string& get_temporary_name(const mi::neuraylib::ICompiled_material* material,
+                                          mi::Size index) const;
 
 private:
 
+    // An element on the explicit stack of the iterative traversal.
+    struct Frame
+    {
+        explicit Frame(const Traversal_element& element)
+            : element(element)
+            , child_count(0)
+            , next_child(0)
+            , expanded(false)
+        { }
+
+        // The visited element.
+        Traversal_element element;
+
+        // Keeps the interface of the element alive while it is on the stack.
+        mi::base::Handle<const mi::base::IInterface> node;
+
+        // The arguments of a direct call or the elements of a compound value.
+        mi::base::Handle<const mi::neuraylib::IExpression_list> arguments;
+        mi::base::Handle<const mi::neuraylib::IValue_compound> compound;
+
+        // The value of a constant.
+        mi::base::Handle<const mi::neuraylib::IValue> constant_value;
+
+        // Number of children and the index of the child to traverse next.
+        mi::Size child_count;
+        mi::Size next_child;
+
+        // True after visit_begin was called for the element.
+        bool expanded;
+    };
+
+    // Iterative counterpart of the recursive traverse function.
+    //
+    // Param:          material    The material.
+    // Param:          element     The element to start at.
+    // Param: [in,out] context     User defined context that is passed through without changes.
+    void traverse_iterative(const mi::neuraylib::ICompiled_material* material,
+                            const Traversal_element& element, void* context) const;
+
+    // Traverses an element in the selected traversal mode.
+    void traverse_element(const mi::neuraylib::ICompiled_material* material,
+                          const Traversal_element& element, void* context) const;
+
     // Recursive function that is used for the actual traversal.
     // The names of templates are lost during compilation. Therefore, we generate numbered ones.
     //
@@ -233,6 +306,12 @@ private:
     // Param: [in,out] context     User defined context that is passed through without changes.
     void traverse(const mi::neuraylib::ICompiled_material* material,
                   const Traversal_element& element, void* context) const;
+
+    Traversal_mode m_traversal_mode;
+
+    // Scratch storage, kept between traversals.
+    mutable std::vector<Frame> m_stack;
+    mutable std::vector<std::string> m_temporary_names;
 };
 
 #endif // COMPILED_MATERIAL_TRAVERSER_BASE_H
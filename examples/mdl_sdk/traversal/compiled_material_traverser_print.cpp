@@ -37,7 +37,6 @@ Compiled_material_traverser_print::Context::Context(mi::neuraylib::ITransaction*
 
 void Compiled_material_traverser_print::Context::reset()
 {
-    m_print.str("");
     m_print.clear();
     m_indent = 0;
     m_imports.clear();
@@ -46,7 +45,6 @@ void Compiled_material_traverser_print::Context::reset()
     m_used_resources.clear();
 
     m_parameters_to_inline.clear();
-    m_print_inline_swap.str("");
     m_print_inline_swap.clear();
     m_indent_inline_swap = 0;
 
@@ -60,15 +58,28 @@ std::string Compiled_material_traverser_print::print_mdl(
     Context& context,
     const std::string& original_module_name,
     const std::string& output_material_name) const
+{
+    String_builder output;
+    print_mdl(material, context, original_module_name, output_material_name, output);
+    return output.str();
+}
+
+
+void Compiled_material_traverser_print::print_mdl(
+    const mi::neuraylib::ICompiled_material* material,
+    Context& context,
+    const std::string& original_module_name,
+    const std::string& output_material_name,
+    String_builder& output) const
 {
     // reset in case of reuse
     context.reset();
 
-    // run the traversal and print MDL to the string stream of the context
+    // run the traversal and print MDL to the string builder of the context
     Compiled_material_traverser_base::traverse(material, &context);
 
     // version string
-    std::stringstream output;
+    output.clear();
     output << "mdl 1.5;\n\n";
 
     // add required includes
@@ -89,7 +100,7 @@ std::string Compiled_material_traverser_print::print_mdl(
         if (current_sep_pos == 0) // show imports of the base namespace (just to list them up)
             output << "//* ";
 
-        output << "import " << it->c_str() << ";\n";
+        output << "import " << *it << ";\n";
     }
 
     // ... and other information not directly part of the compiled material.
@@ -99,9 +110,7 @@ std::string Compiled_material_traverser_print::print_mdl(
     output << "export material " << output_material_name << "";
 
     // append the result of the traversal
-    output << context.m_print.str();
-
-    return output.str();
+    output.append(context.m_print);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -433,7 +442,7 @@ void Compiled_material_traverser_print::visit_begin(
             {
                 const mi::base::Handle<const mi::neuraylib::IValue_float> value_float(
                     element.value->get_interface<const mi::neuraylib::IValue_float>());
-                ctx->m_print << std::showpoint << value_float->get_value() << "f";
+                ctx->m_print << value_float->get_value() << "f";
                 return;
             }
 
@@ -441,7 +450,7 @@ void Compiled_material_traverser_print::visit_begin(
             {
                 const mi::base::Handle<const mi::neuraylib::IValue_double> value_double(
                     element.value->get_interface<const mi::neuraylib::IValue_double>());
-                ctx->m_print << std::showpoint << value_double->get_value();
+                ctx->m_print << value_double->get_value();
                 return;
             }
 
@@ -626,16 +635,7 @@ void Compiled_material_traverser_print::visit_begin(
         // we will swap back in the 'visit_end' method
         if (!ctx->m_keep_compiled_material_structure && generated)
         {
-            {
-                // c++11
-                //std::swap(ctx->m_print, ctx->m_print_inline_swap);
-
-                // c++0x (knowing that ctx->m_print will be discarded afterwards)
-                ctx->m_print_inline_swap.str("");
-                ctx->m_print_inline_swap.clear();
-                ctx->m_print_inline_swap << ctx->m_print.str();
-            }
-            ctx->m_print.str("");
+            ctx->m_print.swap(ctx->m_print_inline_swap);
             ctx->m_print.clear();
 
             std::swap(ctx->m_indent, ctx->m_indent_inline_swap);
@@ -928,17 +928,8 @@ void Compiled_material_traverser_print::visit_end(
         if (!ctx->m_keep_compiled_material_structure && generated)
         {
             // keep the printed code and swap back
-            ctx->m_parameters_to_inline[name] = ctx->m_print.str();
-
-            {
-                // c++11
-                //std::swap(ctx->m_print, ctx->m_print_inline_swap);
-                
-                // c++0x (knowing that ctx->m_print_inline_swap will be discarded)
-                ctx->m_print.str("");
-                ctx->m_print.clear();
-                ctx->m_print << ctx->m_print_inline_swap.str();
-            }
+            ctx->m_print.str(ctx->m_parameters_to_inline[name]);
+            ctx->m_print.swap(ctx->m_print_inline_swap);
 
             std::swap(ctx->m_indent, ctx->m_indent_inline_swap);
 
@@ -948,14 +939,10 @@ void Compiled_material_traverser_print::visit_end(
             if (element.sibling_index == element.sibling_count - 1)
             {
                 // therefore we simply check if the last two characters are ",\n"
-                std::string current = ctx->m_print.str();
-                current = current.substr(std::max(size_t(0), current.length() - 2));
-
                 // and if so, we replace them by "\n "
-                if (current == ",\n")
+                if (ctx->m_print.ends_with(",\n"))
                 {
-                    size_t pos = ctx->m_print.tellp();
-                    ctx->m_print.seekp(pos - 2);
+                    ctx->m_print.pop_back(2);
                     ctx->m_print << "\n ";
                 }
             }
@@ -13,6 +13,7 @@
 #define COMPILED_MATERIAL_TRAVERSER_PRINT_H
 
 #include "compiled_material_traverser_base.h"
+#include "string_builder.h"
 #include <stack>
 #include <set>
 #include <map>
@@ -65,8 +66,8 @@ public:
         mi::neuraylib::ITransaction* m_transaction;
         mi::neuraylib::IMdl_compiler* m_compiler;
 
-        // stream to build up the mdl code
-        std::stringstream m_print;
+        // builder to build up the mdl code, its chunks are reused when the context is reused
+        String_builder m_print;
 
         // for formatting
         size_t m_indent;
@@ -81,7 +82,7 @@ public:
         // favor compiler created structure (may create invalid mdl)
         bool m_keep_compiled_material_structure;
         std::map<std::string, std::string> m_parameters_to_inline;
-        std::stringstream m_print_inline_swap;
+        String_builder m_print_inline_swap;
         size_t m_indent_inline_swap;
 
         // relevant only in case we do not inline generated parameters
@@ -108,6 +109,23 @@ public:
                                 const std::string& original_module_name,
                                 const std::string& output_material_name) const;
 
+    // Generates MDL code from a compiled material into a string builder.
+    //
+    // Reusing the context and the output builder for a sequence of materials avoids most
+    // allocations once the buffers have grown to the size of the largest material.
+    // Concurrent calls require separate instances of this class, contexts and builders.
+    //
+    // Param:          material                The material to print.
+    // Param: [in,out] context                 The context that is passed through.
+    // Param:          original_module_name    Name of the original module.
+    // Param:          output_material_name    Name of the output material.
+    // Param: [out]    output                  Receives the generated MDL code.
+    void print_mdl(const mi::neuraylib::ICompiled_material* material,
+                   Context& context,
+                   const std::string& original_module_name,
+                   const std::string& output_material_name,
+                   String_builder& output) const;
+
 protected:
 
     // Called at the beginning of each traversal stage: Parameters, Temporaries and Body.
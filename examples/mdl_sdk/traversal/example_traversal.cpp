@@ -6,17 +6,31 @@
 //
 // Instantiates the materials in a given module, compiles them and recovers mdl code from
 // the compiled material. This shows how to traverse a compiled material.
-
+//
+// The materials are compiled and printed by a pool of worker threads that share one
+// transaction. Every worker owns a traverser, a printer context and an output buffer, which are
+// reused for all materials the worker processes. The printed modules are loaded again one after
+// another afterwards, and the results are reported in the order of the materials in the module.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <stack>
 #include <set>
+#include <vector>
 
 #include <mi/mdl_sdk.h>
 
 #include "example_shared.h"
+#include "example_thread_pool.h"
 #include "compiled_material_traverser_print.h"
+#include "compiled_material_snapshot.h"
+#include "string_builder.h"
 
 void print_help();
 bool consume_cmd_options(int argc, char *argv[]);
@@ -30,6 +44,270 @@ static const bool WRTIE_TO_FILE = true;
 std::string g_qualified_module_name = MODULE_TO_TRAVERSE;
 bool g_use_class_compilation = true;
 bool g_keep_compiled_structure = false;
+bool g_write_snapshot = false;
+size_t g_num_threads = 1;
+
+// The state owned by one worker thread, reused for all materials processed by the worker.
+struct Worker_state
+{
+    Worker_state()
+        : mdl(64 * 1024, 64 * 1024)
+    { }
+
+    // the traverser keeps scratch storage, so every worker needs its own instance
+    Compiled_material_traverser_print printer;
+    std::unique_ptr<Compiled_material_traverser_print::Context> printer_context;
+
+    // the printed mdl code
+    String_builder mdl;
+
+    Compiled_material_snapshot snapshot;
+};
+
+// The outcome of processing one material.
+struct Material_result
+{
+    Material_result()
+        : success(false)
+        , compile_ms(0.0)
+        , print_ms(0.0)
+        , reload_ms(0.0)
+        , mdl_size(0)
+    { }
+
+    std::string material_name;
+    std::string log;        // messages to report on the standard output
+    std::string errors;     // messages to report on the error output
+    bool success;
+
+    // the printed module to load again, empty if the printed code is known to be invalid
+    std::string printed_module_name;
+    std::string printed_mdl;
+
+    // timings in milliseconds and the size of the printed code in bytes
+    double compile_ms;
+    double print_ms;
+    double reload_ms;
+    size_t mdl_size;
+};
+
+// Returns the milliseconds elapsed since a given point in time.
+static double get_elapsed_ms(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// Compiles a material and prints mdl code from the compiled material.
+// Runs on a worker thread. All workers share the transaction, which is only read.
+static void process_material(
+    Worker_state& state,
+    mi::neuraylib::ITransaction* transaction,
+    mi::neuraylib::IMdl_factory* factory,
+    const std::string& module_mdl_name,
+    size_t index,
+    Material_result& result)
+{
+    const std::string& material_name = result.material_name;
+    std::stringstream log;
+    std::stringstream errors;
+    log << "\n[EXAMPLE] info: Started processing material: " << material_name << "\n";
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // assuming the material has parameters without defaults
+    mi::neuraylib::Definition_wrapper definition_wrapper(
+        transaction, material_name.c_str(), factory);
+
+    mi::Sint32 ret = 0;
+    mi::base::Handle<mi::neuraylib::IScene_element> material_instance_se(
+        definition_wrapper.create_instance(nullptr, &ret));
+
+    if (ret < 0 || !material_instance_se)
+    {
+        errors << "[EXAMPLE] error: Failed to create material instance of '"
+               << material_name << "'\n";
+        result.log = log.str();
+        result.errors = errors.str();
+        return;
+    }
+
+    const mi::base::Handle<mi::neuraylib::IMaterial_instance> material_instance(
+        material_instance_se->get_interface<mi::neuraylib::IMaterial_instance>());
+
+    // Compile the material instance
+    const mi::Uint32 flags = g_use_class_compilation
+                           ? mi::neuraylib::IMaterial_instance::CLASS_COMPILATION
+                           : mi::neuraylib::IMaterial_instance::DEFAULT_OPTIONS;
+
+    mi::base::Handle<mi::neuraylib::ICompiled_material> compiled_material(
+        material_instance->create_compiled_material(
+            flags));
+
+    result.compile_ms = get_elapsed_ms(start);
+
+    if (!compiled_material)
+    {
+        errors << "[EXAMPLE] error: Failed to compile material instance of '"
+               << material_name << "'\n";
+        result.log = log.str();
+        result.errors = errors.str();
+        return;
+    }
+
+    // generate mdl from a compiled material
+    // since not all information is available anymore, we need to pass them manually
+
+    std::stringstream number;
+    number << "_" << index;
+    const std::string printed_material_name = std::string(
+        material_name.substr(material_name.rfind("::") + 2)) +
+        number.str() + "_printed";
+
+    // print mdl code into the output buffer of the worker, the interfaces dropped by the
+    // traversal are released in batches
+    start = std::chrono::steady_clock::now();
+    {
+        mi::base::Deferred_release_scope release_scope;
+        state.printer.print_mdl(
+            compiled_material.get(),    // to compiled material to traverse
+            *state.printer_context,     // the context passed through while traversing
+            module_mdl_name,            // the original module path (for include)
+            printed_material_name,      // the name of the output material
+            state.mdl);                 // receives the mdl code
+    }
+    result.print_ms = get_elapsed_ms(start);
+    result.mdl_size = state.mdl.size();
+
+    // optional: print directly referenced modules and resources
+    /*
+    log << "\n";
+    log << "Reconstructed Mdl code for '" << material_name << "'\n";
+    log << "Modules directly imported by the module "
+        << "and used by the material:\n";
+    std::set<std::string>::iterator it = state.printer_context->get_used_modules().begin();
+    std::set<std::string>::iterator end = state.printer_context->get_used_modules().end();
+    for (; it != end; ++it)
+        log << " " << it->c_str() << "\n";
+
+    log << "Resources directly imported by the module "
+        << "and used by the material:\n";
+    it = state.printer_context->get_used_resources().begin();
+    end = state.printer_context->get_used_resources().end();
+    for (; it != end; ++it)
+        log << " " << it->c_str() << "\n";
+    log << "\n";
+    */
+
+    // write to file if enabled
+    if (WRTIE_TO_FILE)
+    {
+        // note the extra underscore: this is used to avoid conflicts while loading
+        std::ofstream file_stream;
+        file_stream.open((printed_material_name + "_.mdl").c_str());
+        if (file_stream)
+        {
+            state.mdl.write(file_stream);
+            file_stream.close();
+        }
+    }
+    else
+    {
+        // print to console instead
+        log << "\n\n\n" << state.mdl.str() << "\n\n\n";
+    }
+
+    // optional: store a flattened snapshot of the compiled material for
+    // offline analysis, along with a readable listing of it
+    if (g_write_snapshot)
+    {
+        state.snapshot.build(transaction, compiled_material.get());
+
+        std::ofstream snapshot_stream(
+            (printed_material_name + ".mdlsnap").c_str(), std::ios::binary);
+        if (!snapshot_stream || !state.snapshot.write(snapshot_stream))
+            errors << "[EXAMPLE] error: Failed to write the snapshot of '"
+                   << material_name << "'\n";
+
+        std::ofstream dump_stream((printed_material_name + ".mdlsnap.txt").c_str());
+        if (dump_stream)
+            state.snapshot.dump(dump_stream);
+
+        log << "[EXAMPLE] info: Snapshot: " << state.snapshot.get_node_count()
+            << " nodes, " << state.snapshot.get_string_count() << " strings, "
+            << state.snapshot.get_type_count() << " types, "
+            << state.snapshot.get_constant_count() << " constants\n";
+    }
+
+    result.success = true;
+
+    // if the resulting printed file is known to be invalid,
+    // we do not try to load it.
+    if (state.printer_context->get_is_valid_mdl())
+    {
+        result.printed_module_name = module_mdl_name + number.str() + "_printed";
+        state.mdl.str(result.printed_mdl);
+    }
+
+    result.log = log.str();
+    result.errors = errors.str();
+}
+
+// Checks if the printed code of a material can be loaded again.
+// Loading modifies the transaction, so this runs for one material after another.
+static void reload_printed_module(
+    mi::neuraylib::ITransaction* transaction,
+    mi::neuraylib::IMdl_compiler* mdl_compiler,
+    Material_result& result)
+{
+    // materials that could not be compiled have reported their errors already
+    if (!result.success)
+        return;
+
+    std::stringstream log;
+    std::stringstream errors;
+
+    if (!result.printed_module_name.empty())
+    {
+        const std::string& printed_module_name = result.printed_module_name;
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const mi::Sint32 ret = mdl_compiler->load_module_from_string(
+            transaction, printed_module_name.c_str(), result.printed_mdl.c_str());
+        result.reload_ms = get_elapsed_ms(start);
+
+        if (ret < 0)
+        {
+            errors << "[EXAMPLE] error: Failed to load generated module: '"
+                   << printed_module_name << "'\n";
+            result.success = false;
+        }
+        else
+        {
+            const mi::base::Handle<const mi::neuraylib::IModule> module_printed(
+                transaction->access<mi::neuraylib::IModule>(
+                    ("mdl" + printed_module_name).c_str()
+                ));
+
+            if (!module_printed)
+            {
+                errors << "[EXAMPLE] error: Loaded generated module is invalid: '"
+                       << printed_module_name << "'\n";
+                result.success = false;
+            }
+        }
+
+        // the code is not needed anymore
+        std::string().swap(result.printed_mdl);
+    }
+
+    log << "[EXAMPLE] info: Timing: compile " << result.compile_ms << " ms, print "
+        << result.print_ms << " ms, reload " << result.reload_ms << " ms, "
+        << result.mdl_size << " bytes of mdl code\n";
+
+    result.log += log.str();
+    result.errors += errors.str();
+}
 
 int main(int argc, char* argv[])
 {
@@ -58,22 +336,26 @@ int main(int argc, char* argv[])
                 neuray->get_api_component<mi::neuraylib::IDatabase>());
             const mi::base::Handle<mi::neuraylib::IScope> scope(
                 database->get_global_scope());
-            const mi::base::Handle<mi::neuraylib::ITransaction> transaction(
-                scope->create_transaction());
 
             // factory to produce default values if not available in the material definition
             mi::base::Handle<mi::neuraylib::IMdl_factory> factory(
                 neuray->get_api_component<mi::neuraylib::IMdl_factory>());
 
+            mi::base::Handle<mi::neuraylib::IMdl_compiler> mdl_compiler(
+                 neuray->get_api_component<mi::neuraylib::IMdl_compiler>());
+
+            // load the selected module and collect its materials. The transaction is
+            // committed, so the module is visible to the transaction of the workers.
+            std::vector<Material_result> results;
+            std::string module_mdl_name;
             {
-                mi::base::Handle<mi::neuraylib::IMdl_compiler> mdl_compiler(
-                     neuray->get_api_component<mi::neuraylib::IMdl_compiler>());
+                const mi::base::Handle<mi::neuraylib::ITransaction> transaction(
+                    scope->create_transaction());
 
                 // Create execution context
                 mi::base::Handle<mi::neuraylib::IMdl_execution_context> context(
                     factory->create_execution_context());
 
-                // load the selected module
                 if (mdl_compiler->load_module(
                     transaction.get(), g_qualified_module_name.c_str(), context.get()) < 0)
                 {
@@ -84,6 +366,7 @@ int main(int argc, char* argv[])
 
                     print_messages(context.get());
                     print_help();
+                    transaction->commit();
                     keep_console_open();
                     return EXIT_FAILURE;
                 }
@@ -93,152 +376,96 @@ int main(int argc, char* argv[])
                         (std::string("mdl") + g_qualified_module_name).c_str()));
                 check_success(mdl_module.is_valid_interface());
 
-                // create an example traverser that allows to print mdl code from compiled materials
-                Compiled_material_traverser_print printer;
+                module_mdl_name = mdl_module->get_mdl_name();
+                results.resize(mdl_module->get_material_count());
+                for (mi::Size i = 0; i < results.size(); ++i)
+                    results[i].material_name = mdl_module->get_material(i);
+
+                mdl_module = 0;
+                transaction->commit();
+            }
 
-                // setup a user defined context that is passed though while traversing
+            // Process all materials exported by the module. The MDL SDK supports only one
+            // transaction at a time, so all workers share one transaction. Compiling and
+            // printing only read from it, loading the printed modules is done afterwards.
+            const std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+            size_t num_threads = 0;
+            {
+                const mi::base::Handle<mi::neuraylib::ITransaction> transaction(
+                    scope->create_transaction());
 
-                // ATTENTION: set the last parameter true to inspect the actual 
-                // structure of the compiled material. However, this may result in 
-                // invalid mdl code, that can not be compiled.
-                Compiled_material_traverser_print::Context printer_context(
-                    transaction.get(),  // used to resolve resources
-                    mdl_compiler.get(), // used to resolve resources 
-                    g_keep_compiled_structure); // show compiler output vs. print valid mdl
+                Thread_pool pool(g_num_threads);
+                num_threads = pool.get_thread_count();
+                std::vector<Worker_state> workers(num_threads);
 
-                // Iterate over all materials exported by the module.
-                mi::Size max_count = mdl_module->get_material_count();
-                for (mi::Size i = 0; i < max_count; ++i)
+                for (size_t i = 0; i < results.size(); ++i)
                 {
-                    std::string material_name = mdl_module->get_material(i);
-                    std::cout << "\n[EXAMPLE] info: Started processing material: " 
-                              << material_name << "\n";
-
-                    // Access the material definition
-                    mi::base::Handle<const mi::neuraylib::IMaterial_definition> material_definition(
-                        transaction->access<mi::neuraylib::IMaterial_definition>(
-                            material_name.c_str()));
-
-                    // assuming the material has parameters without defaults
-                    mi::neuraylib::Definition_wrapper definition_wrapper(
-                        transaction.get(), material_name.c_str(), factory.get());
-
-                    mi::base::Handle<mi::neuraylib::IScene_element> material_instance_se(
-                        definition_wrapper.create_instance(nullptr, &result));
-
-                    if (result < 0)
-                    {
-                        std::cerr << "[EXAMPLE] error: Failed to create material instance of '" 
-                                  << material_name << "'\n";
-                        continue;
-                    }
-
-                    const mi::base::Handle<mi::neuraylib::IMaterial_instance> material_instance(
-                        material_instance_se->get_interface<mi::neuraylib::IMaterial_instance>());
-
-                    // Compile the material instance
-                    const mi::Uint32 flags = g_use_class_compilation
-                                           ? mi::neuraylib::IMaterial_instance::CLASS_COMPILATION
-                                           : mi::neuraylib::IMaterial_instance::DEFAULT_OPTIONS;
-
-                    mi::base::Handle<mi::neuraylib::ICompiled_material> compiled_material(
-                        material_instance->create_compiled_material(
-                            flags));
-
-                    if (!material_instance)
-                    {
-                        std::cerr << "[EXAMPLE] error: Failed to compile material instance of '" 
-                                  << material_name << "'\n";
-                        continue;
-                    }
-
-                    // generate mdl from a compiled material
-                    // since not all information is available anymore, we need to pass them manually
-                    
-                    std::stringstream number;
-                    number << "_" << i;
-                    const std::string printed_material_name = std::string(
-                        material_name.substr(material_name.rfind("::") + 2)) + 
-                        number.str() + "_printed";
-
-                    // print mdl string
-                    const std::string mdl = printer.print_mdl(
-                        compiled_material.get(), // to compiled material to traverse
-                        printer_context,         // the context passed through while traversing
-                        mdl_module->get_mdl_name(), // the original module path (for include)
-                        printed_material_name);  // the name of the output material
-
-                    // optional: print directly referenced modules and resources
-                    /*
-                    std::cout << "\n";
-                    std::cout << "Reconstructed Mdl code for '" << material_name << "'\n";
-                    std::cout << "Modules directly imported by the module " 
-                              << "and used by the material:\n";
-                    std::set<std::string>::iterator it = printer_context.get_used_modules().begin();
-                    std::set<std::string>::iterator end = printer_context.get_used_modules().end();
-                    for (; it != end; ++it)
-                        std::cout << " " << it->c_str() << "\n";
-
-                    std::cout << "Resources directly imported by the module "
-                              << "and used by the material:\n";
-                    it = printer_context.get_used_resources().begin();
-                    end = printer_context.get_used_resources().end();
-                    for (; it != end; ++it)
-                        std::cout << " " << it->c_str() << "\n";
-                    std::cout << "\n";
-                    */
-
-                    // write to file if enabled
-                    if (WRTIE_TO_FILE)
-                    {
-                        // note the extra underscore: this is used to avoid conflicts while loading
-                        std::ofstream file_stream;
-                        file_stream.open((printed_material_name + "_.mdl").c_str());
-                        if (file_stream)
+                    pool.submit([&, i](size_t worker) {
+                        Worker_state& state = workers[worker];
+                        if (!state.printer_context)
                         {
-                            file_stream << mdl;
-                            file_stream.close();
+                            // setup a user defined context that is passed though while
+                            // traversing
+
+                            // ATTENTION: set the last parameter true to inspect the actual 
+                            // structure of the compiled material. However, this may result in 
+                            // invalid mdl code, that can not be compiled.
+                            state.printer_context.reset(
+                                new Compiled_material_traverser_print::Context(
+                                    transaction.get(),       // used to resolve resources
+                                    mdl_compiler.get(),      // used to resolve resources 
+                                    g_keep_compiled_structure)); // show compiler output vs. 
+                                                                 // print valid mdl
                         }
-                    }
-                    else
-                    {
-                        // print to console instead
-                        std::cout << "\n\n\n" << mdl << "\n\n\n";
-                    }
-
-                    // if the resulting printed file is known to be invalid, 
-                    // we do not try to load it.
-                    if (!printer_context.get_is_valid_mdl())
-                        continue;
-
-                    // check if the result can be loaded again
-                    const std::string printed_module_name = 
-                        std::string(mdl_module->get_mdl_name()) + number.str() + "_printed";
-
-                    result = mdl_compiler->load_module_from_string(
-                        transaction.get(), printed_module_name.c_str(), mdl.c_str());
-
-                    if (result < 0)
-                    {
-                        std::cerr << "[EXAMPLE] error: Failed to load generated module: '" 
-                                  << printed_module_name << "'\n";
-                        continue;
-                    }
-
-                    const mi::base::Handle<const mi::neuraylib::IModule> module_printed(
-                        transaction->access<mi::neuraylib::IModule>(
-                            ("mdl" + printed_module_name).c_str()
-                        ));
-
-                    if (!module_printed)
-                    {
-                        std::cerr << "[EXAMPLE] error: Loaded generated module is invalid: '"
-                                  << printed_module_name << "'\n";
-                    }
+
+                        process_material(state, transaction.get(), factory.get(),
+                                         module_mdl_name, i, results[i]);
+                    });
                 }
+                pool.wait();
+
+                // the contexts reference the transaction
+                for (size_t i = 0; i < workers.size(); ++i)
+                    workers[i].printer_context.reset();
+
+                // check if the printed modules can be loaded again, one after another
+                for (size_t i = 0; i < results.size(); ++i)
+                    reload_printed_module(transaction.get(), mdl_compiler.get(), results[i]);
+
+                transaction->commit();
+            }
+            const double total_ms = get_elapsed_ms(start);
+
+            // report in the order of the materials
+            double compile_ms = 0.0;
+            double print_ms = 0.0;
+            double reload_ms = 0.0;
+            size_t slowest = 0;
+            size_t failed = 0;
+            for (size_t i = 0; i < results.size(); ++i)
+            {
+                std::cout << results[i].log;
+                std::cerr << results[i].errors;
+
+                compile_ms += results[i].compile_ms;
+                print_ms += results[i].print_ms;
+                reload_ms += results[i].reload_ms;
+                if (results[i].print_ms > results[slowest].print_ms)
+                    slowest = i;
+                if (!results[i].success)
+                    ++failed;
             }
 
-            transaction->commit();
+            std::cout << "\n[EXAMPLE] info: Processed " << results.size() << " materials ("
+                      << failed << " failed) in " << total_ms << " ms using "
+                      << num_threads << " thread(s)\n";
+            std::cout << "[EXAMPLE] info: Accumulated time: compile " << compile_ms
+                      << " ms, print " << print_ms << " ms, reload " << reload_ms << " ms\n";
+            if (!results.empty())
+                std::cout << "[EXAMPLE] info: Slowest to print: "
+                          << results[slowest].material_name << " ("
+                          << results[slowest].print_ms << " ms)\n";
         }
     }
 
@@ -263,7 +490,8 @@ void print_help()
     std::cerr << "-------------------------------------------------------------------------------";
     std::cerr << std::endl 
               << "Usage: example_traversal <qualified_module_name> [--class|--instance] [--keep]"
-              << std::endl;
+              << " [--snapshot]" << std::endl
+              << "                         [--threads <n>]" << std::endl;
     std::cerr << "-------------------------------------------------------------------------------";
 
     std::cerr << std::endl 
@@ -271,6 +499,15 @@ void print_help()
               << "       example_traversal ::example_modules -class" << std::endl
               << "       example_traversal ::nvidia::core_definitions -instance -keep" << std::endl;
 
+    std::cerr << std::endl
+              << "--snapshot writes a flattened snapshot of each compiled material to"
+              << std::endl
+              << "           <material>.mdlsnap and a readable listing to <material>.mdlsnap.txt"
+              << std::endl;
+    std::cerr << "--threads  number of materials processed concurrently, 0 selects the number"
+              << std::endl
+              << "           of hardware threads (default: 1)" << std::endl;
+
     std::cerr << std::endl 
               << "The following three calls produce identical results:" << std::endl;
     std::cerr << "       example_traversal ::example -class" << std::endl;
@@ -306,6 +543,20 @@ bool consume_cmd_options(int argc, char *argv[])
                 continue;
             }
 
+            // store flattened snapshots of the compiled materials
+            if (cmd == "--snapshot")
+            {
+                g_write_snapshot = true; // default is false
+                continue;
+            }
+
+            // number of worker threads
+            if (cmd == "--threads" && i < argc - 1)
+            {
+                g_num_threads = size_t(std::max(0, atoi(argv[++i])));
+                continue;
+            }
+
             if (cmd == "--help" || cmd == "-h")
             {
                 print_help();
@@ -334,6 +585,9 @@ bool consume_cmd_options(int argc, char *argv[])
         << (g_use_class_compilation ? "true" : "false") << "\n";
     std::cout << "[EXAMPLE] info: Keep compiled structure: "
         << (g_keep_compiled_structure ? "true" : "false") << "\n";
+    std::cout << "[EXAMPLE] info: Write snapshots: "
+        << (g_write_snapshot ? "true" : "false") << "\n";
+    std::cout << "[EXAMPLE] info: Worker threads: " << g_num_threads << "\n";
     std::cout << "\n";
     return true;
 }
\ No newline at end of file
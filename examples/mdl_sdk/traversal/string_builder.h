@@ -0,0 +1,169 @@
+/******************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ *****************************************************************************/
+
+// examples/string_builder.h
+//
+// Append-only text buffer made of fixed-size chunks that are kept when the buffer is cleared.
+
+#ifndef STRING_BUILDER_H
+#define STRING_BUILDER_H
+
+#include <mi/base/types.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// A string builder that stores its content in a list of equally sized chunks.
+//
+// Appending never moves text that was written before, unlike growing a std::string or a
+// std::stringstream. Clearing the builder keeps all chunks, so a builder that is reused for
+// many outputs stops allocating once it has grown to the largest output.
+//
+// Numbers are written like by a std::ostream with default settings, except that floating
+// point numbers always contain a decimal point, like with std::showpoint.
+class String_builder
+{
+public:
+
+    // Creates a builder.
+    //
+    // Param:  chunk_size  Size of each chunk in bytes.
+    // Param:  reserve     Number of bytes that are allocated upfront.
+    explicit String_builder(size_t chunk_size = 64 * 1024, size_t reserve = 0)
+        : m_chunk_size(std::max(chunk_size, size_t(64)))
+        , m_size(0)
+    {
+        this->reserve(reserve);
+    }
+
+    // Allocates chunks until the builder can hold at least the given number of bytes.
+    void reserve(size_t size)
+    {
+        while (m_chunks.size() * m_chunk_size < size)
+            m_chunks.push_back(std::unique_ptr<char[]>(new char[m_chunk_size]));
+    }
+
+    // Number of characters in the builder.
+    size_t size() const { return m_size; }
+
+    bool empty() const { return m_size == 0; }
+
+    // Removes the content, but keeps the allocated chunks.
+    void clear() { m_size = 0; }
+
+    // Exchanges the content and chunks with another builder.
+    void swap(String_builder& other)
+    {
+        m_chunks.swap(other.m_chunks);
+        std::swap(m_chunk_size, other.m_chunk_size);
+        std::swap(m_size, other.m_size);
+    }
+
+    // Gets the character at a position, which has to be less than size().
+    char at(size_t pos) const { return m_chunks[pos / m_chunk_size][pos % m_chunk_size]; }
+
+    // Checks whether the content ends with a given suffix.
+    bool ends_with(const char* suffix) const
+    {
+        const size_t length = strlen(suffix);
+        if (length > m_size)
+            return false;
+        for (size_t i = 0; i < length; ++i)
+            if (at(m_size - length + i) != suffix[i])
+                return false;
+        return true;
+    }
+
+    // Removes characters from the end.
+    void pop_back(size_t count) { m_size -= std::min(count, m_size); }
+
+    String_builder& append(const char* data, size_t size)
+    {
+        reserve(m_size + size);
+        while (size > 0)
+        {
+            const size_t offset = m_size % m_chunk_size;
+            const size_t n = std::min(size, m_chunk_size - offset);
+            memcpy(m_chunks[m_size / m_chunk_size].get() + offset, data, n);
+            m_size += n;
+            data += n;
+            size -= n;
+        }
+        return *this;
+    }
+
+    String_builder& append(const String_builder& other)
+    {
+        for (size_t pos = 0; pos < other.m_size; pos += other.m_chunk_size)
+            append(other.m_chunks[pos / other.m_chunk_size].get(),
+                   std::min(other.m_chunk_size, other.m_size - pos));
+        return *this;
+    }
+
+    String_builder& operator<<(const char* text) { return append(text, strlen(text)); }
+    String_builder& operator<<(const std::string& text)
+    {
+        return append(text.data(), text.size());
+    }
+    String_builder& operator<<(char c) { return append(&c, 1); }
+    String_builder& operator<<(mi::Sint32 value) { return format("%d", value); }
+    String_builder& operator<<(mi::Uint32 value) { return format("%u", value); }
+    String_builder& operator<<(mi::Sint64 value) { return format("%lld", (long long) value); }
+    String_builder& operator<<(mi::Uint64 value)
+    {
+        return format("%llu", (unsigned long long) value);
+    }
+    String_builder& operator<<(mi::Float32 value) { return format("%#g", double(value)); }
+    String_builder& operator<<(mi::Float64 value) { return format("%#g", value); }
+
+    // Copies the content into a string, reusing the capacity of the string.
+    void str(std::string& output) const
+    {
+        output.clear();
+        output.reserve(m_size);
+        for (size_t pos = 0; pos < m_size; pos += m_chunk_size)
+            output.append(m_chunks[pos / m_chunk_size].get(),
+                          std::min(m_chunk_size, m_size - pos));
+    }
+
+    // Returns the content as string.
+    std::string str() const
+    {
+        std::string output;
+        str(output);
+        return output;
+    }
+
+    // Writes the content to a stream without joining the chunks.
+    void write(std::ostream& stream) const
+    {
+        for (size_t pos = 0; pos < m_size; pos += m_chunk_size)
+            stream.write(m_chunks[pos / m_chunk_size].get(),
+                         std::streamsize(std::min(m_chunk_size, m_size - pos)));
+    }
+
+private:
+
+    template<typename T>
+    String_builder& format(const char* format_string, T value)
+    {
+        char buffer[64];
+        const int length = snprintf(buffer, sizeof(buffer), format_string, value);
+        if (length > 0)
+            append(buffer, std::min(size_t(length), sizeof(buffer) - 1));
+        return *this;
+    }
+
+    std::vector<std::unique_ptr<char[]> > m_chunks;
+    size_t m_chunk_size;
+    size_t m_size;
+};
+
+#endif // STRING_BUILDER_H
@@ -14,6 +14,7 @@
 #include <mi/base/condition.h>
 #include <mi/base/config.h>
 #include <mi/base/default_allocator.h>
+#include <mi/base/deferred_release.h>
 #include <mi/base/enums.h>
 #include <mi/base/handle.h>
 #include <mi/base/iallocator.h>
@@ -12,8 +12,13 @@
 #include <mi/base/config.h>
 #include <mi/base/types.h>
 
-// Select implementation to use
-#if defined( MI_ARCH_X86) && defined( MI_COMPILER_MSC)
+// Select implementation to use. All implementations except the generic one store the counter as
+// a plain Uint32, so the layout of Atom32 does not depend on the language standard or the chosen
+// implementation.
+#if defined( MI_COMPILER_GCC) && ( defined( __clang__) || ( __GNUC__ > 4) \
+    || (( __GNUC__ == 4) && ( __GNUC_MINOR__ >= 7)))
+#  define MI_ATOM32_GCCBUILTIN
+#elif defined( MI_ARCH_X86) && defined( MI_COMPILER_MSC)
 #  define MI_ATOM32_X86MSC
 #  include <intrin.h>
 #  pragma intrinsic( _InterlockedExchangeAdd)
@@ -45,7 +50,7 @@ public:
 
 #if defined( MI_ATOM32_GENERIC)
     /// The copy constructor assigns the value of \p other to the counter.
-    Atom32( const mi::base::Atom32& other) : m_value( other.m_value) { }
+    Atom32( const mi::base::Atom32& other) : m_value( Uint32( other)) { }
 
     /// Assigns the value of \p rhs to the counter.
     mi::base::Atom32& operator=( const mi::base::Atom32& rhs);
@@ -78,6 +83,19 @@ public:
     /// Assigns \p rhs to the counter and returns the old value of counter.
     Uint32 swap( const Uint32 rhs);
 
+    /// Increments the counter by one (pre-increment) without ordering other memory accesses.
+    ///
+    /// Sufficient for reference counts, since a new reference is always created from an
+    /// existing one. Implementations without weaker orderings use #operator++().
+    Uint32 increment_relaxed();
+
+    /// Decrements the counter by one (pre-decrement) with acquire-release ordering.
+    ///
+    /// Makes all accesses of other threads that preceded their decrement visible to the thread
+    /// that sees the counter drop to zero, as required for releasing a reference counted object.
+    /// Implementations without weaker orderings use #operator--().
+    Uint32 decrement_acq_rel();
+
 private:
     // The counter.
     volatile Uint32 m_value;
@@ -90,7 +108,54 @@ private:
 
 #if !defined( MI_FOR_DOXYGEN_ONLY)
 
-#if defined( MI_ATOM32_X86MSC)
+#if defined( MI_ATOM32_GCCBUILTIN)
+
+inline Uint32 Atom32::operator+=( const Uint32 rhs)
+{
+    return __atomic_add_fetch( &m_value, rhs, __ATOMIC_SEQ_CST);
+}
+
+inline Uint32 Atom32::operator-=( const Uint32 rhs)
+{
+    return __atomic_sub_fetch( &m_value, rhs, __ATOMIC_SEQ_CST);
+}
+
+inline Uint32 Atom32::operator++()
+{
+    return __atomic_add_fetch( &m_value, 1U, __ATOMIC_SEQ_CST);
+}
+
+inline Uint32 Atom32::operator++( int)
+{
+    return __atomic_fetch_add( &m_value, 1U, __ATOMIC_SEQ_CST);
+}
+
+inline Uint32 Atom32::operator--()
+{
+    return __atomic_sub_fetch( &m_value, 1U, __ATOMIC_SEQ_CST);
+}
+
+inline Uint32 Atom32::operator--( int)
+{
+    return __atomic_fetch_sub( &m_value, 1U, __ATOMIC_SEQ_CST);
+}
+
+inline Uint32 Atom32::swap( const Uint32 rhs)
+{
+    return __atomic_exchange_n( &m_value, rhs, __ATOMIC_SEQ_CST);
+}
+
+inline Uint32 Atom32::increment_relaxed()
+{
+    return __atomic_add_fetch( &m_value, 1U, __ATOMIC_RELAXED);
+}
+
+inline Uint32 Atom32::decrement_acq_rel()
+{
+    return __atomic_sub_fetch( &m_value, 1U, __ATOMIC_ACQ_REL);
+}
+
+#elif defined( MI_ATOM32_X86MSC) // defined( MI_ATOM32_GCCBUILTIN)
 
 __forceinline Uint32 Atom32::operator+=( const Uint32 rhs)
 {
@@ -128,6 +193,16 @@ __forceinline Uint32 Atom32::swap( const Uint32 rhs)
     return _InterlockedExchange( reinterpret_cast<volatile long*>( &m_value), rhs);
 }
 
+inline Uint32 Atom32::increment_relaxed()
+{
+    return ++*this;
+}
+
+inline Uint32 Atom32::decrement_acq_rel()
+{
+    return --*this;
+}
+
 #elif defined( MI_ATOM32_X86GCC) // defined( MI_ATOM32_X86MSC)
 
 inline Uint32 Atom32::operator+=( const Uint32 rhs)
@@ -228,6 +303,16 @@ inline Uint32 Atom32::swap( const Uint32 rhs)
     return retval;
 }
 
+inline Uint32 Atom32::increment_relaxed()
+{
+    return ++*this;
+}
+
+inline Uint32 Atom32::decrement_acq_rel()
+{
+    return --*this;
+}
+
 #elif defined( MI_ATOM32_GENERIC) // defined( MI_ATOM32_X86GCC)
 
 inline mi::base::Atom32& Atom32::operator=( const mi::base::Atom32& rhs)
@@ -280,10 +365,22 @@ inline Uint32 Atom32::swap( const Uint32 rhs)
     return retval;
 }
 
+inline Uint32 Atom32::increment_relaxed()
+{
+    return ++*this;
+}
+
+inline Uint32 Atom32::decrement_acq_rel()
+{
+    return --*this;
+}
+
 #else // MI_ATOM32_GENERIC
-#error One of MI_ATOM32_X86MSC, MI_ATOM32_X86GCC, or MI_ATOM32_GENERIC must be defined. 
+#error One of MI_ATOM32_GCCBUILTIN, MI_ATOM32_X86MSC, MI_ATOM32_X86GCC, or MI_ATOM32_GENERIC \
+       must be defined.
 #endif
 
+#undef MI_ATOM32_GCCBUILTIN
 #undef MI_ATOM32_X86MSC
 #undef MI_ATOM32_X86GCC
 #undef MI_ATOM32_GENERIC
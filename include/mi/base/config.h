@@ -297,6 +297,15 @@
 #define MI_CXX_FEATURE_RVALUE_REFERENCES
 #endif
 
+#if (__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1900))
+/// This macro is defined if the compiler provides \c std::atomic and \c thread_local.
+///
+/// Pre-define \c MI_CXX_FEATURE_NO_ATOMIC to use the compiler-specific implementations instead.
+#if !defined(MI_CXX_FEATURE_NO_ATOMIC)
+#define MI_CXX_FEATURE_ATOMIC
+#endif
+#endif
+
 /*@}*/ // end group mi_base_config
 
 #endif // MI_BASE_CONFIG_H
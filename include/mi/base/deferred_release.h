@@ -0,0 +1,133 @@
+/***************************************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ **************************************************************************************************/
+/// \file mi/base/deferred_release.h
+/// \brief Batched release of interfaces on the calling thread.
+
+#ifndef MI_BASE_DEFERRED_RELEASE_H
+#define MI_BASE_DEFERRED_RELEASE_H
+
+#include <mi/base/config.h> // for MI_CXX_FEATURE_ATOMIC
+#include <mi/base/handle.h>
+#include <mi/base/iinterface.h>
+#include <mi/base/types.h>
+
+#if defined( MI_CXX_FEATURE_ATOMIC) || defined( MI_FOR_DOXYGEN_ONLY)
+
+namespace mi {
+namespace base {
+
+/** \addtogroup mi_base_iinterface
+@{
+*/
+
+/// Collects the interfaces passed to #mi::base::release_deferred() on the calling thread and
+/// releases them in batches.
+///
+/// While a scope exists, #mi::base::release_deferred() adds interfaces to the innermost scope of
+/// the calling thread instead of releasing them. The interfaces are released when the batch is
+/// full, when #flush() is called, and when the scope is destroyed. This moves the reference count
+/// updates and the destruction of objects out of hot loops, e.g., when the handles of a large
+/// expression tree are dropped while the tree is traversed.
+///
+/// Without a scope, #mi::base::release_deferred() releases interfaces immediately, so code that
+/// uses it behaves as before unless a caller opts in by creating a scope.
+///
+/// Scopes can be nested and have to be destroyed on the creating thread in reverse order of
+/// their construction, which is the natural order for local variables.
+///
+///    \par Include File:
+///    <tt> \#include <mi/base/deferred_release.h></tt>
+class Deferred_release_scope
+{
+public:
+    /// The number of interfaces that are collected before they are released.
+    static const Size BATCH_SIZE = 256;
+
+    /// Makes this scope the innermost scope of the calling thread.
+    Deferred_release_scope()
+      : m_count( 0)
+      , m_previous( current())
+    {
+        current() = this;
+    }
+
+    /// Releases all collected interfaces and restores the previous scope of the calling thread.
+    ~Deferred_release_scope()
+    {
+        flush();
+        current() = m_previous;
+    }
+
+    /// Adds an interface to the batch, releasing the batch first if it is full.
+    void defer( const IInterface* iptr)
+    {
+        if( !iptr)
+            return;
+        if( m_count == BATCH_SIZE)
+            flush();
+        m_pending[m_count++] = iptr;
+    }
+
+    /// Releases all collected interfaces, in reverse order of their deferral.
+    ///
+    /// Interfaces that are deferred by destructors running during the flush are released by the
+    /// same flush.
+    void flush()
+    {
+        while( m_count > 0)
+            m_pending[--m_count]->release();
+    }
+
+    /// Returns the number of collected interfaces.
+    Size get_count() const { return m_count; }
+
+    /// Returns the innermost scope of the calling thread, or \c NULL if there is none.
+    static Deferred_release_scope* get_current() { return current(); }
+
+private:
+    // Not copyable.
+    Deferred_release_scope( const Deferred_release_scope&);
+    Deferred_release_scope& operator=( const Deferred_release_scope&);
+
+    // The innermost scope of the calling thread.
+    static Deferred_release_scope*& current()
+    {
+        static thread_local Deferred_release_scope* s_current = 0;
+        return s_current;
+    }
+
+    const IInterface* m_pending[BATCH_SIZE];
+    Size m_count;
+    Deferred_release_scope* m_previous;
+};
+
+/// Releases an interface, deferred to the innermost #mi::base::Deferred_release_scope of the
+/// calling thread if there is one, and immediately otherwise.
+inline void release_deferred( const IInterface* iptr)
+{
+    if( !iptr)
+        return;
+    Deferred_release_scope* scope = Deferred_release_scope::get_current();
+    if( scope)
+        scope->defer( iptr);
+    else
+        iptr->release();
+}
+
+/// Releases the interface of a handle like #mi::base::release_deferred(const IInterface*) and
+/// leaves the handle with an invalid interface.
+template <class Interface>
+inline void release_deferred( Handle<Interface>& handle)
+{
+    release_deferred( static_cast<const IInterface*>( handle.extract()));
+}
+
+/*@}*/ // end group mi_base_iinterface
+
+} // namespace base
+} // namespace mi
+
+#endif // MI_CXX_FEATURE_ATOMIC || MI_FOR_DOXYGEN_ONLY
+
+#endif // MI_BASE_DEFERRED_RELEASE_H
@@ -179,12 +179,22 @@ public:
     }
 
 #ifdef MI_CXX_FEATURE_RVALUE_REFERENCES
-    /// Move constructor.
+    /// Move constructor, takes over the interface of \p other without changing the reference
+    /// count.
     Handle( Self&& other)
       : m_iptr( other.m_iptr)
     {
         other.m_iptr = 0;
     }
+
+    /// Move constructor template which allows the construction from assignment compatible
+    /// interface pointers, takes over the interface of \p other without changing the reference
+    /// count.
+    template <class Interface2>
+    Handle( Handle<Interface2>&& other)
+      : m_iptr( other.extract())
+    {
+    }
 #endif
 
     /// Swap two interfaces.
@@ -229,6 +239,19 @@ public:
         }
         return *this;
     }
+
+    /// Move assignment operator template, releases old interface and takes over the interface of
+    /// \p other without changing its reference count.
+    ///
+    /// This assignment operator allows specifically the assignment of a <tt>Handle< I ></tt> to a
+    /// <tt>Handle< const I ></tt> value, and the promotion of derived interfaces to %base
+    /// interfaces.
+    template <class Interface2>
+    Self& operator=( Handle<Interface2>&& other)
+    {
+        Self( static_cast<Handle<Interface2>&&>( other)).swap( *this);
+        return *this;
+    }
 #endif
 
     /// Assignment operator from interface pointer, releases old interface and assigns new interface
@@ -242,6 +265,19 @@ public:
         return *this;
     }
 
+    /// Gives up the ownership of the current interface without changing the reference count.
+    ///
+    /// The handle holds an invalid interface afterwards. The caller takes over the reference
+    /// and has to release it eventually.
+    ///
+    /// \return   The interface pointer, or \c NULL if the handle holds an invalid interface.
+    Interface* extract()
+    {
+        Interface* iptr = m_iptr;
+        m_iptr = 0;
+        return iptr;
+    }
+
     /// Releases the current interface, decrementing the reference count.
     void reset()
     {
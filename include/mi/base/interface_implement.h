@@ -75,7 +75,7 @@ public:
     /// and returns the new reference count. The operation is thread-safe.
     virtual Uint32 retain() const
     {
-        return ++m_refcnt;
+        return m_refcnt.increment_relaxed();
     }
 
     /// Decrements the reference count.
@@ -85,7 +85,7 @@ public:
     /// zero, the object will be deleted. The operation is thread-safe.
     virtual Uint32 release() const
     {
-        Uint32 cnt = --m_refcnt;
+        Uint32 cnt = m_refcnt.decrement_acq_rel();
         if( !cnt)
             delete this;
         return cnt;
@@ -197,7 +197,7 @@ public:
     /// and returns the new reference count. The operation is thread-safe.
     virtual Uint32 retain() const
     {
-        return ++m_refcnt;
+        return m_refcnt.increment_relaxed();
     }
 
     /// Decrements the reference count.
@@ -207,7 +207,7 @@ public:
     /// zero, the object will be deleted. The operation is thread-safe.
     virtual Uint32 release() const
     {
-        Uint32 cnt = --m_refcnt;
+        Uint32 cnt = m_refcnt.decrement_acq_rel();
         if( !cnt)
             delete this;
         return cnt;
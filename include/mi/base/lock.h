@@ -13,6 +13,12 @@
 
 #include <mi/base/assert.h>
 #include <mi/base/config.h>
+#include <mi/base/types.h>
+
+#if defined( MI_CXX_FEATURE_ATOMIC)
+#include <atomic>
+#include <thread>
+#endif
 
 #ifndef MI_PLATFORM_WINDOWS
 #include <cerrno>
@@ -223,6 +229,273 @@ private:
 #endif
 };
 
+#if defined( MI_CXX_FEATURE_ATOMIC) || defined( MI_FOR_DOXYGEN_ONLY)
+
+/// %Reader-writer lock class.
+///
+/// The lock implements a critical region that can be entered either by one writer or by any
+/// number of readers at a time. Writers acquire the lock exclusively via
+/// #mi::base::Shared_lock::Block, readers acquire it shared via
+/// #mi::base::Shared_lock::Shared_block. The lock is non-recursive, i.e., a thread that holds the
+/// lock in either mode can not lock it again.
+///
+/// The lock counts how often an acquisition had to wait for another thread, which helps to
+/// decide whether a structure needs a different synchronization scheme.
+///
+/// This class is only available if the compiler supports \c std::atomic, see
+/// #MI_CXX_FEATURE_ATOMIC.
+///
+/// \see #mi::base::Shared_lock::Block, #mi::base::Shared_lock::Shared_block
+class Shared_lock
+{
+public:
+    /// Constructor.
+    Shared_lock();
+
+    /// Destructor.
+    ~Shared_lock();
+
+    /// Utility class to acquire a lock exclusively that is released by the destructor.
+    ///
+    /// \see #mi::base::Shared_lock
+    class Block
+    {
+    public:
+        /// Constructor.
+        ///
+        /// \param lock   If not \c NULL, this lock is acquired. If \c NULL, #set() can be used to
+        ///               explicitly acquire a lock later.
+        explicit Block( Shared_lock* lock = 0);
+
+        /// Destructor.
+        ///
+        /// Releases the lock (if it is acquired).
+        ~Block();
+
+        /// Acquires a lock exclusively.
+        ///
+        /// Releases the current lock (if it is set) and acquires the given lock.
+        ///
+        /// This method does nothing if the passed lock is already acquired by this class.
+        ///
+        /// \param lock   The new lock to acquire.
+        void set( Shared_lock* lock);
+
+        /// Tries to acquire a lock exclusively.
+        ///
+        /// Releases the current lock (if it is set) and tries to acquire the given lock.
+        ///
+        /// This method does nothing if the passed lock is already acquired by this class.
+        ///
+        /// \param lock   The new lock to acquire.
+        /// \return       \c true if the lock was acquired, \c false otherwise.
+        bool try_set( Shared_lock* lock);
+
+        /// Releases the lock.
+        ///
+        /// Useful to release the lock before the destructor is called.
+        void release();
+
+    private:
+        // The lock associated with this helper class.
+        Shared_lock* m_lock;
+    };
+
+    /// Utility class to acquire a lock shared that is released by the destructor.
+    ///
+    /// \see #mi::base::Shared_lock
+    class Shared_block
+    {
+    public:
+        /// Constructor.
+        ///
+        /// \param lock   If not \c NULL, this lock is acquired. If \c NULL, #set() can be used to
+        ///               explicitly acquire a lock later.
+        explicit Shared_block( Shared_lock* lock = 0);
+
+        /// Destructor.
+        ///
+        /// Releases the lock (if it is acquired).
+        ~Shared_block();
+
+        /// Acquires a lock shared.
+        ///
+        /// Releases the current lock (if it is set) and acquires the given lock.
+        ///
+        /// This method does nothing if the passed lock is already acquired by this class.
+        ///
+        /// \param lock   The new lock to acquire.
+        void set( Shared_lock* lock);
+
+        /// Tries to acquire a lock shared.
+        ///
+        /// Releases the current lock (if it is set) and tries to acquire the given lock.
+        ///
+        /// This method does nothing if the passed lock is already acquired by this class.
+        ///
+        /// \param lock   The new lock to acquire.
+        /// \return       \c true if the lock was acquired, \c false otherwise.
+        bool try_set( Shared_lock* lock);
+
+        /// Releases the lock.
+        ///
+        /// Useful to release the lock before the destructor is called.
+        void release();
+
+    private:
+        // The lock associated with this helper class.
+        Shared_lock* m_lock;
+    };
+
+    /// Returns the number of exclusive acquisitions that had to wait for another thread.
+    Uint64 get_contention_count() const;
+
+    /// Returns the number of shared acquisitions that had to wait for a writer.
+    Uint64 get_shared_contention_count() const;
+
+protected:
+    /// %Locks the lock exclusively.
+    void lock();
+
+    /// Tries to lock the lock exclusively.
+    bool try_lock();
+
+    /// Unlocks the exclusively locked lock.
+    void unlock();
+
+    /// %Locks the lock shared.
+    void lock_shared();
+
+    /// Tries to lock the lock shared.
+    bool try_lock_shared();
+
+    /// Unlocks the shared locked lock.
+    void unlock_shared();
+
+private:
+    // This class is non-copyable.
+    Shared_lock( Shared_lock const &);
+
+    // This class is non-assignable.
+    Shared_lock& operator=( Shared_lock const &);
+
+#ifndef MI_PLATFORM_WINDOWS
+    // The reader-writer lock implementing the lock.
+    pthread_rwlock_t m_rwlock;
+#else
+    // The slim reader-writer lock implementing the lock.
+    SRWLOCK m_srwlock;
+#endif
+
+    // The number of exclusive acquisitions that had to wait.
+    std::atomic<Uint64> m_contention_count;
+
+    // The number of shared acquisitions that had to wait.
+    std::atomic<Uint64> m_shared_contention_count;
+};
+
+/// %Spin lock class.
+///
+/// The lock implements a critical region that only one thread can enter at a time, like
+/// #mi::base::Lock, but waits without involving the operating system. A waiting thread spins for
+/// a short time and then yields its time slice until the lock becomes available. This is faster
+/// than #mi::base::Lock for critical regions of a few instructions, e.g., updates of small
+/// shared structures, and wastes processor time for long critical regions.
+///
+/// The lock is non-recursive, i.e., a thread that holds the lock can not lock it again. Any
+/// attempt to do so will spin forever.
+///
+/// This class is only available if the compiler supports \c std::atomic, see
+/// #MI_CXX_FEATURE_ATOMIC.
+///
+/// \see #mi::base::Spin_lock::Block
+class Spin_lock
+{
+public:
+    /// The number of times a waiting thread spins before it starts yielding its time slice.
+    static const Uint32 SPIN_COUNT = 64;
+
+    /// Constructor.
+    Spin_lock();
+
+    /// Utility class to acquire a lock that is released by the destructor.
+    ///
+    /// \see #mi::base::Spin_lock
+    class Block
+    {
+    public:
+        /// Constructor.
+        ///
+        /// \param lock   If not \c NULL, this lock is acquired. If \c NULL, #set() can be used to
+        ///               explicitly acquire a lock later.
+        explicit Block( Spin_lock* lock = 0);
+
+        /// Destructor.
+        ///
+        /// Releases the lock (if it is acquired).
+        ~Block();
+
+        /// Acquires a lock.
+        ///
+        /// Releases the current lock (if it is set) and acquires the given lock.
+        ///
+        /// This method does nothing if the passed lock is already acquired by this class.
+        ///
+        /// \param lock   The new lock to acquire.
+        void set( Spin_lock* lock);
+
+        /// Tries to acquire a lock.
+        ///
+        /// Releases the current lock (if it is set) and tries to acquire the given lock.
+        ///
+        /// This method does nothing if the passed lock is already acquired by this class.
+        ///
+        /// \param lock   The new lock to acquire.
+        /// \return       \c true if the lock was acquired, \c false otherwise.
+        bool try_set( Spin_lock* lock);
+
+        /// Releases the lock.
+        ///
+        /// Useful to release the lock before the destructor is called.
+        void release();
+
+    private:
+        // The lock associated with this helper class.
+        Spin_lock* m_lock;
+    };
+
+    /// Returns the number of acquisitions that had to wait for another thread.
+    Uint64 get_contention_count() const;
+
+protected:
+    /// %Locks the lock.
+    void lock();
+
+    /// Tries to lock the lock.
+    bool try_lock();
+
+    /// Unlocks the lock.
+    void unlock();
+
+private:
+    // This class is non-copyable.
+    Spin_lock( Spin_lock const &);
+
+    // This class is non-assignable.
+    Spin_lock& operator=( Spin_lock const &);
+
+    // Tells the processor that the thread is spinning.
+    static void pause();
+
+    // The flag that is set while the lock is held.
+    std::atomic<bool> m_locked;
+
+    // The number of acquisitions that had to wait.
+    std::atomic<Uint64> m_contention_count;
+};
+
+#endif // MI_CXX_FEATURE_ATOMIC || MI_FOR_DOXYGEN_ONLY
+
 #ifndef MI_FOR_DOXYGEN_ONLY
 
 inline Lock::Lock()
@@ -449,6 +722,306 @@ inline void Recursive_lock::Block::release()
     m_lock = 0;
 }
 
+#if defined( MI_CXX_FEATURE_ATOMIC)
+
+inline Shared_lock::Shared_lock()
+  : m_contention_count( 0)
+  , m_shared_contention_count( 0)
+{
+#ifndef MI_PLATFORM_WINDOWS
+    pthread_rwlockattr_t rwlock_attributes;
+    pthread_rwlockattr_init( &rwlock_attributes);
+#if defined( __GLIBC__)
+    // The default of glibc prefers readers, which lets a steady stream of readers starve writers.
+    pthread_rwlockattr_setkind_np(
+        &rwlock_attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init( &m_rwlock, &rwlock_attributes);
+    pthread_rwlockattr_destroy( &rwlock_attributes);
+#else
+    InitializeSRWLock( &m_srwlock);
+#endif
+}
+
+inline Shared_lock::~Shared_lock()
+{
+#ifndef MI_PLATFORM_WINDOWS
+    int result = pthread_rwlock_destroy( &m_rwlock);
+    // Avoid assertion here because it might be mapped to an exception.
+    // mi_base_assert( result == 0);
+    (void) result;
+#endif
+}
+
+inline Uint64 Shared_lock::get_contention_count() const
+{
+    return m_contention_count.load( std::memory_order_relaxed);
+}
+
+inline Uint64 Shared_lock::get_shared_contention_count() const
+{
+    return m_shared_contention_count.load( std::memory_order_relaxed);
+}
+
+inline void Shared_lock::lock()
+{
+    if( try_lock())
+        return;
+    m_contention_count.fetch_add( 1, std::memory_order_relaxed);
+#ifndef MI_PLATFORM_WINDOWS
+    int result = pthread_rwlock_wrlock( &m_rwlock);
+    if( result == EDEADLK) {
+        mi_base_assert( !"Dead lock");
+        abort();
+    }
+#else
+    AcquireSRWLockExclusive( &m_srwlock);
+#endif
+}
+
+inline bool Shared_lock::try_lock()
+{
+#ifndef MI_PLATFORM_WINDOWS
+    int result = pthread_rwlock_trywrlock( &m_rwlock);
+    mi_base_assert( result == 0 || result == EBUSY || result == EDEADLK);
+    return result == 0;
+#else
+    return TryAcquireSRWLockExclusive( &m_srwlock) != 0;
+#endif
+}
+
+inline void Shared_lock::unlock()
+{
+#ifndef MI_PLATFORM_WINDOWS
+    int result = pthread_rwlock_unlock( &m_rwlock);
+    mi_base_assert( result == 0);
+    (void) result;
+#else
+    ReleaseSRWLockExclusive( &m_srwlock);
+#endif
+}
+
+inline void Shared_lock::lock_shared()
+{
+    if( try_lock_shared())
+        return;
+    m_shared_contention_count.fetch_add( 1, std::memory_order_relaxed);
+#ifndef MI_PLATFORM_WINDOWS
+    int result = pthread_rwlock_rdlock( &m_rwlock);
+    if( result == EDEADLK) {
+        mi_base_assert( !"Dead lock");
+        abort();
+    }
+#else
+    AcquireSRWLockShared( &m_srwlock);
+#endif
+}
+
+inline bool Shared_lock::try_lock_shared()
+{
+#ifndef MI_PLATFORM_WINDOWS
+    int result = pthread_rwlock_tryrdlock( &m_rwlock);
+    mi_base_assert( result == 0 || result == EBUSY || result == EDEADLK || result == EAGAIN);
+    return result == 0;
+#else
+    return TryAcquireSRWLockShared( &m_srwlock) != 0;
+#endif
+}
+
+inline void Shared_lock::unlock_shared()
+{
+#ifndef MI_PLATFORM_WINDOWS
+    int result = pthread_rwlock_unlock( &m_rwlock);
+    mi_base_assert( result == 0);
+    (void) result;
+#else
+    ReleaseSRWLockShared( &m_srwlock);
+#endif
+}
+
+inline Shared_lock::Block::Block( Shared_lock* lock)
+{
+    m_lock = lock;
+    if( m_lock)
+        m_lock->lock();
+}
+
+inline Shared_lock::Block::~Block()
+{
+    release();
+}
+
+inline void Shared_lock::Block::set( Shared_lock* lock)
+{
+    if( m_lock == lock)
+        return;
+    if( m_lock)
+        m_lock->unlock();
+    m_lock = lock;
+    if( m_lock)
+        m_lock->lock();
+}
+
+inline bool Shared_lock::Block::try_set( Shared_lock* lock)
+{
+    if( m_lock == lock)
+        return true;
+    if( m_lock)
+        m_lock->unlock();
+    m_lock = lock;
+    if( m_lock && m_lock->try_lock())
+        return true;
+    m_lock = 0;
+    return false;
+}
+
+inline void Shared_lock::Block::release()
+{
+    if( m_lock)
+        m_lock->unlock();
+    m_lock = 0;
+}
+
+inline Shared_lock::Shared_block::Shared_block( Shared_lock* lock)
+{
+    m_lock = lock;
+    if( m_lock)
+        m_lock->lock_shared();
+}
+
+inline Shared_lock::Shared_block::~Shared_block()
+{
+    release();
+}
+
+inline void Shared_lock::Shared_block::set( Shared_lock* lock)
+{
+    if( m_lock == lock)
+        return;
+    if( m_lock)
+        m_lock->unlock_shared();
+    m_lock = lock;
+    if( m_lock)
+        m_lock->lock_shared();
+}
+
+inline bool Shared_lock::Shared_block::try_set( Shared_lock* lock)
+{
+    if( m_lock == lock)
+        return true;
+    if( m_lock)
+        m_lock->unlock_shared();
+    m_lock = lock;
+    if( m_lock && m_lock->try_lock_shared())
+        return true;
+    m_lock = 0;
+    return false;
+}
+
+inline void Shared_lock::Shared_block::release()
+{
+    if( m_lock)
+        m_lock->unlock_shared();
+    m_lock = 0;
+}
+
+inline Spin_lock::Spin_lock()
+  : m_locked( false)
+  , m_contention_count( 0)
+{
+}
+
+inline Uint64 Spin_lock::get_contention_count() const
+{
+    return m_contention_count.load( std::memory_order_relaxed);
+}
+
+inline void Spin_lock::lock()
+{
+    if( try_lock())
+        return;
+    m_contention_count.fetch_add( 1, std::memory_order_relaxed);
+    Uint32 spin = 0;
+    do {
+        // Wait with plain loads, which do not take the cache line away from the lock holder.
+        while( m_locked.load( std::memory_order_relaxed)) {
+            if( spin < SPIN_COUNT) {
+                ++spin;
+                pause();
+            } else
+                std::this_thread::yield();
+        }
+    } while( m_locked.exchange( true, std::memory_order_acquire));
+}
+
+inline bool Spin_lock::try_lock()
+{
+    return !m_locked.load( std::memory_order_relaxed)
+        && !m_locked.exchange( true, std::memory_order_acquire);
+}
+
+inline void Spin_lock::unlock()
+{
+    mi_base_assert( m_locked.load( std::memory_order_relaxed));
+    m_locked.store( false, std::memory_order_release);
+}
+
+inline void Spin_lock::pause()
+{
+#if defined( MI_ARCH_X86) && defined( MI_PLATFORM_WINDOWS)
+    YieldProcessor();
+#elif defined( MI_ARCH_X86) && defined( MI_COMPILER_GCC)
+    __builtin_ia32_pause();
+#elif defined( __aarch64__) && defined( MI_COMPILER_GCC)
+    __asm__ __volatile__( "yield");
+#endif
+}
+
+inline Spin_lock::Block::Block( Spin_lock* lock)
+{
+    m_lock = lock;
+    if( m_lock)
+        m_lock->lock();
+}
+
+inline Spin_lock::Block::~Block()
+{
+    release();
+}
+
+inline void Spin_lock::Block::set( Spin_lock* lock)
+{
+    if( m_lock == lock)
+        return;
+    if( m_lock)
+        m_lock->unlock();
+    m_lock = lock;
+    if( m_lock)
+        m_lock->lock();
+}
+
+inline bool Spin_lock::Block::try_set( Spin_lock* lock)
+{
+    if( m_lock == lock)
+        return true;
+    if( m_lock)
+        m_lock->unlock();
+    m_lock = lock;
+    if( m_lock && m_lock->try_lock())
+        return true;
+    m_lock = 0;
+    return false;
+}
+
+inline void Spin_lock::Block::release()
+{
+    if( m_lock)
+        m_lock->unlock();
+    m_lock = 0;
+}
+
+#endif // MI_CXX_FEATURE_ATOMIC
+
 #endif // MI_FOR_DOXYGEN_ONLY
 
 /*@}*/ // end group mi_base_threads
@@ -13,11 +13,14 @@
 #include <mi/math/version.h>
 #include <mi/math/assert.h>
 #include <mi/math/function.h>
+#include <mi/math/simd.h>
 #include <mi/math/vector.h>
 #include <mi/math/matrix.h>
 #include <mi/math/bbox.h>
+#include <mi/math/batch.h>
 #include <mi/math/color.h>
 #include <mi/math/spectrum.h>
+#include <mi/math/color_batch.h>
 
 namespace mi {
 
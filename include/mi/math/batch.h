@@ -0,0 +1,315 @@
+/***************************************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ **************************************************************************************************/
+/// \file mi/math/batch.h
+/// \brief Transformation of arrays of points, vectors and normals by a single matrix.
+///
+/// See \ref mi_math_batch.
+
+#ifndef MI_MATH_BATCH_H
+#define MI_MATH_BATCH_H
+
+#include <mi/base/types.h>
+#include <mi/math/assert.h>
+#include <mi/math/bbox.h>
+#include <mi/math/matrix.h>
+#include <mi/math/simd.h>
+#include <mi/math/vector.h>
+
+namespace mi {
+
+namespace math {
+
+/** \defgroup mi_math_batch Batch Transformations
+    \ingroup mi_math
+
+    Transformation of arrays of three-dimensional #mi::Float32 points, vectors and normals by a
+    single 4x4 matrix, and bounding boxes of such arrays.
+
+    The functions in this group have the same semantics as #mi::math::transform_point(),
+    #mi::math::transform_vector(), #mi::math::transform_normal_inv(), and
+    #mi::math::transform_normal() applied to each element, but process four elements at a time
+    with the SIMD instructions selected in \ref mi_math_simd.
+
+    The arrays are stored as structure of arrays, i.e., in three separate arrays for the x, y,
+    and z components. For arrays of #mi::math::Vector, calling the functions for single elements
+    is as fast as converting the arrays. The result arrays may be identical to the input arrays,
+    but must not overlap them otherwise.
+
+    \par Include File:
+    <tt> \#include <mi/math/batch.h></tt>
+
+    @{
+*/
+
+/// Transforms arrays of points, vectors or normals by a single matrix.
+///
+/// The matrix is prepared once in the constructor, e.g., the inverse for normals, so an instance
+/// can be reused for any number of arrays.
+///
+/// \see \ref mi_math_batch
+class Batch_transform
+{
+public:
+    /// The kind of the transformed elements.
+    enum Kind {
+        /// Points, see #mi::math::transform_point(const Matrix<T,4,4>&,const Vector<U,3>&).
+        POINT,
+        /// Vectors, see #mi::math::transform_vector(const Matrix<T,4,4>&,const Vector<U,3>&).
+        VECTOR,
+        /// Normals, see #mi::math::transform_normal(). The inverse of the upper-left 3x3
+        /// sub-matrix is computed in the constructor. If it cannot be inverted, normals are
+        /// copied unchanged.
+        NORMAL,
+        /// Normals with the inverse matrix, see
+        /// #mi::math::transform_normal_inv(const Matrix<T,4,4>&,const Vector<U,3>&).
+        NORMAL_INV
+    };
+
+    /// Constructor.
+    ///
+    /// \param mat    the 4x4 transformation matrix, or its inverse for #NORMAL_INV
+    /// \param kind   the kind of the transformed elements
+    Batch_transform( const Matrix<Float32,4,4>& mat, Kind kind);
+
+    /// Returns \c false if the kind is #NORMAL and the sub-matrix cannot be inverted.
+    bool is_invertible() const { return m_invertible; }
+
+    /// Transforms \p count elements stored as structure of arrays.
+    void apply(
+        const Float32* x,
+        const Float32* y,
+        const Float32* z,
+        Float32*       out_x,
+        Float32*       out_y,
+        Float32*       out_z,
+        Size           count) const;
+
+private:
+    // Transforms up to four elements per component array.
+    void apply4(
+        const Float32* x,
+        const Float32* y,
+        const Float32* z,
+        Float32*       out_x,
+        Float32*       out_y,
+        Float32*       out_z) const;
+
+    // The coefficients for the x, y, and z components of the result, applied as row vector
+    // (x, y, z, 1) times this matrix. The translation row is zero for vectors and normals.
+    Float32 m_rows[4][4];
+    // Whether the w component of the result has to be computed, i.e., for projective points.
+    bool m_projective;
+    // Whether the elements are copied unchanged.
+    bool m_copy;
+    bool m_invertible;
+};
+
+/// Transforms \p count points stored as structure of arrays by the 4x4 matrix \p mat.
+///
+/// \see #mi::math::Batch_transform
+inline void transform_points(
+    const Matrix<Float32,4,4>& mat,
+    const Float32* x, const Float32* y, const Float32* z,
+    Float32* out_x, Float32* out_y, Float32* out_z,
+    Size count)
+{
+    Batch_transform( mat, Batch_transform::POINT).apply( x, y, z, out_x, out_y, out_z, count);
+}
+
+/// Transforms \p count vectors stored as structure of arrays by the 4x4 matrix \p mat.
+///
+/// \see #mi::math::Batch_transform
+inline void transform_vectors(
+    const Matrix<Float32,4,4>& mat,
+    const Float32* x, const Float32* y, const Float32* z,
+    Float32* out_x, Float32* out_y, Float32* out_z,
+    Size count)
+{
+    Batch_transform( mat, Batch_transform::VECTOR).apply( x, y, z, out_x, out_y, out_z, count);
+}
+
+/// Transforms \p count normals stored as structure of arrays by the 4x4 matrix \p mat, whose
+/// upper-left 3x3 sub-matrix is inverted once for all normals.
+///
+/// \return   \c false if the sub-matrix cannot be inverted, the normals are copied unchanged then.
+/// \see #mi::math::Batch_transform
+inline bool transform_normals(
+    const Matrix<Float32,4,4>& mat,
+    const Float32* x, const Float32* y, const Float32* z,
+    Float32* out_x, Float32* out_y, Float32* out_z,
+    Size count)
+{
+    Batch_transform transform( mat, Batch_transform::NORMAL);
+    transform.apply( x, y, z, out_x, out_y, out_z, count);
+    return transform.is_invertible();
+}
+
+/// Inserts \p count points stored as structure of arrays into the bounding box \p bbox.
+///
+/// This is the structure of arrays variant of
+/// #mi::math::Bbox<Float32,3>::insert(const Vector*,Size).
+inline void insert(
+    Bbox<Float32,3>& bbox,
+    const Float32* x, const Float32* y, const Float32* z,
+    Size count);
+
+/*@}*/ // end group mi_math_batch
+
+#ifndef MI_FOR_DOXYGEN_ONLY
+
+inline Batch_transform::Batch_transform( const Matrix<Float32,4,4>& mat, Kind kind)
+  : m_projective( false)
+  , m_copy( false)
+  , m_invertible( true)
+{
+    for( Size row = 0; row < 4; ++row)
+        for( Size col = 0; col < 4; ++col)
+            m_rows[row][col] = 0.0f;
+
+    if( kind == NORMAL || kind == NORMAL_INV) {
+        // Like transform_normal(), only the upper-left 3x3 sub-matrix is inverted. The normals
+        // are transformed by the transposed inverse.
+        Matrix<Float32,3,3> sub_mat( sub_matrix<3,3>( mat));
+        if( kind == NORMAL) {
+            m_invertible = sub_mat.invert();
+            m_copy = !m_invertible;
+        }
+        for( Size row = 0; row < 3; ++row)
+            for( Size col = 0; col < 3; ++col)
+                m_rows[row][col] = sub_mat( col, row);
+        return;
+    }
+
+    for( Size row = 0; row < 3; ++row)
+        for( Size col = 0; col < 3; ++col)
+            m_rows[row][col] = mat( row, col);
+    if( kind == POINT) {
+        for( Size col = 0; col < 3; ++col)
+            m_rows[3][col] = mat( 3, col);
+        m_rows[0][3] = mat.xw;
+        m_rows[1][3] = mat.yw;
+        m_rows[2][3] = mat.zw;
+        m_rows[3][3] = mat.ww;
+        m_projective = mat.xw != 0.0f || mat.yw != 0.0f || mat.zw != 0.0f || mat.ww != 1.0f;
+    }
+}
+
+inline void Batch_transform::apply4(
+    const Float32* x,
+    const Float32* y,
+    const Float32* z,
+    Float32*       out_x,
+    Float32*       out_y,
+    Float32*       out_z) const
+{
+    using namespace simd;
+
+    const Float4 vx = load( x);
+    const Float4 vy = load( y);
+    const Float4 vz = load( z);
+
+    Float4 r[3];
+    for( Size col = 0; col < 3; ++col)
+        r[col] = madd( vx, splat( m_rows[0][col]),
+                 madd( vy, splat( m_rows[1][col]),
+                 madd( vz, splat( m_rows[2][col]), splat( m_rows[3][col]))));
+
+    if( m_projective) {
+        // Like transform_point(), divide only if w is neither 0 nor 1.
+        const Float4 w = madd( vx, splat( m_rows[0][3]),
+                         madd( vy, splat( m_rows[1][3]),
+                         madd( vz, splat( m_rows[2][3]), splat( m_rows[3][3]))));
+        const Float4 one = splat( 1.0f);
+        const Float4 keep = bit_or( equal( w, splat( 0.0f)), equal( w, one));
+        const Float4 rw = select( keep, one, div( one, w));
+        for( Size col = 0; col < 3; ++col)
+            r[col] = mul( r[col], rw);
+    }
+
+    store( out_x, r[0]);
+    store( out_y, r[1]);
+    store( out_z, r[2]);
+}
+
+inline void Batch_transform::apply(
+    const Float32* x,
+    const Float32* y,
+    const Float32* z,
+    Float32*       out_x,
+    Float32*       out_y,
+    Float32*       out_z,
+    Size           count) const
+{
+    if( m_copy) {
+        for( Size i = 0; i < count; ++i) {
+            out_x[i] = x[i];
+            out_y[i] = y[i];
+            out_z[i] = z[i];
+        }
+        return;
+    }
+
+    Size i = 0;
+    for( ; i + 4 <= count; i += 4)
+        apply4( x + i, y + i, z + i, out_x + i, out_y + i, out_z + i);
+    if( i == count)
+        return;
+
+    // The remaining elements are padded to four.
+    Float32 in[3][4] = { { 0.0f } };
+    Float32 out[3][4];
+    for( Size k = 0; i + k < count; ++k) {
+        in[0][k] = x[i + k];
+        in[1][k] = y[i + k];
+        in[2][k] = z[i + k];
+    }
+    apply4( in[0], in[1], in[2], out[0], out[1], out[2]);
+    for( Size k = 0; i + k < count; ++k) {
+        out_x[i + k] = out[0][k];
+        out_y[i + k] = out[1][k];
+        out_z[i + k] = out[2][k];
+    }
+}
+
+inline void insert(
+    Bbox<Float32,3>& bbox,
+    const Float32* x, const Float32* y, const Float32* z,
+    Size count)
+{
+    const Float32* values[3] = { x, y, z };
+    const Size simd_count = count & ~Size( 3);
+    for( Size k = 0; k < 3; ++k) {
+        const Float32* p = values[k];
+        Float32& lo = bbox.min[k];
+        Float32& hi = bbox.max[k];
+        if( simd_count > 0) {
+            simd::Float4 lo4 = simd::splat( lo);
+            simd::Float4 hi4 = simd::splat( hi);
+            for( Size i = 0; i < simd_count; i += 4) {
+                const simd::Float4 v = simd::load( p + i);
+                lo4 = simd::min MI_PREVENT_MACRO_EXPAND ( lo4, v);
+                hi4 = simd::max MI_PREVENT_MACRO_EXPAND ( hi4, v);
+            }
+            Float32 lo_values[4], hi_values[4];
+            simd::store( lo_values, lo4);
+            simd::store( hi_values, hi4);
+            for( Size l = 0; l < 4; ++l) {
+                lo = base::min MI_PREVENT_MACRO_EXPAND ( lo, lo_values[l]);
+                hi = base::max MI_PREVENT_MACRO_EXPAND ( hi, hi_values[l]);
+            }
+        }
+        for( Size i = simd_count; i < count; ++i) {
+            lo = base::min MI_PREVENT_MACRO_EXPAND ( lo, p[i]);
+            hi = base::max MI_PREVENT_MACRO_EXPAND ( hi, p[i]);
+        }
+    }
+}
+
+#endif // MI_FOR_DOXYGEN_ONLY
+
+} // namespace math
+
+} // namespace mi
+
+#endif // MI_MATH_BATCH_H
@@ -15,6 +15,7 @@
 #include <mi/math/function.h>
 #include <mi/math/vector.h>
 #include <mi/math/matrix.h>
+#include <mi/math/simd.h>
 
 namespace mi {
 
@@ -375,6 +376,12 @@ public:
         InputIterator first,
         InputIterator last);
 
+    /// Inserts an array of \p count points into this bounding box.
+    ///
+    /// This is equivalent to inserting the points one by one, but uses SIMD instructions for
+    /// #mi::Float32 bounding boxes of dimension 3, see \ref mi_math_simd.
+    void insert( const Vector* points, Size count);
+
 
     /// Returns the translation of this bounding box by vectors that are inside the scaled bounding
     /// box of vectors, i.e., \c t*vbox.
@@ -740,6 +747,57 @@ void Bbox<T,DIM>::insert( InputIterator first, InputIterator last)
         insert( *first);
 }
 
+template <typename T, Size DIM>
+void Bbox<T,DIM>::insert( const Vector* points, Size count)
+{
+    for( Size i = 0; i < count; ++i)
+        insert( points[i]);
+}
+
+#if defined( MI_MATH_SIMD_SSE) || defined( MI_MATH_SIMD_NEON)
+
+template <>
+inline void Bbox<Float32,3>::insert( const Vector* points, Size count)
+{
+    mi_static_assert( sizeof( Vector) == 3 * sizeof( Float32));
+    if( count < 4) {
+        for( Size i = 0; i < count; ++i)
+            insert( points[i]);
+        return;
+    }
+
+    // Four points are loaded as three groups of values (x y z x) (y z x y) (z x y z), so each
+    // lane of the three accumulators always sees the same component.
+    const Float32* p = vector_base_ptr( points[0]);
+    simd::Float4 lo[3], hi[3];
+    for( Size k = 0; k < 3; ++k) {
+        lo[k] = simd::set( min[k % 3], min[(k + 1) % 3], min[(k + 2) % 3], min[k % 3]);
+        hi[k] = simd::set( max[k % 3], max[(k + 1) % 3], max[(k + 2) % 3], max[k % 3]);
+    }
+    const Size simd_count = count & ~Size( 3);
+    for( Size i = 0; i < simd_count; i += 4, p += 12)
+        for( Size k = 0; k < 3; ++k) {
+            const simd::Float4 v = simd::load( p + 4 * k);
+            lo[k] = simd::min MI_PREVENT_MACRO_EXPAND ( lo[k], v);
+            hi[k] = simd::max MI_PREVENT_MACRO_EXPAND ( hi[k], v);
+        }
+
+    Float32 lo_values[12], hi_values[12];
+    for( Size k = 0; k < 3; ++k) {
+        simd::store( lo_values + 4 * k, lo[k]);
+        simd::store( hi_values + 4 * k, hi[k]);
+    }
+    for( Size j = 0; j < 12; ++j) {
+        min[j % 3] = base::min MI_PREVENT_MACRO_EXPAND ( min[j % 3], lo_values[j]);
+        max[j % 3] = base::max MI_PREVENT_MACRO_EXPAND ( max[j % 3], hi_values[j]);
+    }
+
+    for( Size i = simd_count; i < count; ++i)
+        insert( points[i]);
+}
+
+#endif // MI_MATH_SIMD_SSE || MI_MATH_SIMD_NEON
+
 template <typename T, Size DIM>
 template <typename InputIterator>
 Bbox<T,DIM>::Bbox( InputIterator first, InputIterator last)
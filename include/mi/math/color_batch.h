@@ -0,0 +1,322 @@
+/***************************************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ **************************************************************************************************/
+/// \file mi/math/color_batch.h
+/// \brief Gamma correction, tone mapping, clipping and intensities of arrays of colors.
+///
+/// See \ref mi_math_color_batch.
+
+#ifndef MI_MATH_COLOR_BATCH_H
+#define MI_MATH_COLOR_BATCH_H
+
+#include <mi/base/types.h>
+#include <mi/math/assert.h>
+#include <mi/math/color.h>
+#include <mi/math/function.h>
+#include <mi/math/simd.h>
+#include <mi/math/spectrum.h>
+
+namespace mi {
+
+namespace math {
+
+/** \defgroup mi_math_color_batch Batch Color Operations
+    \ingroup mi_math
+
+    Operations on arrays of colors, for example, on the pixel data of a canvas tile.
+
+    The operations work in place on arrays of #mi::math::Color, #mi::math::Spectrum, or
+    #mi::Float32 values, e.g., the data of tiles with the pixel types \c "Color", \c "Rgb_fp", or
+    \c "Float32". They process four values at a time with the SIMD instructions selected in
+    \ref mi_math_simd. The alpha component of colors is left unchanged, except by
+    #mi::math::clip().
+
+    Powers are computed with the approximation of #mi::math::fast_pow_poly(), whose relative error
+    is about 1e-6 for typical gamma values, which is far below the quantization of 8-bit and
+    half-float images.
+
+    \par Include File:
+    <tt> \#include <mi/math/color_batch.h></tt>
+
+    @{
+*/
+
+/// Applies the gamma encoding pow(x,1/\p gamma) to \p count values.
+///
+/// Negative values are set to 0. This is the inverse of #gamma_decode().
+inline void gamma_encode( Float32* values, Size count, Float32 gamma);
+
+/// Applies the gamma decoding pow(x,\p gamma) to \p count values.
+///
+/// Negative values are set to 0. This is the inverse of #gamma_encode().
+inline void gamma_decode( Float32* values, Size count, Float32 gamma);
+
+/// Applies the Reinhard tone mapping operator s/(1+s) with s = \p exposure * x to \p count values.
+///
+/// Negative values are set to 0.
+inline void tone_map_reinhard( Float32* values, Size count, Float32 exposure = 1.0f);
+
+/// Clamps \p count values to [\p low,\p high].
+inline void clamp( Float32* values, Size count, Float32 low, Float32 high);
+
+/// Computes the intensities of \p count RGB triples, weighted according to the CIE standard.
+///
+/// \param rgb           the 3 * \p count components of the triples
+/// \param count         the number of triples
+/// \param intensities   receives the \p count intensities
+/// \see #mi::math::Color::cie_intensity()
+inline void cie_intensity( const Float32* rgb, Size count, Float32* intensities);
+
+/// Applies the gamma encoding pow(x,1/\p gamma) to the RGB components of \p count colors.
+///
+/// This corresponds to #mi::math::gamma_correction(const Color&,Float32) for each color, but
+/// uses the more accurate #mi::math::fast_pow_poly() and sets negative values to 0.
+inline void gamma_encode( Color* colors, Size count, Float32 gamma);
+
+/// Applies the gamma decoding pow(x,\p gamma) to the RGB components of \p count colors.
+///
+/// Negative values are set to 0.
+inline void gamma_decode( Color* colors, Size count, Float32 gamma);
+
+/// Applies the Reinhard tone mapping operator s/(1+s) with s = \p exposure * x to the RGB
+/// components of \p count colors.
+///
+/// Negative values are set to 0.
+inline void tone_map_reinhard( Color* colors, Size count, Float32 exposure = 1.0f);
+
+/// Clips \p count colors into the [0,1] range.
+///
+/// This is the same as #mi::math::Color::clip() for each color.
+inline void clip( Color* colors, Size count, Clip_mode mode = CLIP_RGB, bool desaturate = false);
+
+/// Computes the intensities of \p count colors, weighted according to the CIE standard.
+///
+/// \see #mi::math::Color::cie_intensity()
+inline void cie_intensity( const Color* colors, Size count, Float32* intensities);
+
+/// Applies the gamma encoding pow(x,1/\p gamma) to all components of \p count spectra.
+///
+/// Negative values are set to 0.
+inline void gamma_encode( Spectrum* spectra, Size count, Float32 gamma);
+
+/// Applies the gamma decoding pow(x,\p gamma) to all components of \p count spectra.
+///
+/// Negative values are set to 0.
+inline void gamma_decode( Spectrum* spectra, Size count, Float32 gamma);
+
+/// Applies the Reinhard tone mapping operator s/(1+s) with s = \p exposure * x to all components
+/// of \p count spectra.
+///
+/// Negative values are set to 0.
+inline void tone_map_reinhard( Spectrum* spectra, Size count, Float32 exposure = 1.0f);
+
+/*@}*/ // end group mi_math_color_batch
+
+#ifndef MI_FOR_DOXYGEN_ONLY
+
+namespace simd {
+
+// Raises non-negative values to a fixed power, and sets negative values to 0.
+struct Pow_op
+{
+    Float4 exponent;
+    explicit Pow_op( Float32 e) : exponent( splat( e)) { }
+    Float4 operator()( Float4 a) const { return fast_pow( a, exponent); }
+};
+
+// The Reinhard tone mapping operator.
+struct Reinhard_op
+{
+    Float4 exposure;
+    explicit Reinhard_op( Float32 e) : exposure( splat( e)) { }
+    Float4 operator()( Float4 a) const
+    {
+        const Float4 s = max MI_PREVENT_MACRO_EXPAND ( mul( a, exposure), splat( 0.0f));
+        return div( s, add( s, splat( 1.0f)));
+    }
+};
+
+// Clamps values to a range.
+struct Clamp_op
+{
+    Float4 low;
+    Float4 high;
+    Clamp_op( Float32 l, Float32 h) : low( splat( l)), high( splat( h)) { }
+    Float4 operator()( Float4 a) const
+    {
+        return min MI_PREVENT_MACRO_EXPAND ( max MI_PREVENT_MACRO_EXPAND ( a, low), high);
+    }
+};
+
+// Applies an operation to an array of values, four at a time.
+template <typename Op>
+inline void apply_to_values( Float32* values, Size count, const Op& op)
+{
+    Size i = 0;
+    for( ; i + 4 <= count; i += 4)
+        store( values + i, op( load( values + i)));
+    if( i == count)
+        return;
+
+    // The remaining values are padded to four.
+    Float32 rest[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for( Size k = 0; i + k < count; ++k)
+        rest[k] = values[i + k];
+    store( rest, op( load( rest)));
+    for( Size k = 0; i + k < count; ++k)
+        values[i + k] = rest[k];
+}
+
+// Applies an operation to the RGB components of an array of colors, one color at a time.
+template <typename Op>
+inline void apply_to_colors( Color* colors, Size count, const Op& op)
+{
+    mi_static_assert( sizeof( Color) == 4 * sizeof( Float32));
+
+    const Float4 rgb = less( set( 0.0f, 0.0f, 0.0f, 1.0f), splat( 0.5f));
+    for( Size i = 0; i < count; ++i) {
+        Float32* p = colors[i].begin();
+        const Float4 c = load( p);
+        store( p, select( rgb, op( c), c));
+    }
+}
+
+// Applies an operation to all components of an array of spectra.
+template <typename Op>
+inline void apply_to_spectra( Spectrum* spectra, Size count, const Op& op)
+{
+    mi_static_assert( sizeof( Spectrum) == Spectrum::SIZE * sizeof( Float32));
+
+    if( count > 0)
+        apply_to_values( spectra[0].begin(), count * Spectrum::SIZE, op);
+}
+
+} // namespace simd
+
+inline void gamma_encode( Float32* values, Size count, Float32 gamma)
+{
+    mi_math_assert( gamma > 0);
+    simd::apply_to_values( values, count, simd::Pow_op( 1.0f / gamma));
+}
+
+inline void gamma_decode( Float32* values, Size count, Float32 gamma)
+{
+    mi_math_assert( gamma > 0);
+    simd::apply_to_values( values, count, simd::Pow_op( gamma));
+}
+
+inline void tone_map_reinhard( Float32* values, Size count, Float32 exposure)
+{
+    simd::apply_to_values( values, count, simd::Reinhard_op( exposure));
+}
+
+inline void clamp( Float32* values, Size count, Float32 low, Float32 high)
+{
+    simd::apply_to_values( values, count, simd::Clamp_op( low, high));
+}
+
+inline void cie_intensity( const Float32* rgb, Size count, Float32* intensities)
+{
+    const Float32 R = 0.212671f;
+    const Float32 G = 0.715160f;
+    const Float32 B = 0.072169f;
+
+    // Four triples are loaded as three groups of values (r g b r) (g b r g) (b r g b).
+    const simd::Float4 w0 = simd::set( R, G, B, R);
+    const simd::Float4 w1 = simd::set( G, B, R, G);
+    const simd::Float4 w2 = simd::set( B, R, G, B);
+    Size i = 0;
+    for( ; i + 4 <= count; i += 4, rgb += 12) {
+        Float32 p[12];
+        simd::store( p,     simd::mul( simd::load( rgb),     w0));
+        simd::store( p + 4, simd::mul( simd::load( rgb + 4), w1));
+        simd::store( p + 8, simd::mul( simd::load( rgb + 8), w2));
+        intensities[i]     = p[0] + p[1]  + p[2];
+        intensities[i + 1] = p[3] + p[4]  + p[5];
+        intensities[i + 2] = p[6] + p[7]  + p[8];
+        intensities[i + 3] = p[9] + p[10] + p[11];
+    }
+    for( ; i < count; ++i, rgb += 3)
+        intensities[i] = rgb[0] * R + rgb[1] * G + rgb[2] * B;
+}
+
+inline void gamma_encode( Color* colors, Size count, Float32 gamma)
+{
+    mi_math_assert( gamma > 0);
+    simd::apply_to_colors( colors, count, simd::Pow_op( 1.0f / gamma));
+}
+
+inline void gamma_decode( Color* colors, Size count, Float32 gamma)
+{
+    mi_math_assert( gamma > 0);
+    simd::apply_to_colors( colors, count, simd::Pow_op( gamma));
+}
+
+inline void tone_map_reinhard( Color* colors, Size count, Float32 exposure)
+{
+    simd::apply_to_colors( colors, count, simd::Reinhard_op( exposure));
+}
+
+inline void clip( Color* colors, Size count, Clip_mode mode, bool desaturate)
+{
+    if( desaturate) {
+        for( Size i = 0; i < count; ++i)
+            colors[i] = colors[i].clip( mode, true);
+        return;
+    }
+
+    // Alpha is clipped as in Color::clip(), then RGB is clamped with SIMD instructions.
+    for( Size i = 0; i < count; ++i) {
+        Color& c = colors[i];
+        Float32 alpha = c.a < 0.0f ? 0.0f : c.a;
+        if( mode == CLIP_RGB) {
+            if( alpha < c.r)  alpha = c.r;
+            if( alpha < c.g)  alpha = c.g;
+            if( alpha < c.b)  alpha = c.b;
+        }
+        if( alpha > 1.0f)
+            alpha = 1.0f;
+        const Float32 max_val = mode == CLIP_ALPHA ? alpha : 1.0f;
+        simd::store( c.begin(), simd::Clamp_op( 0.0f, max_val)( simd::load( c.begin())));
+        c.a = alpha;
+    }
+}
+
+inline void cie_intensity( const Color* colors, Size count, Float32* intensities)
+{
+    const simd::Float4 w = simd::set( 0.212671f, 0.715160f, 0.072169f, 0.0f);
+    Size i = 0;
+    for( ; i + 4 <= count; i += 4)
+        simd::store( intensities + i, simd::sum_each(
+            simd::mul( simd::load( colors[i].begin()),     w),
+            simd::mul( simd::load( colors[i + 1].begin()), w),
+            simd::mul( simd::load( colors[i + 2].begin()), w),
+            simd::mul( simd::load( colors[i + 3].begin()), w)));
+    for( ; i < count; ++i)
+        intensities[i] = colors[i].cie_intensity();
+}
+
+inline void gamma_encode( Spectrum* spectra, Size count, Float32 gamma)
+{
+    mi_math_assert( gamma > 0);
+    simd::apply_to_spectra( spectra, count, simd::Pow_op( 1.0f / gamma));
+}
+
+inline void gamma_decode( Spectrum* spectra, Size count, Float32 gamma)
+{
+    mi_math_assert( gamma > 0);
+    simd::apply_to_spectra( spectra, count, simd::Pow_op( gamma));
+}
+
+inline void tone_map_reinhard( Spectrum* spectra, Size count, Float32 exposure)
+{
+    simd::apply_to_spectra( spectra, count, simd::Reinhard_op( exposure));
+}
+
+#endif // MI_FOR_DOXYGEN_ONLY
+
+} // namespace math
+
+} // namespace mi
+
+#endif // MI_MATH_COLOR_BATCH_H
@@ -419,6 +419,81 @@ inline Float32 fast_pow(
     return base::binary_cast<Float32>( static_cast<int>( z));
 }
 
+/// A fast polynomial approximation of log2(x) for floats with bounded error.
+///
+/// The absolute error is below 1e-6 + 1.2e-7 * |log2(x)|, which is considerably more accurate
+/// than #fast_log2(). \p x must be positive and finite; values below the smallest normalized float
+/// are treated as the smallest normalized float.
+inline Float32 fast_log2_poly( Float32 x)
+{
+    const Float32 MIN_NORMAL = 1.17549435e-38f;
+    if( x < MIN_NORMAL)
+        x = MIN_NORMAL;
+
+    // Split x into 2^e * m with m in [sqrt(1/2), sqrt(2)).
+    const Uint32 bits = base::binary_cast<Uint32>( x);
+    Float32 e = static_cast<Float32>( static_cast<Sint32>( bits >> 23) - 127);
+    Float32 m = base::binary_cast<Float32>( (bits & 0x007fffffU) | 0x3f800000U);
+    if( m > 1.41421356f) {
+        m *= 0.5f;
+        e += 1.0f;
+    }
+
+    // log2(1+t) = t * p(t), with a minimax polynomial p of degree 6.
+    const Float32 t = m - 1.0f;
+    Float32 p = 0.176167148f;
+    p = p * t - 0.270977482f;
+    p = p * t + 0.295099747f;
+    p = p * t - 0.359184796f;
+    p = p * t + 0.480648704f;
+    p = p * t - 0.721367694f;
+    p = p * t + 1.44269631f;
+    return e + t * p;
+}
+
+/// A fast polynomial approximation of pow(2,x) for floats with bounded error.
+///
+/// The relative error is below 2e-7, which is considerably more accurate than #fast_pow2().
+/// Results below the smallest normalized float are flushed to zero, results above the largest
+/// float are clamped to it.
+inline Float32 fast_pow2_poly( Float32 x)
+{
+    if( x < -126.0f)
+        return 0.0f;
+    if( x > 127.99999f)
+        x = 127.99999f;
+
+    // 2^x = 2^n * 2^f, with a minimax polynomial of degree 5 for 2^f, f in [0,1).
+    const Float32 n = std::floor( x);
+    const Float32 f = x - n;
+    Float32 p = 0.00187757706f;
+    p = p * f + 0.00898933917f;
+    p = p * f + 0.0558263188f;
+    p = p * f + 0.240153617f;
+    p = p * f + 0.693153073f;
+    p = p * f + 0.999999925f;
+
+    // Add n to the exponent of p, which is in [1,2).
+    const Uint32 bits = base::binary_cast<Uint32>( p)
+        + (static_cast<Uint32>( static_cast<Sint32>( n)) << 23);
+    return base::binary_cast<Float32>( bits);
+}
+
+/// A fast polynomial approximation of pow(x,y) for floats with bounded error.
+///
+/// Combines #fast_log2_poly() and #fast_pow2_poly(). The relative error is below
+/// 2e-7 + |e| * (7e-7 + 1e-7 * |log2(b)|), e.g., about 1e-6 for gamma correction of values in
+/// [2^-16,1], which is considerably more accurate than #fast_pow(). Returns 0 for non-positive
+/// values of \p b.
+inline Float32 fast_pow_poly(
+    Float32 b,  ///< %base
+    Float32 e)  ///< exponent
+{
+    if( !( b > 0.0f))
+        return 0.0f;
+    return fast_pow2_poly( e * fast_log2_poly( b));
+}
+
 /*@}*/ // end group mi_math_approx_function
 
 
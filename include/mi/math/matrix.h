@@ -13,6 +13,7 @@
 #include <mi/base/types.h>
 #include <mi/math/assert.h>
 #include <mi/math/function.h>
+#include <mi/math/simd.h>
 #include <mi/math/vector.h>
 
 namespace mi {
@@ -1950,6 +1951,180 @@ inline Matrix<T,4,4> operator*(
     return temp;
 }
 
+
+//------ Specializations for Float32 using SIMD instructions, see mi/math/simd.h ----------------
+
+// Without SIMD instructions, the general templates are used, which compilers optimize well.
+#if defined( MI_MATH_SIMD_SSE) || defined( MI_MATH_SIMD_NEON)
+
+namespace simd {
+
+// Multiplies the first \c rows rows of a matrix with four columns by a 4x4 matrix. All matrices
+// are stored in row-major order. The result may overwrite \c lhs or \c rhs.
+inline void multiply_rows_4x4(
+    Float32*       result,
+    const Float32* lhs,
+    Size           rows,
+    const Float32* rhs)
+{
+    Size row = 0;
+#if defined( MI_MATH_SIMD_AVX)
+    // Two rows at a time, the in-lane permutation broadcasts lhs(i,k) and lhs(i+1,k) into the
+    // lower and upper half.
+    const __m256 b0 = _mm256_broadcast_ps( reinterpret_cast<const __m128*>( rhs));
+    const __m256 b1 = _mm256_broadcast_ps( reinterpret_cast<const __m128*>( rhs + 4));
+    const __m256 b2 = _mm256_broadcast_ps( reinterpret_cast<const __m128*>( rhs + 8));
+    const __m256 b3 = _mm256_broadcast_ps( reinterpret_cast<const __m128*>( rhs + 12));
+    for( ; row + 2 <= rows; row += 2) {
+        const __m256 l = _mm256_loadu_ps( lhs + 4 * row);
+        const __m256 s01 = _mm256_add_ps(
+            _mm256_mul_ps( _mm256_permute_ps( l, 0x00), b0),
+            _mm256_mul_ps( _mm256_permute_ps( l, 0x55), b1));
+        const __m256 s23 = _mm256_add_ps(
+            _mm256_mul_ps( _mm256_permute_ps( l, 0xaa), b2),
+            _mm256_mul_ps( _mm256_permute_ps( l, 0xff), b3));
+        _mm256_storeu_ps( result + 4 * row, _mm256_add_ps( s01, s23));
+    }
+    if( row == rows)
+        return;
+#endif
+    const Float4 r0 = load( rhs);
+    const Float4 r1 = load( rhs + 4);
+    const Float4 r2 = load( rhs + 8);
+    const Float4 r3 = load( rhs + 12);
+    for( ; row < rows; ++row) {
+        const Float32* l = lhs + 4 * row;
+        const Float4 s01 = madd( splat( l[0]), r0, mul( splat( l[1]), r1));
+        const Float4 s23 = madd( splat( l[2]), r2, mul( splat( l[3]), r3));
+        store( result + 4 * row, add( s01, s23));
+    }
+}
+
+// Returns x * mat.row(0) + y * mat.row(1) + z * mat.row(2).
+inline Float4 combine_rows_3x4(
+    const Float32* mat,
+    Float32        x,
+    Float32        y,
+    Float32        z)
+{
+    const Float4 s01 = madd( splat( x), load( mat), mul( splat( y), load( mat + 4)));
+    return madd( splat( z), load( mat + 8), s01);
+}
+
+// Returns x * mat.row(0) + y * mat.row(1) + z * mat.row(2) + w * mat.row(3).
+inline Float4 combine_rows_4x4(
+    const Float32* mat,
+    Float32        x,
+    Float32        y,
+    Float32        z,
+    Float32        w)
+{
+    const Float4 s01 = madd( splat( x), load( mat), mul( splat( y), load( mat + 4)));
+    const Float4 s23 = madd( splat( z), load( mat + 8), mul( splat( w), load( mat + 12)));
+    return add( s01, s23);
+}
+
+} // namespace simd
+
+// Specialization of common matrix multiplication for 4x4 Float32 matrices.
+template <>
+inline Matrix<Float32,4,4>& operator*=(
+    Matrix<Float32,4,4>&       lhs,
+    const Matrix<Float32,4,4>& rhs)
+{
+    simd::multiply_rows_4x4( lhs.begin(), lhs.begin(), 4, rhs.begin());
+    return lhs;
+}
+
+// Specialization of common matrix multiplication for 4x4 Float32 matrices.
+template <>
+inline Matrix<Float32,4,4> operator*(
+    const Matrix<Float32,4,4>& lhs,
+    const Matrix<Float32,4,4>& rhs)
+{
+    Matrix<Float32,4,4> result;
+    simd::multiply_rows_4x4( result.begin(), lhs.begin(), 4, rhs.begin());
+    return result;
+}
+
+// Specialization of matrix multiplication for 3x4 times 4x4 Float32 matrices.
+template <>
+inline Matrix<Float32,3,4>& operator*=(
+    Matrix<Float32,3,4>&       lhs,
+    const Matrix<Float32,4,4>& rhs)
+{
+    simd::multiply_rows_4x4( lhs.begin(), lhs.begin(), 3, rhs.begin());
+    return lhs;
+}
+
+// Specialization of matrix multiplication for 3x4 times 4x4 Float32 matrices.
+template <>
+inline Matrix<Float32,3,4> operator*(
+    const Matrix<Float32,3,4>& lhs,
+    const Matrix<Float32,4,4>& rhs)
+{
+    Matrix<Float32,3,4> result;
+    simd::multiply_rows_4x4( result.begin(), lhs.begin(), 3, rhs.begin());
+    return result;
+}
+
+// Specialization of the 4x4 Float32 matrix times (column) vector multiplication.
+template <>
+inline Vector<Float32,4> operator*<Float32,4,4,4>(
+    const Matrix<Float32,4,4>& mat,
+    const Vector<Float32,4>&   vec)
+{
+    const Float32* m = mat.begin();
+    const simd::Float4 v = simd::load( vector_base_ptr( vec));
+    Vector<Float32,4> result;
+    simd::store( vector_base_ptr( result), simd::sum_each(
+        simd::mul( simd::load( m), v),     simd::mul( simd::load( m + 4), v),
+        simd::mul( simd::load( m + 8), v), simd::mul( simd::load( m + 12), v)));
+    return result;
+}
+
+// Specialization of the (row) vector times 4x4 Float32 matrix multiplication.
+template <>
+inline Vector<Float32,4> operator*<4,Float32,4,4>(
+    const Vector<Float32,4>&   vec,
+    const Matrix<Float32,4,4>& mat)
+{
+    Vector<Float32,4> result;
+    simd::store( vector_base_ptr( result),
+        simd::combine_rows_4x4( mat.begin(), vec.x, vec.y, vec.z, vec.w));
+    return result;
+}
+
+// Specialization of the 3D point transformation for Float32.
+template <>
+inline Vector<Float32,3> transform_point<Float32,Float32>(
+    const Matrix<Float32,4,4>& mat,
+    const Vector<Float32,3>&   point)
+{
+    Float32 r[4];
+    const Float32* m = mat.begin();
+    simd::store( r, simd::add(
+        simd::combine_rows_3x4( m, point.x, point.y, point.z), simd::load( m + 12)));
+    const Float32 w = r[3];
+    if( w == 0.0f || w == 1.0f) // avoids division
+        return Vector<Float32,3>( r[0], r[1], r[2]);
+    const Float32 rw = 1.0f / w;
+    return Vector<Float32,3>( r[0] * rw, r[1] * rw, r[2] * rw);
+}
+
+// Specialization of the 3D vector transformation for Float32.
+template <>
+inline Vector<Float32,3> transform_vector<Float32,Float32>(
+    const Matrix<Float32,4,4>& mat,
+    const Vector<Float32,3>&   vector)
+{
+    Float32 r[4];
+    simd::store( r, simd::combine_rows_3x4( mat.begin(), vector.x, vector.y, vector.z));
+    return Vector<Float32,3>( r[0], r[1], r[2]);
+}
+
+#endif // MI_MATH_SIMD_SSE || MI_MATH_SIMD_NEON
+
 #endif // MI_FOR_DOXYGEN_ONLY
 
 /*@}*/ // end group mi_math_matrix
@@ -0,0 +1,427 @@
+/***************************************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ **************************************************************************************************/
+/// \file mi/math/simd.h
+/// \brief Compile-time selection of SIMD instructions for the Math API.
+///
+/// See \ref mi_math_simd.
+
+#ifndef MI_MATH_SIMD_H
+#define MI_MATH_SIMD_H
+
+#include <mi/base/config.h>
+#include <mi/base/types.h>
+
+#include <cmath>
+
+/** \defgroup mi_math_simd SIMD Support
+    \ingroup mi_math
+
+    Selection of the SIMD instruction set used by specializations of the Math API.
+
+    Some operations on #mi::Float32 matrices and vectors, for example, the product of 4x4
+    matrices and #mi::math::transform_point(), have specializations that use SIMD instructions.
+    These specializations are disabled by default. Pre-define \c MI_MATH_ENABLE_SIMD to enable
+    them. The instruction set is then chosen at compile time from the target architecture of the
+    compiler:
+
+    - \c MI_MATH_SIMD_AVX is defined if AVX instructions are available, e.g., with \c -mavx or
+      \c /arch:AVX. \c MI_MATH_SIMD_SSE is defined as well in that case.
+    - \c MI_MATH_SIMD_SSE is defined on x86 targets with SSE2 instructions, i.e., on all x86-64
+      targets.
+    - \c MI_MATH_SIMD_NEON is defined on 64-bit ARM targets.
+
+    If none of these macros is defined, the %general templates are used, and the functions in
+    \ref mi_math_batch use scalar code. The results of the specializations may differ from the
+    %general templates in the last bits, since the operations are evaluated in a different order,
+    and possibly with fused multiply-add instructions.
+
+    The specializations are inline and differ between the instruction sets. Therefore, all
+    translation units of a program have to agree on \c MI_MATH_ENABLE_SIMD and have to be
+    compiled for the same instruction set, e.g., all with or all without \c -mavx. Otherwise the
+    program violates the one definition rule. Define the macro on the command line of the
+    compiler for the whole program rather than before individual includes.
+
+    \par Include File:
+    <tt> \#include <mi/math/simd.h></tt>
+*/
+
+#if defined( MI_MATH_ENABLE_SIMD) && !defined( MI_FOR_DOXYGEN_ONLY)
+
+#if defined( __SSE2__) || defined( _M_X64) || ( defined( _M_IX86_FP) && _M_IX86_FP >= 2)
+#define MI_MATH_SIMD_SSE
+#if defined( __AVX__)
+#define MI_MATH_SIMD_AVX
+#endif
+#elif ( defined( __aarch64__) && defined( __ARM_NEON)) || defined( _M_ARM64)
+#define MI_MATH_SIMD_NEON
+#endif
+
+#endif // MI_MATH_ENABLE_SIMD && !MI_FOR_DOXYGEN_ONLY
+
+#if defined( MI_MATH_SIMD_AVX)
+#include <immintrin.h>
+#elif defined( MI_MATH_SIMD_SSE)
+#include <emmintrin.h>
+#elif defined( MI_MATH_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifndef MI_FOR_DOXYGEN_ONLY
+
+namespace mi {
+
+namespace math {
+
+// Thin wrappers around the selected SIMD instruction set, used to write the specializations of
+// the Math API once for all instruction sets. Without SIMD instructions, the operations are
+// implemented with scalar code that compilers can still vectorize.
+namespace simd {
+
+// Four Float32 values.
+struct Float4
+{
+#if defined( MI_MATH_SIMD_SSE)
+    __m128 v;
+#elif defined( MI_MATH_SIMD_NEON)
+    float32x4_t v;
+#else
+    Float32 v[4];
+#endif
+};
+
+// Loads four values from memory, which does not need to be aligned.
+inline Float4 load( const Float32* p)
+{
+    Float4 r;
+#if defined( MI_MATH_SIMD_SSE)
+    r.v = _mm_loadu_ps( p);
+#elif defined( MI_MATH_SIMD_NEON)
+    r.v = vld1q_f32( p);
+#else
+    r.v[0] = p[0]; r.v[1] = p[1]; r.v[2] = p[2]; r.v[3] = p[3];
+#endif
+    return r;
+}
+
+// Stores four values to memory, which does not need to be aligned.
+inline void store( Float32* p, Float4 a)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    _mm_storeu_ps( p, a.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    vst1q_f32( p, a.v);
+#else
+    p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3];
+#endif
+}
+
+// Returns four copies of a value.
+inline Float4 splat( Float32 s)
+{
+    Float4 r;
+#if defined( MI_MATH_SIMD_SSE)
+    r.v = _mm_set1_ps( s);
+#elif defined( MI_MATH_SIMD_NEON)
+    r.v = vdupq_n_f32( s);
+#else
+    r.v[0] = s; r.v[1] = s; r.v[2] = s; r.v[3] = s;
+#endif
+    return r;
+}
+
+// Returns the four values (x, y, z, w).
+inline Float4 set( Float32 x, Float32 y, Float32 z, Float32 w)
+{
+    const Float32 values[4] = { x, y, z, w };
+    return load( values);
+}
+
+inline Float4 add( Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_add_ps( a.v, b.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vaddq_f32( a.v, b.v);
+#else
+    a.v[0] += b.v[0]; a.v[1] += b.v[1]; a.v[2] += b.v[2]; a.v[3] += b.v[3];
+#endif
+    return a;
+}
+
+inline Float4 sub( Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_sub_ps( a.v, b.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vsubq_f32( a.v, b.v);
+#else
+    a.v[0] -= b.v[0]; a.v[1] -= b.v[1]; a.v[2] -= b.v[2]; a.v[3] -= b.v[3];
+#endif
+    return a;
+}
+
+inline Float4 mul( Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_mul_ps( a.v, b.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vmulq_f32( a.v, b.v);
+#else
+    a.v[0] *= b.v[0]; a.v[1] *= b.v[1]; a.v[2] *= b.v[2]; a.v[3] *= b.v[3];
+#endif
+    return a;
+}
+
+inline Float4 div( Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_div_ps( a.v, b.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vdivq_f32( a.v, b.v);
+#else
+    a.v[0] /= b.v[0]; a.v[1] /= b.v[1]; a.v[2] /= b.v[2]; a.v[3] /= b.v[3];
+#endif
+    return a;
+}
+
+// Returns a * b + c, fused if the instruction set supports it.
+inline Float4 madd( Float4 a, Float4 b, Float4 c)
+{
+#if defined( MI_MATH_SIMD_SSE) && defined( __FMA__)
+    a.v = _mm_fmadd_ps( a.v, b.v, c.v);
+    return a;
+#elif defined( MI_MATH_SIMD_NEON)
+    c.v = vfmaq_f32( c.v, a.v, b.v);
+    return c;
+#else
+    return add( mul( a, b), c);
+#endif
+}
+
+// Returns the elementwise minimum. If one of the values is a NaN, the value of b is returned.
+inline Float4 min MI_PREVENT_MACRO_EXPAND ( Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_min_ps( a.v, b.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vbslq_f32( vcltq_f32( a.v, b.v), a.v, b.v);
+#else
+    for( Size i = 0; i < 4; ++i)
+        a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+#endif
+    return a;
+}
+
+// Returns the elementwise maximum. If one of the values is a NaN, the value of b is returned.
+inline Float4 max MI_PREVENT_MACRO_EXPAND ( Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_max_ps( a.v, b.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vbslq_f32( vcgtq_f32( a.v, b.v), a.v, b.v);
+#else
+    for( Size i = 0; i < 4; ++i)
+        a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+#endif
+    return a;
+}
+
+// Returns the elementwise floor. The values have to be in the range of Sint32.
+inline Float4 floor( Float4 a)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    const __m128 t = _mm_cvtepi32_ps( _mm_cvttps_epi32( a.v));
+    a.v = _mm_sub_ps( t, _mm_and_ps( _mm_cmpgt_ps( t, a.v), _mm_set1_ps( 1.0f)));
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vrndmq_f32( a.v);
+#else
+    for( Size i = 0; i < 4; ++i)
+        a.v[i] = std::floor( a.v[i]);
+#endif
+    return a;
+}
+
+// Splits positive normalized values into 2^e * m with m in [1,2) and returns e as float.
+inline Float4 split_exponent( Float4 a, Float4& mantissa)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    const __m128i bits = _mm_castps_si128( a.v);
+    mantissa.v = _mm_castsi128_ps( _mm_or_si128(
+        _mm_and_si128( bits, _mm_set1_epi32( 0x007fffff)), _mm_set1_epi32( 0x3f800000)));
+    a.v = _mm_cvtepi32_ps( _mm_sub_epi32( _mm_srli_epi32( bits, 23), _mm_set1_epi32( 127)));
+#elif defined( MI_MATH_SIMD_NEON)
+    const int32x4_t bits = vreinterpretq_s32_f32( a.v);
+    mantissa.v = vreinterpretq_f32_s32( vorrq_s32(
+        vandq_s32( bits, vdupq_n_s32( 0x007fffff)), vdupq_n_s32( 0x3f800000)));
+    a.v = vcvtq_f32_s32( vsubq_s32( vshrq_n_s32( bits, 23), vdupq_n_s32( 127)));
+#else
+    for( Size i = 0; i < 4; ++i) {
+        const Uint32 bits = base::binary_cast<Uint32>( a.v[i]);
+        mantissa.v[i] = base::binary_cast<Float32>( (bits & 0x007fffffU) | 0x3f800000U);
+        a.v[i] = static_cast<Float32>( static_cast<Sint32>( bits >> 23) - 127);
+    }
+#endif
+    return a;
+}
+
+// Returns a * 2^n for integral n, as long as the result is a normalized float.
+inline Float4 scale_by_pow2( Float4 a, Float4 n)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_castsi128_ps( _mm_add_epi32(
+        _mm_castps_si128( a.v), _mm_slli_epi32( _mm_cvttps_epi32( n.v), 23)));
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vreinterpretq_f32_s32( vaddq_s32(
+        vreinterpretq_s32_f32( a.v), vshlq_n_s32( vcvtq_s32_f32( n.v), 23)));
+#else
+    for( Size i = 0; i < 4; ++i)
+        a.v[i] = base::binary_cast<Float32>( base::binary_cast<Uint32>( a.v[i])
+            + (static_cast<Uint32>( static_cast<Sint32>( n.v[i])) << 23));
+#endif
+    return a;
+}
+
+// Returns a mask of the lanes where a is less than b. Masks are only meant to be passed to
+// bit_or() and select().
+inline Float4 less( Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_cmplt_ps( a.v, b.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vreinterpretq_f32_u32( vcltq_f32( a.v, b.v));
+#else
+    for( Size i = 0; i < 4; ++i)
+        a.v[i] = a.v[i] < b.v[i] ? 1.0f : 0.0f;
+#endif
+    return a;
+}
+
+// Returns a mask of the lanes where a equals b. Masks are only meant to be passed to bit_or()
+// and select().
+inline Float4 equal( Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_cmpeq_ps( a.v, b.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vreinterpretq_f32_u32( vceqq_f32( a.v, b.v));
+#else
+    for( Size i = 0; i < 4; ++i)
+        a.v[i] = a.v[i] == b.v[i] ? 1.0f : 0.0f;
+#endif
+    return a;
+}
+
+// Returns the union of two masks.
+inline Float4 bit_or( Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_or_ps( a.v, b.v);
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vreinterpretq_f32_u32(
+        vorrq_u32( vreinterpretq_u32_f32( a.v), vreinterpretq_u32_f32( b.v)));
+#else
+    for( Size i = 0; i < 4; ++i)
+        a.v[i] = a.v[i] != 0.0f || b.v[i] != 0.0f ? 1.0f : 0.0f;
+#endif
+    return a;
+}
+
+// Returns the lanes of a where the mask is set, and the lanes of b otherwise.
+inline Float4 select( Float4 mask, Float4 a, Float4 b)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    a.v = _mm_or_ps( _mm_and_ps( mask.v, a.v), _mm_andnot_ps( mask.v, b.v));
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vbslq_f32( vreinterpretq_u32_f32( mask.v), a.v, b.v);
+#else
+    for( Size i = 0; i < 4; ++i)
+        a.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i];
+#endif
+    return a;
+}
+
+// Returns (sum of a, sum of b, sum of c, sum of d).
+inline Float4 sum_each( Float4 a, Float4 b, Float4 c, Float4 d)
+{
+#if defined( MI_MATH_SIMD_SSE)
+    _MM_TRANSPOSE4_PS( a.v, b.v, c.v, d.v);
+    return add( add( a, b), add( c, d));
+#elif defined( MI_MATH_SIMD_NEON)
+    a.v = vpaddq_f32( vpaddq_f32( a.v, b.v), vpaddq_f32( c.v, d.v));
+    return a;
+#else
+    Float4 r;
+    r.v[0] = ( a.v[0] + a.v[1]) + ( a.v[2] + a.v[3]);
+    r.v[1] = ( b.v[0] + b.v[1]) + ( b.v[2] + b.v[3]);
+    r.v[2] = ( c.v[0] + c.v[1]) + ( c.v[2] + c.v[3]);
+    r.v[3] = ( d.v[0] + d.v[1]) + ( d.v[2] + d.v[3]);
+    return r;
+#endif
+}
+
+// Returns the sum of the four values.
+inline Float32 sum( Float4 a)
+{
+    Float32 values[4];
+    store( values, a);
+    return ( values[0] + values[1]) + ( values[2] + values[3]);
+}
+
+// The same approximation as mi::math::fast_log2_poly() in mi/math/function.h.
+inline Float4 fast_log2( Float4 a)
+{
+    a = max MI_PREVENT_MACRO_EXPAND ( a, splat( 1.17549435e-38f));
+
+    Float4 m;
+    Float4 e = split_exponent( a, m);
+    const Float4 above = less( splat( 1.41421356f), m);
+    m = select( above, mul( m, splat( 0.5f)), m);
+    e = add( e, select( above, splat( 1.0f), splat( 0.0f)));
+
+    const Float4 t = sub( m, splat( 1.0f));
+    Float4 p = splat( 0.176167148f);
+    p = madd( p, t, splat( -0.270977482f));
+    p = madd( p, t, splat( 0.295099747f));
+    p = madd( p, t, splat( -0.359184796f));
+    p = madd( p, t, splat( 0.480648704f));
+    p = madd( p, t, splat( -0.721367694f));
+    p = madd( p, t, splat( 1.44269631f));
+    return madd( t, p, e);
+}
+
+// The same approximation as mi::math::fast_pow2_poly() in mi/math/function.h.
+inline Float4 fast_pow2( Float4 a)
+{
+    const Float4 underflow = less( a, splat( -126.0f));
+    a = min MI_PREVENT_MACRO_EXPAND ( a, splat( 127.99999f));
+    a = max MI_PREVENT_MACRO_EXPAND ( a, splat( -126.0f));
+
+    const Float4 n = floor( a);
+    const Float4 f = sub( a, n);
+    Float4 p = splat( 0.00187757706f);
+    p = madd( p, f, splat( 0.00898933917f));
+    p = madd( p, f, splat( 0.0558263188f));
+    p = madd( p, f, splat( 0.240153617f));
+    p = madd( p, f, splat( 0.693153073f));
+    p = madd( p, f, splat( 0.999999925f));
+    return select( underflow, splat( 0.0f), scale_by_pow2( p, n));
+}
+
+// The same approximation as mi::math::fast_pow_poly() in mi/math/function.h.
+inline Float4 fast_pow( Float4 b, Float4 e)
+{
+    const Float4 zero = splat( 0.0f);
+    const Float4 positive = less( zero, b);
+    return select( positive, fast_pow2( mul( e, fast_log2( b))), zero);
+}
+
+} // namespace simd
+
+} // namespace math
+
+} // namespace mi
+
+#endif // MI_FOR_DOXYGEN_ONLY
+
+#endif // MI_MATH_SIMD_H
@@ -13,6 +13,7 @@
 #include <mi/math.h>
 
 #include <mi/neuraylib/annotation_wrapper.h>
+#include <mi/neuraylib/argument_batch_editor.h>
 #include <mi/neuraylib/argument_editor.h>
 #include <mi/neuraylib/assert.h>
 #include <mi/neuraylib/bsdf_isotropic_data.h>
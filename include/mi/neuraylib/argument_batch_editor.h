@@ -0,0 +1,591 @@
+/***************************************************************************************************
+ * Copyright 2019 NVIDIA Corporation. All rights reserved.
+ **************************************************************************************************/
+/// \file
+/// \brief   Utility class to change many arguments of MDL material instances and function calls.
+
+#ifndef MI_NEURAYLIB_ARGUMENT_BATCH_EDITOR_H
+#define MI_NEURAYLIB_ARGUMENT_BATCH_EDITOR_H
+
+#include <mi/base/handle.h>
+#include <mi/neuraylib/assert.h>
+#include <mi/neuraylib/iexpression.h>
+#include <mi/neuraylib/ifunction_call.h>
+#include <mi/neuraylib/imaterial_instance.h>
+#include <mi/neuraylib/imdl_factory.h>
+#include <mi/neuraylib/itransaction.h>
+#include <mi/neuraylib/itype.h>
+#include <mi/neuraylib/ivalue.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mi {
+
+namespace neuraylib {
+
+/** \addtogroup mi_neuray_mdl_elements
+@{
+*/
+
+/// A wrapper around MDL material instances and function calls that changes many arguments at once.
+///
+/// #mi::neuraylib::Argument_editor edits the material instance or function call, fetches all
+/// arguments, and creates a new value and expression for each single change. This is convenient,
+/// but too expensive for tools that change hundreds of arguments per frame.
+///
+/// The batch editor stages changes of argument values locally instead. The value and expression
+/// factories are created once, and parameter names are mapped to indices by a cached table. A
+/// staged value is created on the first change of an argument and modified in place by subsequent
+/// changes of the same argument, including changes of components or fields. #commit() applies all
+/// staged changes in a single edit of the DB element with a single call of \c set_arguments().
+///
+/// Staged changes are visible to #get_value() of this editor, but not to other users of the DB
+/// element until #commit() is called. Changes that have not been committed are discarded when the
+/// editor is destroyed.
+///
+/// The editor caches the arguments of the DB element. They are fetched in the constructor and
+/// fetched again by #commit(), before and after the staged changes are applied. Changes of the DB
+/// element by other means, e.g., by #mi::neuraylib::Argument_editor, are therefore visible to
+/// this editor after the next #commit(). Only the arguments with staged changes are set by
+/// #commit(), all other arguments keep their current values.
+///
+/// See also #mi::neuraylib::Argument_editor for changes of calls and array sizes.
+class Argument_batch_editor
+{
+public:
+
+    /// \name General methods
+    //@{
+
+    /// Constructs an MDL argument batch editor for a fixed material instance or function call.
+    ///
+    /// \param transaction   The transaction to be used.
+    /// \param name          The name of the wrapped material instance or function call.
+    /// \param mdl_factory   A pointer to the API component #mi::neuraylib::IMdl_factory.
+    Argument_batch_editor( ITransaction* transaction, const char* name, IMdl_factory* mdl_factory);
+
+    /// Indicates whether the argument batch editor is in a valid state.
+    ///
+    /// The editor is valid if and only if the name passed in the constructor identifies a
+    /// material instance or function call. If it returns \c false, no other methods of this class
+    /// should be called.
+    bool is_valid() const;
+
+    /// Indicates whether the editor acts on a material instance or on a function call.
+    ///
+    /// \return    Either #mi::neuraylib::ELEMENT_TYPE_MATERIAL_INSTANCE, or
+    ///            #mi::neuraylib::ELEMENT_TYPE_FUNCTION_CALL, or undefined if #is_valid()
+    ///            return \c false.
+    Element_type get_type() const;
+
+    /// Returns the number of parameters.
+    Size get_parameter_count() const;
+
+    /// Returns the name of the parameter at \p index.
+    ///
+    /// \param index    The index of the parameter.
+    /// \return         The name of the parameter, or \c NULL if \p index is out of range.
+    const char* get_parameter_name( Size index) const;
+
+    /// Returns the index position of a parameter.
+    ///
+    /// The indices are cached when the editor is constructed.
+    ///
+    /// \param name     The name of the parameter.
+    /// \return         The index of the parameter, or -1 if \p name is invalid.
+    Size get_parameter_index( const char* name) const;
+
+    /// Get the DB name of the MDL function call or material instance.
+    const std::string& get_name() const;
+
+    //@}
+    /// \name Methods related to constant expressions for arguments
+    //@{
+
+    /// Returns a non-compound argument (values of constants only, no calls).
+    ///
+    /// Returns the staged value if the argument has been changed since the last #commit().
+    ///
+    /// If a literal \c 0 is passed for \p parameter_index, the call is ambiguous. You need to
+    /// explicitly cast the value to #mi::Size.
+    ///
+    /// \param parameter_index  The index of the argument in question.
+    /// \param[out] value       The current value of the specified argument.
+    /// \return
+    ///                         -  0: Success.
+    ///                         - -1: #is_valid() returns \c false.
+    ///                         - -2: \p parameter_index is out of range.
+    ///                         - -4: The argument is not a constant.
+    ///                         - -5: The type of the argument does not match \p T.
+    template<class T>
+    Sint32 get_value( Size parameter_index, T& value) const;
+
+    /// Returns a non-compound argument (values of constants only, no calls).
+    ///
+    /// Returns the staged value if the argument has been changed since the last #commit().
+    ///
+    /// \param parameter_name   The name of the argument in question.
+    /// \param[out] value       The current value of the specified argument.
+    /// \return
+    ///                         -  0: Success.
+    ///                         - -1: #is_valid() returns \c false.
+    ///                         - -2: \p parameter_name is invalid.
+    ///                         - -4: The argument is not a constant.
+    ///                         - -5: The type of the argument does not match \p T.
+    template <class T>
+    Sint32 get_value( const char* parameter_name, T& value) const;
+
+    /// Stages a change of a non-compound argument.
+    ///
+    /// If the current argument is a call expression, it will be replaced by a constant expression
+    /// on #commit().
+    ///
+    /// If a literal \c 0 is passed for \p parameter_index, the call is ambiguous. You need to
+    /// explicitly cast the value to #mi::Size.
+    ///
+    /// \param parameter_index  The index of the argument in question.
+    /// \param value            The new value of the specified argument.
+    /// \return
+    ///                         -  0: Success.
+    ///                         - -1: #is_valid() returns \c false.
+    ///                         - -2: \p parameter_index is out of range.
+    ///                         - -5: The type of the argument does not match \p T.
+    template<class T>
+    Sint32 set_value( Size parameter_index, const T& value);
+
+    /// Stages a change of a non-compound argument.
+    ///
+    /// If the current argument is a call expression, it will be replaced by a constant expression
+    /// on #commit().
+    ///
+    /// \param parameter_name   The name of the argument in question.
+    /// \param value            The new value of the specified argument.
+    /// \return
+    ///                         -  0: Success.
+    ///                         - -1: #is_valid() returns \c false.
+    ///                         - -2: \p parameter_name is invalid.
+    ///                         - -5: The type of the argument does not match \p T.
+    template <class T>
+    Sint32 set_value( const char* parameter_name, const T& value);
+
+    /// Stages a change of a component of a compound argument.
+    ///
+    /// If the current argument is a call expression, it will be replaced by a constant expression
+    /// on #commit(), whose other components have default values.
+    ///
+    /// If a literal \c 0 is passed for \p parameter_index, the call is ambiguous. You need to
+    /// explicitly cast the value to #mi::Size.
+    ///
+    /// \param parameter_index  The index of the argument in question.
+    /// \param component_index  The index of the component in question.
+    /// \param value            The new value of the specified argument.
+    /// \return
+    ///                         -  0: Success.
+    ///                         - -1: #is_valid() returns \c false.
+    ///                         - -2: \p parameter_index is out of range.
+    ///                         - -3: \p component_index is out of range.
+    ///                         - -5: The type of the argument does not match \p T.
+    template<class T>
+    Sint32 set_value( Size parameter_index, Size component_index, const T& value);
+
+    /// Stages a change of a component of a compound argument.
+    ///
+    /// If the current argument is a call expression, it will be replaced by a constant expression
+    /// on #commit(), whose other components have default values.
+    ///
+    /// \param parameter_name   The name of the argument in question.
+    /// \param component_index  The index of the component in question.
+    /// \param value            The new value of the specified argument.
+    /// \return
+    ///                         -  0: Success.
+    ///                         - -1: #is_valid() returns \c false.
+    ///                         - -2: \p parameter_name is invalid.
+    ///                         - -3: \p component_index is out of range.
+    ///                         - -5: The type of the argument does not match \p T.
+    template <class T>
+    Sint32 set_value( const char* parameter_name, Size component_index, const T& value);
+
+    /// Stages a change of a field of a struct argument.
+    ///
+    /// If the current argument is a call expression, it will be replaced by a constant expression
+    /// on #commit(), whose other fields have default values.
+    ///
+    /// If a literal \c 0 is passed for \p parameter_index, the call is ambiguous. You need to
+    /// explicitly cast the value to #mi::Size.
+    ///
+    /// \param parameter_index  The index of the argument in question.
+    /// \param field_name       The name of the struct field in question.
+    /// \param value            The new value of the specified argument.
+    /// \return
+    ///                         -  0: Success.
+    ///                         - -1: #is_valid() returns \c false.
+    ///                         - -2: \p parameter_index is out of range.
+    ///                         - -3: \p field_name is invalid.
+    ///                         - -5: The type of the argument does not match \p T.
+    template<class T>
+    Sint32 set_value( Size parameter_index, const char* field_name, const T& value);
+
+    /// Stages a change of a field of a struct argument.
+    ///
+    /// If the current argument is a call expression, it will be replaced by a constant expression
+    /// on #commit(), whose other fields have default values.
+    ///
+    /// \param parameter_name   The name of the argument in question.
+    /// \param field_name       The name of the struct field in question.
+    /// \param value            The new value of the specified argument.
+    /// \return
+    ///                         -  0: Success.
+    ///                         - -1: #is_valid() returns \c false.
+    ///                         - -2: \p parameter_name is invalid.
+    ///                         - -3: \p field_name is invalid.
+    ///                         - -5: The type of the argument does not match \p T.
+    template <class T>
+    Sint32 set_value( const char* parameter_name, const char* field_name, const T& value);
+
+    //@}
+    /// \name Methods related to staged changes
+    //@{
+
+    /// Returns the number of arguments with staged changes.
+    Size get_staged_count() const;
+
+    /// Applies all staged changes in a single edit of the material instance or function call.
+    ///
+    /// The arguments are fetched again before the staged changes are applied, so that changes of
+    /// the DB element since the last fetch are not lost. The staged changes are discarded
+    /// afterwards, even if the edit fails.
+    ///
+    /// \return
+    ///                         -  0: Success, or there are no staged changes.
+    ///                         - -1: #is_valid() returns \c false.
+    ///                         - -4: The material instance or function call is immutable.
+    ///                         - <0: Any other error code of
+    ///                               #mi::neuraylib::IMaterial_instance::set_arguments() or
+    ///                               #mi::neuraylib::IFunction_call::set_arguments().
+    Sint32 commit();
+
+    /// Discards all staged changes.
+    void discard();
+
+    //@}
+
+private:
+    // Returns the staged value of an argument, which is created if needed, either as copy of the
+    // current constant argument if \p copy_current is set, or with default values otherwise.
+    // Sets \p created if the value was created by this call.
+    IValue* stage( Size parameter_index, bool copy_current, bool& created);
+
+    // Removes the most recently created staged value after a failed change.
+    void unstage_last();
+
+    // Returns the value of a current constant argument, or NULL if it is not a constant.
+    const IValue* get_current_value( Size parameter_index) const;
+
+    // Fetches the arguments of the material instance or function call.
+    void update_arguments();
+
+    base::Handle<ITransaction> m_transaction;
+    base::Handle<IValue_factory> m_value_factory;
+    base::Handle<IExpression_factory> m_expression_factory;
+    base::Handle<const IExpression_list> m_arguments;
+    Element_type m_type;
+    std::string m_name;
+    std::vector<std::string> m_parameter_names;
+    std::map<std::string, Size> m_parameter_indices;
+    std::vector<base::Handle<IValue> > m_staged_values;
+    std::vector<Size> m_staged_indices;
+};
+
+/*@}*/ // end group mi_neuray_mdl_elements
+
+inline Argument_batch_editor::Argument_batch_editor(
+    ITransaction* transaction, const char* name, IMdl_factory* mdl_factory)
+  : m_type( ELEMENT_TYPE_FORCE_32_BIT)
+{
+    mi_neuray_assert( transaction);
+    mi_neuray_assert( name);
+    mi_neuray_assert( mdl_factory);
+
+    m_transaction = make_handle_dup( transaction);
+    m_name = name;
+    m_value_factory = mdl_factory->create_value_factory( m_transaction.get());
+    m_expression_factory = mdl_factory->create_expression_factory( m_transaction.get());
+
+    base::Handle<const IScene_element> access( transaction->access<IScene_element>( name));
+    if( !access)
+        return;
+    m_type = access->get_element_type();
+    update_arguments();
+    if( !m_arguments)
+        return;
+
+    const Size count = m_arguments->get_size();
+    m_parameter_names.resize( count);
+    m_staged_values.resize( count);
+    for( Size i = 0; i < count; ++i) {
+        m_parameter_names[i] = m_arguments->get_name( i);
+        m_parameter_indices[m_parameter_names[i]] = i;
+    }
+}
+
+inline bool Argument_batch_editor::is_valid() const
+{
+    return m_arguments
+        && (m_type == ELEMENT_TYPE_MATERIAL_INSTANCE ||  m_type == ELEMENT_TYPE_FUNCTION_CALL);
+}
+
+inline Element_type Argument_batch_editor::get_type() const
+{
+    return m_type;
+}
+
+inline Size Argument_batch_editor::get_parameter_count() const
+{
+    return m_parameter_names.size();
+}
+
+inline const char* Argument_batch_editor::get_parameter_name( Size index) const
+{
+    return index < m_parameter_names.size() ? m_parameter_names[index].c_str() : 0;
+}
+
+inline Size Argument_batch_editor::get_parameter_index( const char* name) const
+{
+    if( !name)
+        return static_cast<Size>( -1);
+    std::map<std::string, Size>::const_iterator it = m_parameter_indices.find( name);
+    return it != m_parameter_indices.end() ? it->second : static_cast<Size>( -1);
+}
+
+inline const std::string& Argument_batch_editor::get_name() const
+{
+    return m_name;
+}
+
+template <class T>
+Sint32 Argument_batch_editor::get_value( Size parameter_index, T& value) const
+{
+    if( !is_valid())
+        return -1;
+    if( parameter_index >= m_parameter_names.size())
+        return -2;
+
+    if( m_staged_values[parameter_index]) {
+        Sint32 result = neuraylib::get_value( m_staged_values[parameter_index].get(), value);
+        return result == 0 ? 0 : -5;
+    }
+
+    base::Handle<const IValue> argument_value( get_current_value( parameter_index));
+    if( !argument_value)
+        return -4;
+    Sint32 result = neuraylib::get_value( argument_value.get(), value);
+    return result == 0 ? 0 : -5;
+}
+
+template <class T>
+Sint32 Argument_batch_editor::get_value( const char* parameter_name, T& value) const
+{
+    if( !is_valid())
+        return -1;
+    return get_value( get_parameter_index( parameter_name), value);
+}
+
+template <class T>
+Sint32 Argument_batch_editor::set_value( Size parameter_index, const T& value)
+{
+    if( !is_valid())
+        return -1;
+    if( parameter_index >= m_parameter_names.size())
+        return -2;
+
+    bool created = false;
+    IValue* new_value = stage( parameter_index, /*copy_current*/ false, created);
+    Sint32 result = neuraylib::set_value( new_value, value);
+    if( result != 0) {
+        if( created)
+            unstage_last();
+        return -5;
+    }
+    return 0;
+}
+
+template <class T>
+Sint32 Argument_batch_editor::set_value( const char* parameter_name, const T& value)
+{
+    if( !is_valid())
+        return -1;
+    return set_value( get_parameter_index( parameter_name), value);
+}
+
+template <class T>
+Sint32 Argument_batch_editor::set_value(
+    Size parameter_index, Size component_index, const T& value)
+{
+    if( !is_valid())
+        return -1;
+    if( parameter_index >= m_parameter_names.size())
+        return -2;
+
+    bool created = false;
+    IValue* new_value = stage( parameter_index, /*copy_current*/ true, created);
+    Sint32 result = neuraylib::set_value( new_value, component_index, value);
+    if( result != 0) {
+        if( created)
+            unstage_last();
+        return result == -3 ? -3 : -5;
+    }
+    return 0;
+}
+
+template <class T>
+Sint32 Argument_batch_editor::set_value(
+    const char* parameter_name, Size component_index, const T& value)
+{
+    if( !is_valid())
+        return -1;
+    return set_value( get_parameter_index( parameter_name), component_index, value);
+}
+
+template <class T>
+Sint32 Argument_batch_editor::set_value(
+    Size parameter_index, const char* field_name, const T& value)
+{
+    if( !is_valid())
+        return -1;
+    if( parameter_index >= m_parameter_names.size())
+        return -2;
+
+    bool created = false;
+    IValue* new_value = stage( parameter_index, /*copy_current*/ true, created);
+    Sint32 result = neuraylib::set_value( new_value, field_name, value);
+    if( result != 0) {
+        if( created)
+            unstage_last();
+        return result == -3 ? -3 : -5;
+    }
+    return 0;
+}
+
+template <class T>
+Sint32 Argument_batch_editor::set_value(
+    const char* parameter_name, const char* field_name, const T& value)
+{
+    if( !is_valid())
+        return -1;
+    return set_value( get_parameter_index( parameter_name), field_name, value);
+}
+
+inline Size Argument_batch_editor::get_staged_count() const
+{
+    return m_staged_indices.size();
+}
+
+inline Sint32 Argument_batch_editor::commit()
+{
+    if( !is_valid())
+        return -1;
+    if( m_staged_indices.empty())
+        return 0;
+
+    // Pick up changes of the DB element since the arguments were fetched.
+    update_arguments();
+    if( !m_arguments) {
+        discard();
+        return -1;
+    }
+
+    base::Handle<IExpression_list> arguments( m_expression_factory->create_expression_list());
+    for( Size i = 0, n = m_staged_indices.size(); i < n; ++i) {
+        const Size index = m_staged_indices[i];
+        base::Handle<IExpression> expression(
+            m_expression_factory->create_constant( m_staged_values[index].get()));
+        arguments->add_expression( m_parameter_names[index].c_str(), expression.get());
+    }
+    discard();
+
+    Sint32 result = -1;
+    if( m_type == ELEMENT_TYPE_MATERIAL_INSTANCE) {
+
+        base::Handle<IMaterial_instance> mi(
+            m_transaction->edit<IMaterial_instance>( m_name.c_str()));
+        mi_neuray_assert( mi);
+        result = mi->set_arguments( arguments.get());
+
+    } else if( m_type == ELEMENT_TYPE_FUNCTION_CALL) {
+
+        base::Handle<IFunction_call> fc( m_transaction->edit<IFunction_call>( m_name.c_str()));
+        mi_neuray_assert( fc);
+        result = fc->set_arguments( arguments.get());
+    }
+
+    update_arguments();
+    return result;
+}
+
+inline void Argument_batch_editor::discard()
+{
+    for( Size i = 0, n = m_staged_indices.size(); i < n; ++i)
+        m_staged_values[m_staged_indices[i]] = 0;
+    m_staged_indices.clear();
+}
+
+inline IValue* Argument_batch_editor::stage(
+    Size parameter_index, bool copy_current, bool& created)
+{
+    created = false;
+    if( m_staged_values[parameter_index])
+        return m_staged_values[parameter_index].get();
+
+    base::Handle<const IValue> current_value(
+        copy_current ? get_current_value( parameter_index) : 0);
+    if( current_value) {
+        m_staged_values[parameter_index] = m_value_factory->clone( current_value.get());
+    } else {
+        base::Handle<const IExpression> argument( m_arguments->get_expression( parameter_index));
+        base::Handle<const IType> type( argument->get_type());
+        m_staged_values[parameter_index] = m_value_factory->create( type.get());
+    }
+    m_staged_indices.push_back( parameter_index);
+    created = true;
+    return m_staged_values[parameter_index].get();
+}
+
+inline void Argument_batch_editor::unstage_last()
+{
+    mi_neuray_assert( !m_staged_indices.empty());
+    m_staged_values[m_staged_indices.back()] = 0;
+    m_staged_indices.pop_back();
+}
+
+inline const IValue* Argument_batch_editor::get_current_value( Size parameter_index) const
+{
+    base::Handle<const IExpression_constant> argument(
+        m_arguments->get_expression<IExpression_constant>( parameter_index));
+    return argument ? argument->get_value() : 0;
+}
+
+inline void Argument_batch_editor::update_arguments()
+{
+    if( m_type == ELEMENT_TYPE_MATERIAL_INSTANCE) {
+
+        base::Handle<const IMaterial_instance> mi(
+            m_transaction->access<IMaterial_instance>( m_name.c_str()));
+        m_arguments = mi ? mi->get_arguments() : 0;
+
+    } else if( m_type == ELEMENT_TYPE_FUNCTION_CALL) {
+
+        base::Handle<const IFunction_call> fc(
+            m_transaction->access<IFunction_call>( m_name.c_str()));
+        m_arguments = fc ? fc->get_arguments() : 0;
+
+    } else
+        m_arguments = 0;
+}
+
+} // namespace neuraylib
+
+} // namespace mi
+
+#endif // MI_NEURAYLIB_ARGUMENT_BATCH_EDITOR_H